@@ -25,6 +25,7 @@
 
 #include <graphene/app/api.hpp>
 #include <graphene/app/api_access.hpp>
+#include <graphene/app/api_workers.hpp>
 #include <graphene/app/application.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/get_config.hpp>
@@ -36,7 +37,10 @@
 #include <graphene/chain/withdraw_permission_object.hpp>
 #include <graphene/chain/worker_object.hpp>
 #include <graphene/chain/tournament_object.hpp>
+#include <graphene/market_history/market_history_store.hpp>
+#include <graphene/account_history/account_history_plugin.hpp>
 
+#include <fc/crypto/base64.hpp>
 #include <fc/crypto/hex.hpp>
 #include <fc/rpc/api_connection.hpp>
 #include <fc/thread/future.hpp>
@@ -88,11 +92,11 @@ namespace graphene { namespace app {
     {
        if( api_name == "database_api" )
        {
-          _database_api = std::make_shared< database_api >( std::ref( *_app.chain_database() ) );
+          _database_api = std::make_shared< database_api >( std::ref( *_app.chain_database() ), &_app );
        }
        else if( api_name == "block_api" )
        {
-          _block_api = std::make_shared< block_api >( std::ref( *_app.chain_database() ) );
+          _block_api = std::make_shared< block_api >( std::ref( *_app.chain_database() ), &_app );
        }
        else if( api_name == "network_broadcast_api" )
        {
@@ -136,16 +140,55 @@ namespace graphene { namespace app {
     }
 
     // block_api
-    block_api::block_api(graphene::chain::database& db) : _db(db) { }
+    block_api::block_api(graphene::chain::database& db, application* app) : _db(db), _app(app) { }
     block_api::~block_api() { }
 
     vector<optional<signed_block>> block_api::get_blocks(uint32_t block_num_from, uint32_t block_num_to)const
     {
        FC_ASSERT( block_num_to >= block_num_from && block_num_to - block_num_from <= 100, "Total blocks to be returned should be less than 100");
-       vector<optional<signed_block>> res;
-       for(uint32_t block_num=block_num_from; block_num<=block_num_to; block_num++) {
-          res.push_back(_db.fetch_block_by_number(block_num));
-       }
+       const vector<packed_block> packed = _db.fetch_packed_blocks( block_num_from, block_num_to, max_blocks_bytes );
+       vector<optional<signed_block>> res( packed.size() );
+       auto unpack = [&]( size_t i ) {
+          if( packed[i].data.empty() )
+             return;
+          try {
+             signed_block block = fc::raw::unpack<signed_block>( packed[i].data );
+             if( block.id() == packed[i].id )
+                res[i] = std::move( block );
+          } catch( const fc::exception& ) {
+          }
+       };
+       if( _app )
+          _app->api_workers("block").for_each( packed.size(), unpack );
+       else
+          for( size_t i = 0; i < packed.size(); ++i )
+             unpack( i );
+       return res;
+    }
+
+    vector<optional<raw_block>> block_api::get_raw_blocks(uint32_t block_num_from, uint32_t block_num_to,
+                                                          const string& encoding)const
+    {
+       FC_ASSERT( block_num_to >= block_num_from && block_num_to - block_num_from <= 1000, "Total blocks to be returned should be less than 1000");
+       FC_ASSERT( encoding == "hex" || encoding == "base64", "Unknown encoding ${e}, expected hex or base64", ("e", encoding) );
+       const bool base64 = encoding == "base64";
+       const vector<packed_block> packed = _db.fetch_packed_blocks( block_num_from, block_num_to, max_blocks_bytes );
+       vector<optional<raw_block>> res( packed.size() );
+       auto encode = [&]( size_t i ) {
+          if( packed[i].data.empty() )
+             return;
+          raw_block block;
+          block.block_num = block_num_from + i;
+          block.id = packed[i].id;
+          block.data = base64 ? fc::base64_encode( (const unsigned char*)packed[i].data.data(), packed[i].data.size() )
+                              : fc::to_hex( packed[i].data.data(), packed[i].data.size() );
+          res[i] = std::move( block );
+       };
+       if( _app )
+          _app->api_workers("block").for_each( packed.size(), encode );
+       else
+          for( size_t i = 0; i < packed.size(); ++i )
+             encode( i );
        return res;
     }
 
@@ -547,29 +590,22 @@ namespace graphene { namespace app {
 
     vector<order_history_object> history_api::get_fill_order_history( std::string asset_a, std::string asset_b, uint32_t limit  )const
     {
-       FC_ASSERT(_app.chain_database());
-       const auto& db = *_app.chain_database();
+       auto hist = _app.get_plugin<market_history_plugin>( "market_history" );
+       FC_ASSERT( hist );
        asset_id_type a = database_api.get_asset_id_from_string( asset_a );
        asset_id_type b = database_api.get_asset_id_from_string( asset_b );
        if( a > b ) std::swap(a,b);
-       const auto& history_idx = db.get_index_type<graphene::market_history::history_index>().indices().get<by_key>();
-       history_key hkey;
-       hkey.base = a;
-       hkey.quote = b;
-       hkey.sequence = std::numeric_limits<int64_t>::min();
-
-       uint32_t count = 0;
-       auto itr = history_idx.lower_bound( hkey );
-       vector<order_history_object> result;
-       while( itr != history_idx.end() && count < limit)
-       {
-          if( itr->key.base != a || itr->key.quote != b ) break;
-          result.push_back( *itr );
-          ++itr;
-          ++count;
-       }
 
-       return result;
+       return _app.api_workers( "history" ).run( *_app.chain_database(), [&]() -> vector<order_history_object> {
+          vector<order_history_object> result;
+          const auto* fills = hist->get_market_history_store().get_fills( a, b );
+          if( !fills )
+             return result;
+          // newest first
+          for( auto itr = fills->rbegin(); itr != fills->rend() && result.size() < limit; ++itr )
+             result.push_back( *itr );
+          return result;
+       });
     }
 
     vector<operation_history_object> history_api::get_account_history( const std::string account_id_or_name,
@@ -592,31 +628,31 @@ namespace graphene { namespace app {
         if(_app.is_plugin_enabled("elasticsearch")) {
            auto es = _app.get_plugin<elasticsearch::elasticsearch_plugin>("elasticsearch");
            if(es.get()->get_running_mode() != elasticsearch::mode::only_save) {
-              if(!_app.elasticsearch_thread)
-                 _app.elasticsearch_thread= std::make_shared<fc::thread>("elasticsearch");
-
-              return _app.elasticsearch_thread->async([&es, &account, &stop, &limit, &start]() {
+              // the query neither reads the chain nor holds its mutex, blocks are applied while it waits on the node
+              return _app.api_workers( "elasticsearch" ).run_unlocked( [&]() {
                  return es->get_account_history(account, stop, limit, start);
-              }, "thread invoke for method " BOOST_PP_STRINGIZE(method_name)).wait();
+              });
            }
         }
 
-        const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
-        const auto& by_op_idx = hist_idx.indices().get<by_op>();
-        auto index_start = by_op_idx.begin();
-        auto itr = by_op_idx.lower_bound(boost::make_tuple(account, start));
-
-        while(itr != index_start && itr->account == account && itr->operation_id.instance.value > stop.instance.value && result.size() < limit)
-        {
-           if(itr->operation_id.instance.value <= start.instance.value)
-              result.push_back(itr->operation_id(db));
-           --itr;
-        }
-        if(stop.instance.value == 0 && result.size() < limit && itr->account == account) {
-          result.push_back(itr->operation_id(db));
-        }
+        return _app.api_workers( "history" ).run( db, [&]() {
+           const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
+           const auto& by_op_idx = hist_idx.indices().get<by_op>();
+           auto index_start = by_op_idx.begin();
+           auto itr = by_op_idx.lower_bound(boost::make_tuple(account, start));
+
+           while(itr != index_start && itr->account == account && itr->operation_id.instance.value > stop.instance.value && result.size() < limit)
+           {
+              if(itr->operation_id.instance.value <= start.instance.value)
+                 result.push_back(itr->operation_id(db));
+              --itr;
+           }
+           if(stop.instance.value == 0 && result.size() < limit && itr->account == account) {
+             result.push_back(itr->operation_id(db));
+           }
 
-        return result;
+           return result;
+        });
     }
 
     vector<operation_history_object> history_api::get_account_history_operations( const std::string account_id_or_name,
@@ -634,29 +670,48 @@ namespace graphene { namespace app {
          account = database_api.get_account_id_from_string(account_id_or_name);
        } catch (...) { return result; }
        
-       const auto& stats = account(db).statistics(db);
-       if( stats.most_recent_op == account_transaction_history_id_type() ) return result;
-       const account_transaction_history_object* node = &stats.most_recent_op(db);
-       if( start == operation_history_id_type() )
-          start = node->operation_id;
+       auto plugin = _app.get_plugin<account_history::account_history_plugin>( "account_history" );
+       const account_history::account_history_by_op_type_index* by_op_type = plugin ? plugin->history_by_op_type() : nullptr;
 
-       while(node && node->operation_id.instance.value > stop.instance.value && result.size() < limit)
-       {
-          if( node->operation_id.instance.value <= start.instance.value ) {
+       return _app.api_workers( "history" ).run( db, [&]() -> vector<operation_history_object> {
+          if( by_op_type )
+          {
+             if( start != operation_history_id_type() && start < stop )
+                return result;
+             const auto& idx = by_op_type->entries().get<account_history::by_account_op_type>();
+             auto itr = start == operation_history_id_type() ? idx.upper_bound( boost::make_tuple( account, operation_id ) )
+                                                             : idx.upper_bound( boost::make_tuple( account, operation_id, start ) );
+             auto first = stop == operation_history_id_type() ? idx.lower_bound( boost::make_tuple( account, operation_id ) )
+                                                              : idx.upper_bound( boost::make_tuple( account, operation_id, stop ) );
+             while( itr != first && result.size() < limit )
+                result.push_back( (--itr)->operation_id(db) );
+             return result;
+          }
 
-             if(node->operation_id(db).op.which() == operation_id)
-               result.push_back( node->operation_id(db) );
+          const auto& stats = account(db).statistics(db);
+          if( stats.most_recent_op == account_transaction_history_id_type() ) return result;
+          const account_transaction_history_object* node = &stats.most_recent_op(db);
+          if( start == operation_history_id_type() )
+             start = node->operation_id;
+
+          while(node && node->operation_id.instance.value > stop.instance.value && result.size() < limit)
+          {
+             if( node->operation_id.instance.value <= start.instance.value ) {
+
+                if(node->operation_id(db).op.which() == operation_id)
+                  result.push_back( node->operation_id(db) );
+             }
+             if( node->next == account_transaction_history_id_type() )
+                node = nullptr;
+             else node = &node->next(db);
           }
-          if( node->next == account_transaction_history_id_type() )
-             node = nullptr;
-          else node = &node->next(db);
-       }
-       if( stop.instance.value == 0 && result.size() < limit ) {
-          auto head = db.find(account_transaction_history_id_type());
-          if (head != nullptr && head->account == account && head->operation_id(db).op.which() == operation_id)
-            result.push_back(head->operation_id(db));
-       }
-       return result;
+          if( stop.instance.value == 0 && result.size() < limit ) {
+             auto head = db.find(account_transaction_history_id_type());
+             if (head != nullptr && head->account == account && head->operation_id(db).op.which() == operation_id)
+               result.push_back(head->operation_id(db));
+          }
+          return result;
+       });
     }
 
 
@@ -673,29 +728,31 @@ namespace graphene { namespace app {
        try {
           account = database_api.get_account_id_from_string(account_id_or_name);
        } catch(...) { return result; }
-       const auto& stats = account(db).statistics(db);
-       if( start == 0 )
-          start = stats.total_ops;
-       else
-          start = min( stats.total_ops, start );
+       return _app.api_workers( "history" ).run( db, [&]() -> vector<operation_history_object> {
+          const auto& stats = account(db).statistics(db);
+          if( start == 0 )
+             start = stats.total_ops;
+          else
+             start = min( stats.total_ops, start );
 
 
-       if( start >= stop && start > stats.removed_ops && limit > 0 )
-       {
-          const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
-          const auto& by_seq_idx = hist_idx.indices().get<by_seq>();
+          if( start >= stop && start > stats.removed_ops && limit > 0 )
+          {
+             const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
+             const auto& by_seq_idx = hist_idx.indices().get<by_seq>();
 
-          auto itr = by_seq_idx.upper_bound( boost::make_tuple( account, start ) );
-          auto itr_stop = by_seq_idx.lower_bound( boost::make_tuple( account, stop ) );
+             auto itr = by_seq_idx.upper_bound( boost::make_tuple( account, start ) );
+             auto itr_stop = by_seq_idx.lower_bound( boost::make_tuple( account, stop ) );
 
-          do
-          {
-             --itr;
-             result.push_back( itr->operation_id(db) );
+             do
+             {
+                --itr;
+                result.push_back( itr->operation_id(db) );
+             }
+             while ( itr != itr_stop && result.size() < limit );
           }
-          while ( itr != itr_stop && result.size() < limit );
-       }
-       return result;
+          return result;
+       });
     }
 
     vector<account_balance_object> history_api::list_core_accounts()const
@@ -715,29 +772,26 @@ namespace graphene { namespace app {
     vector<bucket_object> history_api::get_market_history( std::string asset_a, std::string asset_b,
                                                            uint32_t bucket_seconds, fc::time_point_sec start, fc::time_point_sec end )const
     { try {
-       FC_ASSERT(_app.chain_database());
-       const auto& db = *_app.chain_database();
+       auto hist = _app.get_plugin<market_history_plugin>( "market_history" );
+       FC_ASSERT( hist );
        asset_id_type a = database_api.get_asset_id_from_string( asset_a );
        asset_id_type b = database_api.get_asset_id_from_string( asset_b );
-       vector<bucket_object> result;
-       result.reserve(200);
-
        if( a > b ) std::swap(a,b);
 
-       const auto& bidx = db.get_index_type<bucket_index>();
-       const auto& by_key_idx = bidx.indices().get<by_key>();
+       return _app.api_workers( "history" ).run( *_app.chain_database(), [&]() -> vector<bucket_object> {
+          vector<bucket_object> result;
+          result.reserve(200);
 
-       auto itr = by_key_idx.lower_bound( bucket_key( a, b, bucket_seconds, start ) );
-       while( itr != by_key_idx.end() && itr->key.open <= end && result.size() < 200 )
-       {
-          if( !(itr->key.base == a && itr->key.quote == b && itr->key.seconds == bucket_seconds) )
-          {
-            return result;
-          }
-          result.push_back(*itr);
-          ++itr;
-       }
-       return result;
+          const auto* buckets = hist->get_market_history_store().get_buckets( a, b, bucket_seconds );
+          if( !buckets )
+             return result;
+
+          auto itr = std::lower_bound( buckets->begin(), buckets->end(), start,
+                                       []( const bucket_object& bucket, fc::time_point_sec t ) { return bucket.key.open < t; } );
+          for( ; itr != buckets->end() && itr->key.open <= end && result.size() < 200; ++itr )
+             result.push_back(*itr);
+          return result;
+       });
     } FC_CAPTURE_AND_RETHROW( (asset_a)(asset_b)(bucket_seconds)(start)(end) ) }
 
     crypto_api::crypto_api(){};
@@ -807,71 +861,55 @@ namespace graphene { namespace app {
       FC_ASSERT(limit <= 100);
 
       asset_id_type asset_id = database_api.get_asset_id_from_string( asset );
-      const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
-      auto range = bal_idx.equal_range( boost::make_tuple( asset_id ) );
+      return _app.api_workers( "asset" ).run( _db, [&]() {
+         const auto& holders = _db.get_index_type< primary_index< account_balance_index > >().get_secondary_index< asset_holders_index >();
 
-      vector<account_asset_balance> result;
+         vector<account_asset_balance> result;
+         for( const account_balance_object* bal : holders.get_holders( asset_id, start, limit ) )
+         {
+           const auto account = _db.find(bal->owner);
 
-      uint32_t index = 0;
-      for( const account_balance_object& bal : boost::make_iterator_range( range.first, range.second ) )
-      {
-        if( result.size() >= limit )
-            break;
+           account_asset_balance aab;
+           aab.name       = account->name;
+           aab.account_id = account->id;
+           aab.amount     = bal->balance.value;
 
-        if( bal.balance.value == 0 )
-            continue;
+           result.push_back(aab);
+         }
 
-        if( index++ < start )
-            continue;
-
-        const auto account = _db.find(bal.owner);
-
-        account_asset_balance aab;
-        aab.name       = account->name;
-        aab.account_id = account->id;
-        aab.amount     = bal.balance.value;
-
-        result.push_back(aab);
-      }
-
-      return result;
+         return result;
+      });
     }
     // get number of asset holders.
     int asset_api::get_asset_holders_count( std::string asset ) const {
 
-      const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
       asset_id_type asset_id = database_api.get_asset_id_from_string( asset );
-      auto range = bal_idx.equal_range( boost::make_tuple( asset_id ) );
-      int count = boost::distance(range) - 1;
-
-      return count;
+      const auto& holders = _db.get_index_type< primary_index< account_balance_index > >().get_secondary_index< asset_holders_index >();
+      return int( holders.balance_count( asset_id ) ) - 1;
     }
     // function to get vector of system assets with holders count.
     vector<asset_holders> asset_api::get_all_asset_holders() const {
 
-      vector<asset_holders> result;
-
-      vector<asset_id_type> total_assets;
-      for( const asset_object& asset_obj : _db.get_index_type<asset_index>().indices() )
-      {
-        const auto& dasset_obj = asset_obj.dynamic_asset_data_id(_db);
-
-        asset_id_type asset_id;
-        asset_id = dasset_obj.id;
+      return _app.api_workers( "asset" ).run( _db, [&]() {
+         vector<asset_holders> result;
+         const auto& holders = _db.get_index_type< primary_index< account_balance_index > >().get_secondary_index< asset_holders_index >();
 
-        const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
-        auto range = bal_idx.equal_range( boost::make_tuple( asset_id ) );
+         for( const asset_object& asset_obj : _db.get_index_type<asset_index>().indices() )
+         {
+           const auto& dasset_obj = asset_obj.dynamic_asset_data_id(_db);
 
-        int count = boost::distance(range) - 1;
+           asset_id_type asset_id;
+           asset_id = dasset_obj.id;
 
-        asset_holders ah;
-        ah.asset_id       = asset_id;
-        ah.count     = count;
+           asset_holders ah;
+           ah.asset_id       = asset_id;
+           ah.count     = int( holders.balance_count( asset_id ) ) - 1;
 
-        result.push_back(ah);
-      }
+           result.push_back(ah);
+         }
 
-      return result;
+         return result;
+      });
     }
 
 } } // graphene::app
@@ -23,7 +23,10 @@
  */
 #include <graphene/app/api.hpp>
 #include <graphene/app/api_access.hpp>
+#include <graphene/app/api_workers.hpp>
 #include <graphene/app/application.hpp>
+#include <graphene/app/full_account_cache.hpp>
+#include <graphene/app/object_notifications.hpp>
 #include <graphene/app/plugin.hpp>
 
 #include <graphene/chain/protocol/fee_schedule.hpp>
@@ -295,8 +298,12 @@ namespace detail {
 
       explicit application_impl(application* self)
          : _self(self),
-           _chain_db(std::make_shared<chain::database>())
+           _chain_db(std::make_shared<chain::database>()),
+           _object_notifications(new object_notification_hub(*_chain_db)),
+           _full_accounts(new full_account_cache(*_chain_db, *_object_notifications))
       {
+         for( const string api : { "database", "history", "asset", "block", "elasticsearch" } )
+            _api_workers[api].reset( new api_worker_pool( api + " API", 0 ) );
       }
 
       ~application_impl()
@@ -888,12 +895,15 @@ namespace detail {
       api_access _apiaccess;
 
       std::shared_ptr<graphene::chain::database>            _chain_db;
+      std::unique_ptr<object_notification_hub>              _object_notifications;
+      std::unique_ptr<full_account_cache>                   _full_accounts;
       std::shared_ptr<graphene::net::node>                  _p2p_network;
       std::shared_ptr<fc::http::websocket_server>      _websocket_server;
       std::shared_ptr<fc::http::websocket_tls_server>  _websocket_tls_server;
 
       std::map<string, std::shared_ptr<abstract_plugin>> _active_plugins;
       std::map<string, std::shared_ptr<abstract_plugin>> _available_plugins;
+      std::map<string, std::unique_ptr<api_worker_pool>> _api_workers;
 
       bool _is_finished_syncing = false;
    };
@@ -936,6 +946,19 @@ void application::set_program_options(boost::program_options::options_descriptio
           "Whether to enable tracking of votes of standby witnesses and committee members. "
           "Set it to true to provide accurate data to API clients, set to false for slightly better performance.")
          ("plugins", bpo::value<string>(), "Space-separated list of plugins to activate")
+         ("database-api-threads", bpo::value<uint32_t>()->default_value(0),
+          "Number of threads running the expensive read-only calls of the database API, 0 to run them on the main thread")
+         ("history-api-threads", bpo::value<uint32_t>()->default_value(0),
+          "Number of threads running the read-only calls of the history API, 0 to run them on the main thread")
+         ("asset-api-threads", bpo::value<uint32_t>()->default_value(0),
+          "Number of threads running the read-only calls of the asset API, 0 to run them on the main thread")
+         ("block-api-threads", bpo::value<uint32_t>()->default_value(0),
+          "Number of threads unpacking and encoding the blocks the block API returns, 0 to do it on the main thread")
+         ("elasticsearch-api-threads", bpo::value<uint32_t>()->default_value(1),
+          "Number of threads running the account history queries to elasticsearch concurrently, started with the "
+          "elasticsearch plugin; at least one, so that a query never blocks the main thread")
+         ("full-account-cache-size", bpo::value<uint32_t>()->default_value(5000),
+          "Number of full accounts kept assembled for the database API, 0 to assemble them on every request")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
@@ -982,6 +1005,16 @@ void application::initialize(const fc::path& data_dir, const boost::program_opti
       std::exit(EXIT_SUCCESS);
    }
 
+   for( const string api : { "database", "history", "asset", "block" } )
+   {
+      const string option = api + "-api-threads";
+      if( options.count(option) && options.at(option).as<uint32_t>() > 0 )
+         my->_api_workers[api].reset( new api_worker_pool( api + " API", options.at(option).as<uint32_t>() ) );
+   }
+
+   if( options.count("full-account-cache-size") )
+      my->_full_accounts->set_max_accounts( options.at("full-account-cache-size").as<uint32_t>() );
+
    std::set<string> wanted;
    if( options.count("plugins") )
    {
@@ -1011,6 +1044,14 @@ void application::initialize(const fc::path& data_dir, const boost::program_opti
       }
       if (!it.empty()) enable_plugin(it);
    }
+
+   // the queries wait on the elasticsearch node, they always get a thread of their own
+   if( wanted.count("elasticsearch") )
+   {
+      const uint32_t threads = options.count("elasticsearch-api-threads") ?
+                               options.at("elasticsearch-api-threads").as<uint32_t>() : 1;
+      my->_api_workers["elasticsearch"].reset( new api_worker_pool( "elasticsearch API", std::max<uint32_t>( threads, 1 ) ) );
+   }
 }
 
 void application::startup()
@@ -1028,7 +1069,8 @@ void application::startup()
 
 std::shared_ptr<abstract_plugin> application::get_plugin(const string& name) const
 {
-   return my->_active_plugins[name];
+   auto itr = my->_active_plugins.find(name);
+   return itr != my->_active_plugins.end() ? itr->second : std::shared_ptr<abstract_plugin>();
 }
 
 bool application::is_plugin_enabled(const string& name) const
@@ -1046,6 +1088,23 @@ std::shared_ptr<chain::database> application::chain_database() const
    return my->_chain_db;
 }
 
+object_notification_hub& application::object_notifications() const
+{
+   return *my->_object_notifications;
+}
+
+full_account_cache& application::full_accounts() const
+{
+   return *my->_full_accounts;
+}
+
+api_worker_pool& application::api_workers(const string& api) const
+{
+   auto itr = my->_api_workers.find(api);
+   FC_ASSERT( itr != my->_api_workers.end(), "Unknown API ${api}", ("api", api) );
+   return *itr->second;
+}
+
 void application::set_block_production(bool producing_blocks)
 {
    my->_is_block_producer = producing_blocks;
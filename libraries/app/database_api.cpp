@@ -23,11 +23,17 @@
  */
 
 #include <graphene/app/database_api.hpp>
+#include <graphene/app/api_workers.hpp>
+#include <graphene/app/application.hpp>
+#include <graphene/app/full_account_cache.hpp>
+#include <graphene/app/object_notifications.hpp>
 #include <graphene/chain/get_config.hpp>
 #include <graphene/chain/tournament_object.hpp>
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/protocol/address.hpp>
 #include <graphene/chain/pts_address.hpp>
+#include <graphene/market_history/market_history_store.hpp>
+#include <graphene/market_history/order_book_feed.hpp>
 
 #include <fc/bloom_filter.hpp>
 
@@ -40,6 +46,7 @@
 #include <boost/multiprecision/cpp_int.hpp>
 
 #include <cctype>
+#include <cmath>
 
 #include <cfenv>
 #include <iostream>
@@ -55,7 +62,7 @@ namespace graphene { namespace app {
 class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 {
    public:
-      database_api_impl( graphene::chain::database& db );
+      database_api_impl( graphene::chain::database& db, const application* app );
       ~database_api_impl();
 
       // Objects
@@ -90,6 +97,9 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       account_id_type get_account_id_from_string(const std::string& name_or_id)const;
       vector<optional<account_object>> get_accounts(const vector<std::string>& account_names_or_ids)const;
       std::map<string,full_account> get_full_accounts( const vector<string>& names_or_ids, bool subscribe );
+      std::map<string,full_account> load_full_accounts( const vector<string>& names_or_ids )const;
+      full_account build_full_account( const account_object& account )const;
+      std::map<string,full_account_delta> get_full_accounts_delta( const vector<string>& names_or_ids, uint32_t since_block )const;
       optional<account_object> get_account_by_name( string name )const;
       vector<account_id_type> get_account_references( const std::string account_id_or_name )const;
       vector<optional<account_object>> lookup_account_names(const vector<string>& account_names)const;
@@ -140,9 +150,16 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       vector<call_order_object>          get_margin_positions( const std::string account_id_or_name )const;
       void subscribe_to_market(std::function<void(const variant&)> callback, const std::string& a, const std::string& b);
       void unsubscribe_from_market(const std::string& a, const std::string& b);
+      order_book_snapshot subscribe_to_order_book(std::function<void(const variant&)> callback, const std::string& a, const std::string& b);
+      void unsubscribe_from_order_book(const std::string& a, const std::string& b);
+      order_book_snapshot get_order_book_snapshot(const std::string& a, const std::string& b)const;
       market_ticker                      get_ticker( const string& base, const string& quote )const;
+      /// the part of a ticker kept by market_history: latest price, 24 hour volume and change, without the order book
+      market_ticker                      get_ticker_aggregates( const string& base, const string& quote )const;
+      vector<market_ticker>              get_tickers( const vector<std::pair<string, string>>& markets )const;
       market_volume                      get_24_volume( const string& base, const string& quote )const;
       order_book                         get_order_book( const string& base, const string& quote, unsigned limit = 50 )const;
+      order_book                         get_order_book_depth( const string& base, const string& quote, uint8_t precision, unsigned limit = 100 )const;
       vector<market_trade>               get_trade_history( const string& base, const string& quote, fc::time_point_sec start, fc::time_point_sec stop, unsigned limit = 100 )const;
 
       // Witnesses
@@ -239,6 +256,17 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       vector<account_role_object> get_account_roles_by_owner(account_id_type owner) const;
 
    //private:
+      /// run a call that only reads the chain and plugin indexes on the database API workers, if any
+      template<typename Callable>
+      auto read_only( Callable&& call )const -> decltype( call() )
+      {
+         if( _app == nullptr )
+            return call();
+         return _app->api_workers( "database" ).run( _db, std::forward<Callable>( call ) );
+      }
+
+      full_account_cache& get_full_account_cache()const;
+
       const account_object* get_account_from_string( const std::string& name_or_id,
                                                      bool throw_if_not_found = true ) const;
       const asset_object* get_asset_from_string( const std::string& symbol_or_id,
@@ -276,28 +304,26 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       }
 
       template<typename T>
-      void enqueue_if_subscribed_to_market(const object* obj, market_queue_type& queue, bool full_object=true)
+      void enqueue_if_subscribed_to_market(const object_notification& notification, size_t index, market_queue_type& queue, bool full_object=true)
       {
-         const T* order = dynamic_cast<const T*>(obj);
+         const T* order = dynamic_cast<const T*>(notification.get_object(index));
          FC_ASSERT( order != nullptr);
 
          auto market = order->get_market();
 
          auto sub = _market_subscriptions.find( market );
          if( sub != _market_subscriptions.end() ) {
-            queue[market].emplace_back( full_object ? obj->to_variant() : fc::variant(obj->id, 1) );
+            queue[market].emplace_back( full_object ? notification.full_object(index) : notification.object_id(index) );
          }
       }
 
       void broadcast_updates( const vector<variant>& updates );
       void broadcast_market_updates( const market_queue_type& queue);
-      void handle_object_changed(bool force_notify, bool full_object, const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts, std::function<const object*(object_id_type id)> find_object);
-
-      /** called every time a block is applied to report the objects that were changed */
-      void on_objects_new(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts);
-      void on_objects_changed(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts);
-      void on_objects_removed(const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts);
+      void handle_object_changed(bool force_notify, bool full_object, const object_notification& notification);
       void on_applied_block();
+      void on_order_book_diffs(const vector<order_book_diff>& diffs);
+      order_book_feed& get_order_book_feed();
+      void unwatch_order_books();
 
       bool _notify_remove_create = false;
       mutable fc::bloom_filter _subscribe_filter;
@@ -306,13 +332,20 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       std::function<void(const fc::variant&)> _pending_trx_callback;
       std::function<void(const fc::variant&)> _block_applied_callback;
 
+      /// only used when the API is not served by an application, which shares its notifications between sessions
+      std::unique_ptr<object_notification_hub>                                                                                     _own_notifications;
+      mutable std::unique_ptr<full_account_cache>                                                                                  _own_full_accounts;
       boost::signals2::scoped_connection                                                                                           _new_connection;
       boost::signals2::scoped_connection                                                                                           _change_connection;
       boost::signals2::scoped_connection                                                                                           _removed_connection;
       boost::signals2::scoped_connection                                                                                           _applied_block_connection;
       boost::signals2::scoped_connection                                                                                           _pending_trx_connection;
       map< pair<asset_id_type,asset_id_type>, std::function<void(const variant&)> >      _market_subscriptions;
+      map< pair<asset_id_type,asset_id_type>, std::function<void(const variant&)> >      _order_book_subscriptions;
+      std::shared_ptr<graphene::market_history::market_history_plugin>                   _market_history;
+      boost::signals2::scoped_connection                                                 _order_book_connection;
       graphene::chain::database&                                                                                                            _db;
+      const application*                                                                                                                    _app;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -321,22 +354,25 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 //                                                                  //
 //////////////////////////////////////////////////////////////////////
 
-database_api::database_api( graphene::chain::database& db )
-   : my( new database_api_impl( db ) ) {}
+database_api::database_api( graphene::chain::database& db, const application* app )
+   : my( new database_api_impl( db, app ) ) {}
 
 database_api::~database_api() {}
 
-database_api_impl::database_api_impl( graphene::chain::database& db ):_db(db)
+database_api_impl::database_api_impl( graphene::chain::database& db, const application* app ):_db(db),_app(app)
 {
    wlog("creating database api ${x}", ("x",int64_t(this)) );
-   _new_connection = _db.new_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_new(ids, impacted_accounts);
+   if( !_app )
+      _own_notifications.reset( new object_notification_hub( _db ) );
+   object_notification_hub& notifications = _app ? _app->object_notifications() : *_own_notifications;
+   _new_connection = notifications.objects_new.connect([this](const object_notification& n) {
+                                handle_object_changed(_notify_remove_create, true, n);
                                 });
-   _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_changed(ids, impacted_accounts);
+   _change_connection = notifications.objects_changed.connect([this](const object_notification& n) {
+                                handle_object_changed(false, true, n);
                                 });
-   _removed_connection = _db.removed_objects.connect([this](const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_removed(ids, objs, impacted_accounts);
+   _removed_connection = notifications.objects_removed.connect([this](const object_notification& n) {
+                                handle_object_changed(_notify_remove_create, false, n);
                                 });
    _applied_block_connection = _db.applied_block.connect([this](const signed_block&){ on_applied_block(); });
 
@@ -348,6 +384,7 @@ database_api_impl::database_api_impl( graphene::chain::database& db ):_db(db)
 database_api_impl::~database_api_impl()
 {
    elog("freeing database api ${x}", ("x",int64_t(this)) );
+   unwatch_order_books();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -441,6 +478,7 @@ void database_api_impl::cancel_all_subscriptions()
 {
    set_subscribe_callback( std::function<void(const fc::variant&)>(), true);
    _market_subscriptions.clear();
+   unwatch_order_books();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -729,10 +767,23 @@ std::map<string,full_account> database_api::get_full_accounts( const vector<stri
 
 std::map<std::string, full_account> database_api_impl::get_full_accounts( const vector<std::string>& names_or_ids, bool subscribe)
 {
-   const auto& proposal_idx = _db.get_index_type<proposal_index>();
-   const auto& pidx = dynamic_cast<const base_primary_index&>(proposal_idx);
-   const auto& proposals_by_account = pidx.get_secondary_index<graphene::chain::required_approval_index>();
+   std::map<std::string, full_account> results = read_only( [&]() { return load_full_accounts( names_or_ids ); } );
 
+   // subscriptions change the session, so they are made here rather than on the workers
+   if( subscribe )
+   {
+      for( const auto& item : results )
+      {
+         FC_ASSERT( std::distance(_subscribed_accounts.begin(), _subscribed_accounts.end()) <= 100 );
+         _subscribed_accounts.insert( item.second.account.get_id() );
+         subscribe_to_item( item.second.account.id );
+      }
+   }
+   return results;
+}
+
+std::map<std::string, full_account> database_api_impl::load_full_accounts( const vector<std::string>& names_or_ids )const
+{
    std::map<std::string, full_account> results;
 
    for (const std::string& account_name_or_id : names_or_ids)
@@ -750,86 +801,123 @@ std::map<std::string, full_account> database_api_impl::get_full_accounts( const
       if (account == nullptr)
          continue;
 
-      if( subscribe )
-      {
-         FC_ASSERT( std::distance(_subscribed_accounts.begin(), _subscribed_accounts.end()) <= 100 );
-         _subscribed_accounts.insert( account->get_id() );
-         subscribe_to_item( account->id );
-      }
+      results[account_name_or_id] = get_full_account_cache().get( *account, [this]( const account_object& a ) {
+         return build_full_account( a );
+      });
+   }
+   return results;
+}
 
-      full_account acnt;
-      acnt.account = *account;
-      acnt.statistics = account->statistics(_db);
-      acnt.registrar_name = account->registrar(_db).name;
-      acnt.referrer_name = account->referrer(_db).name;
-      acnt.lifetime_referrer_name = account->lifetime_referrer(_db).name;
-      acnt.votes = lookup_vote_ids( vector<vote_id_type>(account->options.votes.begin(),account->options.votes.end()) );
+full_account_cache& database_api_impl::get_full_account_cache()const
+{
+   if( _app )
+      return _app->full_accounts();
+   if( !_own_full_accounts )
+      _own_full_accounts.reset( new full_account_cache( _db, *_own_notifications ) );
+   return *_own_full_accounts;
+}
 
-      if (account->cashback_vb)
-      {
-         acnt.cashback_balance = account->cashback_balance(_db);
-      }
-      // Add the account's proposals
-      auto  required_approvals_itr = proposals_by_account._account_to_proposals.find( account->id );
-      if( required_approvals_itr != proposals_by_account._account_to_proposals.end() )
+std::map<string,full_account_delta> database_api::get_full_accounts_delta( const vector<string>& names_or_ids,
+                                                                           uint32_t since_block )const
+{
+   return my->get_full_accounts_delta( names_or_ids, since_block );
+}
+
+std::map<string,full_account_delta> database_api_impl::get_full_accounts_delta( const vector<string>& names_or_ids,
+                                                                                uint32_t since_block )const
+{
+   return read_only( [&]() {
+      std::map<string,full_account_delta> results;
+      for( const string& name_or_id : names_or_ids )
       {
-         acnt.proposals.reserve( required_approvals_itr->second.size() );
-         for( auto proposal_id : required_approvals_itr->second )
-            acnt.proposals.push_back( proposal_id(_db) );
+         const account_object* account = name_or_id.empty() ? nullptr : get_account_from_string( name_or_id, false );
+         if( account == nullptr )
+            continue;
+         results[name_or_id] = get_full_account_cache().get_delta( *account, since_block, [this]( const account_object& a ) {
+            return build_full_account( a );
+         });
       }
+      return results;
+   });
+}
 
+full_account database_api_impl::build_full_account( const account_object& account )const
+{
+   const auto& proposal_idx = _db.get_index_type<proposal_index>();
+   const auto& pidx = dynamic_cast<const base_primary_index&>(proposal_idx);
+   const auto& proposals_by_account = pidx.get_secondary_index<graphene::chain::required_approval_index>();
 
-      // Add the account's balances
-      const auto& balances = _db.get_index_type< primary_index< account_balance_index > >().get_secondary_index< balances_by_account_index >().get_account_balances( account->id );
-      for( const auto balance : balances )
-         acnt.balances.emplace_back( *balance.second );
-
-      // Add the account's vesting balances
-      auto vesting_range = _db.get_index_type<vesting_balance_index>().indices().get<by_account>().equal_range(account->id);
-      std::for_each(vesting_range.first, vesting_range.second,
-                    [&acnt](const vesting_balance_object& balance) {
-                       acnt.vesting_balances.emplace_back(balance);
-                    });
-
-      // Add the account's orders
-      auto order_range = _db.get_index_type<limit_order_index>().indices().get<by_account>().equal_range(account->id);
-      std::for_each(order_range.first, order_range.second,
-                    [&acnt] (const limit_order_object& order) {
-                       acnt.limit_orders.emplace_back(order);
-                    });
-      auto call_range = _db.get_index_type<call_order_index>().indices().get<by_account>().equal_range(account->id);
-      std::for_each(call_range.first, call_range.second,
-                    [&acnt] (const call_order_object& call) {
-                       acnt.call_orders.emplace_back(call);
-                    });
-      auto settle_range = _db.get_index_type<force_settlement_index>().indices().get<by_account>().equal_range(account->id);
-      std::for_each(settle_range.first, settle_range.second,
-                    [&acnt] (const force_settlement_object& settle) {
-                       acnt.settle_orders.emplace_back(settle);
-                    });
-
-      // get assets issued by user
-      auto asset_range = _db.get_index_type<asset_index>().indices().get<by_issuer>().equal_range(account->id);
-      std::for_each(asset_range.first, asset_range.second,
-                    [&acnt] (const asset_object& asset) {
-                       acnt.assets.emplace_back(asset.id);
-                    });
+   full_account acnt;
+   acnt.account = account;
+   acnt.statistics = account.statistics(_db);
+   acnt.registrar_name = account.registrar(_db).name;
+   acnt.referrer_name = account.referrer(_db).name;
+   acnt.lifetime_referrer_name = account.lifetime_referrer(_db).name;
+   acnt.votes = lookup_vote_ids( vector<vote_id_type>(account.options.votes.begin(),account.options.votes.end()) );
 
-      // get withdraws permissions
-      auto withdraw_range = _db.get_index_type<withdraw_permission_index>().indices().get<by_from>().equal_range(account->id);
-      std::for_each(withdraw_range.first, withdraw_range.second,
-                    [&acnt] (const withdraw_permission_object& withdraw) {
-                       acnt.withdraws.emplace_back(withdraw);
-                    });
+   if (account.cashback_vb)
+   {
+      acnt.cashback_balance = account.cashback_balance(_db);
+   }
+   // Add the account's proposals
+   auto  required_approvals_itr = proposals_by_account._account_to_proposals.find( account.id );
+   if( required_approvals_itr != proposals_by_account._account_to_proposals.end() )
+   {
+      acnt.proposals.reserve( required_approvals_itr->second.size() );
+      for( auto proposal_id : required_approvals_itr->second )
+         acnt.proposals.push_back( proposal_id(_db) );
+   }
 
-      auto pending_payouts_range =
-         _db.get_index_type<pending_dividend_payout_balance_for_holder_object_index>().indices().get<by_account_dividend_payout>().equal_range(boost::make_tuple(account->id));
 
-      std::copy(pending_payouts_range.first, pending_payouts_range.second, std::back_inserter(acnt.pending_dividend_payments));
+   // Add the account's balances
+   const auto& balances = _db.get_index_type< primary_index< account_balance_index > >().get_secondary_index< balances_by_account_index >().get_account_balances( account.id );
+   for( const auto balance : balances )
+      acnt.balances.emplace_back( *balance.second );
 
-      results[account_name_or_id] = acnt;
-   }
-   return results;
+   // Add the account's vesting balances
+   auto vesting_range = _db.get_index_type<vesting_balance_index>().indices().get<by_account>().equal_range(account.id);
+   std::for_each(vesting_range.first, vesting_range.second,
+                 [&acnt](const vesting_balance_object& balance) {
+                    acnt.vesting_balances.emplace_back(balance);
+                 });
+
+   // Add the account's orders
+   auto order_range = _db.get_index_type<limit_order_index>().indices().get<by_account>().equal_range(account.id);
+   std::for_each(order_range.first, order_range.second,
+                 [&acnt] (const limit_order_object& order) {
+                    acnt.limit_orders.emplace_back(order);
+                 });
+   auto call_range = _db.get_index_type<call_order_index>().indices().get<by_account>().equal_range(account.id);
+   std::for_each(call_range.first, call_range.second,
+                 [&acnt] (const call_order_object& call) {
+                    acnt.call_orders.emplace_back(call);
+                 });
+   auto settle_range = _db.get_index_type<force_settlement_index>().indices().get<by_account>().equal_range(account.id);
+   std::for_each(settle_range.first, settle_range.second,
+                 [&acnt] (const force_settlement_object& settle) {
+                    acnt.settle_orders.emplace_back(settle);
+                 });
+
+   // get assets issued by user
+   auto asset_range = _db.get_index_type<asset_index>().indices().get<by_issuer>().equal_range(account.id);
+   std::for_each(asset_range.first, asset_range.second,
+                 [&acnt] (const asset_object& asset) {
+                    acnt.assets.emplace_back(asset.id);
+                 });
+
+   // get withdraws permissions
+   auto withdraw_range = _db.get_index_type<withdraw_permission_index>().indices().get<by_from>().equal_range(account.id);
+   std::for_each(withdraw_range.first, withdraw_range.second,
+                 [&acnt] (const withdraw_permission_object& withdraw) {
+                    acnt.withdraws.emplace_back(withdraw);
+                 });
+
+   auto pending_payouts_range =
+      _db.get_index_type<pending_dividend_payout_balance_for_holder_object_index>().indices().get<by_account_dividend_payout>().equal_range(boost::make_tuple(account.id));
+
+   std::copy(pending_payouts_range.first, pending_payouts_range.second, std::back_inserter(acnt.pending_dividend_payments));
+
+   return acnt;
 }
 
 optional<account_object> database_api::get_account_by_name( string name )const
@@ -1334,7 +1422,7 @@ vector<bet_object> database_api_impl::get_all_unmatched_bets_for_bettor(account_
 
 vector<limit_order_object> database_api::get_limit_orders(const std::string& a, const std::string& b, const uint32_t limit)const
 {
-   return my->get_limit_orders( a, b, limit );
+   return my->read_only( [&]() { return my->get_limit_orders( a, b, limit ); } );
 }
 
 /**
@@ -1381,7 +1469,7 @@ vector<limit_order_object> database_api_impl::get_limit_orders( const asset_id_t
 
 vector<call_order_object> database_api::get_call_orders(const std::string& a, uint32_t limit)const
 {
-   return my->get_call_orders( a, limit );
+   return my->read_only( [&]() { return my->get_call_orders( a, limit ); } );
 }
 
 vector<call_order_object> database_api_impl::get_call_orders(const std::string& a, uint32_t limit)const
@@ -1396,7 +1484,7 @@ vector<call_order_object> database_api_impl::get_call_orders(const std::string&
 
 vector<force_settlement_object> database_api::get_settle_orders(const std::string& a, uint32_t limit)const
 {
-   return my->get_settle_orders( a, limit );
+   return my->read_only( [&]() { return my->get_settle_orders( a, limit ); } );
 }
 
 vector<force_settlement_object> database_api_impl::get_settle_orders(const std::string& a, uint32_t limit)const
@@ -1461,12 +1549,119 @@ void database_api_impl::unsubscribe_from_market(const std::string& a, const std:
    _market_subscriptions.erase(std::make_pair(asset_a_id,asset_b_id));
 }
 
+order_book_snapshot database_api::subscribe_to_order_book(std::function<void(const variant&)> callback, const std::string& a, const std::string& b)
+{
+   return my->subscribe_to_order_book( callback, a, b );
+}
+
+order_book_snapshot database_api_impl::subscribe_to_order_book(std::function<void(const variant&)> callback, const std::string& a, const std::string& b)
+{
+   auto asset_a_id = get_asset_from_string(a)->id;
+   auto asset_b_id = get_asset_from_string(b)->id;
+
+   if(asset_a_id > asset_b_id) std::swap(asset_a_id,asset_b_id);
+   FC_ASSERT(asset_a_id != asset_b_id);
+
+   order_book_feed& feed = get_order_book_feed();
+   const auto market = std::make_pair(asset_a_id,asset_b_id);
+   if( _order_book_subscriptions.count(market) )
+   {
+      _order_book_subscriptions[market] = callback;
+      return feed.get_snapshot( asset_a_id, asset_b_id );
+   }
+   if( _order_book_subscriptions.empty() )
+      _order_book_connection = feed.diffs_applied.connect([this](const vector<order_book_diff>& diffs){ on_order_book_diffs(diffs); });
+   _order_book_subscriptions[market] = callback;
+   return feed.watch( _db, asset_a_id, asset_b_id );
+}
+
+void database_api::unsubscribe_from_order_book(const std::string& a, const std::string& b)
+{
+   my->unsubscribe_from_order_book( a, b );
+}
+
+void database_api_impl::unsubscribe_from_order_book(const std::string& a, const std::string& b)
+{
+   auto asset_a_id = get_asset_from_string(a)->id;
+   auto asset_b_id = get_asset_from_string(b)->id;
+
+   if(asset_a_id > asset_b_id) std::swap(asset_a_id,asset_b_id);
+   FC_ASSERT(asset_a_id != asset_b_id);
+   if( _order_book_subscriptions.erase(std::make_pair(asset_a_id,asset_b_id)) )
+      get_order_book_feed().unwatch( asset_a_id, asset_b_id );
+   if( _order_book_subscriptions.empty() )
+      _order_book_connection.disconnect();
+}
+
+order_book_snapshot database_api::get_order_book_snapshot(const std::string& a, const std::string& b)const
+{
+   return my->get_order_book_snapshot( a, b );
+}
+
+order_book_snapshot database_api_impl::get_order_book_snapshot(const std::string& a, const std::string& b)const
+{
+   auto asset_a_id = get_asset_from_string(a)->id;
+   auto asset_b_id = get_asset_from_string(b)->id;
+
+   if(asset_a_id > asset_b_id) std::swap(asset_a_id,asset_b_id);
+   FC_ASSERT( _order_book_subscriptions.count(std::make_pair(asset_a_id,asset_b_id)),
+              "Subscribe to the order book of the market first" );
+   return _market_history->get_order_book_feed().get_snapshot( asset_a_id, asset_b_id );
+}
+
+order_book_feed& database_api_impl::get_order_book_feed()
+{
+   if( !_market_history )
+   {
+      FC_ASSERT( _app, "Order book subscriptions are not available from this API instance" );
+      _market_history = _app->get_plugin<graphene::market_history::market_history_plugin>( "market_history" );
+      FC_ASSERT( _market_history, "Order book subscriptions require the market_history plugin" );
+   }
+   return _market_history->get_order_book_feed();
+}
+
+void database_api_impl::unwatch_order_books()
+{
+   _order_book_connection.disconnect();
+   for( const auto& item : _order_book_subscriptions )
+      _market_history->get_order_book_feed().unwatch( item.first.first, item.first.second );
+   _order_book_subscriptions.clear();
+}
+
 market_ticker database_api::get_ticker( const string& base, const string& quote )const
 {
-    return my->get_ticker( base, quote );
+    return my->read_only( [&]() { return my->get_ticker( base, quote ); } );
 }
 
 market_ticker database_api_impl::get_ticker( const string& base, const string& quote )const
+{
+    market_ticker result = get_ticker_aggregates( base, quote );
+    try {
+        const auto assets = lookup_asset_symbols( {base, quote} );
+        const auto base_id = assets[0]->id;
+        const auto quote_id = assets[1]->id;
+        const auto& depth = _db.get_index_type< primary_index<limit_order_index> >().get_secondary_index<limit_order_depth_index>();
+
+        auto asset_to_real = [&]( const asset& a, int p ) { return double(a.amount.value)/pow( 10, p ); };
+        auto price_to_real = [&]( const price& p )
+        {
+           if( p.base.asset_id == base_id )
+              return asset_to_real( p.base, assets[0]->precision ) / asset_to_real( p.quote, assets[1]->precision );
+           else
+              return asset_to_real( p.quote, assets[0]->precision ) / asset_to_real( p.base, assets[1]->precision );
+        };
+
+        // the best level of each side is the first one
+        const auto* bids = depth.get_levels( base_id, quote_id );
+        if( bids != nullptr && !bids->empty() ) result.highest_bid = price_to_real( bids->begin()->first );
+        const auto* asks = depth.get_levels( quote_id, base_id );
+        if( asks != nullptr && !asks->empty() ) result.lowest_ask = price_to_real( asks->begin()->first );
+    } FC_CAPTURE_AND_RETHROW( (base)(quote) )
+
+    return result;
+}
+
+market_ticker database_api_impl::get_ticker_aggregates( const string& base, const string& quote )const
 {
     const auto assets = lookup_asset_symbols( {base, quote} );
     FC_ASSERT( assets[0], "Invalid base asset symbol: ${s}", ("s",base) );
@@ -1483,56 +1678,66 @@ market_ticker database_api_impl::get_ticker( const string& base, const string& q
     result.quote_volume = 0;
 
     try {
-        const fc::time_point_sec now = fc::time_point::now();
-        const fc::time_point_sec yesterday = fc::time_point_sec( now.sec_since_epoch() - 86400 );
-        const auto batch_size = 100;
-
-        vector<market_trade> trades = get_trade_history( base, quote, now, yesterday, batch_size );
-        if( !trades.empty() )
+        auto base_id = assets[0]->id;
+        auto quote_id = assets[1]->id;
+        const bool inverted = base_id > quote_id;
+        if( inverted ) std::swap( base_id, quote_id );
+
+        const auto& ticker_idx = _db.get_index_type<graphene::market_history::market_ticker_index>().indices().get<by_market>();
+        auto itr = ticker_idx.find( std::make_tuple( base_id, quote_id ) );
+        if( itr != ticker_idx.end() )
         {
-            result.latest = trades[0].price;
-
-            while( !trades.empty() )
+            auto to_real = [&]( const share_type a, const share_type b ) {
+                return std::make_pair( double( a.value ) / pow( 10, assets[inverted ? 1 : 0]->precision ),
+                                       double( b.value ) / pow( 10, assets[inverted ? 0 : 1]->precision ) );
+            };
+            // ( base, quote ) of the request from ( base, quote ) of the ticker
+            auto oriented = [&]( const share_type a, const share_type b ) {
+                const auto amounts = to_real( a, b );
+                return inverted ? std::make_pair( amounts.second, amounts.first ) : amounts;
+            };
+
+            const auto window = itr->get_window( _db.head_block_time() );
+            const auto latest = oriented( itr->latest_base, itr->latest_quote );
+            const auto volume = oriented( window.base_volume, window.quote_volume );
+            result.latest = latest.first / latest.second;
+            result.base_volume = volume.first;
+            result.quote_volume = volume.second;
+
+            if( window.last_day_base != 0 && window.last_day_quote != 0 )
             {
-                for( const market_trade& t: trades )
-                {
-                    result.base_volume += t.value;
-                    result.quote_volume += t.amount;
-                }
-
-                trades = get_trade_history( base, quote, trades.back().date, yesterday, batch_size );
-            }
-
-            const auto last_trade_yesterday = get_trade_history( base, quote, yesterday, fc::time_point_sec(), 1 );
-            if( !last_trade_yesterday.empty() )
-            {
-                const auto price_yesterday = last_trade_yesterday[0].price;
-                result.percent_change = ( (result.latest / price_yesterday) - 1 ) * 100;
+                const auto last_day = oriented( window.last_day_base, window.last_day_quote );
+                result.percent_change = ( ( result.latest / ( last_day.first / last_day.second ) ) - 1 ) * 100;
             }
         }
-        else
-        {
-            const auto last_trade = get_trade_history( base, quote, now, fc::time_point_sec(), 1 );
-            if( !last_trade.empty() )
-                result.latest = last_trade[0].price;
-        }
-
-        const auto orders = get_order_book( base, quote, 1 );
-        if( !orders.asks.empty() ) result.lowest_ask = orders.asks[0].price;
-        if( !orders.bids.empty() ) result.highest_bid = orders.bids[0].price;
     } FC_CAPTURE_AND_RETHROW( (base)(quote) )
 
     return result;
 }
 
+vector<market_ticker> database_api::get_tickers( const vector<std::pair<string, string>>& markets )const
+{
+    return my->read_only( [&]() { return my->get_tickers( markets ); } );
+}
+
+vector<market_ticker> database_api_impl::get_tickers( const vector<std::pair<string, string>>& markets )const
+{
+    FC_ASSERT( markets.size() <= 100, "Only 100 tickers can be queried at a time" );
+    vector<market_ticker> result;
+    result.reserve( markets.size() );
+    for( const auto& market : markets )
+        result.push_back( get_ticker( market.first, market.second ) );
+    return result;
+}
+
 market_volume database_api::get_24_volume( const string& base, const string& quote )const
 {
-    return my->get_24_volume( base, quote );
+    return my->read_only( [&]() { return my->get_24_volume( base, quote ); } );
 }
 
 market_volume database_api_impl::get_24_volume( const string& base, const string& quote )const
 {
-    const auto ticker = get_ticker( base, quote );
+    const auto ticker = get_ticker_aggregates( base, quote );
 
     market_volume result;
     result.base = ticker.base;
@@ -1545,7 +1750,7 @@ market_volume database_api_impl::get_24_volume( const string& base, const string
 
 order_book database_api::get_order_book( const string& base, const string& quote, unsigned limit )const
 {
-   return my->get_order_book( base, quote, limit);
+   return my->read_only( [&]() { return my->get_order_book( base, quote, limit ); } );
 }
 
 order_book database_api_impl::get_order_book( const string& base, const string& quote, unsigned limit )const
@@ -1598,13 +1803,97 @@ order_book database_api_impl::get_order_book( const string& base, const string&
    return result;
 }
 
+order_book database_api::get_order_book_depth( const string& base, const string& quote, uint8_t precision, unsigned limit )const
+{
+   return my->read_only( [&]() { return my->get_order_book_depth( base, quote, precision, limit ); } );
+}
+
+order_book database_api_impl::get_order_book_depth( const string& base, const string& quote, uint8_t precision, unsigned limit )const
+{
+   using boost::multiprecision::uint128_t;
+   using boost::multiprecision::uint256_t;
+   FC_ASSERT( limit <= 1000 );
+   FC_ASSERT( precision <= 18 );
+
+   order_book result;
+   result.base = base;
+   result.quote = quote;
+
+   auto assets = lookup_asset_symbols( {base, quote} );
+   FC_ASSERT( assets[0], "Invalid base asset symbol: ${s}", ("s",base) );
+   FC_ASSERT( assets[1], "Invalid quote asset symbol: ${s}", ("s",quote) );
+
+   auto base_id = assets[0]->id;
+   auto quote_id = assets[1]->id;
+   const auto& depth = _db.get_index_type< primary_index<limit_order_index> >().get_secondary_index<limit_order_depth_index>();
+
+   auto asset_to_real = [&]( share_type a, int p ) { return double(a.value)/pow( 10, p ); };
+   auto pow10 = []( int exponent ) {
+      uint256_t result = 1;
+      while( exponent-- > 0 )
+         result *= 10;
+      return result;
+   };
+   // the price in base per quote times 10^precision, rounded in integers so that equal prices always fall together
+   const uint256_t base_scale = pow10( assets[0]->precision );
+   const uint256_t quote_scale = pow10( assets[1]->precision + precision );
+   auto round_price = [&]( const price& p, bool round_up ) {
+      const asset& base_amount = p.base.asset_id == base_id ? p.base : p.quote;
+      const asset& quote_amount = p.base.asset_id == base_id ? p.quote : p.base;
+      const uint256_t numerator = uint256_t( base_amount.amount.value ) * quote_scale;
+      const uint256_t denominator = uint256_t( quote_amount.amount.value ) * base_scale;
+      uint256_t rounded = numerator / denominator;
+      if( round_up && rounded * denominator != numerator )
+         ++rounded;
+      return rounded;
+   };
+   const double price_scale = pow( 10, precision );
+
+   // levels come best first, so rounding bids down and asks up keeps equal rounded prices next to each other
+   auto aggregate = [&]( asset_id_type sell, asset_id_type receive, bool round_up, vector<order>& side )
+   {
+      const limit_order_depth_index::levels_type* levels = depth.get_levels( sell, receive );
+      if( !levels )
+         return;
+      uint256_t last_price;
+      for( const auto& level : *levels )
+      {
+         const uint256_t rounded = round_price( level.first, round_up );
+         if( side.empty() || rounded != last_price )
+         {
+            if( side.size() == limit )
+               return;
+            side.push_back( order{ rounded.convert_to<double>() / price_scale, 0, 0 } );
+            last_price = rounded;
+         }
+         const share_type received( ( uint128_t( level.second.value ) * level.first.quote.amount.value )
+                                    / level.first.base.amount.value );
+         order& ord = side.back();
+         if( sell == base_id )
+         {
+            ord.base += asset_to_real( level.second, assets[0]->precision );
+            ord.quote += asset_to_real( received, assets[1]->precision );
+         }
+         else
+         {
+            ord.quote += asset_to_real( level.second, assets[1]->precision );
+            ord.base += asset_to_real( received, assets[0]->precision );
+         }
+      }
+   };
+   aggregate( base_id, quote_id, false, result.bids );
+   aggregate( quote_id, base_id, true, result.asks );
+
+   return result;
+}
+
 vector<market_trade> database_api::get_trade_history( const string& base,
                                                       const string& quote,
                                                       fc::time_point_sec start,
                                                       fc::time_point_sec stop,
                                                       unsigned limit )const
 {
-   return my->get_trade_history( base, quote, start, stop, limit );
+   return my->read_only( [&]() { return my->get_trade_history( base, quote, start, stop, limit ); } );
 }
 
 vector<market_trade> database_api_impl::get_trade_history( const string& base,
@@ -1623,22 +1912,24 @@ vector<market_trade> database_api_impl::get_trade_history( const string& base,
    auto quote_id = assets[1]->id;
 
    if( base_id > quote_id ) std::swap( base_id, quote_id );
-   const auto& history_idx = _db.get_index_type<graphene::market_history::history_index>().indices().get<by_key>();
-   history_key hkey;
-   hkey.base = base_id;
-   hkey.quote = quote_id;
-   hkey.sequence = std::numeric_limits<int64_t>::min();
+
+   FC_ASSERT( _app, "Trade history is not available from this API instance" );
+   auto hist = _app->get_plugin<graphene::market_history::market_history_plugin>( "market_history" );
+   FC_ASSERT( hist, "Trade history requires the market_history plugin" );
 
    auto price_to_real = [&]( const share_type a, int p ) { return double( a.value ) / pow( 10, p ); };
 
    if ( start.sec_since_epoch() == 0 )
       start = fc::time_point_sec( fc::time_point::now() );
 
-   uint32_t count = 0;
-   auto itr = history_idx.lower_bound( hkey );
    vector<market_trade> result;
+   const auto* fills = hist->get_market_history_store().get_fills( base_id, quote_id );
+   if( !fills )
+      return result;
 
-   while( itr != history_idx.end() && count < limit && !( itr->key.base != base_id || itr->key.quote != quote_id || itr->time < stop ) )
+   uint32_t count = 0;
+   auto itr = fills->rbegin();
+   while( itr != fills->rend() && count < limit && itr->time >= stop )
    {
       if( itr->time < start )
       {
@@ -1664,7 +1955,8 @@ vector<market_trade> database_api_impl::get_trade_history( const string& base,
 
       // Trades are tracked in each direction.
       ++itr;
-      ++itr;
+      if( itr != fills->rend() )
+         ++itr;
    }
 
    return result;
@@ -3193,57 +3485,28 @@ void database_api_impl::broadcast_market_updates( const market_queue_type& queue
    }
 }
 
-void database_api_impl::on_objects_removed( const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts)
-{
-   handle_object_changed(_notify_remove_create, false, ids, impacted_accounts,
-      [objs](object_id_type id) -> const object* {
-         auto it = std::find_if(
-               objs.begin(), objs.end(),
-               [id](const object* o) {return o != nullptr && o->id == id;});
-
-         if (it != objs.end())
-            return *it;
-
-         return nullptr;
-      }
-   );
-}
-
-void database_api_impl::on_objects_new(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts)
-{
-   handle_object_changed(_notify_remove_create, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
-}
-
-void database_api_impl::on_objects_changed(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts)
-{
-   handle_object_changed(false, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
-}
-
-void database_api_impl::handle_object_changed(bool force_notify, bool full_object, const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts, std::function<const object*(object_id_type id)> find_object)
+/** the objects are serialized by the first session that needs them, the others share the same variants */
+void database_api_impl::handle_object_changed(bool force_notify, bool full_object, const object_notification& notification)
 {
+   const vector<object_id_type>& ids = notification.ids();
    if( _subscribe_callback )
    {
       vector<variant> updates;
+      const bool impacted = is_impacted_account( notification.impacted_accounts() );
 
-      for(auto id : ids)
+      for( size_t i = 0; i < ids.size(); ++i )
       {
-         if( force_notify || is_subscribed_to_item(id) || is_impacted_account(impacted_accounts) )
+         if( force_notify || impacted || is_subscribed_to_item(ids[i]) )
          {
             if( full_object )
             {
-               auto obj = find_object(id);
-               if( obj )
-               {
-                  updates.emplace_back( obj->to_variant() );
-               }
+               const variant& obj = notification.full_object(i);
+               if( !obj.is_null() )
+                  updates.emplace_back( obj );
             }
             else
             {
-               updates.emplace_back( fc::variant( id, 1 ) );
+               updates.emplace_back( notification.object_id(i) );
             }
          }
       }
@@ -3261,15 +3524,15 @@ void database_api_impl::handle_object_changed(bool force_notify, bool full_objec
    //if( _subscribe_callback )
    //         _subscribe_callback( updates );
 
-      for(auto id : ids)
+      for( size_t i = 0; i < ids.size(); ++i )
       {
-         if( id.is<call_order_object>() )
+         if( ids[i].is<call_order_object>() )
          {
-            enqueue_if_subscribed_to_market<call_order_object>( find_object(id), broadcast_queue, full_object );
+            enqueue_if_subscribed_to_market<call_order_object>( notification, i, broadcast_queue, full_object );
          }
-         else if( id.is<limit_order_object>() )
+         else if( ids[i].is<limit_order_object>() )
          {
-            enqueue_if_subscribed_to_market<limit_order_object>( find_object(id), broadcast_queue, full_object );
+            enqueue_if_subscribed_to_market<limit_order_object>( notification, i, broadcast_queue, full_object );
          }
       }
 
@@ -3277,6 +3540,29 @@ void database_api_impl::handle_object_changed(bool force_notify, bool full_objec
    }
 }
 
+/** note: this method cannot yield because it is called in the middle of
+ * apply a block.
+ */
+void database_api_impl::on_order_book_diffs(const vector<order_book_diff>& diffs)
+{
+   vector<order_book_diff> subscribed;
+   for( const order_book_diff& diff : diffs )
+      if( _order_book_subscriptions.count( std::make_pair( diff.base, diff.quote ) ) )
+         subscribed.push_back( diff );
+   if( subscribed.empty() )
+      return;
+
+   auto capture_this = shared_from_this();
+   fc::async([this,capture_this,subscribed](){
+      for( const order_book_diff& diff : subscribed )
+      {
+         auto itr = _order_book_subscriptions.find( std::make_pair( diff.base, diff.quote ) );
+         if( itr != _order_book_subscriptions.end() )
+            itr->second( fc::variant( diff, GRAPHENE_NET_MAX_NESTED_OBJECTS ) );
+      }
+   });
+}
+
 /** note: this method cannot yield because it is called in the middle of
  * apply a block.
  */
@@ -0,0 +1,377 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/full_account_cache.hpp>
+#include <graphene/app/object_notifications.hpp>
+
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/proposal_object.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/io/raw_variant.hpp>
+
+namespace graphene { namespace app {
+
+namespace {
+
+   template<typename T>
+   void pack_into( vector<char>& out, const T& value )
+   {
+      const vector<char> packed = fc::raw::pack( value );
+      out.insert( out.end(), packed.begin(), packed.end() );
+   }
+
+   std::array<vector<char>, full_account_cache::section_count> pack_sections( const full_account& a )
+   {
+      std::array<vector<char>, full_account_cache::section_count> result;
+      pack_into( result[full_account_cache::account_section], a.account );
+      pack_into( result[full_account_cache::account_section], a.registrar_name );
+      pack_into( result[full_account_cache::account_section], a.referrer_name );
+      pack_into( result[full_account_cache::account_section], a.lifetime_referrer_name );
+      pack_into( result[full_account_cache::statistics_section], a.statistics );
+      pack_into( result[full_account_cache::votes_section], a.votes );
+      pack_into( result[full_account_cache::cashback_balance_section], a.cashback_balance );
+      pack_into( result[full_account_cache::balances_section], a.balances );
+      pack_into( result[full_account_cache::vesting_balances_section], a.vesting_balances );
+      pack_into( result[full_account_cache::limit_orders_section], a.limit_orders );
+      pack_into( result[full_account_cache::call_orders_section], a.call_orders );
+      pack_into( result[full_account_cache::settle_orders_section], a.settle_orders );
+      pack_into( result[full_account_cache::proposals_section], a.proposals );
+      pack_into( result[full_account_cache::assets_section], a.assets );
+      pack_into( result[full_account_cache::withdraws_section], a.withdraws );
+      pack_into( result[full_account_cache::pending_dividend_payments_section], a.pending_dividend_payments );
+      return result;
+   }
+
+   void clear_section( full_account& a, full_account_cache::section_type section )
+   {
+      switch( section )
+      {
+         case full_account_cache::account_section:
+            a.account = account_object();
+            a.registrar_name.clear();
+            a.referrer_name.clear();
+            a.lifetime_referrer_name.clear();
+            break;
+         case full_account_cache::statistics_section:         a.statistics = account_statistics_object(); break;
+         case full_account_cache::votes_section:              a.votes.clear(); break;
+         case full_account_cache::cashback_balance_section:   a.cashback_balance.reset(); break;
+         case full_account_cache::balances_section:           a.balances.clear(); break;
+         case full_account_cache::vesting_balances_section:   a.vesting_balances.clear(); break;
+         case full_account_cache::limit_orders_section:       a.limit_orders.clear(); break;
+         case full_account_cache::call_orders_section:        a.call_orders.clear(); break;
+         case full_account_cache::settle_orders_section:      a.settle_orders.clear(); break;
+         case full_account_cache::proposals_section:          a.proposals.clear(); break;
+         case full_account_cache::assets_section:             a.assets.clear(); break;
+         case full_account_cache::withdraws_section:          a.withdraws.clear(); break;
+         case full_account_cache::pending_dividend_payments_section: a.pending_dividend_payments.clear(); break;
+         default: break;
+      }
+   }
+
+   /// the account whose full account lists @ref obj, for the kinds of objects listed by owner
+   optional<account_id_type> listing_account( const object* obj )
+   {
+      if( obj == nullptr )
+         return optional<account_id_type>();
+      if( auto balance = dynamic_cast<const account_balance_object*>( obj ) )
+         return balance->owner;
+      if( auto vesting = dynamic_cast<const vesting_balance_object*>( obj ) )
+         return vesting->owner;
+      if( auto order = dynamic_cast<const limit_order_object*>( obj ) )
+         return order->seller;
+      if( auto call = dynamic_cast<const call_order_object*>( obj ) )
+         return call->borrower;
+      if( auto settle = dynamic_cast<const force_settlement_object*>( obj ) )
+         return settle->owner;
+      if( auto withdraw = dynamic_cast<const withdraw_permission_object*>( obj ) )
+         return withdraw->withdraw_from_account;
+      if( auto payout = dynamic_cast<const pending_dividend_payout_balance_for_holder_object*>( obj ) )
+         return payout->owner;
+      if( auto asset = dynamic_cast<const asset_object*>( obj ) )
+         return asset->issuer;
+      return optional<account_id_type>();
+   }
+
+} // anonymous namespace
+
+full_account_cache::full_account_cache( database& db, object_notification_hub& notifications, uint32_t max_accounts )
+   : _db( db ), _max_accounts( max_accounts )
+{
+   _new_connection = notifications.objects_new.connect( [this]( const object_notification& n ) {
+      on_objects( n, true );
+   });
+   _change_connection = notifications.objects_changed.connect( [this]( const object_notification& n ) {
+      on_objects( n, false );
+   });
+   _removed_connection = notifications.objects_removed.connect( [this]( const object_notification& n ) {
+      on_objects( n, false );
+   });
+   _applied_block_connection = _db.applied_block.connect( [this]( const signed_block& block ) {
+      std::lock_guard<std::mutex> lock( _mutex );
+      // notifications only report what blocks change, not what popping blocks reverts
+      if( block.previous != _head_block_id )
+         clear();
+      _head_block_id = _db.head_block_id();
+      ++_pending_generation;
+   });
+   _pending_connection = _db.on_pending_transaction.connect( [this]( const signed_transaction& ) {
+      std::lock_guard<std::mutex> lock( _mutex );
+      ++_pending_generation;
+   });
+}
+
+void full_account_cache::set_max_accounts( uint32_t max_accounts )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _max_accounts = max_accounts;
+   while( _entries.size() > _max_accounts )
+      erase( _entries.find( _lru.back() ) );
+}
+
+const char* full_account_cache::section_name( section_type section )
+{
+   static const char* const names[section_count] = {
+      "account", "statistics", "votes", "cashback_balance", "balances", "vesting_balances", "limit_orders",
+      "call_orders", "settle_orders", "proposals", "assets", "withdraws", "pending_dividend_payments"
+   };
+   return names[section];
+}
+
+full_account full_account_cache::get( const account_object& account, const builder_type& build )
+{
+   return lookup( account, build ).value;
+}
+
+full_account_delta full_account_cache::get_delta( const account_object& account, uint32_t since_block,
+                                                  const builder_type& build )
+{
+   lookup_result found = lookup( account, build );
+
+   full_account_delta result;
+   result.block_num = _db.head_block_num();
+   result.complete = !found.cached || since_block < found.known_since;
+   result.account = std::move( found.value );
+   for( uint32_t s = 0; s < section_count; ++s )
+   {
+      const section_type section = section_type( s );
+      if( result.complete || found.changed_in[s] > since_block )
+         result.sections.insert( section_name( section ) );
+      else
+         clear_section( result.account, section );
+   }
+   return result;
+}
+
+full_account_cache::lookup_result full_account_cache::lookup( const account_object& account, const builder_type& build )
+{
+   lookup_result result;
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      check_head_block();
+      auto itr = _entries.find( account.get_id() );
+      if( itr != _entries.end() && itr->second.invalidated_in == 0 && _db._undo_db.enabled()
+          && !has_pending_changes( account.get_id(), itr->second.dependencies ) )
+      {
+         _lru.splice( _lru.begin(), _lru, itr->second.lru_position );
+         result.value = itr->second.value;
+         result.cached = true;
+         result.known_since = itr->second.known_since;
+         result.changed_in = itr->second.changed_in;
+         return result;
+      }
+   }
+
+   // built without the lock, so that workers build different accounts at once; no block is applied meanwhile
+   result.value = build( account );
+
+   flat_set<object_id_type> dependencies = dependencies_of( result.value );
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _max_accounts == 0 || !_db._undo_db.enabled() || has_pending_changes( account.get_id(), dependencies ) )
+      return result;
+
+   auto itr = _entries.find( account.get_id() );
+   if( itr == _entries.end() )
+   {
+      itr = _entries.emplace( account.get_id(), entry() ).first;
+      entry& e = itr->second;
+      e.known_since = _db.head_block_num();
+      e.changed_in.fill( 0 );
+      _lru.push_front( account.get_id() );
+      e.lru_position = _lru.begin();
+   }
+   else
+   {
+      // another worker may have refreshed it already
+      entry& e = itr->second;
+      if( e.invalidated_in != 0 )
+      {
+         const auto before = pack_sections( e.value );
+         const auto after = pack_sections( result.value );
+         for( uint32_t s = 0; s < section_count; ++s )
+            if( before[s] != after[s] )
+               e.changed_in[s] = e.invalidated_in;
+         e.invalidated_in = 0;
+      }
+      _lru.splice( _lru.begin(), _lru, e.lru_position );
+      for( const object_id_type& id : e.dependencies )
+      {
+         auto dependents = _dependents.find( id );
+         if( dependents != _dependents.end() && dependents->second.erase( account.get_id() ) && dependents->second.empty() )
+            _dependents.erase( dependents );
+      }
+   }
+
+   entry& e = itr->second;
+   e.value = result.value;
+   e.dependencies = std::move( dependencies );
+   for( const object_id_type& id : e.dependencies )
+      _dependents[id].insert( account.get_id() );
+
+   result.cached = true;
+   result.known_since = e.known_since;
+   result.changed_in = e.changed_in;
+
+   while( _entries.size() > _max_accounts )
+      erase( _entries.find( _lru.back() ) );
+   return result;
+}
+
+void full_account_cache::on_objects( const object_notification& notification, bool owners_of_new_objects )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _entries.empty() )
+      return;
+
+   const uint32_t block_num = _db.head_block_num();
+   for( const account_id_type& account : notification.impacted_accounts() )
+      invalidate( account, block_num );
+   for( size_t i = 0; i < notification.ids().size(); ++i )
+   {
+      auto dependents = _dependents.find( notification.ids()[i] );
+      if( dependents != _dependents.end() )
+         for( const account_id_type& account : dependents->second )
+            invalidate( account, block_num );
+      // not every object listed in a full account impacts its owner, e.g. pending dividend payouts
+      if( owners_of_new_objects )
+      {
+         const optional<account_id_type> owner = listing_account( notification.get_object( i ) );
+         if( owner.valid() )
+            invalidate( *owner, block_num );
+      }
+   }
+}
+
+void full_account_cache::invalidate( account_id_type account, uint32_t block_num )
+{
+   auto itr = _entries.find( account );
+   if( itr != _entries.end() )
+      itr->second.invalidated_in = block_num;
+}
+
+void full_account_cache::erase( std::map<account_id_type, entry>::iterator itr )
+{
+   for( const object_id_type& id : itr->second.dependencies )
+   {
+      auto dependents = _dependents.find( id );
+      if( dependents != _dependents.end() && dependents->second.erase( itr->first ) && dependents->second.empty() )
+         _dependents.erase( dependents );
+   }
+   _lru.erase( itr->second.lru_position );
+   _entries.erase( itr );
+}
+
+void full_account_cache::clear()
+{
+   _entries.clear();
+   _lru.clear();
+   _dependents.clear();
+}
+
+void full_account_cache::check_head_block()
+{
+   if( _db.head_block_id() != _head_block_id )
+   {
+      clear();
+      _head_block_id = _db.head_block_id();
+      ++_pending_generation;
+   }
+}
+
+bool full_account_cache::has_pending_changes( account_id_type account, const flat_set<object_id_type>& dependencies )
+{
+   if( !_db.has_pending_transactions() )
+      return false;
+
+   if( _pending_generation_seen != _pending_generation )
+   {
+      _pending_generation_seen = _pending_generation;
+      _pending_ids.clear();
+      _pending_owners.clear();
+      _pending_proposals = false;
+      const undo_state& state = _db._undo_db.head();
+      auto add = [this]( object_id_type id, const object* obj ) {
+         _pending_ids.insert( id );
+         const optional<account_id_type> owner = listing_account( obj );
+         if( owner.valid() )
+            _pending_owners.insert( *owner );
+         if( id.is<proposal_object>() )
+            _pending_proposals = true;
+      };
+      for( const auto& item : state.old_values )
+         add( item.first, item.second.get() );
+      for( const auto& item : state.removed )
+         add( item.first, item.second.get() );
+      for( const object_id_type& id : state.new_ids )
+         add( id, _db.find_object( id ) );
+   }
+
+   if( _pending_proposals || _pending_owners.count( account ) || _pending_ids.count( account ) )
+      return true;
+   for( const object_id_type& id : dependencies )
+      if( _pending_ids.count( id ) )
+         return true;
+   return false;
+}
+
+flat_set<object_id_type> full_account_cache::dependencies_of( const full_account& value )
+{
+   flat_set<object_id_type> result;
+   result.insert( value.statistics.id );
+   if( value.cashback_balance.valid() )
+      result.insert( value.cashback_balance->id );
+   for( const fc::variant& vote : value.votes )
+      if( vote.is_object() && vote.get_object().contains( "id" ) )
+         result.insert( vote["id"].as<object_id_type>( 1 ) );
+   for( const auto& o : value.balances )                  result.insert( o.id );
+   for( const auto& o : value.vesting_balances )          result.insert( o.id );
+   for( const auto& o : value.limit_orders )              result.insert( o.id );
+   for( const auto& o : value.call_orders )               result.insert( o.id );
+   for( const auto& o : value.settle_orders )             result.insert( o.id );
+   for( const auto& o : value.proposals )                 result.insert( o.id );
+   for( const auto& o : value.withdraws )                 result.insert( o.id );
+   for( const auto& o : value.pending_dividend_payments ) result.insert( o.id );
+   return result;
+}
+
+} } // graphene::app
@@ -155,19 +155,50 @@ namespace graphene { namespace app {
            graphene::app::database_api database_api;
    };
 
+   /// a block in its wire format, as returned by @ref block_api::get_raw_blocks
+   struct raw_block
+   {
+      uint32_t       block_num = 0;
+      block_id_type  id;
+      /// the packed signed_block, hex or base64 encoded
+      string         data;
+   };
+
    /**
     * @brief Block api
     */
    class block_api
    {
    public:
-      block_api(graphene::chain::database& db);
+      block_api(graphene::chain::database& db, application* app = nullptr);
       ~block_api();
 
+      /// packed size of the blocks returned by one call, the range is cut short past it
+      static const uint64_t max_blocks_bytes = 4 * 1024 * 1024;
+
+      /**
+       * @brief Get a range of blocks
+       * @param block_num_from first block to return
+       * @param block_num_to last block to return, at most 100 blocks after the first
+       * @return the blocks, null for those that are not known.  When the blocks exceed @ref max_blocks_bytes the
+       * result ends early, the first block not returned is block_num_from plus its size.
+       */
       vector<optional<signed_block>> get_blocks(uint32_t block_num_from, uint32_t block_num_to)const;
 
+      /**
+       * @brief Get a range of blocks in their wire format, for clients that unpack blocks themselves
+       * @param block_num_from first block to return
+       * @param block_num_to last block to return, at most 1000 blocks after the first
+       * @param encoding "hex" or "base64"
+       * @return the packed blocks with their ids, null for those that are not known.  When the blocks exceed
+       * @ref max_blocks_bytes the result ends early, the first block not returned is block_num_from plus its size.
+       */
+      vector<optional<raw_block>> get_raw_blocks(uint32_t block_num_from, uint32_t block_num_to,
+                                                 const string& encoding)const;
+
    private:
       graphene::chain::database& _db;
+      application*               _app;
    };
 
 
@@ -442,6 +473,8 @@ FC_REFLECT( graphene::app::verify_range_proof_rewind_result,
 //FC_REFLECT_TYPENAME( fc::ecc::compact_signature );
 //FC_REFLECT_TYPENAME( fc::ecc::commitment_type );
 
+FC_REFLECT( graphene::app::raw_block, (block_num)(id)(data) )
+
 FC_REFLECT( graphene::app::account_asset_balance, (name)(account_id)(amount) );
 FC_REFLECT( graphene::app::asset_holders, (asset_id)(count) );
 
@@ -456,6 +489,7 @@ FC_API(graphene::app::history_api,
      )
 FC_API(graphene::app::block_api,
        (get_blocks)
+       (get_raw_blocks)
      )
 FC_API(graphene::app::network_broadcast_api,
        (broadcast_transaction)
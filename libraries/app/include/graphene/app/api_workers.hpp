@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <fc/thread/thread.hpp>
+
+#include <boost/thread/locks.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace app {
+
+   /**
+    *  Threads that run the read-only calls of one API, so that expensive queries neither wait for nor delay block
+    *  application on the main thread.  A call holds the chain state mutex shared while it runs, so it sees the state
+    *  between two blocks; blocks are applied once the calls that already started are done.
+    *
+    *  Calls must only read the chain database and the plugins' indexes; anything that changes a session, like
+    *  subscriptions, stays on the calling thread.  A pool without threads runs calls where they are made.
+    */
+   class api_worker_pool
+   {
+      public:
+         api_worker_pool( const std::string& name, uint32_t thread_count )
+         {
+            for( uint32_t i = 0; i < thread_count; ++i )
+               _threads.emplace_back( std::make_shared<fc::thread>( name + " " + std::to_string( i ) ) );
+         }
+
+         uint32_t thread_count()const { return _threads.size(); }
+
+         /// run @ref call on the next worker thread and wait for its result, yielding the calling fiber meanwhile
+         template<typename Callable>
+         auto run( const chain::database& db, Callable&& call ) -> decltype( call() )
+         {
+            if( _threads.empty() )
+               return call();
+            fc::thread& worker = *_threads[ _next_thread++ % _threads.size() ];
+            return worker.async( [&db, &call]() {
+               boost::shared_lock<boost::shared_mutex> read_lock( db.chain_state_mutex() );
+               return call();
+            }, "read-only API call" ).wait();
+         }
+
+         /**
+          *  run @ref call on the next worker thread without the chain state mutex and wait for its result, yielding
+          *  the calling fiber meanwhile; for calls that wait on an external service rather than read the chain
+          */
+         template<typename Callable>
+         auto run_unlocked( Callable&& call ) -> decltype( call() )
+         {
+            if( _threads.empty() )
+               return call();
+            fc::thread& worker = *_threads[ _next_thread++ % _threads.size() ];
+            return worker.async( [&call]() { return call(); }, "external API call" ).wait();
+         }
+
+         /**
+          *  run @ref call(i) for every i below @ref count, spread over the worker threads, and wait for all of them;
+          *  the chain state mutex is not taken, this is for work on data already read from the chain
+          */
+         template<typename Callable>
+         void for_each( size_t count, Callable&& call )
+         {
+            const size_t chunks = std::min<size_t>( _threads.size(), count );
+            if( chunks < 2 )
+            {
+               for( size_t i = 0; i < count; ++i )
+                  call( i );
+               return;
+            }
+            std::vector< fc::future<void> > done;
+            done.reserve( chunks );
+            for( size_t chunk = 0; chunk < chunks; ++chunk )
+               done.push_back( _threads[ _next_thread++ % _threads.size() ]->async( [&call, chunk, chunks, count]() {
+                  for( size_t i = chunk; i < count; i += chunks )
+                     call( i );
+               }, "parallel API work" ) );
+            // every chunk must be done with @ref call before an error leaves this frame
+            std::exception_ptr error;
+            for( fc::future<void>& f : done )
+               try {
+                  f.wait();
+               } catch( ... ) {
+                  if( !error )
+                     error = std::current_exception();
+               }
+            if( error )
+               std::rethrow_exception( error );
+         }
+
+      private:
+         std::vector< std::shared_ptr<fc::thread> > _threads;
+         uint32_t                                   _next_thread = 0;
+   };
+
+} }
@@ -31,6 +31,9 @@
 
 namespace graphene { namespace app {
    namespace detail { class application_impl; }
+   class api_worker_pool;
+   class full_account_cache;
+   class object_notification_hub;
    using std::string;
 
    class abstract_plugin;
@@ -86,6 +89,12 @@ namespace graphene { namespace app {
 
          net::node_ptr                    p2p_node();
          std::shared_ptr<chain::database> chain_database()const;
+         /// the object notifications of the chain database, shared by every API session
+         object_notification_hub&         object_notifications()const;
+         /// the full accounts assembled for the database API, shared by every API session
+         full_account_cache&              full_accounts()const;
+         /// the worker threads running the read-only calls of an API: "database", "history" or "asset"
+         api_worker_pool&                 api_workers( const string& api )const;
 
          void set_block_production(bool producing_blocks);
          fc::optional< api_access_info > get_api_access_info( const string& username )const;
@@ -99,8 +108,6 @@ namespace graphene { namespace app {
 
          bool is_plugin_enabled(const string& name) const;
 
-         std::shared_ptr<fc::thread> elasticsearch_thread;
-
    private:
          void add_available_plugin( std::shared_ptr<abstract_plugin> p );
          std::shared_ptr<detail::application_impl> my;
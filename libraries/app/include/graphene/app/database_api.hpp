@@ -58,6 +58,7 @@
 #include <graphene/chain/account_role_object.hpp>
 
 #include <graphene/market_history/market_history_plugin.hpp>
+#include <graphene/market_history/order_book_feed.hpp>
 
 #include <fc/api.hpp>
 #include <fc/optional.hpp>
@@ -74,6 +75,8 @@
 
 namespace graphene { namespace app {
 
+class application;
+
 using namespace graphene::chain;
 using namespace graphene::market_history;
 using namespace std;
@@ -143,7 +146,8 @@ struct gpos_info {
 class database_api
 {
    public:
-      database_api(graphene::chain::database& db);
+      /// @param app the application whose plugins serve the plugin backed queries, such as get_trade_history
+      database_api(graphene::chain::database& db, const application* app = nullptr);
       ~database_api();
 
       /////////////
@@ -297,6 +301,18 @@ class database_api
        */
       std::map<string,full_account> get_full_accounts( const vector<string>& names_or_ids, bool subscribe );
 
+      /**
+       * @brief Fetch the parts of full accounts that changed after a block
+       * @param names_or_ids Each item must be the name or ID of an account to retrieve
+       * @param since_block The block_num of the previous result for the same accounts, 0 to fetch everything
+       * @return Map of string from @ref names_or_ids to the sections of the account that changed in later blocks
+       *
+       * Accounts that cannot be found are ignored.  A result is complete when the server does not know the changes
+       * since @ref since_block, then it replaces what the client has.  This call does not subscribe.
+       */
+      std::map<string,full_account_delta> get_full_accounts_delta( const vector<string>& names_or_ids,
+                                                                   uint32_t since_block )const;
+
       optional<account_object> get_account_by_name( string name )const;
 
       /**
@@ -511,6 +527,33 @@ class database_api
        */
       void unsubscribe_from_market( const std::string& a, const std::string& b );
 
+      /**
+       * @brief Request the price levels of the market between two assets, and their changes once per block
+       * @param callback Callback method which is called with an order_book_diff when a block changes the market
+       * @param a First asset ID or name
+       * @param b Second asset ID or name
+       * @return The current price levels; the diff following them has the snapshot's sequence + 1
+       *
+       * The levels and diffs are computed once per block by the market_history plugin for every subscriber.  A client
+       * that misses a diff, seen as a gap in the sequence, resyncs with get_order_book_snapshot().
+       */
+      order_book_snapshot subscribe_to_order_book( std::function<void(const variant&)> callback,
+                                                   const std::string& a, const std::string& b );
+
+      /**
+       * @brief Unsubscribe from the price levels of a given market
+       * @param a First asset ID or name
+       * @param b Second asset ID or name
+       */
+      void unsubscribe_from_order_book( const std::string& a, const std::string& b );
+
+      /**
+       * @brief Returns the current price levels of a market subscribed to with subscribe_to_order_book()
+       * @param a First asset ID or name
+       * @param b Second asset ID or name
+       */
+      order_book_snapshot get_order_book_snapshot( const std::string& a, const std::string& b )const;
+
       /**
        * @brief Returns the ticker for the market assetA:assetB
        * @param a String name of the first asset
@@ -519,6 +562,13 @@ class database_api
        */
       market_ticker get_ticker( const string& base, const string& quote )const;
 
+      /**
+       * @brief Returns the tickers of several markets at once
+       * @param markets Pairs of base and quote asset names or IDs, up to 100
+       * @return The market tickers for the past 24 hours, in the order of @ref markets
+       */
+      vector<market_ticker> get_tickers( const vector<std::pair<string, string>>& markets )const;
+
       /**
        * @brief Returns the 24 hour volume for the market assetA:assetB
        * @param a String name of the first asset
@@ -536,6 +586,19 @@ class database_api
        */
       order_book get_order_book( const string& base, const string& quote, unsigned limit = 50 )const;
 
+      /**
+       * @brief Returns the order book for the market base:quote aggregated into price levels
+       * @param base String name of the first asset
+       * @param quote String name of the second asset
+       * @param precision Number of decimals the prices are rounded to, bids down and asks up, at most 18
+       * @param limit Number of levels of each asks and bids, capped at 1000
+       * @return Order book of the market, with the amounts of every order at each rounded price summed up
+       *
+       * The levels are read from an index of the amount for sale at each price, so this costs as much as the number of
+       * distinct prices in the book rather than the number of orders.
+       */
+      order_book get_order_book_depth( const string& base, const string& quote, uint8_t precision, unsigned limit = 100 )const;
+
       /**
        * @brief Returns recent trades for the market assetA:assetB
        * Note: Currentlt, timezone offsets are not supported. The time must be UTC.
@@ -992,6 +1055,7 @@ FC_API(graphene::app::database_api,
    (get_account_id_from_string)
    (get_accounts)
    (get_full_accounts)
+   (get_full_accounts_delta)
    (get_account_by_name)
    (get_account_references)
    (lookup_account_names)
@@ -1031,13 +1095,18 @@ FC_API(graphene::app::database_api,
    
    // Markets / feeds
    (get_order_book)
+   (get_order_book_depth)
    (get_limit_orders)
    (get_call_orders)
    (get_settle_orders)
    (get_margin_positions)
    (subscribe_to_market)
    (unsubscribe_from_market)
+   (subscribe_to_order_book)
+   (unsubscribe_from_order_book)
+   (get_order_book_snapshot)
    (get_ticker)
+   (get_tickers)
    (get_24_volume)
    (get_trade_history)
 
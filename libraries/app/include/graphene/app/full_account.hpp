@@ -52,6 +52,20 @@ namespace graphene { namespace app {
       vector<pending_dividend_payout_balance_for_holder_object> pending_dividend_payments;
    };
 
+   /**
+    *  The sections of a full account that changed after a block the client already has.  Sections that did not change
+    *  are left empty in @ref account; the names of the ones included are in @ref sections.
+    */
+   struct full_account_delta
+   {
+      /// the head block the result is current with, to pass as the next since_block
+      uint32_t                         block_num = 0;
+      /// true when every section is included, because changes since the requested block are not known
+      bool                             complete = false;
+      flat_set<string>                 sections;
+      full_account                     account;
+   };
+
 } }
 
 FC_REFLECT( graphene::app::full_account,
@@ -72,3 +86,5 @@ FC_REFLECT( graphene::app::full_account,
             (withdraws)
             (pending_dividend_payments)
           )
+
+FC_REFLECT( graphene::app::full_account_delta, (block_num)(complete)(sections)(account) )
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/full_account.hpp>
+
+#include <boost/signals2.hpp>
+
+#include <array>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace graphene { namespace app {
+   using namespace graphene::chain;
+
+   class object_notification;
+   class object_notification_hub;
+
+   /**
+    *  Assembled full accounts of the accounts API clients asked for most recently, shared by every API session.
+    *
+    *  An entry is invalidated when a block creates, changes or removes an object impacting its account, or changes or
+    *  removes an object it includes, like a witness it votes for.  The next request rebuilds it and compares it with
+    *  the previous one section by section, which gives the block each section last changed in and lets clients ask
+    *  for the changes after a block they have.
+    *
+    *  Entries hold the state of the head block.  Accounts that pending transactions changed are built on every
+    *  request and not cached, as are all accounts while the database has no undo history.
+    *
+    *  Lookups may be made by several API worker threads at once; notifications arrive while blocks are applied,
+    *  which waits for the workers.
+    */
+   class full_account_cache
+   {
+      public:
+         enum section_type
+         {
+            account_section,
+            statistics_section,
+            votes_section,
+            cashback_balance_section,
+            balances_section,
+            vesting_balances_section,
+            limit_orders_section,
+            call_orders_section,
+            settle_orders_section,
+            proposals_section,
+            assets_section,
+            withdraws_section,
+            pending_dividend_payments_section,
+            section_count
+         };
+
+         typedef std::function<full_account(const account_object&)> builder_type;
+
+         full_account_cache( database& db, object_notification_hub& notifications, uint32_t max_accounts = 5000 );
+
+         void set_max_accounts( uint32_t max_accounts );
+
+         /// @return the full account of @ref account, built with @ref build unless the cached one is still current
+         full_account get( const account_object& account, const builder_type& build );
+         /// @return the sections of the full account of @ref account that changed in blocks after @ref since_block
+         full_account_delta get_delta( const account_object& account, uint32_t since_block, const builder_type& build );
+
+         static const char* section_name( section_type section );
+
+      private:
+         struct entry
+         {
+            full_account                           value;
+            /// changes before this block are not known
+            uint32_t                               known_since = 0;
+            /// the last block that changed something in the account since it was built, 0 while it is current
+            uint32_t                               invalidated_in = 0;
+            std::array<uint32_t, section_count>    changed_in;
+            flat_set<object_id_type>               dependencies;
+            std::list<account_id_type>::iterator   lru_position;
+         };
+
+         struct lookup_result
+         {
+            full_account                           value;
+            /// false if the account was built without being cached, then the change history is not known
+            bool                                   cached = false;
+            uint32_t                               known_since = 0;
+            std::array<uint32_t, section_count>    changed_in;
+         };
+
+         lookup_result lookup( const account_object& account, const builder_type& build );
+
+         void on_objects( const object_notification& notification, bool owners_of_new_objects );
+         void invalidate( account_id_type account, uint32_t block_num );
+         void erase( std::map<account_id_type, entry>::iterator itr );
+         void clear();
+         /// drop everything if blocks were popped without applying others
+         void check_head_block();
+         /// @return true if pending transactions changed @ref account or objects its full account includes
+         bool has_pending_changes( account_id_type account, const flat_set<object_id_type>& dependencies );
+
+         static flat_set<object_id_type> dependencies_of( const full_account& value );
+
+         database&                                                   _db;
+         uint32_t                                                    _max_accounts;
+         std::mutex                                                  _mutex;
+
+         std::map<account_id_type, entry>                            _entries;
+         /// most recently used first
+         std::list<account_id_type>                                  _lru;
+         std::unordered_map<object_id_type, flat_set<account_id_type>> _dependents;
+         block_id_type                                               _head_block_id;
+
+         /// changes of the pending transactions, recomputed when transactions were pushed since
+         uint64_t                                                    _pending_generation = 1;
+         uint64_t                                                    _pending_generation_seen = 0;
+         std::unordered_set<object_id_type>                          _pending_ids;
+         flat_set<account_id_type>                                   _pending_owners;
+         bool                                                        _pending_proposals = false;
+
+         boost::signals2::scoped_connection                          _new_connection;
+         boost::signals2::scoped_connection                          _change_connection;
+         boost::signals2::scoped_connection                          _removed_connection;
+         boost::signals2::scoped_connection                          _applied_block_connection;
+         boost::signals2::scoped_connection                          _pending_connection;
+   };
+
+} }
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <fc/signals.hpp>
+#include <fc/variant.hpp>
+
+#include <boost/signals2.hpp>
+
+namespace graphene { namespace app {
+   using namespace graphene::chain;
+
+   /**
+    *  One notification of the database about objects that were created, changed or removed, shared by every API
+    *  session.  Each object is serialized at most once, the first time a session asks for it, and sessions copy the
+    *  resulting variant, which shares its contents rather than duplicating them.
+    *
+    *  Only valid while the notification is being emitted: removed objects are gone afterwards.
+    */
+   class object_notification
+   {
+      public:
+         object_notification( const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts,
+                              std::function<const object*(object_id_type)> find_object );
+
+         const vector<object_id_type>&     ids()const { return _ids; }
+         const flat_set<account_id_type>&  impacted_accounts()const { return _impacted_accounts; }
+
+         /// @return the object at @ref index of ids(), or nullptr if it no longer exists
+         const object*                     get_object( size_t index )const;
+         /// @return the object at @ref index of ids() as a variant, null if it no longer exists
+         const fc::variant&                full_object( size_t index )const;
+         /// @return the id at @ref index of ids() as a variant
+         const fc::variant&                object_id( size_t index )const;
+
+      private:
+         const vector<object_id_type>&                  _ids;
+         const flat_set<account_id_type>&               _impacted_accounts;
+         std::function<const object*(object_id_type)>   _find_object;
+         mutable vector< optional<fc::variant> >        _full_objects;
+         mutable vector< optional<fc::variant> >        _object_ids;
+   };
+
+   /**
+    *  Forwards the object notifications of the database to every API session, so that an object changed in a block is
+    *  serialized once no matter how many sessions are subscribed to it.  Handlers must not yield.
+    */
+   class object_notification_hub
+   {
+      public:
+         explicit object_notification_hub( database& db );
+
+         fc::signal<void(const object_notification&)> objects_new;
+         fc::signal<void(const object_notification&)> objects_changed;
+         fc::signal<void(const object_notification&)> objects_removed;
+
+      private:
+         database&                            _db;
+         boost::signals2::scoped_connection   _new_connection;
+         boost::signals2::scoped_connection   _change_connection;
+         boost::signals2::scoped_connection   _removed_connection;
+   };
+
+} }
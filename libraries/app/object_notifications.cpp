@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/object_notifications.hpp>
+
+namespace graphene { namespace app {
+
+object_notification::object_notification( const vector<object_id_type>& ids,
+                                          const flat_set<account_id_type>& impacted_accounts,
+                                          std::function<const object*(object_id_type)> find_object )
+   : _ids( ids ), _impacted_accounts( impacted_accounts ), _find_object( std::move( find_object ) ),
+     _full_objects( ids.size() ), _object_ids( ids.size() )
+{}
+
+const object* object_notification::get_object( size_t index )const
+{
+   return _find_object( _ids[index] );
+}
+
+const fc::variant& object_notification::full_object( size_t index )const
+{
+   optional<fc::variant>& result = _full_objects[index];
+   if( !result )
+   {
+      const object* obj = get_object( index );
+      result = obj ? obj->to_variant() : fc::variant();
+   }
+   return *result;
+}
+
+const fc::variant& object_notification::object_id( size_t index )const
+{
+   optional<fc::variant>& result = _object_ids[index];
+   if( !result )
+      result = fc::variant( _ids[index], 1 );
+   return *result;
+}
+
+object_notification_hub::object_notification_hub( database& db ) : _db( db )
+{
+   auto find_in_db = [this]( object_id_type id ) { return _db.find_object( id ); };
+   _new_connection = _db.new_objects.connect(
+      [this, find_in_db]( const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts ) {
+         if( !objects_new.empty() )
+            objects_new( object_notification( ids, impacted_accounts, find_in_db ) );
+      });
+   _change_connection = _db.changed_objects.connect(
+      [this, find_in_db]( const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts ) {
+         if( !objects_changed.empty() )
+            objects_changed( object_notification( ids, impacted_accounts, find_in_db ) );
+      });
+   _removed_connection = _db.removed_objects.connect(
+      [this]( const vector<object_id_type>& ids, const vector<const object*>& objs,
+              const flat_set<account_id_type>& impacted_accounts ) {
+         if( objects_removed.empty() )
+            return;
+         flat_map<object_id_type, const object*> removed;
+         for( const object* obj : objs )
+            if( obj != nullptr )
+               removed.emplace( obj->id, obj );
+         objects_removed( object_notification( ids, impacted_accounts, [&removed]( object_id_type id ) -> const object* {
+            auto itr = removed.find( id );
+            return itr != removed.end() ? itr->second : nullptr;
+         }));
+      });
+}
+
+} }
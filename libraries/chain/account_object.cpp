@@ -319,6 +319,79 @@ const account_balance_object* balances_by_account_index::get_account_balance( co
    return itr->second;
 }
 
+void asset_holders_index::add( const account_balance_object& abo )
+{
+   counts& c = _counts[abo.asset_type];
+   ++c.balances;
+   if( abo.balance == 0 )
+      return;
+   ++c.holders;
+   _holders.insert( { abo.asset_type, abo.balance, abo.owner, &abo } );
+}
+
+void asset_holders_index::remove( const account_balance_object& abo )
+{
+   auto itr = _counts.find( abo.asset_type );
+   if( itr == _counts.end() )
+      return;
+   if( abo.balance != 0 )
+   {
+      auto holder_itr = _holders.find( boost::make_tuple( abo.asset_type, abo.balance, abo.owner ) );
+      if( holder_itr != _holders.end() )
+      {
+         _holders.erase( holder_itr );
+         --itr->second.holders;
+      }
+   }
+   if( --itr->second.balances == 0 )
+      _counts.erase( itr );
+}
+
+void asset_holders_index::object_inserted( const object& obj )
+{
+   add( static_cast< const account_balance_object& >( obj ) );
+}
+
+void asset_holders_index::object_removed( const object& obj )
+{
+   remove( static_cast< const account_balance_object& >( obj ) );
+}
+
+void asset_holders_index::about_to_modify( const object& before )
+{
+   remove( static_cast< const account_balance_object& >( before ) );
+}
+
+void asset_holders_index::object_modified( const object& after  )
+{
+   add( static_cast< const account_balance_object& >( after ) );
+}
+
+uint32_t asset_holders_index::balance_count( asset_id_type asset )const
+{
+   auto itr = _counts.find( asset );
+   return itr == _counts.end() ? 0 : itr->second.balances;
+}
+
+uint32_t asset_holders_index::holder_count( asset_id_type asset )const
+{
+   auto itr = _counts.find( asset );
+   return itr == _counts.end() ? 0 : itr->second.holders;
+}
+
+vector<const account_balance_object*> asset_holders_index::get_holders( asset_id_type asset, uint32_t start, uint32_t limit )const
+{
+   vector<const account_balance_object*> result;
+   const uint32_t holders = holder_count( asset );
+   if( start >= holders )
+      return result;
+   result.reserve( std::min( limit, holders - start ) );
+   auto itr = _holders.nth( _holders.rank( _holders.lower_bound( boost::make_tuple( asset ) ) ) + start );
+   for( ; result.size() < limit && itr != _holders.end() && itr->asset_type == asset; ++itr )
+      result.push_back( itr->object );
+   return result;
+}
+
 } } // graphene::chain
 
 GRAPHENE_EXTERNAL_SERIALIZATION( /*not extern*/, graphene::chain::account_object )
@@ -222,6 +222,97 @@ vector<uint64_t> asset_object::get_ticket_ids( database& db ) const
    return ids;
 }
 
+size_t lottery_ticket_ranges::holder_index( uint64_t ticket )const
+{
+   FC_ASSERT( ticket < size() );
+   return std::upper_bound( range_ends.begin(), range_ends.end(), ticket ) - range_ends.begin();
+}
+
+lottery_ticket_ranges asset_object::get_ticket_ranges( database& db ) const
+{
+   auto& asset_bal_idx = db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
+   lottery_ticket_ranges ranges;
+   uint64_t end = 0;
+   const auto range = asset_bal_idx.equal_range( boost::make_tuple( get_id() ) );
+   for( const account_balance_object& bal : boost::make_iterator_range( range.first, range.second ) )
+   {
+      if( bal.balance <= 0 )
+         continue;
+      end += bal.balance.value;
+      ranges.range_ends.push_back( end );
+      ranges.owners.push_back( bal.owner );
+   }
+   return ranges;
+}
+
+optional<uint64_t> asset_object::get_ticket_id( database& db, const lottery_ticket_ranges& ranges, uint64_t ticket ) const
+{
+   const lottery_ticket_purchase_index* purchases = db.get_lottery_ticket_purchases();
+   if( purchases == nullptr )
+      return optional<uint64_t>();
+   const size_t holder = ranges.holder_index( ticket );
+   return purchases->find_purchase( get_id(), ranges.owners[holder], ticket - ranges.range_begin( holder ) );
+}
+
+void lottery_ticket_purchase_index::object_inserted( const object& obj )
+{
+   const operation_history_object& oho = static_cast<const operation_history_object&>( obj );
+   if( oho.op.which() != operation::tag<ticket_purchase_operation>::value )
+      return;
+   const ticket_purchase_operation& op = oho.op.get<ticket_purchase_operation>();
+   purchases_type& purchases = _purchases[ std::make_pair( op.lottery, op.buyer ) ];
+   auto itr = _ends.find( oho.id );
+   if( itr != _ends.end() )
+   {
+      // undo restored a purchase pruned from the history
+      purchases[itr->second].pruned = false;
+      return;
+   }
+   const uint64_t end = ( purchases.empty() ? 0 : purchases.rbegin()->first ) + op.tickets_to_buy;
+   purchase& p = purchases[end];
+   p.tickets = op.tickets_to_buy;
+   p.operation_id = oho.id;
+   _ends[oho.id] = end;
+}
+
+void lottery_ticket_purchase_index::object_removed( const object& obj )
+{
+   const operation_history_object& oho = static_cast<const operation_history_object&>( obj );
+   auto itr = _ends.find( oho.id );
+   if( itr == _ends.end() )
+      return;
+   const ticket_purchase_operation& op = oho.op.get<ticket_purchase_operation>();
+   purchases_type& purchases = _purchases[ std::make_pair( op.lottery, op.buyer ) ];
+   if( _db != nullptr && _db->_undo_db.enabled() )
+   {
+      // pruned while applying a block, which may still be undone
+      purchases[itr->second].pruned = true;
+      return;
+   }
+   purchases.erase( itr->second );
+   _ends.erase( itr );
+   if( purchases.empty() )
+      _purchases.erase( std::make_pair( op.lottery, op.buyer ) );
+}
+
+optional<uint64_t> lottery_ticket_purchase_index::find_purchase( asset_id_type lottery, account_id_type buyer,
+                                                                 uint64_t offset )const
+{
+   auto itr = _purchases.find( std::make_pair( lottery, buyer ) );
+   if( itr == _purchases.end() )
+      return optional<uint64_t>();
+   const purchases_type& purchases = itr->second;
+   const uint64_t last = purchases.rbegin()->first;
+   if( offset >= last )
+      return optional<uint64_t>();
+   const uint64_t ticket = last - 1 - offset;
+   auto p = purchases.upper_bound( ticket );
+   // gaps are left by purchases erased from the history during a replay
+   if( p->second.pruned || p->first - p->second.tickets > ticket )
+      return optional<uint64_t>();
+   return p->second.operation_id.instance.value;
+}
+
 void asset_object::distribute_benefactors_part( database& db )
 {
    transaction_evaluation_state eval( &db );
@@ -242,28 +333,25 @@ map< account_id_type, vector< uint16_t > > asset_object::distribute_winners_part
 {
    transaction_evaluation_state eval( &db );
       
-   auto holders = get_holders( db );
-   vector<uint64_t> ticket_ids = get_ticket_ids(db);
-   FC_ASSERT( dynamic_data( db ).current_supply == holders.size() );
+   const lottery_ticket_ranges ranges = get_ticket_ranges( db );
+   const uint64_t tickets_sold = ranges.size();
+   FC_ASSERT( dynamic_data( db ).current_supply == tickets_sold );
    map<account_id_type, vector<uint16_t> > structurized_participants;
-   for( account_id_type holder : holders )
-   {
-      if( !structurized_participants.count( holder ) )
-         structurized_participants.emplace( holder, vector< uint16_t >() );
-   }
+   for( account_id_type holder : ranges.owners )
+      structurized_participants.emplace( holder, vector< uint16_t >() );
    uint64_t jackpot = get_id()( db ).dynamic_data( db ).current_supply.value * lottery_options->ticket_price.amount.value;
-   auto winner_numbers = db.get_winner_numbers( get_id(), holders.size(), lottery_options->winning_tickets.size() );
+   auto winner_numbers = db.get_winner_numbers( get_id(), tickets_sold, lottery_options->winning_tickets.size() );
    
    auto& tickets( lottery_options->winning_tickets );
    
-   if( holders.size() < tickets.size() ) {
+   if( tickets_sold < tickets.size() ) {
       uint16_t percents_to_distribute = 0;
-      for( auto i = tickets.begin() + holders.size(); i != tickets.end(); ) {
+      for( auto i = tickets.begin() + tickets_sold; i != tickets.end(); ) {
          percents_to_distribute += *i;
          i = tickets.erase(i);
       }
-      for( auto t = tickets.begin(); t != tickets.begin() + holders.size(); ++t )
-         *t += percents_to_distribute / holders.size();
+      for( auto t = tickets.begin(); t != tickets.begin() + tickets_sold; ++t )
+         *t += percents_to_distribute / tickets_sold;
    }
    auto sweeps_distribution_percentage = db.get_global_properties().parameters.sweeps_distribution_percentage();
    for( int c = 0; c < winner_numbers.size(); ++c ) {
@@ -271,17 +359,22 @@ map< account_id_type, vector< uint16_t > > asset_object::distribute_winners_part
       lottery_reward_operation reward_op;
       reward_op.lottery = get_id();
       reward_op.is_benefactor_reward = false;
-      reward_op.winner = holders[winner_num];
-      if(db.head_block_time() > HARDFORK_5050_1_TIME && ticket_ids.size() > winner_num)
+      const account_id_type winner = ranges.owners[ ranges.holder_index( winner_num ) ];
+      reward_op.winner = winner;
+      if( db.head_block_time() > HARDFORK_5050_1_TIME )
       {
-         const static_variant<uint64_t, void_t> tkt_id = ticket_ids[winner_num];
-         reward_op.winner_ticket_id = tkt_id;
+         const optional<uint64_t> ticket_id = get_ticket_id( db, ranges, winner_num );
+         if( ticket_id.valid() )
+         {
+            const static_variant<uint64_t, void_t> tkt_id = *ticket_id;
+            reward_op.winner_ticket_id = tkt_id;
+         }
       }
       reward_op.win_percentage = tickets[c];
       reward_op.amount = asset( jackpot * tickets[c] * ( 1. - sweeps_distribution_percentage / (double)GRAPHENE_100_PERCENT ) / GRAPHENE_100_PERCENT , db.get_balance(id).asset_id );
       db.apply_operation(eval, reward_op);
       
-      structurized_participants[ holders[ winner_num ] ].push_back( tickets[c] );
+      structurized_participants[ winner ].push_back( tickets[c] );
    }
    return structurized_participants;
 }
@@ -31,6 +31,8 @@
 #include <graphene/chain/hardfork.hpp>
 #include <graphene/chain/is_authorized_asset.hpp>
 
+#include <boost/range/iterator_range.hpp>
+
 namespace graphene { namespace chain {
 
 void_result betting_market_rules_create_evaluator::do_evaluate(const betting_market_rules_create_operation& op)
@@ -168,25 +170,25 @@ void_result betting_market_group_update_evaluator::do_apply(const betting_market
       if (betting_market_group.bets_are_allowed() && 
           bets_were_delayed && !bets_are_delayed)
       {
-         const auto& bet_odds_idx = d.get_index_type<bet_object_index>().indices().get<by_odds>();
-         auto bet_iter = bet_odds_idx.begin();
-         bool last = bet_iter == bet_odds_idx.end() || !bet_iter->end_of_delay;
-         while (!last)
+         const auto& delayed_bet_idx = d.get_index_type<primary_index<bet_object_index>>().get_secondary_index<delayed_bet_index>();
+         const auto& betting_market_index = d.get_index_type<betting_market_object_index>().indices().get<by_betting_market_group_id>();
+
+         // gather the delayed bets of every market in the group, then place them in by_odds order
+         std::vector<std::pair<time_point_sec, bet_id_type>> bets_to_place;
+         for (const betting_market_object& betting_market : boost::make_iterator_range(betting_market_index.equal_range(op.betting_market_group_id)))
+            if (const delayed_bet_index::delayed_bet_queue* delayed_bets = delayed_bet_idx.get_delayed_bets(betting_market.id))
+               bets_to_place.insert(bets_to_place.end(), delayed_bets->begin(), delayed_bets->end());
+         std::sort(bets_to_place.begin(), bets_to_place.end());
+
+         for (const auto& delayed_bet_entry : bets_to_place)
          {
-            const bet_object& delayed_bet = *bet_iter;
-            ++bet_iter;
-            last = bet_iter == bet_odds_idx.end() || !bet_iter->end_of_delay;
-
-            const betting_market_object& betting_market = delayed_bet.betting_market_id(d);
-            if (betting_market.group_id == op.betting_market_group_id)
-            {
-               d.modify(delayed_bet, [](bet_object& bet_obj) {
-                  // clear the end_of_delay,  which will re-sort the bet into its place in the book
-                  bet_obj.end_of_delay.reset();
-               });
-
-               d.place_bet(delayed_bet);
-            }
+            const bet_object& delayed_bet = delayed_bet_entry.second(d);
+            d.modify(delayed_bet, [](bet_object& bet_obj) {
+               // clear the end_of_delay,  which will re-sort the bet into its place in the book
+               bet_obj.end_of_delay.reset();
+            });
+
+            d.place_bet(delayed_bet);
          }
       }
    });
@@ -395,16 +395,14 @@ void betting_market_object::cancel_all_unmatched_bets(database& db) const
       db.cancel_bet(*old_book_itr, true);
    }
 
-   // then, cancel any delayed bets on that market.  We don't have an index for
-   // that, so walk through all delayed bets
-   book_itr = bet_odds_idx.begin();
-   while (book_itr != bet_odds_idx.end() &&
-          book_itr->end_of_delay)
+   // then, cancel any delayed bets on that market
+   const auto& delayed_bet_idx = db.get_index_type<primary_index<bet_object_index>>().get_secondary_index<delayed_bet_index>();
+   if (const delayed_bet_index::delayed_bet_queue* delayed_bets = delayed_bet_idx.get_delayed_bets(id))
    {
-      auto old_book_itr = book_itr;
-      ++book_itr;
-      if (old_book_itr->betting_market_id == id)
-         db.cancel_bet(*old_book_itr, true);
+      // canceling removes the bet from the queue, so take a copy first
+      const delayed_bet_index::delayed_bet_queue bets_to_cancel = *delayed_bets;
+      for (const auto& delayed_bet : bets_to_cancel)
+         db.cancel_bet(delayed_bet.second(db), true);
    }
 }
     
@@ -422,6 +420,186 @@ void betting_market_object::cancel_all_bets(database& db) const
     }
 }
 
+namespace {
+   template<typename Levels>
+   void add_to_level( Levels& levels, const bet_object& bet )
+   {
+      bet_price_level& level = levels[bet.backer_multiplier];
+      level.total_amount_to_bet += bet.amount_to_bet.amount;
+      level.bets.insert( bet.id );
+   }
+
+   template<typename Levels>
+   void remove_from_level( Levels& levels, const bet_object& bet )
+   {
+      auto level_itr = levels.find( bet.backer_multiplier );
+      if( level_itr == levels.end() )
+         return;
+      level_itr->second.total_amount_to_bet -= bet.amount_to_bet.amount;
+      level_itr->second.bets.erase( bet.id );
+      if( level_itr->second.bets.empty() )
+         levels.erase( level_itr );
+   }
+}
+
+void bet_order_book_index::add_bet( const bet_object& bet )
+{
+   if( bet.end_of_delay )
+      return;
+   betting_market_book& book = books[bet.betting_market_id];
+   if( bet.back_or_lay == bet_type::back )
+   {
+      add_to_level( book.back_levels, bet );
+      book.total_back_amount_to_bet += bet.amount_to_bet.amount;
+   }
+   else
+   {
+      add_to_level( book.lay_levels, bet );
+      book.total_lay_amount_to_bet += bet.amount_to_bet.amount;
+   }
+}
+
+void bet_order_book_index::remove_bet( const bet_object& bet )
+{
+   if( bet.end_of_delay )
+      return;
+   auto book_itr = books.find( bet.betting_market_id );
+   if( book_itr == books.end() )
+      return;
+   betting_market_book& book = book_itr->second;
+   if( bet.back_or_lay == bet_type::back )
+   {
+      remove_from_level( book.back_levels, bet );
+      book.total_back_amount_to_bet -= bet.amount_to_bet.amount;
+   }
+   else
+   {
+      remove_from_level( book.lay_levels, bet );
+      book.total_lay_amount_to_bet -= bet.amount_to_bet.amount;
+   }
+   if( book.back_levels.empty() && book.lay_levels.empty() )
+      books.erase( book_itr );
+}
+
+void bet_order_book_index::object_inserted( const object& obj )
+{
+   add_bet( static_cast<const bet_object&>( obj ) );
+}
+
+void bet_order_book_index::object_removed( const object& obj )
+{
+   remove_bet( static_cast<const bet_object&>( obj ) );
+}
+
+void bet_order_book_index::about_to_modify( const object& before )
+{
+   bets_being_modified.emplace( static_cast<const bet_object&>( before ) );
+}
+
+void bet_order_book_index::object_modified( const object& after )
+{
+   FC_ASSERT( !bets_being_modified.empty() && bets_being_modified.top().id == after.id, "Modification of ID is not supported!" );
+   remove_bet( bets_being_modified.top() );
+   bets_being_modified.pop();
+   add_bet( static_cast<const bet_object&>( after ) );
+}
+
+const betting_market_book* bet_order_book_index::get_book( betting_market_id_type betting_market_id )const
+{
+   auto book_itr = books.find( betting_market_id );
+   return book_itr == books.end() ? nullptr : &book_itr->second;
+}
+
+void delayed_bet_index::add_bet( const bet_object& bet )
+{
+   if( !bet.end_of_delay )
+      return;
+   delayed_bet_queue& queue = bets_by_market[bet.betting_market_id];
+   if( !queue.empty() )
+      markets_by_next_delay.erase( std::make_pair( queue.begin()->first, bet.betting_market_id ) );
+   queue.emplace( *bet.end_of_delay, bet.id );
+   markets_by_next_delay.emplace( queue.begin()->first, bet.betting_market_id );
+}
+
+void delayed_bet_index::remove_bet( const bet_object& bet )
+{
+   if( !bet.end_of_delay )
+      return;
+   auto queue_itr = bets_by_market.find( bet.betting_market_id );
+   if( queue_itr == bets_by_market.end() )
+      return;
+   delayed_bet_queue& queue = queue_itr->second;
+   markets_by_next_delay.erase( std::make_pair( queue.begin()->first, bet.betting_market_id ) );
+   queue.erase( std::make_pair( *bet.end_of_delay, bet.id ) );
+   if( queue.empty() )
+      bets_by_market.erase( queue_itr );
+   else
+      markets_by_next_delay.emplace( queue.begin()->first, bet.betting_market_id );
+}
+
+void delayed_bet_index::object_inserted( const object& obj )
+{
+   add_bet( static_cast<const bet_object&>( obj ) );
+}
+
+void delayed_bet_index::object_removed( const object& obj )
+{
+   remove_bet( static_cast<const bet_object&>( obj ) );
+}
+
+void delayed_bet_index::about_to_modify( const object& before )
+{
+   bets_being_modified.emplace( static_cast<const bet_object&>( before ) );
+}
+
+void delayed_bet_index::object_modified( const object& after )
+{
+   FC_ASSERT( !bets_being_modified.empty() && bets_being_modified.top().id == after.id, "Modification of ID is not supported!" );
+   remove_bet( bets_being_modified.top() );
+   bets_being_modified.pop();
+   add_bet( static_cast<const bet_object&>( after ) );
+}
+
+const delayed_bet_index::delayed_bet_queue* delayed_bet_index::get_delayed_bets( betting_market_id_type betting_market_id )const
+{
+   auto queue_itr = bets_by_market.find( betting_market_id );
+   return queue_itr == bets_by_market.end() ? nullptr : &queue_itr->second;
+}
+
+void betting_market_open_interest_index::adjust( const betting_market_position_object& position, int sign )
+{
+   share_type& market_open_interest = open_interest[position.betting_market_id];
+   market_open_interest += sign * position.pay_if_canceled.value;
+   if( market_open_interest == 0 )
+      open_interest.erase( position.betting_market_id );
+}
+
+void betting_market_open_interest_index::object_inserted( const object& obj )
+{
+   adjust( static_cast<const betting_market_position_object&>( obj ), 1 );
+}
+
+void betting_market_open_interest_index::object_removed( const object& obj )
+{
+   adjust( static_cast<const betting_market_position_object&>( obj ), -1 );
+}
+
+void betting_market_open_interest_index::about_to_modify( const object& before )
+{
+   adjust( static_cast<const betting_market_position_object&>( before ), -1 );
+}
+
+void betting_market_open_interest_index::object_modified( const object& after )
+{
+   adjust( static_cast<const betting_market_position_object&>( after ), 1 );
+}
+
+share_type betting_market_open_interest_index::get_open_interest( betting_market_id_type betting_market_id )const
+{
+   auto itr = open_interest.find( betting_market_id );
+   return itr == open_interest.end() ? share_type() : itr->second;
+}
+
 void betting_market_object::pack_impl(std::ostream& stream) const
 {
    boost::archive::binary_oarchive oa(stream, boost::archive::no_header|boost::archive::no_codecvt|boost::archive::no_xml_tag_checking);
@@ -25,6 +25,8 @@
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <fc/io/raw.hpp>
 
+#include <algorithm>
+
 namespace graphene { namespace chain {
 
 struct index_entry
@@ -206,6 +208,86 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    return optional<signed_block>();
 }
 
+vector<packed_block> block_database::fetch_range( uint32_t first, uint32_t last, uint64_t max_bytes )const
+{
+   vector<packed_block> result;
+   if( last < first )
+      return result;
+   result.resize( uint64_t(last) - first + 1 );
+   try
+   {
+      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
+      const uint64_t index_end = std::min<uint64_t>( uint64_t(_block_num_to_pos.tellg()) / sizeof(index_entry),
+                                                     uint64_t(last) + 1 );
+      if( index_end <= first )
+         return result;
+
+      vector<index_entry> entries( index_end - first );
+      _block_num_to_pos.seekg( sizeof(index_entry) * uint64_t(first) );
+      _block_num_to_pos.read( (char*)entries.data(), sizeof(index_entry) * entries.size() );
+
+      _blocks.seekg( 0, _blocks.end );
+      const uint64_t blocks_size = _blocks.tellg();
+      uint64_t span_begin = blocks_size;
+      uint64_t span_end = 0;
+      uint64_t total = 0;
+      for( size_t i = 0; i < entries.size(); ++i )
+      {
+         index_entry& e = entries[i];
+         if( e.block_id == block_id_type() || e.block_pos + e.block_size > blocks_size )
+            e.block_size = 0;
+         if( e.block_size == 0 )
+            continue;
+         if( total != 0 && total + e.block_size > max_bytes )
+         {
+            entries.resize( i );
+            result.resize( i );
+            break;
+         }
+         span_begin = std::min( span_begin, e.block_pos );
+         span_end = std::max( span_end, e.block_pos + e.block_size );
+         total += e.block_size;
+      }
+      if( total == 0 )
+         return result;
+
+      // blocks replaced by a fork switch were appended elsewhere, read those one by one rather than the gap
+      vector<char> span;
+      if( span_end - span_begin <= 2 * total )
+      {
+         span.resize( span_end - span_begin );
+         _blocks.seekg( span_begin );
+         _blocks.read( span.data(), span.size() );
+      }
+
+      for( size_t i = 0; i < entries.size(); ++i )
+      {
+         const index_entry& e = entries[i];
+         if( e.block_size == 0 )
+            continue;
+         vector<char> data;
+         if( !span.empty() )
+            data.assign( span.begin() + ( e.block_pos - span_begin ),
+                         span.begin() + ( e.block_pos - span_begin + e.block_size ) );
+         else
+         {
+            data.resize( e.block_size );
+            _blocks.seekg( e.block_pos );
+            _blocks.read( data.data(), e.block_size );
+         }
+         result[i].id = e.block_id;
+         result[i].data = std::move( data );
+      }
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return result;
+}
+
 optional<index_entry> block_database::last_index_entry()const {
    try
    {
@@ -65,16 +65,14 @@ void database::cancel_all_unmatched_bets_on_betting_market(const betting_market_
       cancel_bet(*old_book_itr, true);
    }
 
-   // then, cancel any delayed bets on that market.  We don't have an index for
-   // that, so walk through all delayed bets
-   book_itr = bet_odds_idx.begin();
-   while (book_itr != bet_odds_idx.end() &&
-          book_itr->end_of_delay)
+   // then, cancel any delayed bets on that market
+   const auto& delayed_bet_idx = get_index_type<primary_index<bet_object_index>>().get_secondary_index<delayed_bet_index>();
+   if (const delayed_bet_index::delayed_bet_queue* delayed_bets = delayed_bet_idx.get_delayed_bets(betting_market.id))
    {
-      auto old_book_itr = book_itr;
-      ++book_itr;
-      if (old_book_itr->betting_market_id == betting_market.id)
-         cancel_bet(*old_book_itr, true);
+      // canceling removes the bet from the queue, so take a copy first
+      const delayed_bet_index::delayed_bet_queue bets_to_cancel = *delayed_bets;
+      for (const auto& delayed_bet : bets_to_cancel)
+         cancel_bet(delayed_bet.second(*this), true);
    }
 }
 
@@ -174,89 +172,66 @@ void database::settle_betting_market_group(const betting_market_group_object& be
    // stored in the individual betting markets
    std::map<betting_market_id_type, betting_market_resolution_type> resolutions_by_market_id;
 
-   // collecting bettors and their positions
-   std::map<account_id_type, std::vector<const betting_market_position_object*> > bettor_positions_map;
-
    auto& betting_market_index = get_index_type<betting_market_object_index>().indices().get<by_betting_market_group_id>();
-   // [ROL] it seems to be my mistake - wrong index used
-   //auto& position_index = get_index_type<betting_market_position_index>().indices().get<by_bettor_betting_market>();
-   auto& position_index = get_index_type<betting_market_position_index>().indices().get<by_betting_market_bettor>();
    auto betting_market_itr = betting_market_index.lower_bound(betting_market_group.id);
    while (betting_market_itr != betting_market_index.end() &&  betting_market_itr->group_id == betting_market_group.id)
    {
       const betting_market_object& betting_market = *betting_market_itr;
       FC_ASSERT(betting_market_itr->resolution, "Unexpected error settling betting market ${market_id}: no published resolution",
                 ("market_id", betting_market_itr->id));
-      resolutions_by_market_id.emplace(betting_market.id, *betting_market_itr->resolution);
+      resolutions_by_market_id.emplace_hint(resolutions_by_market_id.end(), betting_market.id, *betting_market_itr->resolution);
 
       ++betting_market_itr;
       cancel_all_unmatched_bets_on_betting_market(betting_market);
-
-      auto position_itr = position_index.lower_bound(betting_market.id);
-
-      while (position_itr != position_index.end() && position_itr->betting_market_id == betting_market.id)
-      {
-         const betting_market_position_object& position = *position_itr;
-         ++position_itr;
-
-         bettor_positions_map[position.bettor_id].push_back(&position);
-      }
    }
 
-   // walking through bettors' positions and collecting winings and fees respecting asset_id
-   for (const auto& bettor_positions_pair: bettor_positions_map)
+   // positions carry their group, so walking this index visits every bettor of the group once, in
+   // account order, with that bettor's positions in market order
+   const auto& position_index = get_index_type<betting_market_position_index>().indices().get<by_betting_market_group_bettor>();
+   const uint16_t rake_fee_percentage = get_global_properties().parameters.betting_rake_fee_percentage();
+
+   auto position_itr = position_index.lower_bound(betting_market_group.id);
+   while (position_itr != position_index.end() && position_itr->betting_market_group_id == betting_market_group.id)
    {
-      uint16_t rake_fee_percentage = get_global_properties().parameters.betting_rake_fee_percentage();
+      const account_id_type bettor_id = position_itr->bettor_id;
       share_type net_profits;
       share_type payout_amounts;
-      account_id_type bettor_id = bettor_positions_pair.first;
-      const std::vector<const betting_market_position_object*>& bettor_positions = bettor_positions_pair.second;
 
-      for (const betting_market_position_object* position : bettor_positions)
+      // walking through bettor's positions and collecting winings and fees respecting asset_id
+      while (position_itr != position_index.end() &&
+             position_itr->betting_market_group_id == betting_market_group.id &&
+             position_itr->bettor_id == bettor_id)
       {
-         betting_market_resolution_type resolution;
-         try
-         {
-            resolution = resolutions_by_market_id.at(position->betting_market_id);
-         }
-         catch (std::out_of_range&)
-         {
-            FC_THROW_EXCEPTION(fc::key_not_found_exception, "Unexpected betting market ID, shouldn't happen");
-         }
-
-         ///if (cancel)
-         ///   resolution = betting_market_resolution_type::cancel;
-         ///else
-         ///{
-         ///   // checked in evaluator, should never happen, see above
-         ///   assert(resolutions.count(position->betting_market_id));
-         ///   resolution = resolutions.at(position->betting_market_id);
-         ///}
+         const betting_market_position_object& position = *position_itr;
+         ++position_itr;
 
+         auto resolution_itr = resolutions_by_market_id.find(position.betting_market_id);
+         if (resolution_itr == resolutions_by_market_id.end())
+            FC_THROW_EXCEPTION(fc::key_not_found_exception, "Unexpected betting market ID, shouldn't happen");
 
-         switch (resolution)
+         switch (resolution_itr->second)
          {
             case betting_market_resolution_type::win:
                {
-                  share_type total_payout = position->pay_if_payout_condition + position->pay_if_not_canceled;
+                  share_type total_payout = position.pay_if_payout_condition + position.pay_if_not_canceled;
                   payout_amounts += total_payout;
-                  net_profits += total_payout - position->pay_if_canceled;
+                  net_profits += total_payout - position.pay_if_canceled;
                   break;
                }
             case betting_market_resolution_type::not_win:
                {
-                  share_type total_payout = position->pay_if_not_payout_condition + position->pay_if_not_canceled;
+                  share_type total_payout = position.pay_if_not_payout_condition + position.pay_if_not_canceled;
                   payout_amounts += total_payout;
-                  net_profits += total_payout - position->pay_if_canceled;
+                  net_profits += total_payout - position.pay_if_canceled;
                   break;
                }
             case betting_market_resolution_type::cancel:
-               payout_amounts += position->pay_if_canceled;
+               payout_amounts += position.pay_if_canceled;
                break;
             default:
                continue;
          }
-         remove(*position);
+         remove(position);
       }
 
       // pay the fees to the dividend-distribution account if net profit
@@ -355,6 +330,7 @@ share_type adjust_betting_position(database& db,
       db.create<betting_market_position_object>([&](betting_market_position_object& position) {
          position.bettor_id = bettor_id;
          position.betting_market_id = betting_market_id;
+         position.betting_market_group_id = betting_market_id(db).group_id;
          position.pay_if_payout_condition = back_or_lay == bet_type::back ? bet_amount + matched_amount : 0;
          position.pay_if_not_payout_condition = back_or_lay == bet_type::lay ? bet_amount + matched_amount : 0;
          position.pay_if_canceled = bet_amount;
@@ -396,6 +372,7 @@ bool bet_was_matched(database& db, const bet_object& bet,
                                                 guaranteed_winnings_returned);
    //fc_edump(fc::logger::get("betting"), (bet_matched_virtual_op));
    db.push_applied_operation(std::move(bet_matched_virtual_op));
+   db.bet_matched(bet, amount_bet);
 
    // update the bet on the books
    if (asset_amount_bet == bet.amount_to_bet)
@@ -123,6 +123,21 @@ optional<signed_block> database::fetch_block_by_number( uint32_t num )const
    return optional<signed_block>();
 }
 
+vector<packed_block> database::fetch_packed_blocks( uint32_t first, uint32_t last, uint64_t max_bytes )const
+{
+   vector<packed_block> result = _block_id_to_block.fetch_range( first, last, max_bytes );
+   for( size_t i = 0; i < result.size(); ++i )
+   {
+      auto items = _fork_db.fetch_block_by_number( first + i );
+      if( items.size() == 1 && items[0]->id != result[i].id )
+      {
+         result[i].id = items[0]->id;
+         result[i].data = fc::raw::pack( items[0]->data );
+      }
+   }
+   return result;
+}
+
 const signed_transaction& database::get_recent_transaction(const transaction_id_type& trx_id) const
 {
    auto& index = get_index_type<transaction_index>().indices().get<by_trx_id>();
@@ -173,6 +188,18 @@ void database::check_transaction_for_duplicated_operations(const signed_transact
    }
 }
 
+database::chain_state_write_guard::chain_state_write_guard( database& db ) : _db( db )
+{
+   if( _db._chain_state_write_depth++ == 0 )
+      _db._chain_state_mutex.lock();
+}
+
+database::chain_state_write_guard::~chain_state_write_guard()
+{
+   if( --_db._chain_state_write_depth == 0 )
+      _db._chain_state_mutex.unlock();
+}
+
 /**
  * Push block "may fail" in which case every partial change is unwound.  After
  * push block is successful the block is appended to the chain database on disk.
@@ -182,6 +209,7 @@ void database::check_transaction_for_duplicated_operations(const signed_transact
 bool database::push_block(const signed_block& new_block, uint32_t skip)
 {
 //   idump((new_block.block_num())(new_block.id())(new_block.timestamp)(new_block.previous));
+   chain_state_write_guard write_guard( *this );
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -370,6 +398,7 @@ void database::update_witnesses( fork_item& fork_entry )const
  */
 processed_transaction database::push_transaction( const signed_transaction& trx, uint32_t skip )
 { try {
+   chain_state_write_guard write_guard( *this );
    processed_transaction result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -456,6 +485,7 @@ signed_block database::generate_block(
    uint32_t skip /* = 0 */
    )
 { try {
+   chain_state_write_guard write_guard( *this );
    signed_block result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -587,6 +617,7 @@ signed_block database::_generate_block(
  */
 void database::pop_block()
 { try {
+   chain_state_write_guard write_guard( *this );
    _pending_tx_session.reset();
    auto head_id = head_block_id();
    optional<signed_block> head_block = fetch_block_by_id( head_id );
@@ -601,6 +632,7 @@ void database::pop_block()
 
 void database::clear_pending()
 { try {
+   chain_state_write_guard write_guard( *this );
    assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
    _pending_tx.clear();
    _pending_tx_session.reset();
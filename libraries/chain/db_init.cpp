@@ -332,8 +332,11 @@ void database::initialize_indexes()
    add_index< primary_index<committee_member_index, 8> >(); // 256 members per chunk
    add_index< primary_index<son_index> >();
    add_index< primary_index<witness_index, 10> >(); // 1024 witnesses per chunk
-   add_index< primary_index<limit_order_index > >();
-   add_index< primary_index<call_order_index > >();
+   auto limit_order_idx = add_index< primary_index<limit_order_index > >();
+   _margin_call_triggers = limit_order_idx->add_secondary_index<margin_call_trigger_index>();
+   limit_order_idx->add_secondary_index<limit_order_depth_index>();
+   auto call_order_idx = add_index< primary_index<call_order_index > >();
+   call_order_idx->add_secondary_index<margin_call_trigger_index::invalidator>()->set_triggers( *_margin_call_triggers );
 
    auto prop_index = add_index< primary_index<proposal_index > >();
    prop_index->add_secondary_index<required_approval_index>();
@@ -349,7 +352,9 @@ void database::initialize_indexes()
    add_index< primary_index<betting_market_rules_object_index > >();
    add_index< primary_index<betting_market_group_object_index > >();
    add_index< primary_index<betting_market_object_index > >();
-   add_index< primary_index<bet_object_index > >();
+   auto bet_idx = add_index< primary_index<bet_object_index > >();
+   bet_idx->add_secondary_index<bet_order_book_index>();
+   bet_idx->add_secondary_index<delayed_bet_index>();
 
    add_index< primary_index<tournament_index> >();
    auto tournament_details_idx = add_index< primary_index<tournament_details_index> >();
@@ -378,8 +383,10 @@ void database::initialize_indexes()
 
    auto bal_idx = add_index< primary_index<account_balance_index          > >();
    bal_idx->add_secondary_index<balances_by_account_index>();
+   bal_idx->add_secondary_index<asset_holders_index>();
 
-   add_index< primary_index<asset_bitasset_data_index,                 13 > >(); // 8192
+   auto bitasset_idx = add_index< primary_index<asset_bitasset_data_index, 13 > >(); // 8192
+   bitasset_idx->add_secondary_index<margin_call_trigger_index::invalidator>()->set_triggers( *_margin_call_triggers );
    add_index< primary_index<asset_dividend_data_object_index              > >();
    add_index< primary_index<simple_index<global_property_object          >> >();
    add_index< primary_index<simple_index<dynamic_global_property_object  >> >();
@@ -393,7 +400,8 @@ void database::initialize_indexes()
    add_index< primary_index< special_authority_index                      > >();
    add_index< primary_index< buyback_index                                > >();
    add_index< primary_index< simple_index< fba_accumulator_object       > > >();
-   add_index< primary_index< betting_market_position_index > >();
+   auto position_idx = add_index< primary_index< betting_market_position_index > >();
+   position_idx->add_secondary_index<betting_market_open_interest_index>();
    add_index< primary_index< global_betting_statistics_object_index > >();
    //add_index< primary_index<pending_dividend_payout_balance_object_index > >();
    //add_index< primary_index<distributed_dividend_balance_object_index > >();
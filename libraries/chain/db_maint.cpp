@@ -1391,7 +1391,7 @@ void schedule_pending_dividend_balances(database& db,
    uint64_t distribution_base_fee = gpo.parameters.current_fees->get<asset_dividend_distribution_operation>().distribution_base_fee;
    uint32_t distribution_fee_per_holder = gpo.parameters.current_fees->get<asset_dividend_distribution_operation>().distribution_fee_per_holder;
 
-   std::map<account_id_type, share_type> vesting_amounts;
+   account_scratch_buffer& vesting_amounts = db.get_account_scratch_buffer();
 
    auto balance_type = vesting_balance_type::normal;
    if(db.head_block_time() >= HARDFORK_GPOS_TIME)
@@ -1408,7 +1408,7 @@ void schedule_pending_dividend_balances(database& db,
 
    for (const vesting_balance_object& vesting_balance_obj : boost::make_iterator_range(vesting_balances_begin, vesting_balances_end))
    {
-        vesting_amounts[vesting_balance_obj.owner] += vesting_balance_obj.balance.amount;
+        vesting_amounts.add(vesting_balance_obj.owner, vesting_balance_obj.balance.amount);
         ++holder_account_count;
         dlog("Vesting balance for account: ${owner}, amount: ${amount}",
              ("owner", vesting_balance_obj.owner(db).name)
@@ -1422,7 +1422,7 @@ void schedule_pending_dividend_balances(database& db,
         if (vesting_balance_obj.balance.asset_id == dividend_holder_asset_obj.id && vesting_balance_obj.balance.amount &&
         vesting_balance_object.balance_type == balance_type)
         {
-            vesting_amounts[vesting_balance_obj.owner] += vesting_balance_obj.balance.amount;
+            vesting_amounts.add(vesting_balance_obj.owner, vesting_balance_obj.balance.amount);
             ++gpos_holder_account_count;
             dlog("Vesting balance for account: ${owner}, amount: ${amount}",
                  ("owner", vesting_balance_obj.owner(db).name)
@@ -1459,9 +1459,8 @@ void schedule_pending_dividend_balances(database& db,
                                                                                             holder_balances_end))
          if (holder_balance_object.owner != dividend_data.dividend_distribution_account) {
             total_balance_of_dividend_asset += holder_balance_object.balance;
-            auto itr = vesting_amounts.find(holder_balance_object.owner);
-            if (itr != vesting_amounts.end())
-               total_balance_of_dividend_asset += itr->second;
+            if (vesting_amounts.contains(holder_balance_object.owner))
+               total_balance_of_dividend_asset += vesting_amounts.get(holder_balance_object.owner);
          }
    }
    // loop through all of the assets currently or previously held in the distribution account
@@ -1630,9 +1629,8 @@ void schedule_pending_dividend_balances(database& db,
 
                      auto holder_balance = holder_balance_object.balance;
 
-                     auto itr = vesting_amounts.find(holder_balance_object.owner);
-                     if (itr != vesting_amounts.end())
-                        holder_balance += itr->second;
+                     if (vesting_amounts.contains(holder_balance_object.owner))
+                        holder_balance += vesting_amounts.get(holder_balance_object.owner);
 
                      fc::uint128_t amount_to_credit(delta_balance.value);
                      amount_to_credit *= holder_balance.value;
@@ -1992,26 +1990,63 @@ void update_son_params(database& db)
    }
 }
 
+account_scratch_buffer& database::get_account_scratch_buffer()
+{
+   _account_scratch_buffer.reset( get_index<account_object>().get_next_id().instance() );
+   return _account_scratch_buffer;
+}
+
+void database::begin_maintenance_phases()
+{
+   _last_maintenance_stats.clear();
+   _last_maintenance_stats.reserve(16);
+   _maintenance_phase_start = fc::time_point::now();
+   _maintenance_probe_start = _maintenance_probe ? _maintenance_probe() : 0;
+}
+
+void database::end_maintenance_phase( const char* name )
+{
+   const fc::time_point now = fc::time_point::now();
+   maintenance_phase_stats stats;
+   stats.name = name;
+   stats.elapsed = now - _maintenance_phase_start;
+   _last_maintenance_stats.emplace_back( std::move(stats) );
+   // sample the probe after recording so that our own bookkeeping is not charged to the next phase
+   if( _maintenance_probe )
+   {
+      const uint64_t probe = _maintenance_probe();
+      _last_maintenance_stats.back().probe_delta = probe - _maintenance_probe_start;
+      _maintenance_probe_start = probe;
+   }
+   _maintenance_phase_start = fc::time_point::now();
+}
+
 void database::perform_chain_maintenance(const signed_block& next_block, const global_property_object& global_props)
 { try {
    const auto& gpo = get_global_properties();
 
+   begin_maintenance_phases();
+
    distribute_fba_balances(*this);
+   end_maintenance_phase("distribute_fba_balances");
    create_buyback_orders(*this);
+   end_maintenance_phase("create_buyback_orders");
 
    process_dividend_assets(*this);
+   end_maintenance_phase("process_dividend_assets");
 
    rolling_period_start(*this);
 
    update_son_params(*this);
+   end_maintenance_phase("update_son_params");
 
    struct vote_tally_helper {
       database& d;
       const global_property_object& props;
-      std::map<account_id_type, share_type> vesting_amounts;
+      account_scratch_buffer& vesting_amounts;
 
       vote_tally_helper(database& d, const global_property_object& gpo)
-         : d(d), props(gpo)
+         : d(d), props(gpo), vesting_amounts(d.get_account_scratch_buffer())
       {
          d._vote_tally_buffer.resize(props.next_available_vote_id);
          d._witness_count_histogram_buffer.resize(props.parameters.maximum_witness_count / 2 + 1);
@@ -2031,7 +2066,7 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
               vesting_index.indices().get<by_asset_balance>().upper_bound(boost::make_tuple(asset_id_type(), balance_type, share_type()));
          for (const vesting_balance_object& vesting_balance_obj : boost::make_iterator_range(vesting_balances_begin, vesting_balances_end))
          {
-            vesting_amounts[vesting_balance_obj.owner] += vesting_balance_obj.balance.amount;
+            vesting_amounts.add(vesting_balance_obj.owner, vesting_balance_obj.balance.amount);
             dlog("Vesting balance for account: ${owner}, amount: ${amount}",
                  ("owner", vesting_balance_obj.owner(d).name)
                  ("amount", vesting_balance_obj.balance.amount));
@@ -2042,7 +2077,7 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
          {
             if (vesting_balance_obj.balance.asset_id == asset_id_type() && vesting_balance_obj.balance.amount && vesting_balance_obj.balance_type == balance_type)
             {
-                vesting_amounts[vesting_balance_obj.owner] += vesting_balance_obj.balance.amount;
+                vesting_amounts.add(vesting_balance_obj.owner, vesting_balance_obj.balance.amount);
                 dlog("Vesting balance for account: ${owner}, amount: ${amount}",
                      ("owner", vesting_balance_obj.owner(d).name)
                      ("amount", vesting_balance_obj.balance.amount));
@@ -2071,13 +2106,13 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
             const auto& stats = stake_account.statistics(d);
             uint64_t voting_stake = 0;
 
-            auto itr = vesting_amounts.find(stake_account.id);
-            if (itr != vesting_amounts.end())
-                voting_stake += itr->second.value;
+            const bool has_vesting = vesting_amounts.contains(stake_account.id);
+            if (has_vesting)
+                voting_stake += vesting_amounts.get(stake_account.id).value;
 
             if(d.head_block_time() >= HARDFORK_GPOS_TIME)
             {
-               if (itr == vesting_amounts.end() && d.head_block_time() >= (HARDFORK_GPOS_TIME + props.parameters.gpos_subperiod()/2))
+               if (!has_vesting && d.head_block_time() >= (HARDFORK_GPOS_TIME + props.parameters.gpos_subperiod()/2))
                   return;
 
                auto vesting_factor = d.calculate_vesting_factor(stake_account);
@@ -2145,8 +2180,10 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
          }
       }
    } tally_helper(*this, gpo);
-   
+   end_maintenance_phase("tally_vesting_balances");
+
    perform_account_maintenance( tally_helper );
+   end_maintenance_phase("perform_account_maintenance");
    struct clear_canary {
       clear_canary(vector<uint64_t>& target): target(target){}
       ~clear_canary() { target.clear(); }
@@ -2159,11 +2196,17 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
                 c(_vote_tally_buffer);
 
    perform_son_tasks();
+   end_maintenance_phase("perform_son_tasks");
    update_top_n_authorities(*this);
+   end_maintenance_phase("update_top_n_authorities");
    update_active_witnesses();
+   end_maintenance_phase("update_active_witnesses");
    update_active_committee_members();
+   end_maintenance_phase("update_active_committee_members");
    update_active_sons();
+   end_maintenance_phase("update_active_sons");
    update_worker_votes();
+   end_maintenance_phase("update_worker_votes");
 
    const dynamic_global_property_object& dgpo = get_dynamic_global_properties();
 
@@ -2276,9 +2319,11 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
    // these custom account auths and account roles are not usable.
    clear_expired_custom_account_authorities(*this);
    clear_expired_account_roles(*this);
+   end_maintenance_phase("update_global_properties");
    // process_budget needs to run at the bottom because
    //   it needs to know the next_maintenance_time
    process_budget();
+   end_maintenance_phase("process_budget");
 } FC_CAPTURE_AND_RETHROW() }
 
 } }
@@ -159,9 +159,8 @@ bool database::apply_order(const limit_order_object& new_order_object, bool allo
    const asset_object& sell_asset = get(new_order_object.amount_for_sale().asset_id);
    const asset_object& receive_asset = get(new_order_object.amount_to_receive().asset_id);
 
-   // Possible optimization: We only need to check calls if both are true:
-   //  - The new order is at the front of the book
-   //  - The new order is below the call limit price
+   // Both checks return right away unless the new order is at the front of the book of an asset selling
+   // for its backing asset, or something else changed the calls of either asset since they were last checked
    bool called_some = check_call_orders(sell_asset, allow_black_swan);
    called_some |= check_call_orders(receive_asset, allow_black_swan);
    if( called_some && !find_object(order_id) ) // then we were filled by call order
@@ -169,11 +168,6 @@ bool database::apply_order(const limit_order_object& new_order_object, bool allo
 
    const auto& limit_price_idx = get_index_type<limit_order_index>().indices().get<by_price>();
 
-   // TODO: it should be possible to simply check the NEXT/PREV iterator after new_order_object to
-   // determine whether or not this order has "changed the book" in a way that requires us to
-   // check orders. For now I just lookup the lower bound and check for equality... this is log(n) vs
-   // constant time check. Potential optimization.
-
    auto max_price = ~new_order_object.sell_price;
    auto limit_itr = limit_price_idx.lower_bound(max_price.max());
    auto limit_end = limit_price_idx.upper_bound(max_price);
@@ -187,8 +181,7 @@ bool database::apply_order(const limit_order_object& new_order_object, bool allo
       finished = (match(new_order_object, *old_limit_itr, old_limit_itr->sell_price) != 2);
    }
 
-   //Possible optimization: only check calls if the new order completely filled some old order
-   //Do I need to check both assets?
+   // Only does anything if matching filled the best order selling one of the assets for its backing asset
    check_call_orders(sell_asset, allow_black_swan);
    check_call_orders(receive_asset, allow_black_swan);
 
@@ -428,11 +421,31 @@ bool database::fill_order(const force_settlement_object& settle, const asset& pa
  */
 bool database::check_call_orders( const asset_object& mia, bool enable_black_swan, bool for_new_limit_order,
                                   const asset_bitasset_data_object* bitasset_ptr )
-{ try {
+{
     if( !mia.is_market_issued() ) return false;
+    if( _margin_call_triggers->is_clean( mia.id ) ) return false;
 
     const asset_bitasset_data_object& bitasset = ( bitasset_ptr ? *bitasset_ptr : mia.bitasset_data(*this) );
+    const asset_id_type backing = bitasset.options.short_backing_asset;
+
+    // anything the check changes, or that is undone after it throws, invalidates the asset again
+    _margin_call_triggers->begin_check( mia.id, backing );
+    if( match_call_orders( mia, bitasset, enable_black_swan ) )
+       return true;
+
+    optional<price> best_bid;
+    const auto& limit_price_index = get_index_type<limit_order_index>().indices().get<by_price>();
+    auto limit_itr = limit_price_index.lower_bound( price::max( mia.id, backing ) );
+    if( limit_itr != limit_price_index.end() && limit_itr->sell_price.base.asset_id == mia.id
+                                             && limit_itr->sell_price.quote.asset_id == backing )
+       best_bid = limit_itr->sell_price;
+    _margin_call_triggers->end_check( mia.id, best_bid );
+    return false;
+}
 
+bool database::match_call_orders( const asset_object& mia, const asset_bitasset_data_object& bitasset,
+                                  bool enable_black_swan )
+{ try {
     if( check_for_blackswan( mia, enable_black_swan, &bitasset ) )
        return false;
 
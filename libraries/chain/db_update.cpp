@@ -166,44 +166,42 @@ void database::place_delayed_bets()
    // If any bets have been placed during live betting where bets are delayed for a few seconds, see if there are
    // any bets whose delays have expired.
 
-   // Delayed bets are sorted to the beginning of the order book, so if there are any bets that need placing, 
-   // they're right at the front of the book
-   const auto& bet_odds_idx = get_index_type<bet_object_index>().indices().get<by_odds>();
-   auto iter = bet_odds_idx.begin();
-
-   // we use an awkward looping mechanism here because there's a case where we are processing the
-   // last delayed bet before the "real" order book starts and `iter` was pointing at the first 
-   // real order.  The place_bet() call can cause the that real order to be deleted, so we need
-   // to decide whether this is the last delayed bet before `place_bet` is called.
-   bool last = iter == bet_odds_idx.end() || 
-               !iter->end_of_delay ||
-               *iter->end_of_delay > head_block_time();
-   while (!last)
+   // Delayed bets are queued per betting market, and the markets are ordered by their soonest
+   // end_of_delay, so we only visit markets that have bets due
+   const auto& delayed_bet_idx = get_index_type<primary_index<bet_object_index>>().get_secondary_index<delayed_bet_index>();
+   const delayed_bet_index::market_queue& markets = delayed_bet_idx.get_markets_by_next_delay();
+
+   // it's possible that the betting market was active when the bet was placed,
+   // but has been frozen before the delay expired.  If that's the case here,
+   // don't try to match the bet.  Its bets stay parked in the queue until the
+   // market is unfrozen, costing one status check per block rather than one per bet.
+   std::vector<std::pair<time_point_sec, bet_id_type>> bets_to_place;
+   for (auto market_itr = markets.begin();
+        market_itr != markets.end() && market_itr->first <= head_block_time();
+        ++market_itr)
    {
-      const bet_object& bet_to_place = *iter;
-      ++iter;
-
-      last = iter == bet_odds_idx.end() || 
-             !iter->end_of_delay ||
-             *iter->end_of_delay > head_block_time();
-
-      // it's possible that the betting market was active when the bet was placed,
-      // but has been frozen before the delay expired.  If that's the case here,
-      // don't try to match the bet.
-      // Since this check happens every block, this could impact performance if a
-      // market with many delayed bets is frozen for a long time.
-      // Our current understanding is that the witnesses will typically cancel all unmatched
-      // bets on frozen markets to avoid this.
-      const betting_market_object& betting_market = bet_to_place.betting_market_id(*this);
-      if (betting_market.get_status() == betting_market_status::unresolved)
-      {
-         modify(bet_to_place, [](bet_object& bet_obj) {
-            // clear the end_of_delay,  which will re-sort the bet into its place in the book
-            bet_obj.end_of_delay.reset();
-         });
+      const betting_market_object& betting_market = market_itr->second(*this);
+      if (betting_market.get_status() != betting_market_status::unresolved)
+         continue;
+
+      const delayed_bet_index::delayed_bet_queue& delayed_bets = *delayed_bet_idx.get_delayed_bets(betting_market.id);
+      for (auto bet_itr = delayed_bets.begin();
+           bet_itr != delayed_bets.end() && bet_itr->first <= head_block_time();
+           ++bet_itr)
+         bets_to_place.push_back(*bet_itr);
+   }
 
-         place_bet(bet_to_place);
-      }
+   // place the bets in the same order the by_odds index sorts delayed bets: soonest delay, then lowest id
+   std::sort(bets_to_place.begin(), bets_to_place.end());
+   for (const auto& delayed_bet : bets_to_place)
+   {
+      const bet_object& bet_to_place = delayed_bet.second(*this);
+      modify(bet_to_place, [](bet_object& bet_obj) {
+         // clear the end_of_delay,  which will re-sort the bet into its place in the book
+         bet_obj.end_of_delay.reset();
+      });
+
+      place_bet(bet_to_place);
    }
 } FC_CAPTURE_AND_RETHROW() }
 
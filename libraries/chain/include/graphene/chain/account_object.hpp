@@ -26,6 +26,7 @@
 #include <graphene/db/generic_index.hpp>
 #include <graphene/chain/protocol/account.hpp>
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/ranked_index.hpp>
 
 namespace graphene { namespace chain {
    class database;
@@ -409,6 +410,65 @@ namespace graphene { namespace chain {
          vector< vector< map< asset_id_type, const account_balance_object* > > > balances;
          std::stack< object_id_type > ids_being_modified;
    };
+
+   /**
+    *  The accounts holding each asset with their rank, largest balance first, and the number of balance objects of
+    *  each asset, so that holders can be paged in O(log N + limit) and counted in constant time.  Zero balances are
+    *  counted as balance objects but are not holders.
+    */
+   class asset_holders_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+         /// number of balance objects of @ref asset, including zero balances
+         uint32_t balance_count( asset_id_type asset )const;
+         /// number of accounts with a balance of @ref asset
+         uint32_t holder_count( asset_id_type asset )const;
+         /// up to @ref limit holders of @ref asset, skipping the @ref start largest ones
+         vector<const account_balance_object*> get_holders( asset_id_type asset, uint32_t start, uint32_t limit )const;
+
+      private:
+         struct holder
+         {
+            asset_id_type                 asset_type;
+            share_type                    balance;
+            account_id_type               owner;
+            const account_balance_object* object;
+         };
+         typedef multi_index_container<
+            holder,
+            indexed_by<
+               ranked_unique<
+                  composite_key<
+                     holder,
+                     member<holder, asset_id_type, &holder::asset_type>,
+                     member<holder, share_type, &holder::balance>,
+                     member<holder, account_id_type, &holder::owner>
+                  >,
+                  composite_key_compare<
+                     std::less< asset_id_type >,
+                     std::greater< share_type >,
+                     std::less< account_id_type >
+                  >
+               >
+            >
+         > holders_type;
+         struct counts
+         {
+            uint32_t balances = 0;
+            uint32_t holders = 0;
+         };
+
+         void add( const account_balance_object& abo );
+         void remove( const account_balance_object& abo );
+
+         holders_type                  _holders;
+         map< asset_id_type, counts >  _counts;
+   };
    
    struct by_asset_balance;
    struct by_maintenance_flag;
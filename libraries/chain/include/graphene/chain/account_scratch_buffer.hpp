@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <graphene/chain/protocol/types.hpp>
+
+#include <fc/exception/exception.hpp>
+
+namespace graphene { namespace chain {
+
+/**
+ * Dense per-account accumulator indexed by account instance, used by maintenance-time aggregations
+ * instead of a std::map keyed by account.  Storage is kept between uses, and reset() only clears the
+ * slots written since the previous reset, so reusing the buffer costs nothing per untouched account.
+ */
+class account_scratch_buffer
+{
+   public:
+      /// Make room for accounts with instance below account_count and clear any previous content
+      void reset( size_t account_count )
+      {
+         for( uint32_t instance : _touched )
+         {
+            _values[instance] = 0;
+            _present[instance] = false;
+         }
+         _touched.clear();
+         if( _values.size() < account_count )
+         {
+            _values.resize( account_count );
+            _present.resize( account_count, false );
+         }
+      }
+
+      void add( account_id_type account, share_type amount )
+      {
+         const uint32_t instance = account.instance.value;
+         FC_ASSERT( instance < _values.size(), "Account scratch buffer is too small for ${a}", ("a",account) );
+         if( !_present[instance] )
+         {
+            _present[instance] = true;
+            _touched.push_back( instance );
+         }
+         _values[instance] += amount;
+      }
+
+      /// @return true if add() was called for the account since the last reset, even with a zero amount
+      bool contains( account_id_type account )const
+      {
+         const uint32_t instance = account.instance.value;
+         return instance < _present.size() && _present[instance];
+      }
+
+      share_type get( account_id_type account )const
+      {
+         const uint32_t instance = account.instance.value;
+         return instance < _values.size() ? _values[instance] : share_type(0);
+      }
+
+      size_t touched_count()const { return _touched.size(); }
+
+   private:
+      vector<share_type> _values;
+      vector<bool>       _present;
+      vector<uint32_t>   _touched;
+};
+
+} } // graphene::chain
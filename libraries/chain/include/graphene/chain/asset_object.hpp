@@ -69,6 +69,66 @@ namespace graphene { namespace chain {
          share_type fee_pool;         ///< in core asset
    };
 
+   /**
+    *  @brief Ticket ranges of a lottery, in the order used to draw winners
+    *
+    *  Winner numbers index a virtual sequence of tickets in which every holder, in @ref by_asset_balance order,
+    *  occupies as many consecutive slots as tickets held. Only the exclusive end of each holder's range is kept,
+    *  so resolving a ticket number costs one binary search instead of materializing one entry per ticket.
+    */
+   struct lottery_ticket_ranges
+   {
+      vector<uint64_t>        range_ends;
+      vector<account_id_type> owners;
+
+      /// Total number of tickets
+      uint64_t size()const { return range_ends.empty() ? 0 : range_ends.back(); }
+      /// Index of the holder owning the given ticket number
+      size_t holder_index( uint64_t ticket )const;
+      /// First ticket number of the given holder
+      uint64_t range_begin( size_t holder )const { return holder == 0 ? 0 : range_ends[holder - 1]; }
+   };
+
+   /**
+    *  @brief The ticket purchases of every lottery and buyer, kept as operation history objects are added and removed
+    *
+    *  Each purchase keeps the exclusive end of its tickets among all tickets the buyer bought in the lottery, so the
+    *  purchase holding a given ticket is found with one lookup instead of walking the buyer's account history.
+    *  Registered on the operation history index by the plugin that keeps it, see
+    *  database::set_lottery_ticket_purchases().
+    */
+   class lottery_ticket_purchase_index : public secondary_index
+   {
+      public:
+         void set_database( const database& db ) { _db = &db; }
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+
+         /**
+          *  @return the instance of the operation history object of the purchase holding the ticket @ref offset of
+          *  @ref buyer in @ref lottery, counting from the most recent purchase backwards as get_ticket_ids() does, or
+          *  nothing if that purchase is no longer in the history
+          */
+         optional<uint64_t> find_purchase( asset_id_type lottery, account_id_type buyer, uint64_t offset )const;
+
+      private:
+         struct purchase
+         {
+            uint64_t                  tickets = 0;
+            operation_history_id_type operation_id;
+            /// removed from the history while applying a block, kept until it is known whether undo restores it
+            bool                      pruned = false;
+         };
+         /// purchases of a lottery and buyer by the exclusive end of their tickets
+         typedef std::map< uint64_t, purchase > purchases_type;
+
+         const database*                                                         _db = nullptr;
+         std::map< std::pair<asset_id_type, account_id_type>, purchases_type >   _purchases;
+         /// the end of every purchase by its operation
+         std::map< operation_history_id_type, uint64_t >                         _ends;
+   };
+
    /**
     *  @brief tracks the parameters of an asset
     *  @ingroup object
@@ -135,6 +195,9 @@ namespace graphene { namespace chain {
          time_point_sec get_lottery_expiration() const;
          vector<account_id_type> get_holders( database& db ) const;
          vector<uint64_t> get_ticket_ids( database& db ) const;
+         lottery_ticket_ranges get_ticket_ranges( database& db ) const;
+         /// Resolve the ID of one ticket from its holder's purchase history, without walking other holders
+         optional<uint64_t> get_ticket_id( database& db, const lottery_ticket_ranges& ranges, uint64_t ticket ) const;
          void distribute_benefactors_part( database& db );
          map< account_id_type, vector< uint16_t > > distribute_winners_part( database& db );
          void distribute_sweeps_holders_part( database& db );
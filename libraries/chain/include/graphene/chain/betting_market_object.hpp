@@ -27,7 +27,10 @@
 #include <graphene/db/object.hpp>
 #include <graphene/db/generic_index.hpp>
 #include <graphene/chain/protocol/betting_market.hpp>
+#include <map>
+#include <set>
 #include <sstream>
+#include <stack>
 
 #include <boost/multi_index/composite_key.hpp>
 
@@ -227,6 +230,8 @@ class betting_market_position_object : public graphene::db::abstract_object< bet
       account_id_type bettor_id;
       
       betting_market_id_type betting_market_id;
+      /// the group of betting_market_id, so a group can be settled bettor by bettor without looking up each market
+      betting_market_group_id_type betting_market_group_id;
 
       share_type pay_if_payout_condition;
       share_type pay_if_not_payout_condition;
@@ -606,8 +611,112 @@ typedef multi_index_container<
       ordered_unique< tag<by_bettor_and_odds>, identity<bet_object>, compare_bet_by_bettor_then_odds > > > bet_object_multi_index_type;
 typedef generic_index<bet_object, bet_object_multi_index_type> bet_object_index;
 
+/**
+ * @brief The unmatched bets of one betting market at one odds level
+ */
+struct bet_price_level
+{
+   /// sum of amount_to_bet over all bets at this level
+   share_type            total_amount_to_bet;
+   /// bets at this level in the order they will be matched (oldest first)
+   std::set<bet_id_type> bets;
+};
+
+/**
+ * @brief Price-level view of the live (not delayed) bets of one betting market
+ */
+struct betting_market_book
+{
+   /// sum of amount_to_bet over all back levels
+   share_type                                                                        total_back_amount_to_bet;
+   /// sum of amount_to_bet over all lay levels
+   share_type                                                                        total_lay_amount_to_bet;
+   /// back bets, best odds for a lay taker (lowest multiplier) first
+   std::map<bet_multiplier_type, bet_price_level>                                    back_levels;
+   /// lay bets, best odds for a back taker (highest multiplier) first
+   std::map<bet_multiplier_type, bet_price_level, std::greater<bet_multiplier_type>> lay_levels;
+};
+
+/**
+ * @brief Aggregates the bet_object_index by (betting_market_id, back_or_lay, backer_multiplier)
+ *
+ * Delayed bets are not part of the book until place_delayed_bets() clears their end_of_delay.
+ */
+class bet_order_book_index : public secondary_index
+{
+   public:
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      /// @return the book of the market, or nullptr if the market has no live unmatched bets
+      const betting_market_book* get_book( betting_market_id_type betting_market_id )const;
+
+   private:
+      void add_bet( const bet_object& bet );
+      void remove_bet( const bet_object& bet );
+
+      std::map< betting_market_id_type, betting_market_book > books;
+      /// copies of the bets being modified, so they can be taken out of their old level
+      std::stack< bet_object > bets_being_modified;
+};
+
+/**
+ * @brief Queue of the delayed (live betting) bets, grouped by betting market
+ *
+ * Within a market, bets are kept in the order the by_odds index gives them (soonest end_of_delay,
+ * then lowest id).  Markets are ordered by their soonest end_of_delay, so place_delayed_bets() only
+ * looks at markets that have bets due, and a frozen market costs one status check per block no
+ * matter how many bets are waiting on it.
+ */
+class delayed_bet_index : public secondary_index
+{
+   public:
+      typedef std::set< std::pair< time_point_sec, bet_id_type > >           delayed_bet_queue;
+      typedef std::set< std::pair< time_point_sec, betting_market_id_type > > market_queue;
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      /// @return the delayed bets of the market, or nullptr if it has none
+      const delayed_bet_queue* get_delayed_bets( betting_market_id_type betting_market_id )const;
+      /// markets that have delayed bets, keyed by the soonest end_of_delay among their bets
+      const market_queue&      get_markets_by_next_delay()const { return markets_by_next_delay; }
+
+   private:
+      void add_bet( const bet_object& bet );
+      void remove_bet( const bet_object& bet );
+
+      std::map< betting_market_id_type, delayed_bet_queue > bets_by_market;
+      market_queue                                          markets_by_next_delay;
+      std::stack< bet_object >                              bets_being_modified;
+};
+
+/**
+ * @brief Open interest of each betting market, the stake its positions would get back if it were canceled
+ */
+class betting_market_open_interest_index : public secondary_index
+{
+   public:
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      share_type get_open_interest( betting_market_id_type betting_market_id )const;
+
+   private:
+      void adjust( const betting_market_position_object& position, int sign );
+
+      std::map< betting_market_id_type, share_type > open_interest;
+};
+
 struct by_bettor_betting_market{};
 struct by_betting_market_bettor{};
+struct by_betting_market_group_bettor{};
 typedef multi_index_container<
    betting_market_position_object,
    indexed_by<
@@ -621,7 +730,13 @@ typedef multi_index_container<
             composite_key<
                betting_market_position_object,
                member<betting_market_position_object, betting_market_id_type, &betting_market_position_object::betting_market_id>,
-               member<betting_market_position_object, account_id_type, &betting_market_position_object::bettor_id> > >
+               member<betting_market_position_object, account_id_type, &betting_market_position_object::bettor_id> > >,
+      ordered_unique< tag<by_betting_market_group_bettor>, 
+            composite_key<
+               betting_market_position_object,
+               member<betting_market_position_object, betting_market_group_id_type, &betting_market_position_object::betting_market_group_id>,
+               member<betting_market_position_object, account_id_type, &betting_market_position_object::bettor_id>,
+               member<betting_market_position_object, betting_market_id_type, &betting_market_position_object::betting_market_id> > >
   > > betting_market_position_multi_index_type;
 
 typedef generic_index<betting_market_position_object, betting_market_position_multi_index_type> betting_market_position_index;
@@ -722,4 +837,4 @@ FC_REFLECT_DERIVED( graphene::chain::betting_market_group_object, (graphene::db:
 FC_REFLECT_DERIVED( graphene::chain::betting_market_object, (graphene::db::object), (group_id)(description)(payout_condition)(resolution) )
 FC_REFLECT_DERIVED( graphene::chain::bet_object, (graphene::db::object), (bettor_id)(betting_market_id)(amount_to_bet)(backer_multiplier)(back_or_lay)(end_of_delay) )
 
-FC_REFLECT_DERIVED( graphene::chain::betting_market_position_object, (graphene::db::object), (bettor_id)(betting_market_id)(pay_if_payout_condition)(pay_if_not_payout_condition)(pay_if_canceled)(pay_if_not_canceled)(fees_collected) )
+FC_REFLECT_DERIVED( graphene::chain::betting_market_position_object, (graphene::db::object), (bettor_id)(betting_market_id)(betting_market_group_id)(pay_if_payout_condition)(pay_if_not_payout_condition)(pay_if_canceled)(pay_if_not_canceled)(fees_collected) )
@@ -30,6 +30,13 @@
 namespace graphene { namespace chain {
    class index_entry;
 
+   /// a block as stored, still packed; @ref data is empty when the block is not stored
+   struct packed_block
+   {
+      block_id_type id;
+      vector<char>  data;
+   };
+
    class block_database 
    {
       public:
@@ -45,6 +52,13 @@ namespace graphene { namespace chain {
          block_id_type          fetch_block_id( uint32_t block_num )const;
          optional<signed_block> fetch_optional( const block_id_type& id )const;
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
+         /**
+          *  The packed blocks @ref first to @ref last, one entry per number, read with a single seek into the index
+          *  and a single read of the blocks file when they are stored next to each other.  The blocks are neither
+          *  unpacked nor hashed, their ids come from the index.  Reading stops before the block that would take the
+          *  stored blocks over @ref max_bytes, the result then ends there; the first stored block is always read.
+          */
+         vector<packed_block>   fetch_range( uint32_t first, uint32_t last, uint64_t max_bytes )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
       private:
@@ -25,6 +25,7 @@
 #include <graphene/chain/global_property_object.hpp>
 #include <graphene/chain/node_property_object.hpp>
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/account_scratch_buffer.hpp>
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/fork_database.hpp>
 #include <graphene/chain/block_database.hpp>
@@ -44,6 +45,8 @@
 
 #include <fc/log/logger.hpp>
 
+#include <boost/thread/shared_mutex.hpp>
+
 #include <map>
 
 namespace graphene { namespace chain {
@@ -51,6 +54,8 @@ namespace graphene { namespace chain {
    using graphene::db::object;
    class op_evaluator;
    class transaction_evaluation_state;
+   class margin_call_trigger_index;
+   class lottery_ticket_purchase_index;
 
    struct budget_record;
 
@@ -128,6 +133,11 @@ namespace graphene { namespace chain {
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+         /**
+          *  the blocks @ref first to @ref last as @ref fetch_block_by_number finds them, still packed.  The result
+          *  stops short of @ref last at the block that would take it over @ref max_bytes.
+          */
+         vector<packed_block>       fetch_packed_blocks( uint32_t first, uint32_t last, uint64_t max_bytes )const;
          const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
@@ -165,6 +175,15 @@ namespace graphene { namespace chain {
 
          void pop_block();
          void clear_pending();
+         /// @return true while transactions not yet in a block are applied on top of the head block state
+         bool has_pending_transactions()const { return _pending_tx_session.valid(); }
+
+         /**
+          *  Held exclusively while blocks and transactions are pushed or popped, on the thread that applies them.
+          *  Threads other than that one must hold it shared while they read the chain state, which then stays the
+          *  same until they release it.
+          */
+         boost::shared_mutex& chain_state_mutex()const { return _chain_state_mutex; }
 
          /**
           *  This method is used to track appied operations during the evaluation of a block, these
@@ -207,6 +226,13 @@ namespace graphene { namespace chain {
           */
          fc::signal<void(const signed_transaction&)>     on_pending_transaction;
 
+         /**
+          * This signal is emitted each time a bet is matched, once for each side, with the part of the
+          * bet that matched.  It is emitted while the match is applied, so database changes made by the
+          * callback are undone along with it.
+          */
+         fc::signal<void(const bet_object&, share_type)> bet_matched;
+
          /**
           *  Emitted After a block has been applied and committed.  The callback
           *  should not yield and should execute quickly.
@@ -470,6 +496,11 @@ namespace graphene { namespace chain {
          bool fill_order( const call_order_object& order, const asset& pays, const asset& receives );
          bool fill_order( const force_settlement_object& settle, const asset& pays, const asset& receives );
 
+         /**
+          * Margin call the call orders of @ref mia that limit orders can fill and settle it globally on a black swan.
+          * Returns right away while nothing changed that could trigger either, see margin_call_trigger_index.
+          * @return true if some call order was margin called or the asset was settled
+          */
          bool check_call_orders( const asset_object& mia, bool enable_black_swan = true, bool for_new_limit_order = false,
                                  const asset_bitasset_data_object* bitasset_ptr = nullptr );
 
@@ -497,6 +528,22 @@ namespace graphene { namespace chain {
           */
          /// Enable or disable tracking of votes of standby witnesses and committee members
          inline void enable_standby_votes_tracking(bool enable)  { _track_standby_votes = enable; }
+
+         /// Cost of one sub-phase of the most recent chain maintenance
+         struct maintenance_phase_stats
+         {
+            string           name;
+            fc::microseconds elapsed;
+            /// Difference of the maintenance probe across this phase, zero if no probe is installed
+            uint64_t         probe_delta = 0;
+         };
+         /// Per-phase timings of the most recent chain maintenance, in the order the phases ran
+         const vector<maintenance_phase_stats>& get_last_maintenance_stats()const { return _last_maintenance_stats; }
+         /// Install a monotonic counter (e.g. an allocation counter) which is sampled around each maintenance phase
+         inline void set_maintenance_probe( std::function<uint64_t()> probe ) { _maintenance_probe = probe; }
+         /// Ticket purchases of lotteries, registered by the plugin that keeps the operation history; null without it
+         const lottery_ticket_purchase_index* get_lottery_ticket_purchases()const { return _lottery_ticket_purchases; }
+         inline void set_lottery_ticket_purchases( const lottery_ticket_purchase_index* purchases ) { _lottery_ticket_purchases = purchases; }
    protected:
          //Mark pop_undo() as protected -- we do not want outside calling pop_undo(); it should call pop_block() instead
          void pop_undo() { object_database::pop_undo(); }
@@ -507,6 +554,23 @@ namespace graphene { namespace chain {
       private:
          optional<undo_database::session>       _pending_tx_session;
          vector< unique_ptr<op_evaluator> >     _operation_evaluators;
+         margin_call_trigger_index*             _margin_call_triggers = nullptr;
+         const lottery_ticket_purchase_index*   _lottery_ticket_purchases = nullptr;
+
+         /** locks chain_state_mutex() for writing, unless an outer guard of the applying thread already does */
+         class chain_state_write_guard
+         {
+            public:
+               explicit chain_state_write_guard( database& db );
+               ~chain_state_write_guard();
+            private:
+               database& _db;
+         };
+         mutable boost::shared_mutex            _chain_state_mutex;
+         uint32_t                               _chain_state_write_depth = 0;
+
+         bool match_call_orders( const asset_object& mia, const asset_bitasset_data_object& bitasset,
+                                 bool enable_black_swan );
 
          template<class Index>
          vector<std::reference_wrapper<const typename Index::object_type>> sort_votable_objects(size_t count)const;
@@ -573,10 +637,17 @@ namespace graphene { namespace chain {
          void update_son_statuses( const vector<son_info>& cur_active_sons, const vector<son_info>& new_active_sons );
          void update_son_wallet( const vector<son_info>& new_active_sons );
          void update_worker_votes();
+         void begin_maintenance_phases();
+         void end_maintenance_phase( const char* name );
 
          public:
             double calculate_vesting_factor(const account_object& stake_account);
             uint32_t get_gpos_current_subperiod();
+            /**
+             * Dense per-account scratch space for maintenance-time aggregations, cleared and sized to the
+             * account index on every call.  Only one aggregation may use it at a time.
+             */
+            account_scratch_buffer& get_account_scratch_buffer();
 
          template<class Type>
          void perform_account_maintenance(Type tally_helper);
@@ -615,6 +686,12 @@ namespace graphene { namespace chain {
          vector<uint64_t>                  _committee_count_histogram_buffer;
          vector<uint64_t>                  _son_count_histogram_buffer;
          uint64_t                          _total_voting_stake;
+         account_scratch_buffer            _account_scratch_buffer;
+
+         vector<maintenance_phase_stats>   _last_maintenance_stats;
+         fc::time_point                    _maintenance_phase_start;
+         uint64_t                          _maintenance_probe_start = 0;
+         std::function<uint64_t()>         _maintenance_probe;
 
          flat_map<uint32_t,block_id_type>  _checkpoints;
 
@@ -30,6 +30,8 @@
 
 #include <boost/multi_index/composite_key.hpp>
 
+#include <map>
+
 namespace graphene { namespace chain {
 
 using namespace graphene::db;
@@ -203,6 +205,84 @@ typedef multi_index_container<
 typedef generic_index<call_order_object, call_order_multi_index_type>                      call_order_index;
 typedef generic_index<force_settlement_object, force_settlement_object_multi_index_type>   force_settlement_index;
 
+/**
+ *  Remembers the market issued assets for which database::check_call_orders() found nothing to do, until something
+ *  it depends on changes: a call order or the bitasset data of the asset, or the best limit order selling the asset
+ *  for its backing asset.  Limit orders behind the best one can't trigger a margin call or a black swan, so most
+ *  new orders leave the asset clean and check_call_orders() returns without walking the call orders.
+ *
+ *  Registered on the limit order index; an @ref invalidator on the call order and bitasset data indexes forwards
+ *  their changes.
+ */
+class margin_call_trigger_index : public secondary_index
+{
+   public:
+      /** forgets the asset of every call order or bitasset data object that changes */
+      class invalidator : public secondary_index
+      {
+         public:
+            void set_triggers( margin_call_trigger_index& triggers ) { _triggers = &triggers; }
+
+            virtual void object_inserted( const object& obj ) override;
+            virtual void object_removed( const object& obj ) override;
+            virtual void about_to_modify( const object& before ) override;
+            virtual void object_modified( const object& after  ) override;
+
+         private:
+            void invalidate( const object& obj );
+
+            margin_call_trigger_index* _triggers = nullptr;
+      };
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+
+      /// @return true if check_call_orders() on @ref mia would find nothing to do
+      bool is_clean( asset_id_type mia )const;
+      /// start tracking changes to @ref mia ahead of a check
+      void begin_check( asset_id_type mia, asset_id_type backing );
+      /// mark @ref mia clean if nothing it depends on changed since begin_check()
+      void end_check( asset_id_type mia, const optional<price>& best_bid );
+      void invalidate( asset_id_type mia ) { _markets.erase( mia ); }
+
+   private:
+      struct market_state
+      {
+         asset_id_type     backing;
+         /// the best limit order selling the asset for backing when the check ended, unset while checking
+         optional<price>   best_bid;
+         bool              clean = false;
+      };
+
+      flat_map< asset_id_type, market_state > _markets;
+};
+
+/**
+ *  The total amount for sale at each price of each market, kept up to date as limit orders are created, filled and
+ *  removed, so that depth queries cost as much as the number of price levels rather than the number of orders.
+ *  Orders whose prices are the same ratio share a level.
+ */
+class limit_order_depth_index : public secondary_index
+{
+   public:
+      /// best price first
+      typedef std::map< price, share_type, std::greater<price> > levels_type;
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      /// @return the levels of the orders selling @ref sell for @ref receive, or nullptr if there are none
+      const levels_type* get_levels( asset_id_type sell, asset_id_type receive )const;
+
+   private:
+      void add( const limit_order_object& order, share_type amount );
+
+      std::map< std::pair<asset_id_type, asset_id_type>, levels_type > _levels;
+      share_type                                                       _for_sale_before_modify;
+};
+
 } } // graphene::chain
 
 FC_REFLECT_DERIVED( graphene::chain::limit_order_object,
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/market_object.hpp>
+#include <graphene/chain/asset_object.hpp>
+
+namespace graphene { namespace chain {
+
+void margin_call_trigger_index::invalidator::invalidate( const object& obj )
+{
+   if( const call_order_object* call = dynamic_cast<const call_order_object*>( &obj ) )
+      _triggers->invalidate( call->debt_type() );
+   else if( const asset_bitasset_data_object* bitasset = dynamic_cast<const asset_bitasset_data_object*>( &obj ) )
+      _triggers->invalidate( bitasset->asset_id );
+}
+
+void margin_call_trigger_index::invalidator::object_inserted( const object& obj )
+{
+   invalidate( obj );
+}
+
+void margin_call_trigger_index::invalidator::object_removed( const object& obj )
+{
+   invalidate( obj );
+}
+
+void margin_call_trigger_index::invalidator::about_to_modify( const object& before )
+{
+   invalidate( before );
+}
+
+void margin_call_trigger_index::invalidator::object_modified( const object& after )
+{
+   invalidate( after );
+}
+
+// a limit order never changes its price, so only adding and removing one can change the best bid
+void margin_call_trigger_index::object_inserted( const object& obj )
+{
+   const limit_order_object& order = static_cast<const limit_order_object&>( obj );
+   auto itr = _markets.find( order.sell_price.base.asset_id );
+   if( itr == _markets.end() || itr->second.backing != order.sell_price.quote.asset_id )
+      return;
+   if( !itr->second.clean || !itr->second.best_bid || order.sell_price > *itr->second.best_bid )
+      _markets.erase( itr );
+}
+
+void margin_call_trigger_index::object_removed( const object& obj )
+{
+   const limit_order_object& order = static_cast<const limit_order_object&>( obj );
+   auto itr = _markets.find( order.sell_price.base.asset_id );
+   if( itr == _markets.end() || itr->second.backing != order.sell_price.quote.asset_id )
+      return;
+   if( !itr->second.clean || !itr->second.best_bid || order.sell_price >= *itr->second.best_bid )
+      _markets.erase( itr );
+}
+
+bool margin_call_trigger_index::is_clean( asset_id_type mia )const
+{
+   auto itr = _markets.find( mia );
+   return itr != _markets.end() && itr->second.clean;
+}
+
+void margin_call_trigger_index::begin_check( asset_id_type mia, asset_id_type backing )
+{
+   market_state& state = _markets[mia];
+   state.backing = backing;
+   state.best_bid.reset();
+   state.clean = false;
+}
+
+void margin_call_trigger_index::end_check( asset_id_type mia, const optional<price>& best_bid )
+{
+   auto itr = _markets.find( mia );
+   if( itr == _markets.end() )
+      return;
+   itr->second.best_bid = best_bid;
+   itr->second.clean = true;
+}
+
+void limit_order_depth_index::add( const limit_order_object& order, share_type amount )
+{
+   if( amount == 0 )
+      return;
+   const auto key = std::make_pair( order.sell_price.base.asset_id, order.sell_price.quote.asset_id );
+   levels_type& levels = _levels[key];
+   share_type& total = levels[order.sell_price];
+   total += amount;
+   if( total == 0 )
+   {
+      levels.erase( order.sell_price );
+      if( levels.empty() )
+         _levels.erase( key );
+   }
+}
+
+void limit_order_depth_index::object_inserted( const object& obj )
+{
+   const limit_order_object& order = static_cast<const limit_order_object&>( obj );
+   add( order, order.for_sale );
+}
+
+void limit_order_depth_index::object_removed( const object& obj )
+{
+   const limit_order_object& order = static_cast<const limit_order_object&>( obj );
+   add( order, -order.for_sale );
+}
+
+void limit_order_depth_index::about_to_modify( const object& before )
+{
+   _for_sale_before_modify = static_cast<const limit_order_object&>( before ).for_sale;
+}
+
+// the price of an order never changes, only the amount left for sale
+void limit_order_depth_index::object_modified( const object& after )
+{
+   const limit_order_object& order = static_cast<const limit_order_object&>( after );
+   add( order, order.for_sale - _for_sale_before_modify );
+}
+
+const limit_order_depth_index::levels_type* limit_order_depth_index::get_levels( asset_id_type sell,
+                                                                                 asset_id_type receive )const
+{
+   auto itr = _levels.find( std::make_pair( sell, receive ) );
+   return itr != _levels.end() ? &itr->second : nullptr;
+}
+
+} } // graphene::chain
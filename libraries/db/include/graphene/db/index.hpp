@@ -385,6 +385,15 @@ namespace graphene { namespace db {
          }
 
 
+         /** used by the undo database to restore removed objects, so secondary indexes must see them again */
+         virtual const object&  insert( object&& obj )override
+         {
+            const auto& result = DerivedIndex::insert( std::move( obj ) );
+            for( const auto& item : _sindex )
+               item->object_inserted( result );
+            return result;
+         }
+
          virtual const object&  create(const std::function<void(object&)>& constructor )override
          {
             const auto& result = DerivedIndex::create( constructor );
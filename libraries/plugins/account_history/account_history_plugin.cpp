@@ -28,6 +28,7 @@
 
 #include <graphene/chain/account_evaluator.hpp>
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/config.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/evaluator.hpp>
@@ -66,6 +67,7 @@ class account_history_plugin_impl
       flat_set<account_id_type> _tracked_accounts;
       bool _partial_operations = false;
       primary_index< simple_index< operation_history_object > >* _oho_index;
+      account_history_by_op_type_index* _by_op_type = nullptr;
       uint32_t _max_ops_per_account = -1;
    private:
       /** add one history record, then check and remove the earliest history record */
@@ -80,6 +82,8 @@ account_history_plugin_impl::~account_history_plugin_impl()
 void account_history_plugin_impl::update_account_histories( const signed_block& b )
 {
    graphene::chain::database& db = database();
+   if( _by_op_type )
+      _by_op_type->forget_removed( db.get_dynamic_global_properties().last_irreversible_block_num );
    vector<optional< operation_history_object > >& hist = db.get_applied_operations();
    bool is_first = true;
    auto skip_oho_id = [&is_first,&db,this]() {
@@ -260,6 +264,53 @@ void account_history_plugin_impl::add_account_history( const account_id_type acc
 
 } // end namespace detail
 
+void account_history_by_op_type_index::object_inserted( const object& obj )
+{
+   const auto& entry = static_cast<const account_transaction_history_object&>( obj );
+   int op_type = 0;
+   auto removed_itr = _removed.find( entry.get_id() );
+   if( const auto* op = _db->find( entry.operation_id ) )
+      op_type = op->op.which();
+   // undo brought back a pruned entry before its operation
+   else if( removed_itr != _removed.end() )
+      op_type = removed_itr->second.op_type;
+   else
+      return;
+   if( removed_itr != _removed.end() )
+      _removed.erase( removed_itr );
+   _entries.insert( { entry.account, op_type, entry.operation_id, entry.get_id() } );
+}
+
+void account_history_by_op_type_index::object_removed( const object& obj )
+{
+   auto& by_entry_idx = _entries.get<by_entry>();
+   auto itr = by_entry_idx.find( account_transaction_history_id_type( obj.id ) );
+   if( itr == by_entry_idx.end() )
+      return;
+   // an entry pruned while applying a block may be put back by undo, entries removed by undo are not
+   if( _db->_undo_db.enabled() )
+   {
+      removed_entry& removed = _removed[ itr->entry ];
+      removed.op_type = itr->op_type;
+      removed.block_num = _db->head_block_num() + 1;
+      _removed_by_block.emplace( removed.block_num, itr->entry );
+   }
+   by_entry_idx.erase( itr );
+}
+
+void account_history_by_op_type_index::forget_removed( uint32_t last_irreversible_block_num )
+{
+   auto end = _removed_by_block.upper_bound( last_irreversible_block_num );
+   for( auto itr = _removed_by_block.begin(); itr != end; ++itr )
+   {
+      auto removed_itr = _removed.find( itr->second );
+      // the entry may have been put back and pruned again in a later block
+      if( removed_itr != _removed.end() && removed_itr->second.block_num == itr->first )
+         _removed.erase( removed_itr );
+   }
+   _removed_by_block.erase( _removed_by_block.begin(), end );
+}
+
 
 
 
@@ -288,6 +339,8 @@ void account_history_plugin::plugin_set_program_options(
          ("track-account", boost::program_options::value<std::vector<std::string>>()->composing()->multitoken(), "Account ID to track history for (may specify multiple times)")
          ("partial-operations", boost::program_options::value<bool>(), "Keep only those operations in memory that are related to account history tracking")
          ("max-ops-per-account", boost::program_options::value<uint32_t>(), "Maximum number of operations per account will be kept in memory")
+         ("history-by-operation-type", boost::program_options::value<bool>()->default_value(false),
+          "Index the account histories by operation type, for get_account_history_operations")
          ;
    cfg.add(cli);
 }
@@ -296,7 +349,10 @@ void account_history_plugin::plugin_initialize(const boost::program_options::var
 {
    database().applied_block.connect( [&]( const signed_block& b){ my->update_account_histories(b); } );
    my->_oho_index = database().add_index< primary_index< simple_index< operation_history_object > > >();
-   database().add_index< primary_index< account_transaction_history_index > >();
+   auto purchases = my->_oho_index->add_secondary_index<lottery_ticket_purchase_index>();
+   purchases->set_database( database() );
+   database().set_lottery_ticket_purchases( purchases );
+   auto ath_index = database().add_index< primary_index< account_transaction_history_index > >();
 
    LOAD_VALUE_SET(options, "track-account", my->_tracked_accounts, graphene::chain::account_id_type);
    if (options.count("partial-operations")) {
@@ -305,6 +361,11 @@ void account_history_plugin::plugin_initialize(const boost::program_options::var
    if (options.count("max-ops-per-account")) {
        my->_max_ops_per_account = options["max-ops-per-account"].as<uint32_t>();
    }
+   if( options.count("history-by-operation-type") && options["history-by-operation-type"].as<bool>() )
+   {
+      my->_by_op_type = ath_index->add_secondary_index<account_history_by_op_type_index>();
+      my->_by_op_type->set_database( database() );
+   }
 }
 
 void account_history_plugin::plugin_startup()
@@ -316,4 +377,9 @@ flat_set<account_id_type> account_history_plugin::tracked_accounts() const
    return my->_tracked_accounts;
 }
 
+const account_history_by_op_type_index* account_history_plugin::history_by_op_type()const
+{
+   return my->_by_op_type;
+}
+
 } }
@@ -53,7 +53,8 @@ namespace graphene { namespace account_history {
 enum account_history_object_type
 {
    key_account_object_type = 0,
-   bucket_object_type = 1 ///< used in market_history_plugin
+   bucket_object_type = 1, ///< used in market_history_plugin
+   market_ticker_object_type = 2 ///< used in market_history_plugin
 };
 
 
@@ -62,6 +63,8 @@ namespace detail
     class account_history_plugin_impl;
 }
 
+class account_history_by_op_type_index;
+
 class account_history_plugin : public graphene::app::plugin
 {
    public:
@@ -76,6 +79,8 @@ class account_history_plugin : public graphene::app::plugin
       virtual void plugin_startup() override;
 
       flat_set<account_id_type> tracked_accounts()const;
+      /// @return the account history entries by operation type, or nullptr without history-by-operation-type
+      const account_history_by_op_type_index* history_by_op_type()const;
 
       friend class detail::account_history_plugin_impl;
       std::unique_ptr<detail::account_history_plugin_impl> my;
@@ -92,6 +97,70 @@ class affiliate_reward_index : public secondary_index
       map<account_id_type, set<operation_history_id_type> > _history_by_account;
 };
 
+struct account_history_op_entry
+{
+   account_id_type                     account;
+   int                                 op_type = 0;
+   operation_history_id_type           operation_id;
+   account_transaction_history_id_type entry;
+};
+
+struct by_account_op_type;
+struct by_entry;
+typedef multi_index_container<
+   account_history_op_entry,
+   indexed_by<
+      ordered_unique< tag<by_account_op_type>,
+         composite_key< account_history_op_entry,
+            member< account_history_op_entry, account_id_type, &account_history_op_entry::account >,
+            member< account_history_op_entry, int, &account_history_op_entry::op_type >,
+            member< account_history_op_entry, operation_history_id_type, &account_history_op_entry::operation_id >
+         >
+      >,
+      ordered_unique< tag<by_entry>,
+         member< account_history_op_entry, account_transaction_history_id_type, &account_history_op_entry::entry >
+      >
+   >
+> account_history_op_entry_index_type;
+
+/**
+ *  The account history entries of every account by operation type, so that looking for one type of operation only
+ *  visits the entries returned.  Operation ids grow with the sequence of an account's entries, the entries of one
+ *  account and type are ordered by both.
+ *
+ *  Kept up to date with the account transaction history index, which covers new entries, the entries pruned by
+ *  max-ops-per-account and undo.  Undo puts objects back in no particular order, so an entry pruned together with its
+ *  operation may come back before the operation; the operation types of pruned entries are kept until their block
+ *  is irreversible for that.
+ */
+class account_history_by_op_type_index : public secondary_index
+{
+   public:
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override{};
+      virtual void object_modified( const object& after  ) override{};
+
+      void set_database( const database& db ) { _db = &db; }
+      /// drop the operation types of the entries pruned in blocks that can no longer be undone
+      void forget_removed( uint32_t last_irreversible_block_num );
+
+      const account_history_op_entry_index_type& entries()const { return _entries; }
+
+   private:
+      struct removed_entry
+      {
+         int      op_type = 0;
+         uint32_t block_num = 0;
+      };
+
+      const database*                     _db = nullptr;
+      account_history_op_entry_index_type _entries;
+      /// entries pruned in reversible blocks, and the same by the block that pruned them
+      std::map< account_transaction_history_id_type, removed_entry >         _removed;
+      std::multimap< uint32_t, account_transaction_history_id_type >         _removed_by_block;
+};
+
 } } //graphene::account_history
 
 /*struct by_id;
@@ -0,0 +1,472 @@
+/*
+ * Copyright (c) 2018 Peerplays Blockchain Standards Association, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/bookie/bet_history_store.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace bookie { namespace detail {
+
+/* The log is a sequence of entries, each one a little endian uint32_t size followed by
+ * that many bytes.  The first entry is the packed header, the others a packed (block number,
+ * record) pair.  A record appears once for every irreversible block that changed it, the last
+ * one wins when the log is read.  The journal file has the same header, followed by one entry
+ * with the journaled blocks and the records they changed.
+ */
+namespace {
+
+typedef std::vector< std::pair< bet_id_type, optional<bet_history_record> > >    saved_block_journal;
+typedef std::pair< std::vector< std::pair< uint32_t, saved_block_journal > >,
+                   std::vector<bet_history_record> >                              saved_journal;
+
+bool read_entry( std::istream& in, std::vector<char>& data )
+{
+   uint32_t entry_size = 0;
+   if( !in.read( (char*)&entry_size, sizeof(entry_size) ) )
+      return false;
+   data.resize( entry_size );
+   return bool( in.read( data.data(), entry_size ) );
+}
+
+void write_entry( std::ostream& out, const std::vector<char>& data )
+{
+   const uint32_t entry_size = data.size();
+   out.write( (const char*)&entry_size, sizeof(entry_size) );
+   out.write( data.data(), data.size() );
+}
+
+bool read_header( std::istream& in, const bet_history_log_header& expected )
+{
+   std::vector<char> data;
+   if( !read_entry( in, data ) )
+      return false;
+   try
+   {
+      bet_history_log_header header;
+      fc::raw::unpack( data, header );
+      return header.chain_id == expected.chain_id && header.db_version == expected.db_version;
+   }
+   catch( const fc::exception& )
+   {
+      return false;
+   }
+}
+
+void set_location( bet_history_location_index_type& locations, const bet_history_record& record, uint64_t offset )
+{
+   bet_history_location location;
+   location.bet_id = record.get_bet_id();
+   location.bettor_id = record.get_bettor_id();
+   location.matched = record.is_matched();
+   location.offset = offset;
+   auto itr = locations.find( location.bet_id );
+   if( itr == locations.end() )
+      locations.insert( location );
+   else
+      locations.replace( itr, location );
+}
+
+}
+
+void bet_history_store::open( const fc::path& log_file, const chain_id_type& chain_id, const std::string& db_version )
+{ try {
+   if( log_file == fc::path() )
+      return;
+
+   _log_file = log_file;
+   _journal_file = log_file.generic_string() + ".reversible";
+   _header.chain_id = chain_id;
+   _header.db_version = db_version;
+   fc::create_directories( log_file.parent_path() );
+
+   if( fc::exists( log_file ) )
+   {
+      std::ifstream in( log_file.generic_string().c_str(), std::ios::binary );
+      if( read_header( in, _header ) )
+      {
+         uint64_t valid_size = in.tellg();
+         std::vector<char> data;
+         while( read_entry( in, data ) )
+         {
+            std::pair<uint32_t, bet_history_record> entry;
+            fc::raw::unpack( data, entry );
+            set_location( _locations, entry.second, valid_size );
+            _last_logged_block_num = std::max( _last_logged_block_num, entry.first );
+            valid_size += sizeof(uint32_t) + data.size();
+            ++_log_entries;
+         }
+         // drop a partially written entry left by a crash
+         if( valid_size != fc::file_size( log_file ) )
+         {
+            wlog( "Truncating bet history log ${f} to its last complete entry", ("f", log_file) );
+            fc::resize_file( log_file, valid_size );
+         }
+      }
+      else
+      {
+         wlog( "Discarding bet history log ${f}, it was not written for chain ${c} and database version ${v}",
+               ("f", log_file)("c", chain_id)("v", db_version) );
+         in.close();
+         fc::remove_all( log_file );
+         fc::remove_all( _journal_file );
+      }
+   }
+
+   if( !fc::exists( log_file ) )
+   {
+      std::ofstream out( log_file.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::trunc );
+      write_header( out );
+   }
+   _log_size = fc::file_size( log_file );
+   _log.open( log_file.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::app );
+   FC_ASSERT( _log.is_open(), "Unable to open bet history log ${f}", ("f", log_file) );
+   ilog( "Indexed ${n} bets from bet history log ${f}, up to block ${b}",
+         ("n", _locations.size())("f", log_file)("b", _last_logged_block_num) );
+
+   if( _log_entries > std::max<uint64_t>( 2 * _locations.size(), min_compact_entries ) )
+      compact();
+   load_journal();
+} FC_CAPTURE_AND_RETHROW( (log_file) ) }
+
+void bet_history_store::close()
+{
+   if( !_log.is_open() )
+      return;
+   save_journal();
+   _log.close();
+}
+
+void bet_history_store::begin_block( uint32_t block_num )
+{
+   // blocks at or above this one were popped, restore the records they changed
+   while( !_journal.empty() && _journal.rbegin()->first >= block_num )
+   {
+      const block_journal entries = std::move( _journal.rbegin()->second );
+      _journal.erase( std::prev( _journal.end() ) );
+      for( const auto& entry : entries )
+      {
+         auto record_itr = _records.find( entry.first );
+         // with no earlier reversible block changing it, the record is back to its logged state
+         if( !entry.second || ( _log.is_open() && !is_journaled( entry.first ) ) )
+         {
+            if( record_itr != _records.end() )
+               _records.erase( record_itr );
+         }
+         else if( record_itr == _records.end() )
+            _records.insert( *entry.second );
+         else
+            _records.replace( record_itr, *entry.second );
+      }
+   }
+   _current_block_num = block_num;
+}
+
+bet_history_multi_index_type::iterator bet_history_store::journal( bet_id_type bet_id )
+{
+   auto record_itr = _records.find( bet_id );
+   if( record_itr == _records.end() )
+   {
+      auto location_itr = _locations.find( bet_id );
+      if( location_itr != _locations.end() )
+      {
+         std::ifstream in( _log_file.generic_string().c_str(), std::ios::binary );
+         record_itr = _records.insert( read_from_log( in, location_itr->offset ) ).first;
+      }
+   }
+
+   block_journal& entries = _journal[_current_block_num];
+   if( entries.find( bet_id ) == entries.end() )
+   {
+      optional<bet_history_record> before;
+      if( record_itr != _records.end() )
+         before = *record_itr;
+      entries.emplace( bet_id, std::move( before ) );
+   }
+   return record_itr;
+}
+
+bool bet_history_store::is_journaled( bet_id_type bet_id ) const
+{
+   for( const auto& block : _journal )
+      if( block.second.find( bet_id ) != block.second.end() )
+         return true;
+   return false;
+}
+
+void bet_history_store::store_bet( const bet_object& bet )
+{
+   auto record_itr = journal( bet.id );
+   if( record_itr == _records.end() )
+   {
+      bet_history_record record;
+      record.bet = bet;
+      _records.insert( std::move( record ) );
+   }
+   else
+      _records.modify( record_itr, [&bet]( bet_history_record& record ) { record.bet = bet; } );
+}
+
+bool bet_history_store::modify( bet_id_type bet_id, const std::function<void(bet_history_record&)>& modifier )
+{
+   if( _records.find( bet_id ) == _records.end() && _locations.find( bet_id ) == _locations.end() )
+      return false;
+   _records.modify( journal( bet_id ), modifier );
+   return true;
+}
+
+void bet_history_store::end_block( uint32_t last_irreversible_block_num )
+{
+   bool logged = false;
+   while( !_journal.empty() && _journal.begin()->first <= last_irreversible_block_num )
+   {
+      const uint32_t block_num = _journal.begin()->first;
+      if( _log.is_open() )
+      {
+         for( const auto& entry : _journal.begin()->second )
+         {
+            // the state the block left the record in is what the next journaled block saw before
+            // changing it, or the current state if no later block changed it
+            const bet_history_record* after = nullptr;
+            bool changed_later = false;
+            for( auto later_itr = std::next( _journal.begin() ); later_itr != _journal.end(); ++later_itr )
+            {
+               auto later_entry = later_itr->second.find( entry.first );
+               if( later_entry != later_itr->second.end() )
+               {
+                  after = later_entry->second ? &*later_entry->second : nullptr;
+                  changed_later = true;
+                  break;
+               }
+            }
+            auto record_itr = _records.find( entry.first );
+            if( !changed_later && record_itr != _records.end() )
+               after = &*record_itr;
+            if( after )
+               append_to_log( block_num, *after );
+            // the log has the current state now, it is read from there
+            if( !changed_later && record_itr != _records.end() )
+               _records.erase( record_itr );
+         }
+         _last_logged_block_num = std::max( _last_logged_block_num, block_num );
+         logged = true;
+      }
+      _journal.erase( _journal.begin() );
+   }
+   if( !logged )
+      return;
+   _log.flush();
+   if( _log_entries > std::max<uint64_t>( 2 * _locations.size(), min_compact_entries ) )
+   {
+      try
+      {
+         compact();
+      }
+      catch( const fc::exception& e )
+      {
+         elog( "Unable to compact bet history log ${f}: ${e}", ("f", _log_file)("e", e.to_detail_string()) );
+      }
+   }
+}
+
+optional<bet_history_record> bet_history_store::find( bet_id_type bet_id ) const
+{
+   auto record_itr = _records.find( bet_id );
+   if( record_itr != _records.end() )
+      return *record_itr;
+   auto location_itr = _locations.find( bet_id );
+   if( location_itr == _locations.end() )
+      return optional<bet_history_record>();
+   std::ifstream in( _log_file.generic_string().c_str(), std::ios::binary );
+   return read_from_log( in, location_itr->offset );
+}
+
+std::vector<bet_history_record> bet_history_store::get_matched_bets( account_id_type bettor_id, bet_id_type start,
+                                                                     uint32_t limit ) const
+{
+   const auto& records_by_bettor = _records.get<by_bettor_id>();
+   const auto& locations_by_bettor = _locations.get<by_bettor_id>();
+   auto record_itr = start == bet_id_type() ? records_by_bettor.lower_bound( std::make_tuple( bettor_id, true ) )
+                                            : records_by_bettor.lower_bound( std::make_tuple( bettor_id, true, start ) );
+   auto location_itr = start == bet_id_type() ? locations_by_bettor.lower_bound( std::make_tuple( bettor_id, true ) )
+                                              : locations_by_bettor.lower_bound( std::make_tuple( bettor_id, true, start ) );
+   const auto records_end = records_by_bettor.upper_bound( std::make_tuple( bettor_id, true ) );
+   const auto locations_end = locations_by_bettor.upper_bound( std::make_tuple( bettor_id, true ) );
+
+   // both ranges are newest first, merge them
+   std::vector<bet_history_record> result;
+   std::ifstream in;
+   while( result.size() < limit )
+   {
+      // a record in memory replaces its logged state
+      while( location_itr != locations_end && _records.find( location_itr->bet_id ) != _records.end() )
+         ++location_itr;
+      if( record_itr != records_end &&
+          ( location_itr == locations_end || location_itr->bet_id < record_itr->get_bet_id() ) )
+      {
+         result.push_back( *record_itr );
+         ++record_itr;
+      }
+      else if( location_itr != locations_end )
+      {
+         if( !in.is_open() )
+            in.open( _log_file.generic_string().c_str(), std::ios::binary );
+         result.push_back( read_from_log( in, location_itr->offset ) );
+         ++location_itr;
+      }
+      else
+         break;
+   }
+   return result;
+}
+
+uint64_t bet_history_store::size() const
+{
+   uint64_t count = _locations.size();
+   for( const bet_history_record& record : _records )
+      if( _locations.find( record.get_bet_id() ) == _locations.end() )
+         ++count;
+   return count;
+}
+
+void bet_history_store::append_to_log( uint32_t block_num, const bet_history_record& record )
+{
+   const std::vector<char> data = fc::raw::pack( std::make_pair( block_num, record ) );
+   write_entry( _log, data );
+   set_location( _locations, record, _log_size );
+   _log_size += sizeof(uint32_t) + data.size();
+   ++_log_entries;
+}
+
+void bet_history_store::write_header( std::ostream& out ) const
+{
+   write_entry( out, fc::raw::pack( _header ) );
+}
+
+bet_history_record bet_history_store::read_from_log( std::istream& in, uint64_t offset ) const
+{
+   in.clear();
+   in.seekg( offset );
+   std::vector<char> data;
+   FC_ASSERT( read_entry( in, data ), "Unable to read bet history log ${f} at ${o}", ("f", _log_file)("o", offset) );
+   std::pair<uint32_t, bet_history_record> entry;
+   fc::raw::unpack( data, entry );
+   return entry.second;
+}
+
+void bet_history_store::compact()
+{ try {
+   _log.flush();
+   const fc::path tmp_file = _log_file.generic_string() + ".tmp";
+   bet_history_location_index_type locations;
+   uint64_t size = 0;
+   {
+      std::ifstream in( _log_file.generic_string().c_str(), std::ios::binary );
+      std::ofstream out( tmp_file.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::trunc );
+      write_header( out );
+      for( const bet_history_location& location : _locations )
+      {
+         const std::vector<char> data = fc::raw::pack( std::make_pair( _last_logged_block_num,
+                                                                       read_from_log( in, location.offset ) ) );
+         bet_history_location compacted = location;
+         compacted.offset = out.tellp();
+         write_entry( out, data );
+         locations.insert( compacted );
+      }
+      out.flush();
+      FC_ASSERT( out.good(), "Unable to write ${f}", ("f", tmp_file) );
+      size = out.tellp();
+   }
+
+   _log.close();
+   try
+   {
+      fc::rename( tmp_file, _log_file );
+   }
+   catch( const fc::exception& )
+   {
+      _log.open( _log_file.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::app );
+      throw;
+   }
+   _log.open( _log_file.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::app );
+   FC_ASSERT( _log.is_open(), "Unable to open bet history log ${f}", ("f", _log_file) );
+   ilog( "Compacted bet history log ${f} from ${o} to ${n} entries", ("f", _log_file)("o", _log_entries)("n", locations.size()) );
+   _locations = std::move( locations );
+   _log_entries = _locations.size();
+   _log_size = size;
+} FC_CAPTURE_AND_RETHROW( (_log_file) ) }
+
+void bet_history_store::load_journal()
+{ try {
+   if( !fc::exists( _journal_file ) )
+      return;
+
+   std::ifstream in( _journal_file.generic_string().c_str(), std::ios::binary );
+   std::vector<char> data;
+   if( read_header( in, _header ) && read_entry( in, data ) )
+   {
+      saved_journal saved;
+      fc::raw::unpack( data, saved );
+      if( !saved.first.empty() && saved.first.front().first > _last_logged_block_num )
+      {
+         for( const auto& block : saved.first )
+            for( const auto& entry : block.second )
+               _journal[block.first].emplace( entry.first, entry.second );
+         for( const bet_history_record& record : saved.second )
+            _records.insert( record );
+         ilog( "Loaded the bet history journal of blocks ${f} to ${l}",
+               ("f", _journal.begin()->first)("l", _journal.rbegin()->first) );
+      }
+   }
+   in.close();
+   // a crash before the next shutdown must not bring back blocks that were rolled back since
+   fc::remove_all( _journal_file );
+} FC_CAPTURE_AND_RETHROW( (_journal_file) ) }
+
+void bet_history_store::save_journal() const
+{ try {
+   if( _journal.empty() )
+      return;
+
+   saved_journal saved;
+   for( const auto& block : _journal )
+   {
+      saved.first.emplace_back( block.first, saved_block_journal() );
+      for( const auto& entry : block.second )
+         saved.first.back().second.emplace_back( entry.first, entry.second );
+   }
+   saved.second.assign( _records.begin(), _records.end() );
+
+   const fc::path tmp_file = _journal_file.generic_string() + ".tmp";
+   {
+      std::ofstream out( tmp_file.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::trunc );
+      FC_ASSERT( out.is_open(), "Unable to open bet history journal ${f}", ("f", tmp_file) );
+      write_header( out );
+      write_entry( out, fc::raw::pack( saved ) );
+   }
+   fc::rename( tmp_file, _journal_file );
+} FC_CAPTURE_AND_RETHROW( (_journal_file) ) }
+
+} } } //graphene::bookie::detail
@@ -38,6 +38,9 @@
 #include <graphene/bookie/bookie_api.hpp>
 #include <graphene/bookie/bookie_plugin.hpp>
 #include <graphene/bookie/bookie_objects.hpp>
+#include <graphene/bookie/bet_history_store.hpp>
+
+#include <limits>
 
 namespace graphene { namespace bookie {
 
@@ -49,9 +52,12 @@ class bookie_api_impl
       bookie_api_impl(graphene::app::application& _app);
 
       binned_order_book get_binned_order_book(graphene::chain::betting_market_id_type betting_market_id, int32_t precision);
-      std::shared_ptr<graphene::bookie::bookie_plugin> get_plugin();
+      std::shared_ptr<graphene::bookie::bookie_plugin> get_plugin() const;
       asset get_total_matched_bet_amount_for_betting_market_group(betting_market_group_id_type group_id);
+      betting_market_group_statistics get_betting_market_group_statistics(betting_market_group_id_type group_id) const;
       std::vector<event_object> get_events_containing_sub_string(const std::string& sub_string, const std::string& language);
+      std::vector<event_object> list_events_containing_sub_string(const std::string& sub_string, const std::string& language,
+                                                                  event_id_type start, uint32_t limit);
       fc::variants get_objects(const vector<object_id_type>& ids) const;
       std::vector<matched_bet_object> get_matched_bets_for_bettor(account_id_type bettor_id) const;
       std::vector<matched_bet_object> get_all_matched_bets_for_bettor(account_id_type bettor_id, bet_id_type start, unsigned limit) const;
@@ -65,7 +71,7 @@ bookie_api_impl::bookie_api_impl(graphene::app::application& _app) : app(_app)
 binned_order_book bookie_api_impl::get_binned_order_book(graphene::chain::betting_market_id_type betting_market_id, int32_t precision)
 {
     std::shared_ptr<graphene::chain::database> db = app.chain_database();
-    const auto& bet_odds_idx = db->get_index_type<graphene::chain::bet_object_index>().indices().get<graphene::chain::by_odds>();
+    const auto& order_book_idx = db->get_index_type<primary_index<graphene::chain::bet_object_index>>().get_secondary_index<graphene::chain::bet_order_book_index>();
     const chain_parameters& current_params = db->get_global_properties().parameters;
 
     graphene::chain::bet_multiplier_type bin_size = GRAPHENE_BETTING_ODDS_PRECISION;
@@ -82,65 +88,40 @@ binned_order_book bookie_api_impl::get_binned_order_book(graphene::chain::bettin
 
     binned_order_book result; 
 
-    // use a bet_object here for convenience. we really only use it to track the amount, odds, and back_or_lay
-    fc::optional<bet_object> current_bin;
+    const graphene::chain::betting_market_book* book = order_book_idx.get_book(betting_market_id);
+    if (!book)
+        return result;
 
-    auto flush_current_bin = [&current_bin, &result]()
+    // the book is already aggregated by odds, so we only need to merge adjacent price levels into bins
+    // for back bets, we want to group all bets with odds from 3.0001 to 4 into the "4" bin
+    for (const auto& level : book->back_levels)
     {
-        if (current_bin) // do nothing if the current bin is empty
+        graphene::chain::bet_multiplier_type bin_multiplier = (level.first + bin_size - 1) / bin_size * bin_size;
+        bin_multiplier = std::min<graphene::chain::bet_multiplier_type>(bin_multiplier, current_params.max_bet_multiplier());
+        if (result.aggregated_back_bets.empty() || level.first > result.aggregated_back_bets.back().backer_multiplier)
         {
-            order_bin current_order_bin;
-
-            current_order_bin.backer_multiplier = current_bin->backer_multiplier;
-            current_order_bin.amount_to_bet = current_bin->amount_to_bet.amount;
-            //idump((*current_bin)(current_order_bin));
-            if (current_bin->back_or_lay == bet_type::back)
-                result.aggregated_back_bets.emplace_back(std::move(current_order_bin));
-            else // current_bin is aggregating back positions
-                result.aggregated_lay_bets.emplace_back(std::move(current_order_bin));
-
-            current_bin.reset();
+            order_bin bin;
+            bin.backer_multiplier = bin_multiplier;
+            bin.amount_to_bet = 0;
+            result.aggregated_back_bets.emplace_back(std::move(bin));
         }
-    };
+        result.aggregated_back_bets.back().amount_to_bet += level.second.total_amount_to_bet;
+    }
 
-    // iterate through both sides of the order book (backs at increasing odds then lays at decreasing odds)
-    for (auto bet_odds_iter = bet_odds_idx.lower_bound(std::make_tuple(betting_market_id));
-         bet_odds_iter != bet_odds_idx.end() && betting_market_id == bet_odds_iter->betting_market_id;
-         ++bet_odds_iter)
+    // for lay bets, we want to group all bets with odds from 3 to 3.9999 into the "3" bin
+    for (const auto& level : book->lay_levels)
     {
-        if (current_bin && 
-            (bet_odds_iter->back_or_lay != current_bin->back_or_lay /* we have switched from back to lay bets */ ||
-             (bet_odds_iter->back_or_lay == bet_type::back ? bet_odds_iter->backer_multiplier > current_bin->backer_multiplier :
-                                                             bet_odds_iter->backer_multiplier < current_bin->backer_multiplier)))
-            flush_current_bin();
-
-        if (!current_bin)
+        graphene::chain::bet_multiplier_type bin_multiplier = level.first / bin_size * bin_size;
+        bin_multiplier = std::max<graphene::chain::bet_multiplier_type>(bin_multiplier, current_params.min_bet_multiplier());
+        if (result.aggregated_lay_bets.empty() || level.first < result.aggregated_lay_bets.back().backer_multiplier)
         {
-            // if there is no current bin, create one appropriate for the bet we're processing
-            current_bin = graphene::chain::bet_object();
-
-            // for back bets, we want to group all bets with odds from 3.0001 to 4 into the "4" bin
-            // for lay bets, we want to group all bets with odds from 3 to 3.9999 into the "3" bin
-            if (bet_odds_iter->back_or_lay == bet_type::back)
-            {
-               current_bin->backer_multiplier = (bet_odds_iter->backer_multiplier + bin_size - 1) / bin_size * bin_size;
-               current_bin->backer_multiplier = std::min<graphene::chain::bet_multiplier_type>(current_bin->backer_multiplier, current_params.max_bet_multiplier());
-               current_bin->back_or_lay = bet_type::back;
-            }
-            else
-            {
-               current_bin->backer_multiplier = bet_odds_iter->backer_multiplier / bin_size * bin_size;
-               current_bin->backer_multiplier = std::max<graphene::chain::bet_multiplier_type>(current_bin->backer_multiplier, current_params.min_bet_multiplier());
-               current_bin->back_or_lay = bet_type::lay;
-            }
-
-            current_bin->amount_to_bet.amount = 0;
+            order_bin bin;
+            bin.backer_multiplier = bin_multiplier;
+            bin.amount_to_bet = 0;
+            result.aggregated_lay_bets.emplace_back(std::move(bin));
         }
-
-        current_bin->amount_to_bet.amount += bet_odds_iter->amount_to_bet.amount;
+        result.aggregated_lay_bets.back().amount_to_bet += level.second.total_amount_to_bet;
     }
-    if (current_bin)
-        flush_current_bin();
 
     return result;
 }
@@ -148,11 +129,13 @@ binned_order_book bookie_api_impl::get_binned_order_book(graphene::chain::bettin
 fc::variants bookie_api_impl::get_objects(const vector<object_id_type>& ids) const
 {
    std::shared_ptr<graphene::chain::database> db = app.chain_database();
+   std::shared_ptr<graphene::bookie::bookie_plugin> plugin = get_plugin();
+   const detail::bet_history_store& bet_history = plugin->get_bet_history();
    fc::variants result;
    result.reserve(ids.size());
 
    std::transform(ids.begin(), ids.end(), std::back_inserter(result),
-                  [this, &db](object_id_type id) -> fc::variant {
+                  [this, &db, &bet_history](object_id_type id) -> fc::variant {
       switch (id.type())
       {
       case event_id_type::type_id:
@@ -166,10 +149,9 @@ fc::variants bookie_api_impl::get_objects(const vector<object_id_type>& ids) con
          }
       case bet_id_type::type_id:
          {
-            auto& persistent_bets_by_bet_id = db->get_index_type<detail::persistent_bet_index>().indices().get<by_bet_id>();
-            auto iter = persistent_bets_by_bet_id.find(id.as<bet_id_type>());
-            if (iter != persistent_bets_by_bet_id.end())
-               return iter->ephemeral_bet_object.to_variant();
+            optional<detail::bet_history_record> record = bet_history.find(id.as<bet_id_type>());
+            if (record)
+               return record->bet.to_variant();
             else
                return {};
          }
@@ -202,25 +184,20 @@ fc::variants bookie_api_impl::get_objects(const vector<object_id_type>& ids) con
 std::vector<matched_bet_object> bookie_api_impl::get_matched_bets_for_bettor(account_id_type bettor_id) const
 {
    std::vector<matched_bet_object> result;
-   std::shared_ptr<graphene::chain::database> db = app.chain_database();
-   auto& persistent_bets_by_bettor_id = db->get_index_type<detail::persistent_bet_index>().indices().get<by_bettor_id>();
-   auto iter = persistent_bets_by_bettor_id.lower_bound(std::make_tuple(bettor_id, true));
-   while (iter != persistent_bets_by_bettor_id.end() && 
-          iter->get_bettor_id() == bettor_id &&
-          iter->is_matched())
+   std::shared_ptr<graphene::bookie::bookie_plugin> plugin = get_plugin();
+   for (const detail::bet_history_record& record :
+        plugin->get_bet_history().get_matched_bets(bettor_id, bet_id_type(), std::numeric_limits<uint32_t>::max()))
    {
       matched_bet_object match;
-      match.id = iter->ephemeral_bet_object.id;
-      match.bettor_id = iter->ephemeral_bet_object.bettor_id;
-      match.betting_market_id = iter->ephemeral_bet_object.betting_market_id;
-      match.amount_to_bet = iter->ephemeral_bet_object.amount_to_bet;
-      match.back_or_lay = iter->ephemeral_bet_object.back_or_lay;
-      match.end_of_delay = iter->ephemeral_bet_object.end_of_delay;
-      match.amount_matched = iter->amount_matched;
-      match.associated_operations = iter->associated_operations;
+      match.id = record.bet.id;
+      match.bettor_id = record.bet.bettor_id;
+      match.betting_market_id = record.bet.betting_market_id;
+      match.amount_to_bet = record.bet.amount_to_bet;
+      match.back_or_lay = record.bet.back_or_lay;
+      match.end_of_delay = record.bet.end_of_delay;
+      match.amount_matched = record.amount_matched;
+      match.associated_operations = record.associated_operations;
       result.emplace_back(std::move(match));
-
-      ++iter;
    }
    return result;
 }
@@ -230,34 +207,23 @@ std::vector<matched_bet_object> bookie_api_impl::get_all_matched_bets_for_bettor
    FC_ASSERT(limit <= 1000, "You may request at most 1000 matched bets at a time");
 
    std::vector<matched_bet_object> result;
-   std::shared_ptr<graphene::chain::database> db = app.chain_database();
-   auto& persistent_bets_by_bettor_id = db->get_index_type<detail::persistent_bet_index>().indices().get<by_bettor_id>();
-   persistent_bet_multi_index_type::index<by_bettor_id>::type::iterator iter;
-   if (start == bet_id_type())
-      iter = persistent_bets_by_bettor_id.lower_bound(std::make_tuple(bettor_id, true));
-   else
-      iter = persistent_bets_by_bettor_id.lower_bound(std::make_tuple(bettor_id, true, start));
-   while (iter != persistent_bets_by_bettor_id.end() && 
-          iter->get_bettor_id() == bettor_id &&
-          iter->is_matched() &&
-          result.size() < limit)
+   std::shared_ptr<graphene::bookie::bookie_plugin> plugin = get_plugin();
+   for (const detail::bet_history_record& record : plugin->get_bet_history().get_matched_bets(bettor_id, start, limit))
    {
       matched_bet_object match;
-      match.id = iter->ephemeral_bet_object.id;
-      match.bettor_id = iter->ephemeral_bet_object.bettor_id;
-      match.betting_market_id = iter->ephemeral_bet_object.betting_market_id;
-      match.amount_to_bet = iter->ephemeral_bet_object.amount_to_bet;
-      match.back_or_lay = iter->ephemeral_bet_object.back_or_lay;
-      match.end_of_delay = iter->ephemeral_bet_object.end_of_delay;
-      match.amount_matched = iter->amount_matched;
+      match.id = record.bet.id;
+      match.bettor_id = record.bet.bettor_id;
+      match.betting_market_id = record.bet.betting_market_id;
+      match.amount_to_bet = record.bet.amount_to_bet;
+      match.back_or_lay = record.bet.back_or_lay;
+      match.end_of_delay = record.bet.end_of_delay;
+      match.amount_matched = record.amount_matched;
       result.emplace_back(std::move(match));
-
-      ++iter;
    }
    return result;
 }
 
-std::shared_ptr<graphene::bookie::bookie_plugin> bookie_api_impl::get_plugin()
+std::shared_ptr<graphene::bookie::bookie_plugin> bookie_api_impl::get_plugin() const
 {
    return app.get_plugin<graphene::bookie::bookie_plugin>("bookie");
 }
@@ -267,11 +233,57 @@ asset bookie_api_impl::get_total_matched_bet_amount_for_betting_market_group(bet
     return get_plugin()->get_total_matched_bet_amount_for_betting_market_group(group_id);
 }
 
+betting_market_group_statistics bookie_api_impl::get_betting_market_group_statistics(betting_market_group_id_type group_id) const
+{
+   std::shared_ptr<graphene::chain::database> db = app.chain_database();
+   const betting_market_group_object* group = db->find(group_id);
+   FC_ASSERT(group, "Invalid betting market group specified");
+
+   const auto& order_book_idx = db->get_index_type<primary_index<bet_object_index>>().get_secondary_index<bet_order_book_index>();
+   const auto& open_interest_idx = db->get_index_type<primary_index<betting_market_position_index>>().get_secondary_index<betting_market_open_interest_index>();
+
+   betting_market_group_statistics result;
+   result.betting_market_group_id = group_id;
+   result.asset_id = group->asset_id;
+   result.total_matched_bets_amount = group->total_matched_bets_amount;
+
+   const auto& persistent_markets = db->get_index_type<detail::persistent_betting_market_index>().indices().get<by_betting_market_id>();
+   const auto& markets_by_group = db->get_index_type<betting_market_object_index>().indices().get<by_betting_market_group_id>();
+   for (auto market_itr = markets_by_group.lower_bound(group_id);
+        market_itr != markets_by_group.end() && market_itr->group_id == group_id;
+        ++market_itr)
+   {
+      betting_market_statistics market_statistics;
+      market_statistics.betting_market_id = market_itr->id;
+      auto persistent_market_itr = persistent_markets.find(market_itr->id);
+      if (persistent_market_itr != persistent_markets.end())
+         market_statistics.total_matched_bets_amount = persistent_market_itr->total_matched_bets_amount;
+      market_statistics.open_interest = open_interest_idx.get_open_interest(market_itr->id);
+      if (const betting_market_book* book = order_book_idx.get_book(market_itr->id))
+      {
+         market_statistics.unmatched_back_amount = book->total_back_amount_to_bet;
+         market_statistics.unmatched_lay_amount = book->total_lay_amount_to_bet;
+      }
+      result.open_interest += market_statistics.open_interest;
+      result.unmatched_back_amount += market_statistics.unmatched_back_amount;
+      result.unmatched_lay_amount += market_statistics.unmatched_lay_amount;
+      result.betting_markets.emplace_back(std::move(market_statistics));
+   }
+   return result;
+}
+
 std::vector<event_object> bookie_api_impl::get_events_containing_sub_string(const std::string& sub_string, const std::string& language)
 {
    return get_plugin()->get_events_containing_sub_string(sub_string, language);
 }
 
+std::vector<event_object> bookie_api_impl::list_events_containing_sub_string(const std::string& sub_string, const std::string& language,
+                                                                             event_id_type start, uint32_t limit)
+{
+   FC_ASSERT(limit <= 100, "limit must be at most 100");
+   return get_plugin()->list_events_containing_sub_string(sub_string, language, start, limit);
+}
+
 } // detail
 
 bookie_api::bookie_api(graphene::app::application& app) :
@@ -289,11 +301,22 @@ asset bookie_api::get_total_matched_bet_amount_for_betting_market_group(betting_
     return my->get_total_matched_bet_amount_for_betting_market_group(group_id);
 }
 
+betting_market_group_statistics bookie_api::get_betting_market_group_statistics(betting_market_group_id_type group_id) const
+{
+   return my->get_betting_market_group_statistics(group_id);
+}
+
 std::vector<event_object> bookie_api::get_events_containing_sub_string(const std::string& sub_string, const std::string& language)
 {
    return my->get_events_containing_sub_string(sub_string, language);
 }
 
+std::vector<event_object> bookie_api::list_events_containing_sub_string(const std::string& sub_string, const std::string& language,
+                                                                        event_id_type start, uint32_t limit)
+{
+   return my->list_events_containing_sub_string(sub_string, language, start, limit);
+}
+
 fc::variants bookie_api::get_objects(const vector<object_id_type>& ids) const
 {
    return my->get_objects(ids);
@@ -23,6 +23,7 @@
  */
 #include <graphene/bookie/bookie_plugin.hpp>
 #include <graphene/bookie/bookie_objects.hpp>
+#include <graphene/bookie/bet_history_store.hpp>
 
 #include <graphene/chain/impacted.hpp>
 
@@ -36,6 +37,11 @@
 
 #include <boost/algorithm/string/case_conv.hpp>
 
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+
 #include <fc/thread/thread.hpp>
 
 #include <boost/polymorphic_cast.hpp>
@@ -56,41 +62,42 @@ namespace detail
  * the block.  However, with bet objects, it's possible that the user places a bet and it fills
  * and is removed during the same block, so need another strategy to detect them immediately after
  * they are created. 
- * We do this by creating a secondary index on bet_object.  We don't actually use it
- * to index any property of the bet, we just use it to register for callbacks.
+ * We do this by creating a secondary index on bet_object.  It only remembers which bets were
+ * touched, and a copy of the bets that were removed; the bet history store is updated from it
+ * once the block is applied, so nothing is written for bets that only existed in pending
+ * transactions.
  */
-class persistent_bet_object_helper : public secondary_index
+class bet_history_staging_index : public secondary_index
 {
    public:
-      virtual ~persistent_bet_object_helper() {}
+      virtual ~bet_history_staging_index() {}
 
       virtual void object_inserted(const object& obj) override;
-      //virtual void object_removed( const object& obj ) override;
-      //virtual void about_to_modify( const object& before ) override;
+      virtual void object_removed(const object& obj) override;
       virtual void object_modified(const object& after) override;
-      void set_plugin_instance(bookie_plugin* instance) { _bookie_plugin = instance; }
-   private:
-      bookie_plugin* _bookie_plugin;
+
+      void clear()
+      {
+         touched_bets.clear();
+         removed_bets.clear();
+      }
+
+      flat_set<bet_id_type> touched_bets;
+      std::map<bet_id_type, bet_object> removed_bets;
 };
 
-void persistent_bet_object_helper::object_inserted(const object& obj) 
+void bet_history_staging_index::object_inserted(const object& obj)
+{
+   touched_bets.insert(obj.id);
+}
+void bet_history_staging_index::object_removed(const object& obj)
 {
    const bet_object& bet_obj = *boost::polymorphic_downcast<const bet_object*>(&obj);
-   _bookie_plugin->database().create<persistent_bet_object>([&](persistent_bet_object& saved_bet_obj) {
-      saved_bet_obj.ephemeral_bet_object = bet_obj;
-   });
+   removed_bets[bet_obj.id] = bet_obj;
 }
-void persistent_bet_object_helper::object_modified(const object& after) 
+void bet_history_staging_index::object_modified(const object& after)
 {
-   database& db = _bookie_plugin->database();
-   auto& persistent_bets_by_bet_id = db.get_index_type<persistent_bet_index>().indices().get<by_bet_id>();
-   const bet_object& bet_obj = *boost::polymorphic_downcast<const bet_object*>(&after);
-   auto iter = persistent_bets_by_bet_id.find(bet_obj.id);
-   assert (iter != persistent_bets_by_bet_id.end());
-   if (iter != persistent_bets_by_bet_id.end())
-      db.modify(*iter, [&](persistent_bet_object& saved_bet_obj) {
-         saved_bet_obj.ephemeral_bet_object = bet_obj;
-      });
+   touched_bets.insert(after.id);
 }
 
 //////////// end bet_object ///////////////////
@@ -110,10 +117,19 @@ class persistent_betting_market_object_helper : public secondary_index
 
 void persistent_betting_market_object_helper::object_inserted(const object& obj) 
 {
+   // undoing a block that removed the betting market inserts it again, its persistent copy is still there
+   database& db = _bookie_plugin->database();
+   auto& persistent_betting_markets_by_betting_market_id = db.get_index_type<persistent_betting_market_index>().indices().get<by_betting_market_id>();
    const betting_market_object& betting_market_obj = *boost::polymorphic_downcast<const betting_market_object*>(&obj);
-   _bookie_plugin->database().create<persistent_betting_market_object>([&](persistent_betting_market_object& saved_betting_market_obj) {
-      saved_betting_market_obj.ephemeral_betting_market_object = betting_market_obj;
-   });
+   auto iter = persistent_betting_markets_by_betting_market_id.find(betting_market_obj.id);
+   if (iter != persistent_betting_markets_by_betting_market_id.end())
+      db.modify(*iter, [&](persistent_betting_market_object& saved_betting_market_obj) {
+         saved_betting_market_obj.ephemeral_betting_market_object = betting_market_obj;
+      });
+   else
+      db.create<persistent_betting_market_object>([&](persistent_betting_market_object& saved_betting_market_obj) {
+         saved_betting_market_obj.ephemeral_betting_market_object = betting_market_obj;
+      });
 }
 void persistent_betting_market_object_helper::object_modified(const object& after) 
 {
@@ -145,10 +161,19 @@ class persistent_betting_market_group_object_helper : public secondary_index
 
 void persistent_betting_market_group_object_helper::object_inserted(const object& obj) 
 {
+   // undoing a block that settled the group inserts it again, its persistent copy is still there
+   database& db = _bookie_plugin->database();
+   auto& persistent_betting_market_groups_by_betting_market_group_id = db.get_index_type<persistent_betting_market_group_index>().indices().get<by_betting_market_group_id>();
    const betting_market_group_object& betting_market_group_obj = *boost::polymorphic_downcast<const betting_market_group_object*>(&obj);
-   _bookie_plugin->database().create<persistent_betting_market_group_object>([&](persistent_betting_market_group_object& saved_betting_market_group_obj) {
-      saved_betting_market_group_obj.ephemeral_betting_market_group_object = betting_market_group_obj;
-   });
+   auto iter = persistent_betting_market_groups_by_betting_market_group_id.find(betting_market_group_obj.id);
+   if (iter != persistent_betting_market_groups_by_betting_market_group_id.end())
+      db.modify(*iter, [&](persistent_betting_market_group_object& saved_betting_market_group_obj) {
+         saved_betting_market_group_obj.ephemeral_betting_market_group_object = betting_market_group_obj;
+      });
+   else
+      db.create<persistent_betting_market_group_object>([&](persistent_betting_market_group_object& saved_betting_market_group_obj) {
+         saved_betting_market_group_obj.ephemeral_betting_market_group_object = betting_market_group_obj;
+      });
 }
 void persistent_betting_market_group_object_helper::object_modified(const object& after) 
 {
@@ -180,10 +205,19 @@ class persistent_event_object_helper : public secondary_index
 
 void persistent_event_object_helper::object_inserted(const object& obj) 
 {
+   // undoing a block that removed the event inserts it again, its persistent copy is still there
+   database& db = _bookie_plugin->database();
+   auto& persistent_events_by_event_id = db.get_index_type<persistent_event_index>().indices().get<by_event_id>();
    const event_object& event_obj = *boost::polymorphic_downcast<const event_object*>(&obj);
-   _bookie_plugin->database().create<persistent_event_object>([&](persistent_event_object& saved_event_obj) {
-      saved_event_obj.ephemeral_event_object = event_obj;
-   });
+   auto iter = persistent_events_by_event_id.find(event_obj.id);
+   if (iter != persistent_events_by_event_id.end())
+      db.modify(*iter, [&](persistent_event_object& saved_event_obj) {
+         saved_event_obj.ephemeral_event_object = event_obj;
+      });
+   else
+      db.create<persistent_event_object>([&](persistent_event_object& saved_event_obj) {
+         saved_event_obj.ephemeral_event_object = event_obj;
+      });
 }
 void persistent_event_object_helper::object_modified(const object& after) 
 {
@@ -199,6 +233,110 @@ void persistent_event_object_helper::object_modified(const object& after)
 }
 
 //////////// end event_object ///////////////////
+
+/**
+ * Lower case event names of one language, with a trigram index over them so a sub string
+ * search only looks at events sharing every trigram of the sub string
+ */
+class localized_event_name_index
+{
+   public:
+      void set_name(event_id_type event_id, const std::string& name);
+
+      /**
+       * @return up to @ref limit events with ids >= @ref start whose name contains @ref lower_case_sub_string,
+       * counting only the events @ref is_live accepts, so removed events do not shorten a page
+       */
+      std::vector<event_id_type> find(const std::string& lower_case_sub_string, event_id_type start, uint32_t limit,
+                                      const std::function<bool(event_id_type)>& is_live) const;
+
+   private:
+      static const size_t ngram_size = 3;
+
+      void index_ngrams(event_id_type event_id, const std::string& lower_case_name);
+      void unindex_ngrams(event_id_type event_id, const std::string& lower_case_name);
+
+      std::map<event_id_type, std::string> lower_case_names;
+      std::unordered_map<std::string, flat_set<event_id_type> > events_by_ngram;
+};
+
+void localized_event_name_index::set_name(event_id_type event_id, const std::string& name)
+{
+   std::string lower_case_name = boost::algorithm::to_lower_copy(name);
+   auto name_itr = lower_case_names.find(event_id);
+   if (name_itr != lower_case_names.end())
+   {
+      if (name_itr->second == lower_case_name)
+         return;
+      unindex_ngrams(event_id, name_itr->second);
+      name_itr->second = std::move(lower_case_name);
+   }
+   else
+      name_itr = lower_case_names.emplace(event_id, std::move(lower_case_name)).first;
+   index_ngrams(event_id, name_itr->second);
+}
+
+void localized_event_name_index::index_ngrams(event_id_type event_id, const std::string& lower_case_name)
+{
+   for (size_t i = 0; i + ngram_size <= lower_case_name.size(); ++i)
+      events_by_ngram[lower_case_name.substr(i, ngram_size)].insert(event_id);
+}
+
+void localized_event_name_index::unindex_ngrams(event_id_type event_id, const std::string& lower_case_name)
+{
+   for (size_t i = 0; i + ngram_size <= lower_case_name.size(); ++i)
+   {
+      auto ngram_itr = events_by_ngram.find(lower_case_name.substr(i, ngram_size));
+      if (ngram_itr == events_by_ngram.end())
+         continue;
+      ngram_itr->second.erase(event_id);
+      if (ngram_itr->second.empty())
+         events_by_ngram.erase(ngram_itr);
+   }
+}
+
+std::vector<event_id_type> localized_event_name_index::find(const std::string& lower_case_sub_string, event_id_type start, uint32_t limit,
+                                                            const std::function<bool(event_id_type)>& is_live) const
+{
+   std::vector<event_id_type> result;
+   if (limit == 0)
+      return result;
+
+   if (lower_case_sub_string.size() < ngram_size)
+   {
+      // too short to use the index, but the names are already lower case
+      for (auto name_itr = lower_case_names.lower_bound(start);
+           name_itr != lower_case_names.end() && result.size() < limit;
+           ++name_itr)
+         if (name_itr->second.find(lower_case_sub_string) != std::string::npos && is_live(name_itr->first))
+            result.push_back(name_itr->first);
+      return result;
+   }
+
+   // every matching event contains all trigrams of the sub string: walk the shortest list
+   // and check the others, then confirm the trigrams are actually adjacent in the name
+   std::vector<const flat_set<event_id_type>*> posting_lists;
+   for (size_t i = 0; i + ngram_size <= lower_case_sub_string.size(); ++i)
+   {
+      auto ngram_itr = events_by_ngram.find(lower_case_sub_string.substr(i, ngram_size));
+      if (ngram_itr == events_by_ngram.end())
+         return result;
+      posting_lists.push_back(&ngram_itr->second);
+   }
+   std::sort(posting_lists.begin(), posting_lists.end(),
+             [](const flat_set<event_id_type>* a, const flat_set<event_id_type>* b) { return a->size() < b->size(); });
+
+   const flat_set<event_id_type>& shortest = *posting_lists.front();
+   for (auto id_itr = shortest.lower_bound(start); id_itr != shortest.end() && result.size() < limit; ++id_itr)
+   {
+      bool in_all = std::all_of(posting_lists.begin() + 1, posting_lists.end(),
+                                [id_itr](const flat_set<event_id_type>* list) { return list->count(*id_itr) != 0; });
+      if (in_all && lower_case_names.at(*id_itr).find(lower_case_sub_string) != std::string::npos && is_live(*id_itr))
+         result.push_back(*id_itr);
+   }
+   return result;
+}
+
 class bookie_plugin_impl
 {
    public:
@@ -222,33 +360,35 @@ class bookie_plugin_impl
        */
       void on_block_applied( const signed_block& b );
 
+      /// open the bet history log once the chain id is known, before the first block is applied
+      void open_bet_history();
+      /// add the stake of one side of a match to the totals of its market and group
+      void on_bet_matched( const bet_object& bet, share_type amount_bet );
+      /// bring the bet history up to date with the bets touched by the block
+      void store_bet_history( const signed_block& b, const vector<optional<operation_history_object> >& hist );
+
       asset get_total_matched_bet_amount_for_betting_market_group(betting_market_group_id_type group_id);
 
       void fill_localized_event_strings();
 
       std::vector<event_object> get_events_containing_sub_string(const std::string& sub_string, const std::string& language);
+      std::vector<event_object> list_events_containing_sub_string(const std::string& sub_string, const std::string& language,
+                                                                  event_id_type start, uint32_t limit);
 
       graphene::chain::database& database()
       {
          return _self.database();
       }
 
-      //                1.18.          "Washington Capitals/Chicago Blackhawks"
-      typedef std::pair<event_id_type, std::string> event_string;
-      struct event_string_less : public std::less<const event_string&>
-      {
-          bool operator()(const event_string &_left, const event_string &_right) const
-          {
-              return (_left.first.instance < _right.first.instance);
-          }
-      };
-
-      typedef flat_set<event_string, event_string_less> event_string_set;
       //       "en"
-      std::map<std::string, event_string_set> localized_event_strings;
+      std::map<std::string, localized_event_name_index> localized_event_strings;
 
       bookie_plugin& _self;
       flat_set<account_id_type> _tracked_accounts;
+      bet_history_store _bet_history;
+      fc::path _bet_history_file;
+      bool _bet_history_opened = false;
+      bet_history_staging_index* _bet_history_staging = nullptr;
 };
 
 bookie_plugin_impl::~bookie_plugin_impl()
@@ -281,61 +421,116 @@ bool is_operation_history_object_stored(operation_history_id_type id)
       return true;
 }
 
-void bookie_plugin_impl::on_block_applied( const signed_block& )
+optional<bet_id_type> get_bet_id(const operation_history_object& op)
+{
+   if( op.op.which() == operation::tag<bet_place_operation>::value )
+   {
+      if( op.result.which() == operation_result::tag<object_id_type>::value )
+         return bet_id_type(op.result.get<object_id_type>());
+   }
+   else if( op.op.which() == operation::tag<bet_matched_operation>::value )
+      return op.op.get<bet_matched_operation>().bet_id;
+   else if( op.op.which() == operation::tag<bet_canceled_operation>::value )
+      return op.op.get<bet_canceled_operation>().bet_id;
+   else if( op.op.which() == operation::tag<bet_adjusted_operation>::value )
+      return op.op.get<bet_adjusted_operation>().bet_id;
+   return optional<bet_id_type>();
+}
+
+void bookie_plugin_impl::open_bet_history()
+{
+   if( _bet_history_opened )
+      return;
+   _bet_history.open(_bet_history_file, database().get_chain_id(), GRAPHENE_CURRENT_DB_VERSION);
+   _bet_history_opened = true;
+}
+
+void bookie_plugin_impl::store_bet_history( const signed_block& b, const vector<optional<operation_history_object> >& hist )
+{
+   graphene::chain::database& db = database();
+   _bet_history.begin_block(b.block_num());
+
+   // bets touched by the staging index but not mentioned in the block's operations were only touched
+   // by pending transactions being undone; if they still exist their state is current anyway
+   flat_set<bet_id_type> bets_in_block;
+   for( const optional<operation_history_object>& o_op : hist )
+      if( o_op.valid() )
+         if( optional<bet_id_type> bet_id = get_bet_id(*o_op) )
+            bets_in_block.insert(*bet_id);
+
+   for( bet_id_type bet_id : _bet_history_staging->touched_bets )
+      if( const bet_object* bet_obj = db.find(bet_id) )
+         _bet_history.store_bet(*bet_obj);
+   for( bet_id_type bet_id : bets_in_block )
+   {
+      if( const bet_object* bet_obj = db.find(bet_id) )
+         _bet_history.store_bet(*bet_obj);
+      else
+      {
+         auto removed_itr = _bet_history_staging->removed_bets.find(bet_id);
+         if( removed_itr != _bet_history_staging->removed_bets.end() )
+            _bet_history.store_bet(removed_itr->second);
+      }
+   }
+
+   for( const optional<operation_history_object>& o_op : hist )
+   {
+      if( !o_op.valid() )
+         continue;
+      const operation_history_object& op = *o_op;
+      if( op.op.which() != operation::tag<bet_matched_operation>::value &&
+          op.op.which() != operation::tag<bet_canceled_operation>::value &&
+          op.op.which() != operation::tag<bet_adjusted_operation>::value )
+         continue;
+
+      const bool op_stored = is_operation_history_object_stored(op.id);
+      bool found = _bet_history.modify(*get_bet_id(op), [&]( bet_history_record& record ) {
+         if( op.op.which() == operation::tag<bet_matched_operation>::value )
+            record.amount_matched += op.op.get<bet_matched_operation>().amount_bet.amount;
+         if( op_stored )
+            record.associated_operations.emplace_back(op.id);
+      });
+      if( !found )
+         wlog("Bet ${id} has an operation in block ${b} but no bet history", ("id", *get_bet_id(op))("b", b.block_num()));
+   }
+
+   _bet_history.end_block(db.get_dynamic_global_properties().last_irreversible_block_num);
+}
+
+void bookie_plugin_impl::on_bet_matched( const bet_object& bet, share_type amount_bet )
+{
+   graphene::chain::database& db = database();
+   const auto& persistent_betting_market_idx = db.get_index_type<persistent_betting_market_index>().indices().get<by_betting_market_id>();
+   auto persistent_betting_market_itr = persistent_betting_market_idx.find(bet.betting_market_id);
+   FC_ASSERT(persistent_betting_market_itr != persistent_betting_market_idx.end());
+   db.modify(*persistent_betting_market_itr, [&amount_bet](persistent_betting_market_object& obj) {
+      obj.total_matched_bets_amount += amount_bet;
+   });
+   // a market taking bets is in a group that is still in the main database, its persistent copy follows it
+   db.modify(persistent_betting_market_itr->ephemeral_betting_market_object.group_id(db), [&amount_bet](betting_market_group_object& obj) {
+      obj.total_matched_bets_amount += amount_bet;
+   });
+}
+
+void bookie_plugin_impl::on_block_applied( const signed_block& b )
 { try {
 
    graphene::chain::database& db = database();
    const vector<optional<operation_history_object> >& hist = db.get_applied_operations();
+
+   // blocks already in the bet history log are being replayed, they only need to update the event names
+   open_bet_history();
+   if( b.block_num() > _bet_history.last_logged_block_num() )
+      store_bet_history(b, hist);
+   _bet_history_staging->clear();
+
    for( const optional<operation_history_object>& o_op : hist )
    {
       if( !o_op.valid() )
          continue;
 
       const operation_history_object& op = *o_op;
-      if( op.op.which() == operation::tag<bet_matched_operation>::value )
-      {
-         const bet_matched_operation& bet_matched_op = op.op.get<bet_matched_operation>();
-         //idump((bet_matched_op));
-         const asset& amount_bet = bet_matched_op.amount_bet;
-         // object may no longer exist
-         //const bet_object& bet = bet_matched_op.bet_id(db);
-         auto& persistent_bets_by_bet_id = db.get_index_type<persistent_bet_index>().indices().get<by_bet_id>();
-         auto bet_iter = persistent_bets_by_bet_id.find(bet_matched_op.bet_id);
-         assert(bet_iter != persistent_bets_by_bet_id.end());
-         if (bet_iter != persistent_bets_by_bet_id.end())
-         {
-            db.modify(*bet_iter, [&]( persistent_bet_object& obj ) {
-               obj.amount_matched += amount_bet.amount;
-               if (is_operation_history_object_stored(op.id))
-                  obj.associated_operations.emplace_back(op.id);
-            });
-            const bet_object& bet_obj = bet_iter->ephemeral_bet_object;
-
-            auto& persistent_betting_market_idx = db.get_index_type<persistent_betting_market_index>().indices().get<by_betting_market_id>();
-            auto persistent_betting_market_object_iter = persistent_betting_market_idx.find(bet_obj.betting_market_id);
-            FC_ASSERT(persistent_betting_market_object_iter != persistent_betting_market_idx.end());
-            const betting_market_object& betting_market = persistent_betting_market_object_iter->ephemeral_betting_market_object;
-
-            auto& persistent_betting_market_group_idx = db.get_index_type<persistent_betting_market_group_index>().indices().get<by_betting_market_group_id>();
-            auto persistent_betting_market_group_object_iter = persistent_betting_market_group_idx.find(betting_market.group_id);
-            FC_ASSERT(persistent_betting_market_group_object_iter != persistent_betting_market_group_idx.end());
-            const betting_market_group_object& betting_market_group = persistent_betting_market_group_object_iter->ephemeral_betting_market_group_object;
-
-            // if the object is still in the main database, keep the running total there
-            // otherwise, add it directly to the persistent version
-            auto& betting_market_group_idx = db.get_index_type<betting_market_group_object_index>().indices().get<by_id>();
-            auto betting_market_group_iter = betting_market_group_idx.find(betting_market_group.id);
-            if (betting_market_group_iter != betting_market_group_idx.end())
-               db.modify( *betting_market_group_iter, [&]( betting_market_group_object& obj ){
-                  obj.total_matched_bets_amount += amount_bet.amount;
-               });
-            else
-               db.modify( *persistent_betting_market_group_object_iter, [&]( persistent_betting_market_group_object& obj ){
-                  obj.ephemeral_betting_market_group_object.total_matched_bets_amount += amount_bet.amount;
-               });
-         }
-      }
-      else if( op.op.which() == operation::tag<event_create_operation>::value )
+      if( op.op.which() == operation::tag<event_create_operation>::value )
       {
          FC_ASSERT(op.result.which() == operation_result::tag<object_id_type>::value);
          //object_id_type object_id = op.result.get<object_id_type>();
@@ -343,7 +538,7 @@ void bookie_plugin_impl::on_block_applied( const signed_block& )
          FC_ASSERT( db.find_object(object_id), "invalid event specified" );
          const event_create_operation& event_create_op = op.op.get<event_create_operation>();
          for(const std::pair<std::string, std::string>& pair : event_create_op.name)
-            localized_event_strings[pair.first].insert(event_string(object_id, pair.second));
+            localized_event_strings[pair.first].set_name(object_id, pair.second);
       }
       else if( op.op.which() == operation::tag<event_update_operation>::value )
       {
@@ -352,48 +547,8 @@ void bookie_plugin_impl::on_block_applied( const signed_block& )
             continue;
          event_id_type event_id = event_create_op.event_id;
          for(const std::pair<std::string, std::string>& pair : *event_create_op.new_name)
-         {
-            // try insert
-            std::pair<event_string_set::iterator, bool> result =
-               localized_event_strings[pair.first].insert(event_string(event_id, pair.second));
-            if (!result.second)
-               //  update string only
-               result.first->second = pair.second;
-         }
+            localized_event_strings[pair.first].set_name(event_id, pair.second);
       }
-      else if ( op.op.which() == operation::tag<bet_canceled_operation>::value )
-      {
-         const bet_canceled_operation& bet_canceled_op = op.op.get<bet_canceled_operation>();
-         auto& persistent_bets_by_bet_id = db.get_index_type<persistent_bet_index>().indices().get<by_bet_id>();
-         auto bet_iter = persistent_bets_by_bet_id.find(bet_canceled_op.bet_id);
-         assert(bet_iter != persistent_bets_by_bet_id.end());
-         if (bet_iter != persistent_bets_by_bet_id.end())
-         {
-            // ilog("Adding bet_canceled_operation ${canceled_id} to bet ${bet_id}'s associated operations", 
-            //     ("canceled_id", op.id)("bet_id", bet_canceled_op.bet_id));
-            if (is_operation_history_object_stored(op.id))
-               db.modify(*bet_iter, [&]( persistent_bet_object& obj ) {
-                  obj.associated_operations.emplace_back(op.id);
-               });
-         }
-      }
-      else if ( op.op.which() == operation::tag<bet_adjusted_operation>::value )
-      {
-         const bet_adjusted_operation& bet_adjusted_op = op.op.get<bet_adjusted_operation>();
-         auto& persistent_bets_by_bet_id = db.get_index_type<persistent_bet_index>().indices().get<by_bet_id>();
-         auto bet_iter = persistent_bets_by_bet_id.find(bet_adjusted_op.bet_id);
-         assert(bet_iter != persistent_bets_by_bet_id.end());
-         if (bet_iter != persistent_bets_by_bet_id.end())
-         {
-            // ilog("Adding bet_adjusted_operation ${adjusted_id} to bet ${bet_id}'s associated operations", 
-            //     ("adjusted_id", op.id)("bet_id", bet_adjusted_op.bet_id));
-            if (is_operation_history_object_stored(op.id))
-               db.modify(*bet_iter, [&]( persistent_bet_object& obj ) {
-                  obj.associated_operations.emplace_back(op.id);
-               });
-         }
-      }
-
    }
 } FC_RETHROW_EXCEPTIONS( warn, "" ) }
 
@@ -408,25 +563,28 @@ void bookie_plugin_impl::fill_localized_event_strings()
            ++event_itr;
            for(const std::pair<std::string, std::string>& pair : event_obj.name)
            {
-                localized_event_strings[pair.first].insert(event_string(event_obj.id, pair.second));
+                localized_event_strings[pair.first].set_name(event_obj.id, pair.second);
            }
        }
 }
 
 std::vector<event_object> bookie_plugin_impl::get_events_containing_sub_string(const std::string& sub_string, const std::string& language)
+{
+   return list_events_containing_sub_string(sub_string, language, event_id_type(), std::numeric_limits<uint32_t>::max());
+}
+
+std::vector<event_object> bookie_plugin_impl::list_events_containing_sub_string(const std::string& sub_string, const std::string& language,
+                                                                                event_id_type start, uint32_t limit)
 {
    graphene::chain::database& db = database();
    std::vector<event_object> events;
-   if (localized_event_strings.find(language) != localized_event_strings.end())
+   auto language_itr = localized_event_strings.find(language);
+   if (language_itr != localized_event_strings.end())
    {
       std::string lower_case_sub_string = boost::algorithm::to_lower_copy(sub_string);
-      const event_string_set& language_set = localized_event_strings[language];
-      for (const event_string& pair : language_set)
-      {
-         std::string lower_case_string = boost::algorithm::to_lower_copy(pair.second);
-         if (lower_case_string.find(lower_case_sub_string) != std::string::npos)
-            events.push_back(pair.first(db));
-      }
+      auto is_live = [&db](event_id_type event_id) { return db.find(event_id) != nullptr; };
+      for (event_id_type event_id : language_itr->second.find(lower_case_sub_string, start, limit, is_live))
+         events.push_back(event_id(db));
    }
    return events;
 }
@@ -468,6 +626,7 @@ void bookie_plugin::plugin_initialize(const boost::program_options::variables_ma
     ilog("bookie plugin: plugin_startup() begin");
     database().force_slow_replays();
     database().applied_block.connect( [&]( const signed_block& b){ my->on_block_applied(b); } );
+    database().bet_matched.connect( [this]( const bet_object& bet, share_type amount_bet ){ my->on_bet_matched(bet, amount_bet); } );
     database().changed_objects.connect([&](const vector<object_id_type>& changed_object_ids, const fc::flat_set<graphene::chain::account_id_type>& impacted_accounts){ my->on_objects_changed(changed_object_ids); });
     database().new_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts) { my->on_objects_new(ids); });
     database().removed_objects.connect([this](const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts) { my->on_objects_removed(ids); });
@@ -477,11 +636,19 @@ void bookie_plugin::plugin_initialize(const boost::program_options::variables_ma
     database().add_index<primary_index<detail::persistent_event_index> >();
     database().add_index<primary_index<detail::persistent_betting_market_group_index> >();
     database().add_index<primary_index<detail::persistent_betting_market_index> >();
-    database().add_index<primary_index<detail::persistent_bet_index> >();
     const primary_index<bet_object_index>& bet_object_idx = database().get_index_type<primary_index<bet_object_index> >();
     primary_index<bet_object_index>& nonconst_bet_object_idx = const_cast<primary_index<bet_object_index>&>(bet_object_idx);
-    detail::persistent_bet_object_helper* persistent_bet_object_helper_index = nonconst_bet_object_idx.add_secondary_index<detail::persistent_bet_object_helper>();
-    persistent_bet_object_helper_index->set_plugin_instance(this);
+    my->_bet_history_staging = nonconst_bet_object_idx.add_secondary_index<detail::bet_history_staging_index>();
+
+    // the bet history lives next to the object database, a node without a data directory keeps it in memory;
+    // the log is opened once the chain is, as it is checked against the chain id
+    if( options.count("data-dir") )
+    {
+       fc::path data_dir = options["data-dir"].as<boost::filesystem::path>();
+       if( data_dir.is_relative() )
+          data_dir = fc::current_path() / data_dir;
+       my->_bet_history_file = data_dir / "bookie" / "bet_history.log";
+    }
 
     const primary_index<betting_market_object_index>& betting_market_object_idx = database().get_index_type<primary_index<betting_market_object_index> >();
     primary_index<betting_market_object_index>& nonconst_betting_market_object_idx = const_cast<primary_index<betting_market_object_index>&>(betting_market_object_idx);
@@ -504,9 +671,15 @@ void bookie_plugin::plugin_initialize(const boost::program_options::variables_ma
 void bookie_plugin::plugin_startup()
 {
    ilog("bookie plugin: plugin_startup()");
+    my->open_bet_history();
     my->fill_localized_event_strings();
 }
 
+void bookie_plugin::plugin_shutdown()
+{
+   my->_bet_history.close();
+}
+
 flat_set<account_id_type> bookie_plugin::tracked_accounts() const
 {
    return my->_tracked_accounts;
@@ -523,5 +696,16 @@ std::vector<event_object> bookie_plugin::get_events_containing_sub_string(const
     return my->get_events_containing_sub_string(sub_string, language);
 }
 
+std::vector<event_object> bookie_plugin::list_events_containing_sub_string(const std::string& sub_string, const std::string& language,
+                                                                           event_id_type start, uint32_t limit)
+{
+    return my->list_events_containing_sub_string(sub_string, language, start, limit);
+}
+
+const detail::bet_history_store& bookie_plugin::get_bet_history() const
+{
+    return my->_bet_history;
+}
+
 } }
 
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2018 Peerplays Blockchain Standards Association, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/betting_market_object.hpp>
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/mem_fun.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+
+#include <boost/container/flat_map.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <fstream>
+#include <map>
+
+namespace graphene { namespace bookie { namespace detail {
+using namespace chain;
+
+/**
+ * The last known state of a bet, kept after the bet has been filled or canceled
+ */
+struct bet_history_record
+{
+   bet_object bet;
+
+   // total amount of the bet that matched
+   share_type amount_matched;
+
+   std::vector<operation_history_id_type> associated_operations;
+
+   bet_id_type            get_bet_id() const { return bet.id; }
+   account_id_type        get_bettor_id() const { return bet.bettor_id; }
+   betting_market_id_type get_betting_market_id() const { return bet.betting_market_id; }
+   bool                   is_matched() const { return amount_matched != share_type(); }
+};
+
+struct by_bet_id;
+struct by_bettor_id;
+struct by_betting_market_bet_id;
+typedef boost::multi_index_container<
+   bet_history_record,
+   boost::multi_index::indexed_by<
+      boost::multi_index::ordered_unique<boost::multi_index::tag<by_bet_id>,
+            boost::multi_index::const_mem_fun<bet_history_record, bet_id_type, &bet_history_record::get_bet_id> >,
+      boost::multi_index::ordered_unique<boost::multi_index::tag<by_bettor_id>,
+            boost::multi_index::composite_key<
+               bet_history_record,
+               boost::multi_index::const_mem_fun<bet_history_record, account_id_type, &bet_history_record::get_bettor_id>,
+               boost::multi_index::const_mem_fun<bet_history_record, bool, &bet_history_record::is_matched>,
+               boost::multi_index::const_mem_fun<bet_history_record, bet_id_type, &bet_history_record::get_bet_id> >,
+            boost::multi_index::composite_key_compare<
+               std::less<account_id_type>,
+               std::less<bool>,
+               std::greater<bet_id_type> > >,
+      boost::multi_index::ordered_unique<boost::multi_index::tag<by_betting_market_bet_id>,
+            boost::multi_index::composite_key<
+               bet_history_record,
+               boost::multi_index::const_mem_fun<bet_history_record, betting_market_id_type, &bet_history_record::get_betting_market_id>,
+               boost::multi_index::const_mem_fun<bet_history_record, bet_id_type, &bet_history_record::get_bet_id> > >
+   > > bet_history_multi_index_type;
+
+/**
+ * Where the logged state of a bet is in the log, with what the queries need to find it
+ */
+struct bet_history_location
+{
+   bet_id_type     bet_id;
+   account_id_type bettor_id;
+   bool            matched = false;
+   /// of the log entry
+   uint64_t        offset = 0;
+};
+
+typedef boost::multi_index_container<
+   bet_history_location,
+   boost::multi_index::indexed_by<
+      boost::multi_index::ordered_unique<boost::multi_index::tag<by_bet_id>,
+            boost::multi_index::member<bet_history_location, bet_id_type, &bet_history_location::bet_id> >,
+      boost::multi_index::ordered_unique<boost::multi_index::tag<by_bettor_id>,
+            boost::multi_index::composite_key<
+               bet_history_location,
+               boost::multi_index::member<bet_history_location, account_id_type, &bet_history_location::bettor_id>,
+               boost::multi_index::member<bet_history_location, bool, &bet_history_location::matched>,
+               boost::multi_index::member<bet_history_location, bet_id_type, &bet_history_location::bet_id> >,
+            boost::multi_index::composite_key_compare<
+               std::less<account_id_type>,
+               std::less<bool>,
+               std::greater<bet_id_type> > >
+   > > bet_history_location_index_type;
+
+/// first entry of the log, a log written for another chain or database version is discarded
+struct bet_history_log_header
+{
+   chain_id_type  chain_id;
+   std::string    db_version;
+};
+
+/**
+ * Bet history kept by the bookie plugin outside of the chain database.
+ *
+ * The records are not undo-tracked and not part of the object database snapshot.  Changes made
+ * while applying a block are journaled until the block is irreversible, so a fork can roll them
+ * back; once irreversible, the records a block touched are appended to a log file.  Only the
+ * records of the reversible blocks are kept in memory, the others are read from the log when
+ * queried, so memory holds just their location.  Once the log holds many more entries than
+ * there are bets, it is rewritten with one entry per bet.  The journal is saved next to the log
+ * on shutdown, so the reversible blocks can still be rolled back after a restart.
+ *
+ * Without a log file every record stays in memory.
+ */
+class bet_history_store
+{
+   public:
+      /**
+       * index the records of @ref log_file, creating it if needed; an empty path keeps the history in memory only.
+       * A log written for another chain or database version is discarded, its blocks are applied again.  The
+       * journal saved by @ref close is loaded too.
+       */
+      void open( const fc::path& log_file, const chain_id_type& chain_id, const std::string& db_version );
+      bool is_open() const { return _log.is_open(); }
+      /// save the journal of the reversible blocks next to the log
+      void close();
+
+      /**
+       * @return the highest irreversible block whose records are in the log; blocks up to it must not be applied
+       * again, later ones roll back their journaled changes in @ref begin_block
+       */
+      uint32_t last_logged_block_num() const { return _last_logged_block_num; }
+
+      /// roll back blocks at or above @ref block_num left over from a fork, then start journaling @ref block_num
+      void begin_block( uint32_t block_num );
+      /// set the bet state of a record, creating it if it doesn't exist
+      void store_bet( const bet_object& bet );
+      /// @return false if there is no record for the bet
+      bool modify( bet_id_type bet_id, const std::function<void(bet_history_record&)>& modifier );
+      /// log the blocks that became irreversible
+      void end_block( uint32_t last_irreversible_block_num );
+
+      optional<bet_history_record> find( bet_id_type bet_id ) const;
+      /**
+       * @return up to @ref limit matched bets of @ref bettor_id, newest first, starting at @ref start or at the newest
+       * if it is the default id
+       */
+      std::vector<bet_history_record> get_matched_bets( account_id_type bettor_id, bet_id_type start, uint32_t limit ) const;
+      /// @return the number of bets with a record
+      uint64_t size() const;
+      /// @return the number of records in the log, including the ones a later entry replaced
+      uint64_t log_entries() const { return _log_entries; }
+
+   private:
+      /// the state of each record before the block first touched it, none if the block created it
+      typedef boost::container::flat_map< bet_id_type, optional<bet_history_record> > block_journal;
+
+      /// logs with fewer entries are not compacted
+      static const uint64_t min_compact_entries = 10000;
+
+      /// journal the record before the current block changes it, and load it from the log if needed
+      bet_history_multi_index_type::iterator journal( bet_id_type bet_id );
+      /// @return whether a reversible block changed the record
+      bool is_journaled( bet_id_type bet_id ) const;
+      void append_to_log( uint32_t block_num, const bet_history_record& record );
+      void write_header( std::ostream& out ) const;
+      bet_history_record read_from_log( std::istream& in, uint64_t offset ) const;
+      /// rewrite the log with the irreversible state of each record
+      void compact();
+      void load_journal();
+      void save_journal() const;
+
+      /// records changed by reversible blocks, or all of them without a log
+      bet_history_multi_index_type                     _records;
+      /// records in the log
+      bet_history_location_index_type                  _locations;
+      /// reversible blocks
+      std::map< uint32_t, block_journal >              _journal;
+      uint32_t                                         _current_block_num = 0;
+      uint32_t                                         _last_logged_block_num = 0;
+      bet_history_log_header                           _header;
+      fc::path                                         _log_file;
+      /// where @ref close saves the journal
+      fc::path                                         _journal_file;
+      uint64_t                                         _log_entries = 0;
+      uint64_t                                         _log_size = 0;
+      std::ofstream                                    _log;
+};
+
+} } } //graphene::bookie::detail
+
+FC_REFLECT( graphene::bookie::detail::bet_history_record, (bet)(amount_matched)(associated_operations) )
+FC_REFLECT( graphene::bookie::detail::bet_history_log_header, (chain_id)(db_version) )
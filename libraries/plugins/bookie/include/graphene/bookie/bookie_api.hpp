@@ -55,6 +55,28 @@ struct binned_order_book {
    std::vector<order_bin> aggregated_lay_bets;
 };
 
+struct betting_market_statistics {
+   betting_market_id_type betting_market_id;
+   /// sum of the stakes of both sides of every match
+   share_type total_matched_bets_amount;
+   /// stake held in matched positions, which would be returned if the market were canceled
+   share_type open_interest;
+   /// stake of the live unmatched bets on each side of the book, not counting delayed bets
+   share_type unmatched_back_amount;
+   share_type unmatched_lay_amount;
+};
+
+struct betting_market_group_statistics {
+   betting_market_group_id_type betting_market_group_id;
+   asset_id_type asset_id;
+   /// totals over all markets of the group
+   share_type total_matched_bets_amount;
+   share_type open_interest;
+   share_type unmatched_back_amount;
+   share_type unmatched_lay_amount;
+   std::vector<betting_market_statistics> betting_markets;
+};
+
 struct matched_bet_object {
    // all fields from bet_object
    bet_id_type id;
@@ -89,7 +111,18 @@ class bookie_api
        */
       binned_order_book get_binned_order_book(graphene::chain::betting_market_id_type betting_market_id, int32_t precision);
       asset get_total_matched_bet_amount_for_betting_market_group(betting_market_group_id_type group_id);
+      /**
+       * Returns the matched volume, open interest and unmatched liquidity of a betting market group
+       * and of each of its markets.  The group must not be settled yet.
+       */
+      betting_market_group_statistics get_betting_market_group_statistics(betting_market_group_id_type group_id) const;
       std::vector<event_object> get_events_containing_sub_string(const std::string& sub_string, const std::string& language);
+      /**
+       * Same as get_events_containing_sub_string(), but returns at most @ref limit events (up to 100),
+       * starting at event id @ref start, so results can be paged
+       */
+      std::vector<event_object> list_events_containing_sub_string(const std::string& sub_string, const std::string& language,
+                                                                  event_id_type start = event_id_type(), uint32_t limit = 100);
       fc::variants get_objects(const vector<object_id_type>& ids)const;
       std::vector<matched_bet_object> get_matched_bets_for_bettor(account_id_type bettor_id) const;
       std::vector<matched_bet_object> get_all_matched_bets_for_bettor(account_id_type bettor_id, bet_id_type start = bet_id_type(), unsigned limit = 1000) const;
@@ -100,12 +133,16 @@ class bookie_api
 
 FC_REFLECT(graphene::bookie::order_bin, (amount_to_bet)(backer_multiplier))
 FC_REFLECT(graphene::bookie::binned_order_book, (aggregated_back_bets)(aggregated_lay_bets))
+FC_REFLECT(graphene::bookie::betting_market_statistics, (betting_market_id)(total_matched_bets_amount)(open_interest)(unmatched_back_amount)(unmatched_lay_amount))
+FC_REFLECT(graphene::bookie::betting_market_group_statistics, (betting_market_group_id)(asset_id)(total_matched_bets_amount)(open_interest)(unmatched_back_amount)(unmatched_lay_amount)(betting_markets))
 FC_REFLECT(graphene::bookie::matched_bet_object, (id)(bettor_id)(betting_market_id)(amount_to_bet)(backer_multiplier)(back_or_lay)(end_of_delay)(amount_matched)(associated_operations))
 
 FC_API(graphene::bookie::bookie_api,
        (get_binned_order_book)
        (get_total_matched_bet_amount_for_betting_market_group)
+       (get_betting_market_group_statistics)
        (get_events_containing_sub_string)
+       (list_events_containing_sub_string)
        (get_objects)
        (get_matched_bets_for_bettor)
        (get_all_matched_bets_for_bettor))
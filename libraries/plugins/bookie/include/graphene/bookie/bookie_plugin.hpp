@@ -48,6 +48,7 @@ enum spaces {
 namespace detail
 {
    class bookie_plugin_impl;
+   class bet_history_store;
 }
 
 class bookie_plugin : public graphene::app::plugin
@@ -61,10 +62,14 @@ class bookie_plugin : public graphene::app::plugin
                                               boost::program_options::options_description& cfg) override;
       virtual void plugin_initialize(const boost::program_options::variables_map& options) override;
       virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
 
       flat_set<account_id_type> tracked_accounts()const;
       asset get_total_matched_bet_amount_for_betting_market_group(betting_market_group_id_type group_id);
       std::vector<event_object> get_events_containing_sub_string(const std::string& sub_string, const std::string& language);
+      std::vector<event_object> list_events_containing_sub_string(const std::string& sub_string, const std::string& language,
+                                                                  event_id_type start, uint32_t limit);
+      const detail::bet_history_store& get_bet_history() const;
 
       friend class detail::bookie_plugin_impl;
       std::unique_ptr<detail::bookie_plugin_impl> my;
@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) 2017 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/elasticsearch/bulk_indexer.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+namespace graphene { namespace elasticsearch {
+
+namespace {
+
+/* The spill file is a sequence of entries, each one a little endian uint32_t size followed by
+ * that many bytes of a packed (block number, bulk lines) pair, oldest first.  The watermark
+ * file holds the chain id, the index prefix and the acknowledged block number as lines of text.
+ */
+template<typename Batch>
+void write_entry( std::ostream& out, const Batch& b )
+{
+   const std::vector<char> data = fc::raw::pack( b );
+   const uint32_t entry_size = data.size();
+   out.write( (const char*)&entry_size, sizeof(entry_size) );
+   out.write( data.data(), data.size() );
+}
+
+}
+
+bulk_indexer::~bulk_indexer()
+{
+   stop();
+}
+
+void bulk_indexer::start( const options& opts )
+{ try {
+   FC_ASSERT( !_thread.joinable(), "The bulk indexer is already running" );
+   FC_ASSERT( opts.queue_size > 0, "The elasticsearch queue must hold at least one batch" );
+   _options = opts;
+   _stopping = false;
+   _acknowledged = 0;
+   _spilled = 0;
+   _spill_read_pos = 0;
+
+   if( _options.directory != fc::path() )
+   {
+      fc::create_directories( _options.directory );
+      bool watermark_matches = false;
+      if( fc::exists( watermark_file() ) )
+      {
+         std::ifstream in( watermark_file().generic_string().c_str() );
+         std::string chain_id;
+         std::string index_prefix;
+         uint32_t block_num = 0;
+         if( std::getline( in, chain_id ) && std::getline( in, index_prefix ) && in >> block_num
+               && chain_id == _options.chain_id.str() && index_prefix == _options.index_prefix )
+         {
+            watermark_matches = true;
+            _acknowledged = block_num;
+         }
+      }
+      // the spilled batches belong to the documents of the watermark
+      if( !watermark_matches && ( fc::exists( watermark_file() ) || fc::exists( spill_file() ) ) )
+      {
+         wlog( "Discarding the elasticsearch watermark and spill file in ${d}, they were not written for chain ${c} "
+               "and index prefix ${p}", ("d", _options.directory)("c", _options.chain_id)("p", _options.index_prefix) );
+         fc::remove_all( watermark_file() );
+         fc::remove_all( spill_file() );
+      }
+      write_watermark( _acknowledged );
+
+      if( fc::exists( spill_file() ) )
+      {
+         const uint64_t file_size = fc::file_size( spill_file() );
+         uint64_t valid_size = 0;
+         std::ifstream in( spill_file().generic_string().c_str(), std::ios::binary );
+         while( valid_size + sizeof(uint32_t) <= file_size )
+         {
+            uint32_t entry_size = 0;
+            in.seekg( valid_size );
+            if( !in.read( (char*)&entry_size, sizeof(entry_size) )
+                  || valid_size + sizeof(entry_size) + entry_size > file_size )
+               break;
+            valid_size += sizeof(entry_size) + entry_size;
+            ++_spilled;
+         }
+         // drop a partially written entry left by a crash
+         if( valid_size != file_size )
+         {
+            wlog( "Truncating elasticsearch spill file ${f} to its last complete entry", ("f", spill_file()) );
+            fc::resize_file( spill_file(), valid_size );
+         }
+      }
+      _spill_out.open( spill_file().generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::app );
+      FC_ASSERT( _spill_out.is_open(), "Unable to open elasticsearch spill file ${f}", ("f", spill_file()) );
+      ilog( "Elasticsearch documents acknowledged up to block ${b}, ${n} batches left to send",
+            ("b", acknowledged_block_num())("n", _spilled) );
+   }
+
+   _thread = std::thread( [this]() { run(); } );
+} FC_CAPTURE_AND_RETHROW( (opts.directory) ) }
+
+void bulk_indexer::stop()
+{
+   if( !_thread.joinable() )
+      return;
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _stopping = true;
+   }
+   _changed.notify_all();
+   _thread.join();
+   save_queue();
+}
+
+void bulk_indexer::push( uint32_t block_num, std::vector<std::string>&& lines )
+{
+   std::unique_lock<std::mutex> lock( _mutex );
+   auto has_room = [this]() { return _spilled == 0 && _queue.size() < _options.queue_size; };
+   if( !has_room() && _options.when_full == block_chain )
+   {
+      // called while a block is applied, the chain thread waits here rather than yield with the chain state held,
+      // but not for longer than it can afford
+      if( !_changed.wait_for( lock, std::chrono::microseconds( _options.max_block_wait.count() ),
+                              [&]() { return _stopping || has_room(); } ) )
+         wlog( "Elasticsearch did not catch up within ${s} seconds, setting aside the documents up to block ${b}",
+               ("s", _options.max_block_wait.to_seconds())("b", block_num) );
+   }
+
+   // without a spill file the queue grows past its size rather than lose the batch
+   if( has_room() || ( _spilled == 0 && !_spill_out.is_open() ) )
+      _queue.emplace_back( block_num, std::move( lines ) );
+   else
+   {
+      write_entry( _spill_out, batch( block_num, std::move( lines ) ) );
+      ++_spilled;
+   }
+   lock.unlock();
+   _changed.notify_all();
+}
+
+uint64_t bulk_indexer::pending_batches()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _queue.size() + _spilled;
+}
+
+void bulk_indexer::run()
+{
+   graphene::utilities::CurlPool::Lease curl( _curl_handles );
+   while( true )
+   {
+      const batch* next = nullptr;
+      batch spilled;
+      uint64_t spilled_size = 0;
+      uint64_t read_pos = 0;
+      {
+         std::unique_lock<std::mutex> lock( _mutex );
+         _changed.wait( lock, [this]() { return _stopping || !_queue.empty() || _spilled > 0; } );
+         if( _stopping )
+            return;
+         if( !_queue.empty() )
+            next = &_queue.front(); // push only appends, which leaves the front in place
+         else
+         {
+            _spill_out.flush();
+            read_pos = _spill_read_pos;
+         }
+      }
+      if( next == nullptr )
+      {
+         // the spilled entries before the end of the file do not change until they are sent
+         if( !read_spilled( read_pos, spilled, spilled_size ) )
+         {
+            elog( "Unable to read the elasticsearch spill file ${f}, dropping ${n} batches",
+                  ("f", spill_file())("n", _spilled) );
+            std::lock_guard<std::mutex> lock( _mutex );
+            _spilled = 0;
+            reset_spill_file();
+            continue;
+         }
+         next = &spilled;
+      }
+
+      int64_t delay = fc::milliseconds( 250 ).count();
+      send_result result;
+      while( ( result = send( curl.get(), *next ) ) == failed )
+      {
+         elog( "Elasticsearch did not index the documents up to block ${b}, retrying in ${d} ms",
+               ("b", next->first)("d", delay / 1000) );
+         std::unique_lock<std::mutex> lock( _mutex );
+         if( _changed.wait_for( lock, std::chrono::microseconds( delay ), [this]() { return _stopping; } ) )
+            return;
+         delay = std::min( delay * 2, _options.max_retry_delay.count() );
+      }
+      if( result == rejected )
+         elog( "Elasticsearch refused the documents up to block ${b}, dropping ${n} bulk lines",
+               ("b", next->first)("n", next->second.size()) );
+
+      const uint32_t block_num = next->first;
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         if( next == &spilled )
+         {
+            _spill_read_pos += spilled_size;
+            if( --_spilled == 0 )
+               reset_spill_file();
+         }
+         else
+            _queue.pop_front();
+      }
+      _changed.notify_all();
+      acknowledge( block_num );
+   }
+}
+
+bulk_indexer::send_result bulk_indexer::send( CURL* curl, const batch& b )const
+{
+   if( b.second.empty() )
+      return sent;
+   try
+   {
+      graphene::utilities::CurlRequest request;
+      request.handler = curl;
+      request.url = _options.node_url + "_bulk";
+      request.auth = _options.basic_auth;
+      request.type = "POST";
+      request.query = graphene::utilities::joinBulkLines( b.second );
+      const std::string response = graphene::utilities::doCurl( request );
+      return classify_response( graphene::utilities::getResponseCode( curl ), response );
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "${e}", ("e", e.to_detail_string()) );
+   }
+   return failed;
+}
+
+bulk_indexer::send_result bulk_indexer::classify_response( long http_code, const std::string& response )
+{
+   // no answer, a timeout, too many requests or a server error: the same request may pass later
+   if( http_code == 0 || http_code == 408 || http_code == 429 || http_code >= 500 )
+   {
+      elog( "Elasticsearch answered ${c} to a bulk request", ("c", http_code) );
+      return failed;
+   }
+   if( http_code != 200 )
+   {
+      elog( "Elasticsearch refused a bulk request with ${c}: ${r}", ("c", http_code)("r", response.substr( 0, 1000 )) );
+      return rejected;
+   }
+
+   try
+   {
+      const fc::variant result = fc::json::from_string( response );
+      if( !result["errors"].as_bool() )
+         return sent;
+      // log the first failed item, the others usually fail the same way
+      for( const fc::variant& item : result["items"].get_array() )
+         for( const auto& action : item.get_object() )
+            if( action.value().get_object().contains( "error" ) )
+            {
+               elog( "Elasticsearch refused a document: ${e}", ("e", action.value()["error"]) );
+               return rejected;
+            }
+      elog( "Elasticsearch refused documents of a bulk request" );
+      return rejected;
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Unable to read the response to a bulk request: ${e}", ("e", e.to_detail_string()) );
+   }
+   return failed;
+}
+
+void bulk_indexer::acknowledge( uint32_t block_num )
+{
+   if( block_num <= _acknowledged )
+      return;
+   _acknowledged = block_num;
+   write_watermark( block_num );
+}
+
+void bulk_indexer::write_watermark( uint32_t block_num )
+{
+   if( _options.directory == fc::path() )
+      return;
+   try
+   {
+      const fc::path tmp_file = watermark_file().generic_string() + ".tmp";
+      {
+         std::ofstream out( tmp_file.generic_string().c_str(), std::ios::out | std::ios::trunc );
+         out << _options.chain_id.str() << "\n" << _options.index_prefix << "\n" << block_num << "\n";
+      }
+      fc::rename( tmp_file, watermark_file() );
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Unable to write the elasticsearch watermark: ${e}", ("e", e.to_detail_string()) );
+   }
+}
+
+bool bulk_indexer::read_spilled( uint64_t pos, batch& b, uint64_t& size )const
+{
+   try
+   {
+      std::ifstream in( spill_file().generic_string().c_str(), std::ios::binary );
+      in.seekg( pos );
+      uint32_t entry_size = 0;
+      if( !in.read( (char*)&entry_size, sizeof(entry_size) ) )
+         return false;
+      std::vector<char> data( entry_size );
+      if( !in.read( data.data(), entry_size ) )
+         return false;
+      fc::raw::unpack( data, b );
+      size = sizeof(entry_size) + entry_size;
+      return true;
+   }
+   catch( const fc::exception& )
+   {
+   }
+   return false;
+}
+
+void bulk_indexer::reset_spill_file()
+{
+   _spill_out.close();
+   _spill_out.open( spill_file().generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::trunc );
+   _spill_read_pos = 0;
+}
+
+void bulk_indexer::save_queue()
+{
+   if( _options.directory == fc::path() )
+   {
+      if( !_queue.empty() )
+         wlog( "Dropping ${n} batches not sent to elasticsearch, there is no data directory to keep them in",
+               ("n", _queue.size()) );
+      _queue.clear();
+      return;
+   }
+
+   // the queued batches are older than the spilled ones, they go first
+   if( !_queue.empty() || _spill_read_pos > 0 )
+   {
+      _spill_out.close();
+      const fc::path tmp_file = spill_file().generic_string() + ".tmp";
+      {
+         std::ofstream out( tmp_file.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::trunc );
+         for( const batch& b : _queue )
+            write_entry( out, b );
+         if( _spilled > 0 )
+         {
+            std::ifstream in( spill_file().generic_string().c_str(), std::ios::binary );
+            in.seekg( _spill_read_pos );
+            out << in.rdbuf();
+         }
+      }
+      fc::rename( tmp_file, spill_file() );
+      _spilled += _queue.size();
+      _queue.clear();
+      _spill_read_pos = 0;
+   }
+   if( _spilled > 0 )
+      ilog( "Saved ${n} batches for elasticsearch to ${f}", ("n", _spilled)("f", spill_file()) );
+   _spill_out.close();
+}
+
+} } //graphene::elasticsearch
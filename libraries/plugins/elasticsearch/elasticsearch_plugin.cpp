@@ -23,9 +23,11 @@
  */
 
 #include <graphene/elasticsearch/elasticsearch_plugin.hpp>
+#include <graphene/elasticsearch/bulk_indexer.hpp>
 #include <graphene/chain/impacted.hpp>
 #include <graphene/chain/account_evaluator.hpp>
 #include <graphene/chain/hardfork.hpp>
+#include <graphene/elasticsearch/json_writer.hpp>
 #include <curl/curl.h>
 
 namespace graphene { namespace elasticsearch {
@@ -42,6 +44,8 @@ class elasticsearch_plugin_impl
       virtual ~elasticsearch_plugin_impl();
 
       bool update_account_histories( const signed_block& b );
+      /// start sending batches once the database knows its chain id, which the watermark is checked against
+      void start_indexer();
 
       graphene::chain::database& database()
       {
@@ -62,10 +66,13 @@ class elasticsearch_plugin_impl
       bool _elasticsearch_operation_string = true;
       mode _elasticsearch_mode = mode::only_save;
       CURL *curl; // curl handler
+      graphene::utilities::CurlPool _query_handles; // handles of the history queries, which run on several threads
       vector <string> bulk_lines; //  vector of op lines
       vector<std::string> prepare;
+      bulk_indexer _indexer; // sends bulk_lines from a thread of its own
+      bulk_indexer::options _indexer_options;
+      bool _indexer_started = false;
 
-      graphene::utilities::ES es;
       uint32_t limit_documents;
       int16_t op_type;
       operation_history_struct os;
@@ -91,11 +98,11 @@ class elasticsearch_plugin_impl
       void cleanObjects(const account_transaction_history_object& ath, account_id_type account_id);
       void createBulkLine(const account_transaction_history_object& ath);
       void prepareBulk(const account_transaction_history_id_type& ath_id);
-      void populateESstruct();
 };
 
 elasticsearch_plugin_impl::~elasticsearch_plugin_impl()
 {
+   _indexer.stop();
    if (curl) {
       curl_easy_cleanup(curl);
       curl = nullptr;
@@ -103,8 +110,19 @@ elasticsearch_plugin_impl::~elasticsearch_plugin_impl()
    return;
 }
 
+void elasticsearch_plugin_impl::start_indexer()
+{
+   if( _indexer_started )
+      return;
+   _indexer_options.chain_id = database().get_chain_id();
+   _indexer_options.index_prefix = _elasticsearch_index_prefix;
+   _indexer.start( _indexer_options );
+   _indexer_started = true;
+}
+
 bool elasticsearch_plugin_impl::update_account_histories( const signed_block& b )
 {
+   start_indexer();
    checkState(b.timestamp);
    index_name = graphene::utilities::generateIndexName(b.timestamp, _elasticsearch_index_prefix);
 
@@ -180,15 +198,9 @@ bool elasticsearch_plugin_impl::update_account_histories( const signed_block& b
    // we send bulk at end of block when we are in sync for better real time client experience
    if(is_sync)
    {
-      populateESstruct();
-      if(es.bulk_lines.size() > 0)
-      {
-         prepare.clear();
-         if(!graphene::utilities::SendBulk(es))
-            return false;
-         else
-            bulk_lines.clear();
-      }
+      prepare.clear();
+      _indexer.push(b.block_num(), std::move(bulk_lines));
+      bulk_lines.clear();
    }
 
    return true;
@@ -220,7 +232,7 @@ void elasticsearch_plugin_impl::doOperationHistory(const optional <operation_his
 {
    os.trx_in_block = oho->trx_in_block;
    os.op_in_trx = oho->op_in_trx;
-   os.operation_result = fc::json::to_string(oho->result);
+   os.operation_result = graphene::elasticsearch::to_json(oho->result);
    os.virtual_op = oho->virtual_op;
 
    if(_elasticsearch_operation_object) {
@@ -229,7 +241,7 @@ void elasticsearch_plugin_impl::doOperationHistory(const optional <operation_his
       os.op_object = adaptor.adapt(os.op_object.get_object());
    }
    if(_elasticsearch_operation_string)
-      os.op = fc::json::to_string(oho->op);
+      os.op = graphene::elasticsearch::to_json(oho->op);
 }
 
 void elasticsearch_plugin_impl::doBlock(const optional <operation_history_object>& oho, const signed_block& b)
@@ -272,19 +284,18 @@ bool elasticsearch_plugin_impl::add_elasticsearch( const account_id_type account
    const auto &stats_obj = getStatsObject(account_id);
    const auto &ath = addNewEntry(stats_obj, account_id, oho);
    growStats(stats_obj, ath);
-   if(block_number > _elasticsearch_start_es_after_block)  {
+   // on replay the blocks the node already acknowledged are not sent again
+   if(block_number > _elasticsearch_start_es_after_block && block_number > _indexer.acknowledged_block_num())  {
       createBulkLine(ath);
       prepareBulk(ath.id);
    }
    cleanObjects(ath, account_id);
 
-   if (curl && bulk_lines.size() >= limit_documents) { // we are in bulk time, ready to add data to elasticsearech
+   if (bulk_lines.size() >= limit_documents) { // we are in bulk time, ready to add data to elasticsearech
       prepare.clear();
-      populateESstruct();
-      if(!graphene::utilities::SendBulk(es))
-         return false;
-      else
-         bulk_lines.clear();
+      // the documents of the current block may not all be in the batch yet
+      _indexer.push(block_number - 1, std::move(bulk_lines));
+      bulk_lines.clear();
    }
 
    return true;
@@ -331,7 +342,7 @@ void elasticsearch_plugin_impl::createBulkLine(const account_transaction_history
    bulk_line_struct.block_data = bs;
    if(_elasticsearch_visitor)
       bulk_line_struct.additional_data = vs;
-   bulk_line = fc::json::to_string(bulk_line_struct);
+   bulk_line = graphene::elasticsearch::to_json(bulk_line_struct);
 }
 
 void elasticsearch_plugin_impl::prepareBulk(const account_transaction_history_id_type& ath_id)
@@ -374,14 +385,6 @@ void elasticsearch_plugin_impl::cleanObjects(const account_transaction_history_o
    }
 }
 
-void elasticsearch_plugin_impl::populateESstruct()
-{
-   es.curl = curl;
-   es.bulk_lines = bulk_lines;
-   es.elasticsearch_url = _elasticsearch_node_url;
-   es.auth = _elasticsearch_basic_auth;
-}
-
 } // end namespace detail
 
 elasticsearch_plugin::elasticsearch_plugin() :
@@ -428,6 +431,19 @@ void elasticsearch_plugin::plugin_set_program_options(
                "Save operation as string. Needed to serve history api calls(true)")
          ("elasticsearch-mode", boost::program_options::value<uint16_t>(),
                "Mode of operation: only_save(0), only_query(1), all(2) - Default: 0")
+         ("elasticsearch-queue-size", boost::program_options::value<uint32_t>(),
+               "Number of bulk requests waiting to be sent before elasticsearch-backpressure applies(16)")
+         ("elasticsearch-backpressure", boost::program_options::value<std::string>(),
+               "What to do when the queue is full: spill the requests to a file in the data directory, "
+               "or block the chain until elasticsearch catches up for at most "
+               "elasticsearch-backpressure-max-wait(spill|block - Default: spill)")
+         ("elasticsearch-backpressure-max-wait", boost::program_options::value<uint32_t>(),
+               "Maximum seconds block backpressure holds a block before spilling its requests anyway(5)")
+         ("elasticsearch-retry-max-delay", boost::program_options::value<uint32_t>(),
+               "Maximum seconds between retries of a bulk request elasticsearch could not take(60), "
+               "requests it refuses are logged and dropped. "
+               "The last acknowledged block is kept in data-dir/elasticsearch/watermark and skipped on replay, "
+               "delete the file to index everything again")
          ;
    cfg.add(cli);
 }
@@ -470,6 +486,26 @@ void elasticsearch_plugin::plugin_initialize(const boost::program_options::varia
          FC_THROW_EXCEPTION(fc::exception, "Elasticsearch mode not valid");
       my->_elasticsearch_mode = static_cast<mode>(options["elasticsearch-mode"].as<uint16_t>());
    }
+   if (options.count("elasticsearch-queue-size")) {
+      my->_indexer_options.queue_size = options["elasticsearch-queue-size"].as<uint32_t>();
+      if(my->_indexer_options.queue_size == 0)
+         FC_THROW_EXCEPTION(fc::exception, "elasticsearch-queue-size must be at least 1");
+   }
+   if (options.count("elasticsearch-backpressure")) {
+      const std::string& backpressure = options["elasticsearch-backpressure"].as<std::string>();
+      if(backpressure == "block")
+         my->_indexer_options.when_full = bulk_indexer::block_chain;
+      else if(backpressure == "spill")
+         my->_indexer_options.when_full = bulk_indexer::spill_to_file;
+      else
+         FC_THROW_EXCEPTION(fc::exception, "Elasticsearch backpressure ${b} not valid", ("b", backpressure));
+   }
+   if (options.count("elasticsearch-backpressure-max-wait")) {
+      my->_indexer_options.max_block_wait = fc::seconds(options["elasticsearch-backpressure-max-wait"].as<uint32_t>());
+   }
+   if (options.count("elasticsearch-retry-max-delay")) {
+      my->_indexer_options.max_retry_delay = fc::seconds(options["elasticsearch-retry-max-delay"].as<uint32_t>());
+   }
 
    if(my->_elasticsearch_mode != mode::only_query) {
       if (my->_elasticsearch_mode == mode::all && !my->_elasticsearch_operation_string)
@@ -481,6 +517,16 @@ void elasticsearch_plugin::plugin_initialize(const boost::program_options::varia
             FC_THROW_EXCEPTION(fc::exception,
                   "Error populating ES database, we are going to keep trying.");
       });
+
+      // started on the first block, the watermark decides which blocks are sent again
+      my->_indexer_options.node_url = my->_elasticsearch_node_url;
+      my->_indexer_options.basic_auth = my->_elasticsearch_basic_auth;
+      if (options.count("data-dir")) {
+         fc::path data_dir = options["data-dir"].as<boost::filesystem::path>();
+         if( data_dir.is_relative() )
+            data_dir = fc::current_path() / data_dir;
+         my->_indexer_options.directory = data_dir / "elasticsearch";
+      }
    }
 }
 
@@ -493,9 +539,16 @@ void elasticsearch_plugin::plugin_startup()
 
    if(!graphene::utilities::checkES(es))
       FC_THROW_EXCEPTION(fc::exception, "ES database is not up in url ${url}", ("url", my->_elasticsearch_node_url));
+   if(my->_elasticsearch_mode != mode::only_query)
+      my->start_indexer();
    ilog("elasticsearch ACCOUNT HISTORY: plugin_startup() begin");
 }
 
+void elasticsearch_plugin::plugin_shutdown()
+{
+   my->_indexer.stop();
+}
+
 operation_history_object elasticsearch_plugin::get_operation_by_id(operation_history_id_type id)
 {
    const string operation_id_string = std::string(object_id_type(id));
@@ -511,7 +564,8 @@ operation_history_object elasticsearch_plugin::get_operation_by_id(operation_his
    }
    )";
 
-   auto es = prepareHistoryQuery(query);
+   graphene::utilities::CurlPool::Lease curl(my->_query_handles);
+   auto es = prepareHistoryQuery(query, curl.get());
    const auto response = graphene::utilities::simpleQuery(es);
    variant variant_response = fc::json::from_string(response);
    const auto source = variant_response["hits"]["hits"][size_t(0)]["_source"];
@@ -553,14 +607,15 @@ vector<operation_history_object> elasticsearch_plugin::get_account_history(
    }
    )";
 
-   auto es = prepareHistoryQuery(query);
+   graphene::utilities::CurlPool::Lease curl(my->_query_handles);
+   auto es = prepareHistoryQuery(query, curl.get());
 
    vector<operation_history_object> result;
 
-   if(!graphene::utilities::checkES(es))
-      return result;
-
+   // an empty response means the node could not be reached
    const auto response = graphene::utilities::simpleQuery(es);
+   if(response.empty())
+      return result;
    variant variant_response = fc::json::from_string(response);
    
    const auto hits = variant_response["hits"]["total"]["value"];
@@ -601,14 +656,12 @@ operation_history_object elasticsearch_plugin::fromEStoOperation(variant source)
    return result;
 }
 
-graphene::utilities::ES elasticsearch_plugin::prepareHistoryQuery(string query)
+graphene::utilities::ES elasticsearch_plugin::prepareHistoryQuery(string query, CURL* curl)
 {
-   CURL *curl;
-   curl = curl_easy_init();
-
    graphene::utilities::ES es;
    es.curl = curl;
    es.elasticsearch_url = my->_elasticsearch_node_url;
+   es.auth = my->_elasticsearch_basic_auth;
    es.index_prefix = my->_elasticsearch_index_prefix;
    es.endpoint = es.index_prefix + "*/data/_search";
    es.query = query;
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2017 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/protocol/types.hpp>
+#include <graphene/utilities/elasticsearch.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/time.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace elasticsearch {
+
+/**
+ *  Sends the bulk requests of the elasticsearch plugin from a thread of its own, so that applying a block never waits
+ *  on the node.
+ *
+ *  Batches are queued with the last block whose documents they complete.  When the queue is full, @ref push spills the
+ *  batch to a file, which is sent once the queue is drained, or blocks the chain thread for a bounded time until the
+ *  indexer catches up.  A batch the node could not take, because it was unreachable or overloaded, is retried with
+ *  exponential backoff, so batches are indexed in order; a batch it refused is logged and dropped, as sending it again
+ *  would be refused the same way.
+ *
+ *  The last block acknowledged by the node is written to a watermark file along with the chain id and index prefix,
+ *  and the batches still queued when the indexer stops are saved to the spill file and sent first on the next start.
+ *  Both files are discarded when they were written for another chain or index prefix.
+ */
+class bulk_indexer
+{
+   public:
+      enum backpressure { block_chain = 0, spill_to_file = 1 };
+      /// what came of sending a batch: indexed, refused by the node, or to be sent again
+      enum send_result { sent = 0, rejected = 1, failed = 2 };
+
+      struct options
+      {
+         std::string                       node_url;
+         std::string                       basic_auth;
+         /// the documents indexed, the watermark and spill files of another chain or prefix are discarded
+         graphene::chain::chain_id_type    chain_id;
+         std::string                       index_prefix;
+         /// batches kept in memory
+         uint32_t                          queue_size = 16;
+         backpressure                      when_full = spill_to_file;
+         /// how long @ref block_chain waits for room before spilling the batch anyway
+         fc::microseconds                  max_block_wait = fc::seconds( 5 );
+         fc::microseconds                  max_retry_delay = fc::seconds( 60 );
+         /// where the watermark and spill files are kept, empty to keep the batches that do not fit in memory
+         fc::path                          directory;
+      };
+
+      ~bulk_indexer();
+
+      /// load the watermark and the batches spilled by the last run, then start the indexer thread
+      void start( const options& opts );
+      /// send the batch being sent, then save the queue to the spill file and stop the thread
+      void stop();
+
+      /**
+       *  queue the bulk lines of a batch, which complete the documents of the blocks up to @ref block_num; an empty
+       *  batch only moves the watermark.  With @ref block_chain the calling thread waits, without yielding, up to
+       *  max_block_wait while the queue is full.
+       */
+      void push( uint32_t block_num, std::vector<std::string>&& lines );
+
+      /// @return the highest block whose documents the node acknowledged
+      uint32_t acknowledged_block_num()const { return _acknowledged; }
+      /// @return the batches queued or spilled and not acknowledged yet
+      uint64_t pending_batches()const;
+
+      /// @return how a bulk request fared from the HTTP status and body of the response
+      static send_result classify_response( long http_code, const std::string& response );
+
+   private:
+      typedef std::pair< uint32_t, std::vector<std::string> > batch;
+
+      void run();
+      send_result send( CURL* curl, const batch& b )const;
+      void acknowledge( uint32_t block_num );
+      void write_watermark( uint32_t block_num );
+      bool read_spilled( uint64_t pos, batch& b, uint64_t& size )const;
+      void reset_spill_file();
+      void save_queue();
+
+      fc::path spill_file()const { return _options.directory / "spill.log"; }
+      fc::path watermark_file()const { return _options.directory / "watermark"; }
+
+      options                          _options;
+      mutable std::mutex               _mutex;
+      std::condition_variable          _changed;
+      /// batches older than any spilled one
+      std::deque<batch>                _queue;
+      /// batches in the spill file after @ref _spill_read_pos
+      uint64_t                         _spilled = 0;
+      uint64_t                         _spill_read_pos = 0;
+      std::ofstream                    _spill_out;
+      bool                             _stopping = false;
+      std::atomic<uint32_t>            _acknowledged{ 0 };
+      graphene::utilities::CurlPool    _curl_handles;
+      std::thread                      _thread;
+};
+
+} } //graphene::elasticsearch
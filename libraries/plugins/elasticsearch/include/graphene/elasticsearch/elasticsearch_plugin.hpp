@@ -65,7 +65,9 @@ class elasticsearch_plugin : public graphene::app::plugin
          boost::program_options::options_description& cfg) override;
       virtual void plugin_initialize(const boost::program_options::variables_map& options) override;
       virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
 
+      /// queries may run on any thread, concurrently
       operation_history_object get_operation_by_id(operation_history_id_type id);
       vector<operation_history_object> get_account_history(const account_id_type account_id,
             operation_history_id_type stop, unsigned limit, operation_history_id_type start);
@@ -76,7 +78,7 @@ class elasticsearch_plugin : public graphene::app::plugin
 
    private:
       operation_history_object fromEStoOperation(variant source);
-      graphene::utilities::ES prepareHistoryQuery(string query);
+      graphene::utilities::ES prepareHistoryQuery(string query, CURL* curl);
 };
 
 
@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/config.hpp>
+#include <graphene/db/object_id.hpp>
+
+#include <fc/container/flat.hpp>
+#include <fc/io/json.hpp>
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/reflect/variant.hpp>
+#include <fc/safe.hpp>
+#include <fc/static_variant.hpp>
+#include <fc/time.hpp>
+#include <fc/variant.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace elasticsearch {
+
+namespace json_writer_detail {
+
+   struct generic_to_variant {};
+
+   /// competes with the generic to_variant of fc, so that the call below only resolves to a to_variant of the type
+   template<typename T>
+   generic_to_variant to_variant( const T&, fc::variant&, uint32_t );
+
+   /**
+    *  True if @ref T has a to_variant of its own, rather than the generic one of fc that visits its reflected members.
+    *  Such types are written through an fc::variant, as are the ones this writer knows nothing about.
+    */
+   template<typename T>
+   struct has_custom_to_variant
+   {
+      template<typename U>
+      static std::true_type test( typename std::enable_if< std::is_void< decltype( to_variant(
+            std::declval<const U&>(), std::declval<fc::variant&>(), uint32_t() ) ) >::value >::type* );
+      template<typename U>
+      static std::false_type test( ... );
+
+      static const bool value = decltype( test<T>( nullptr ) )::value;
+   };
+
+} // json_writer_detail
+
+/**
+ *  Writes values as JSON straight from their reflection, without building the fc::variant tree that fc::json::to_string
+ *  serializes.  The output is the same as fc::json::to_string with its default formatting: reflected structs are
+ *  objects without their unset optional members, enums are their names, object ids and times are strings, maps are
+ *  arrays of pairs, static variants are [which, value] and 64 bit integers over 32 bits are strings.
+ *
+ *  Types with a to_variant of their own, strings that need escaping and anything not listed here go through
+ *  fc::variant, which keeps the output identical for them at their usual cost.
+ *
+ *  It serves the documents this plugin writes.  API results are serialized by the RPC layer of fc, which always
+ *  converts them to fc::variant, so the writer does not apply to them.
+ */
+class json_writer
+{
+   public:
+      explicit json_writer( std::string& out, uint32_t max_depth = GRAPHENE_MAX_NESTED_OBJECTS )
+         : _out( out ), _max_depth( max_depth ) {}
+
+      template<typename T>
+      void write( const T& value ) { write_value( value ); }
+
+   private:
+      template<typename T>
+      struct member_visitor
+      {
+         json_writer&   writer;
+         const T&       obj;
+         bool&          first;
+
+         template<typename Member, class Class, Member (Class::*member)>
+         void operator()( const char* name )const
+         {
+            writer.write_member( name, obj.*member, first );
+         }
+      };
+
+      struct static_variant_visitor
+      {
+         typedef void result_type;
+         json_writer& writer;
+
+         template<typename T>
+         void operator()( const T& value )const { writer.write_value( value ); }
+      };
+
+      template<typename M>
+      void write_member( const char* name, const M& value, bool& first )
+      {
+         _out += first ? "\"" : ",\"";
+         first = false;
+         _out += name;
+         _out += "\":";
+         write_value( value );
+      }
+
+      template<typename M>
+      void write_member( const char* name, const fc::optional<M>& value, bool& first )
+      {
+         if( value.valid() )
+            write_member( name, *value, first );
+      }
+
+      void write_value( bool value ) { _out += value ? "true" : "false"; }
+
+      void write_value( int8_t value )   { write_signed( value ); }
+      void write_value( int16_t value )  { write_signed( value ); }
+      void write_value( int32_t value )  { write_signed( value ); }
+      void write_value( int64_t value )  { write_signed( value ); }
+      void write_value( uint8_t value )  { write_unsigned( value ); }
+      void write_value( uint16_t value ) { write_unsigned( value ); }
+      void write_value( uint32_t value ) { write_unsigned( value ); }
+      void write_value( uint64_t value ) { write_unsigned( value ); }
+
+      /// doubles are strings, written the way fc::variant formats them
+      void write_value( double value ) { write_variant( fc::variant( value ) ); }
+      void write_value( float value )  { write_variant( fc::variant( double( value ) ) ); }
+
+      void write_value( const std::string& value )
+      {
+         for( char c : value )
+            if( c < 0x20 || c > 0x7e || c == '"' || c == '\\' )
+               return write_variant( fc::variant( value ) );
+         _out += '"';
+         _out += value;
+         _out += '"';
+      }
+
+      void write_value( const fc::time_point_sec& value ) { write_value( value.to_iso_string() ); }
+
+      void write_value( const graphene::db::object_id_type& value )
+      {
+         _out += '"';
+         _out += std::to_string( value.space() );
+         _out += '.';
+         _out += std::to_string( value.type() );
+         _out += '.';
+         _out += std::to_string( value.instance() );
+         _out += '"';
+      }
+
+      template<uint8_t SpaceID, uint8_t TypeID, typename T>
+      void write_value( const graphene::db::object_id<SpaceID, TypeID, T>& value )
+      {
+         write_value( graphene::db::object_id_type( value ) );
+      }
+
+      template<typename T>
+      void write_value( const fc::safe<T>& value ) { write_value( value.value ); }
+
+      template<typename T>
+      void write_value( const fc::optional<T>& value )
+      {
+         if( value.valid() )
+            write_value( *value );
+         else
+            _out += "null";
+      }
+
+      void write_value( const fc::variant& value ) { write_variant( value ); }
+      void write_value( const fc::variant_object& value ) { write_variant( fc::variant( value ) ); }
+      void write_value( const fc::mutable_variant_object& value ) { write_variant( fc::variant( value ) ); }
+
+      /// blobs are hex strings
+      void write_value( const std::vector<char>& value ) { write_variant( fc::variant( value, _max_depth ) ); }
+
+      template<typename T>
+      void write_value( const std::vector<T>& value ) { write_array( value ); }
+      template<typename T, typename... Args>
+      void write_value( const boost::container::flat_set<T, Args...>& value ) { write_array( value ); }
+      template<typename T, typename... Args>
+      void write_value( const std::set<T, Args...>& value ) { write_array( value ); }
+      template<typename K, typename V, typename... Args>
+      void write_value( const boost::container::flat_map<K, V, Args...>& value ) { write_array( value ); }
+      template<typename K, typename V, typename... Args>
+      void write_value( const std::map<K, V, Args...>& value ) { write_array( value ); }
+
+      template<typename A, typename B>
+      void write_value( const std::pair<A, B>& value )
+      {
+         _out += '[';
+         write_value( value.first );
+         _out += ',';
+         write_value( value.second );
+         _out += ']';
+      }
+
+      template<typename... Types>
+      void write_value( const fc::static_variant<Types...>& value )
+      {
+         _out += '[';
+         write_signed( value.which() );
+         _out += ',';
+         static_variant_visitor visitor{ *this };
+         value.visit( visitor );
+         _out += ']';
+      }
+
+      /// reflected structs and enums, unless they have a to_variant of their own
+      template<typename T>
+      void write_value( const T& value )
+      {
+         write_reflected( value, std::integral_constant<bool, json_writer_detail::has_custom_to_variant<T>::value>(),
+                          std::integral_constant<bool, fc::reflector<T>::is_enum::value>() );
+      }
+
+      template<typename T, typename IsEnum>
+      void write_reflected( const T& value, std::true_type, IsEnum )
+      {
+         write_variant( fc::variant( value, _max_depth ) );
+      }
+
+      template<typename T>
+      void write_reflected( const T& value, std::false_type, std::true_type )
+      {
+         write_value( std::string( fc::reflector<T>::to_string( value ) ) );
+      }
+
+      template<typename T>
+      void write_reflected( const T& value, std::false_type, std::false_type )
+      {
+         bool first = true;
+         _out += '{';
+         fc::reflector<T>::visit( member_visitor<T>{ *this, value, first } );
+         _out += '}';
+      }
+
+      template<typename Container>
+      void write_array( const Container& values )
+      {
+         _out += '[';
+         bool first = true;
+         for( const auto& value : values )
+         {
+            if( !first )
+               _out += ',';
+            first = false;
+            write_value( value );
+         }
+         _out += ']';
+      }
+
+      void write_signed( int64_t value )
+      {
+         if( value > 0xffffffff )
+         {
+            _out += '"';
+            _out += std::to_string( value );
+            _out += '"';
+         }
+         else
+            _out += std::to_string( value );
+      }
+
+      void write_unsigned( uint64_t value )
+      {
+         if( value > 0xffffffff )
+         {
+            _out += '"';
+            _out += std::to_string( value );
+            _out += '"';
+         }
+         else
+            _out += std::to_string( value );
+      }
+
+      void write_variant( const fc::variant& value )
+      {
+         _out += fc::json::to_string( value, fc::json::stringify_large_ints_and_doubles, _max_depth );
+      }
+
+      std::string&   _out;
+      uint32_t       _max_depth;
+};
+
+/// @return @ref value as JSON, the same as fc::json::to_string( fc::variant( value ) ) but faster for reflected types
+template<typename T>
+std::string to_json( const T& value, uint32_t max_depth = GRAPHENE_MAX_NESTED_OBJECTS )
+{
+   std::string result;
+   json_writer( result, max_depth ).write( value );
+   return result;
+}
+
+} } // graphene::elasticsearch
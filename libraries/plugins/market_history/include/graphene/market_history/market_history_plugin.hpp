@@ -28,6 +28,8 @@
 
 #include <fc/thread/future.hpp>
 
+#include <boost/multi_index/composite_key.hpp>
+
 namespace graphene { namespace market_history {
 using namespace chain;
 
@@ -99,6 +101,10 @@ struct history_key {
     return std::tie( a.base, a.quote, a.sequence ) == std::tie( b.base, b.quote, b.sequence );
   }
 };
+/**
+ *  A fill kept by the market history store.  It is no longer a database object, its id is numbered by the store
+ *  in the order fills happened, as the database numbered it before.
+ */
 struct order_history_object : public abstract_object<order_history_object>
 {
   history_key          key; 
@@ -106,27 +112,94 @@ struct order_history_object : public abstract_object<order_history_object>
   fill_order_operation op;
 };
 
-struct by_key;
-typedef multi_index_container<
-   bucket_object,
-   indexed_by<
-      hashed_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
-      ordered_unique< tag<by_key>, member< bucket_object, bucket_key, &bucket_object::key > >
-   >
-> bucket_object_multi_index_type;
+struct market_ticker_bucket
+{
+   fc::time_point_sec  open;
+   share_type          base_volume;
+   share_type          quote_volume;
+   share_type          close_base;
+   share_type          close_quote;
+};
+
+/**
+ *  Rolling 24 hour statistics of a market, so that a ticker can be read without walking the trade history.
+ *
+ *  Trades are summed into sub-buckets of bucket_seconds; the totals cover every bucket in @ref buckets.  Buckets that
+ *  fell out of the window are only dropped by the next trade in the market, until then readers subtract them using
+ *  get_window().
+ */
+struct market_ticker_object : public abstract_object<market_ticker_object>
+{
+   static const uint8_t space_id = ACCOUNT_HISTORY_SPACE_ID;
+   static const uint8_t type_id  = 2; // market_history_plugin type, referenced from account_history_plugin.hpp
+
+   static const uint32_t window_seconds = 86400;
+   static const uint32_t bucket_seconds = 300;
+
+   struct window
+   {
+      share_type base_volume;
+      share_type quote_volume;
+      /// the last trade before the window, zero if there was none
+      share_type last_day_base;
+      share_type last_day_quote;
+   };
+
+   /// buckets opened before the returned time are outside of the window at @ref now
+   static fc::time_point_sec window_start( fc::time_point_sec now )
+   {
+      const uint32_t current_open = ( now.sec_since_epoch() / bucket_seconds ) * bucket_seconds;
+      return fc::time_point_sec( current_open > window_seconds - bucket_seconds ?
+                                 current_open - ( window_seconds - bucket_seconds ) : 0 );
+   }
+
+   window get_window( fc::time_point_sec now )const
+   {
+      window result{ base_volume, quote_volume, last_day_base, last_day_quote };
+      const fc::time_point_sec start = window_start( now );
+      for( const market_ticker_bucket& b : buckets )
+      {
+         if( b.open >= start )
+            break;
+         result.base_volume -= b.base_volume;
+         result.quote_volume -= b.quote_volume;
+         result.last_day_base = b.close_base;
+         result.last_day_quote = b.close_quote;
+      }
+      return result;
+   }
 
+   asset_id_type                  base;
+   asset_id_type                  quote;
+   share_type                     latest_base;
+   share_type                     latest_quote;
+   share_type                     last_day_base;
+   share_type                     last_day_quote;
+   share_type                     base_volume;
+   share_type                     quote_volume;
+   /// oldest first
+   vector<market_ticker_bucket>   buckets;
+};
+
+struct by_market;
 typedef multi_index_container<
-   order_history_object,
+   market_ticker_object,
    indexed_by<
       hashed_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
-      ordered_unique< tag<by_key>, member< order_history_object, history_key, &order_history_object::key > >
+      ordered_unique< tag<by_market>,
+         composite_key< market_ticker_object,
+            member< market_ticker_object, asset_id_type, &market_ticker_object::base >,
+            member< market_ticker_object, asset_id_type, &market_ticker_object::quote >
+         >
+      >
    >
-> order_history_multi_index_type;
+> market_ticker_multi_index_type;
 
+typedef generic_index<market_ticker_object, market_ticker_multi_index_type> market_ticker_index;
 
-typedef generic_index<bucket_object, bucket_object_multi_index_type> bucket_index;
-typedef generic_index<order_history_object, order_history_multi_index_type> history_index;
 
+class market_history_store;
+class order_book_feed;
 
 namespace detail
 {
@@ -135,8 +208,10 @@ namespace detail
 
 /**
  *  The market history plugin can be configured to track any number of intervals via its configuration.  Once per block it
- *  will scan the virtual operations and look for fill_order_operations and then adjust the appropriate bucket objects for
- *  each fill order.
+ *  will scan the virtual operations and look for fill_order_operations, sum them up per bucket and then adjust each
+ *  bucket object the block traded in once.  Buckets and fills are kept in a market_history_store rather than in the
+ *  chain database.  Independently of the configured intervals it keeps a market_ticker_object per traded market, and
+ *  the order_book_feed of the markets API clients subscribed to.
  */
 class market_history_plugin : public graphene::app::plugin
 {
@@ -151,10 +226,16 @@ class market_history_plugin : public graphene::app::plugin
       virtual void plugin_initialize(
          const boost::program_options::variables_map& options) override;
       virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
 
       uint32_t                    max_history()const;
       const flat_set<uint32_t>&   tracked_buckets()const;
 
+      /// the buckets and fill history, which are not kept in the chain database
+      const market_history_store& get_market_history_store()const;
+      /// the order books API clients subscribed to, updated once per block
+      order_book_feed& get_order_book_feed();
+
    private:
       friend class detail::market_history_plugin_impl;
       std::unique_ptr<detail::market_history_plugin_impl> my;
@@ -172,4 +253,11 @@ FC_REFLECT_DERIVED( graphene::market_history::bucket_object, (graphene::db::obje
                     (open_base)(open_quote)
                     (close_base)(close_quote)
                     (base_volume)(quote_volume) )
-
+FC_REFLECT( graphene::market_history::market_ticker_bucket,
+            (open)(base_volume)(quote_volume)(close_base)(close_quote) )
+FC_REFLECT_DERIVED( graphene::market_history::market_ticker_object, (graphene::db::object),
+                    (base)(quote)
+                    (latest_base)(latest_quote)
+                    (last_day_base)(last_day_quote)
+                    (base_volume)(quote_volume)
+                    (buckets) )
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/market_history/market_history_plugin.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/static_variant.hpp>
+
+#include <deque>
+#include <fstream>
+#include <map>
+#include <set>
+#include <tuple>
+
+namespace graphene { namespace market_history {
+
+/// first entry of the log, a log written for another chain or database version is discarded
+struct market_history_log_header
+{
+   chain_id_type  chain_id;
+   std::string    db_version;
+};
+
+/**
+ *  Buckets and fill history kept by the market history plugin outside of the chain database.
+ *
+ *  Each market keeps its fills, and each market and bucket size its buckets, in a deque ordered by time, so that
+ *  history queries read a contiguous range.  Nothing here is undo-tracked: changes made while applying a block are
+ *  journaled until the block is irreversible, so that a fork can roll them back, and are then appended to a log file
+ *  which is read back on startup.  The journal of the reversible blocks is saved next to the log on shutdown, so
+ *  that they can still be rolled back after a restart.  Fills get ids from one counter over all markets, so they keep increasing as they
+ *  did when fills were database objects.
+ */
+class market_history_store
+{
+   public:
+      /// base, quote and bucket size of a series of buckets
+      typedef std::tuple<asset_id_type, asset_id_type, uint32_t> series_key;
+      typedef std::pair<asset_id_type, asset_id_type>            market_key;
+
+      /**
+       *  load the history from @ref log_file, creating it if needed; an empty path keeps the history in memory only.
+       *  A log written for another chain or database version is discarded, its blocks are applied again.  The
+       *  journal saved by @ref close is loaded too.
+       */
+      void open( const fc::path& log_file, const chain_id_type& chain_id, const std::string& db_version );
+      /// save the journal of the reversible blocks next to the log
+      void close();
+
+      /**
+       *  @return the highest irreversible block whose changes are in the log; blocks up to it must not be applied
+       *  again, later ones roll back their journaled changes in @ref begin_block
+       */
+      uint32_t last_logged_block_num()const { return _last_logged_block_num; }
+
+      /// roll back blocks at or above @ref block_num left over from a fork, then start journaling @ref block_num
+      void begin_block( uint32_t block_num );
+      /// append a fill to the history of its market, which is ordered base < quote
+      void append_fill( const fill_order_operation& op, fc::time_point_sec time );
+      /// create or replace the bucket at bucket.key
+      void store_bucket( const bucket_object& bucket );
+      /// remove the buckets of @ref seconds size that opened before @ref cutoff, in every market
+      void remove_buckets_before( uint32_t seconds, fc::time_point_sec cutoff );
+      /// log the blocks that became irreversible
+      void end_block( uint32_t last_irreversible_block_num );
+
+      /// @return the fills of the market in both directions, oldest first, or nullptr if it never traded
+      const std::deque<order_history_object>* get_fills( asset_id_type base, asset_id_type quote )const;
+      /// @return the buckets of the series, oldest first, or nullptr if there are none
+      const std::deque<bucket_object>* get_buckets( asset_id_type base, asset_id_type quote, uint32_t seconds )const;
+      const bucket_object* find_bucket( const bucket_key& key )const;
+
+      /// a fill appended, a bucket stored or a bucket removed
+      typedef fc::static_variant< order_history_object, bucket_object, bucket_key > change_type;
+
+   private:
+      struct journal_entry
+      {
+         change_type                change;
+         /// the bucket before it was stored or removed
+         optional<bucket_object>    before;
+      };
+
+      void apply( const change_type& change );
+      void undo( const journal_entry& entry );
+      void set_bucket( const bucket_object& bucket );
+      void erase_bucket( const bucket_key& key );
+      void append_to_log( uint32_t block_num, const change_type& change );
+      void write_header( std::ostream& out )const;
+      void load_journal();
+      void save_journal()const;
+
+      std::map< market_key, std::deque<order_history_object> >   _fills;
+      std::map< series_key, std::deque<bucket_object> >          _buckets;
+      /// the oldest bucket of every series by bucket size and open time, so expired buckets are found first
+      std::set< std::tuple<uint32_t, fc::time_point_sec, asset_id_type, asset_id_type> > _oldest_buckets;
+
+      /// reversible blocks, with the changes they made in order
+      std::map< uint32_t, std::vector<journal_entry> >            _journal;
+      uint32_t                                                     _current_block_num = 0;
+      uint32_t                                                     _last_logged_block_num = 0;
+      /// instance of the id of the next fill
+      uint64_t                                                     _next_fill_instance = 0;
+      market_history_log_header                                    _header;
+      std::ofstream                                                _log;
+      /// where @ref close saves the journal
+      fc::path                                                     _journal_file;
+};
+
+} } //graphene::market_history
+
+FC_REFLECT( graphene::market_history::market_history_log_header, (chain_id)(db_version) )
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/market_object.hpp>
+#include <graphene/chain/protocol/market.hpp>
+
+#include <fc/signals.hpp>
+
+#include <map>
+
+namespace graphene { namespace market_history {
+using namespace chain;
+
+/** the total amount for sale by the limit orders at one price, zero in a diff when the level is gone */
+struct order_book_level
+{
+   price                      sell_price;
+   share_type                 for_sale;
+};
+
+/**
+ *  Every price level of a market.  Markets are keyed with base < quote: asks are the orders selling base for quote
+ *  and bids the orders selling quote for base, both best price first.
+ */
+struct order_book_snapshot
+{
+   asset_id_type              base;
+   asset_id_type              quote;
+   /// sequence of the last diff included, the next diff of the market has sequence + 1
+   uint64_t                   sequence = 0;
+   uint32_t                   block_num = 0;
+   vector<order_book_level>   asks;
+   vector<order_book_level>   bids;
+};
+
+/** the levels of a market that changed in one block, and the trades of the block */
+struct order_book_diff
+{
+   asset_id_type              base;
+   asset_id_type              quote;
+   uint64_t                   sequence = 0;
+   uint32_t                   block_num = 0;
+   fc::time_point_sec         time;
+   vector<order_book_level>   asks;
+   vector<order_book_level>   bids;
+   /// one fill per match, the one paying base
+   vector<fill_order_operation> trades;
+};
+
+/**
+ *  Aggregated order books of the markets API clients watch, kept by the market history plugin and updated once per
+ *  block for every client.
+ *
+ *  Only the price levels touched by the limit orders the block created, changed or removed are recomputed, from the
+ *  undo state of the block.  A market that was just watched, or a block applied after a fork switch or without undo,
+ *  reloads the whole book and publishes the difference.  Call orders are not on the book; margin calls show up as
+ *  trades.
+ */
+class order_book_feed
+{
+   public:
+      typedef std::pair<asset_id_type, asset_id_type> market_key;
+
+      /// emitted once per block with the diffs of the watched markets that changed, must not yield
+      fc::signal<void(const vector<order_book_diff>&)> diffs_applied;
+
+      /// start or keep tracking a market, one call per client; @return its current book
+      order_book_snapshot watch( const database& db, asset_id_type a, asset_id_type b );
+      /// stop tracking a market once every client that watched it unwatched it
+      void unwatch( asset_id_type a, asset_id_type b );
+      /// @return the current book of a watched market, to resync after missing a diff
+      order_book_snapshot get_snapshot( asset_id_type a, asset_id_type b )const;
+
+      /// publish the diffs of @ref block, called once the block is applied
+      void apply_block( const database& db, const signed_block& block );
+
+   private:
+      typedef limit_order_depth_index::levels_type levels_type;
+
+      struct market_book
+      {
+         uint32_t                 watchers = 0;
+         uint64_t                 sequence = 0;
+         uint32_t                 block_num = 0;
+         /// set until the first block after the book was loaded, which may have included pending transactions
+         bool                     reload = true;
+         levels_type              asks;
+         levels_type              bids;
+      };
+
+      static market_key make_key( asset_id_type a, asset_id_type b )
+      {
+         return a < b ? std::make_pair( a, b ) : std::make_pair( b, a );
+      }
+      static void load( const database& db, const market_key& market, market_book& book );
+      static share_type level_total( const database& db, const price& p );
+      static void set_level( levels_type& levels, const price& p, share_type total, vector<order_book_level>& changes );
+      static order_book_diff reload( const database& db, const market_key& market, market_book& book );
+
+      std::map< market_key, market_book > _books;
+      uint32_t                            _last_block_num = 0;
+};
+
+} } // graphene::market_history
+
+FC_REFLECT( graphene::market_history::order_book_level, (sell_price)(for_sale) )
+FC_REFLECT( graphene::market_history::order_book_snapshot, (base)(quote)(sequence)(block_num)(asks)(bids) )
+FC_REFLECT( graphene::market_history::order_book_diff, (base)(quote)(sequence)(block_num)(time)(asks)(bids)(trades) )
@@ -23,6 +23,8 @@
  */
 
 #include <graphene/market_history/market_history_plugin.hpp>
+#include <graphene/market_history/market_history_store.hpp>
+#include <graphene/market_history/order_book_feed.hpp>
 
 #include <graphene/chain/account_evaluator.hpp>
 #include <graphene/chain/account_object.hpp>
@@ -40,6 +42,26 @@ namespace graphene { namespace market_history {
 namespace detail
 {
 
+/** the fills of one block in one bucket */
+struct bucket_accumulator
+{
+   share_type base_volume;
+   share_type quote_volume;
+   price      open;
+   price      close;
+   price      high;
+   price      low;
+};
+
+/** the fills of one block in one market */
+struct ticker_accumulator
+{
+   share_type base_volume;
+   share_type quote_volume;
+   share_type latest_base;
+   share_type latest_quote;
+};
+
 class market_history_plugin_impl
 {
    public:
@@ -51,6 +73,8 @@ class market_history_plugin_impl
        * and will process/index all operations that were applied in the block.
        */
       void update_market_histories( const signed_block& b );
+      /** load the store once the database knows its chain id */
+      void open_store();
 
       graphene::chain::database& database()
       {
@@ -60,16 +84,33 @@ class market_history_plugin_impl
       market_history_plugin&     _self;
       flat_set<uint32_t>         _tracked_buckets;
       uint32_t                   _maximum_history_per_bucket_size = 1000;
+
+      market_history_store       _store;
+      fc::path                   _store_file;
+      bool                       _store_opened = false;
+      /** false while replaying blocks that are already in the store's log */
+      bool                       _storing_history = false;
+
+      order_book_feed            _feed;
+
+      /** fills of the block being processed, applied once per bucket and market */
+      flat_map<bucket_key, bucket_accumulator>                                 _pending_buckets;
+      flat_map<std::pair<asset_id_type, asset_id_type>, ticker_accumulator>    _pending_tickers;
+
+   private:
+      void apply_pending_buckets();
+      void apply_pending_tickers( fc::time_point_sec now );
+      void remove_expired_buckets( fc::time_point_sec now );
 };
 
 
 struct operation_process_fill_order
 {
-   market_history_plugin&    _plugin;
-   fc::time_point_sec        _now;
+   market_history_plugin_impl&    _impl;
+   fc::time_point_sec             _now;
 
-   operation_process_fill_order( market_history_plugin& mhp, fc::time_point_sec n )
-   :_plugin(mhp),_now(n) {}
+   operation_process_fill_order( market_history_plugin_impl& impl, fc::time_point_sec n )
+   :_impl(impl),_now(n) {}
 
    typedef void result_type;
 
@@ -77,135 +118,57 @@ struct operation_process_fill_order
    template<typename T>
    void operator()( const T& )const{}
 
-   void operator()( const fill_order_operation& o )const 
+   void operator()( const fill_order_operation& o )const
    {
       //ilog( "processing ${o}", ("o",o) );
-      const auto& buckets = _plugin.tracked_buckets();
-      auto& db         = _plugin.database();
-      const auto& bucket_idx = db.get_index_type<bucket_index>();
-      const auto& history_idx = db.get_index_type<history_index>().indices().get<by_key>();
-
-      auto time = db.head_block_time();
-
-      history_key hkey;
-      hkey.base = o.pays.asset_id;
-      hkey.quote = o.receives.asset_id;
-      if( hkey.base > hkey.quote ) 
-         std::swap( hkey.base, hkey.quote );
-      hkey.sequence = std::numeric_limits<int64_t>::min();
-
-      auto itr = history_idx.lower_bound( hkey );
-
-      if( itr->key.base == hkey.base && itr->key.quote == hkey.quote )
-         hkey.sequence = itr->key.sequence - 1;
-      else
-         hkey.sequence = 0;
-
-      db.create<order_history_object>( [&]( order_history_object& ho ) {
-         ho.key = hkey;
-         ho.time = time;
-         ho.op = o;
-      });
-
-      hkey.sequence += 200;
-      itr = history_idx.lower_bound( hkey );
-      /*
-      while( itr != history_idx.end() )
+      /** for every matched order there are two fill order operations created, one for
+       * each side.  We can filter the duplicates by only considering the fill operations where
+       * the base < quote
+       */
+      if( o.pays.asset_id < o.receives.asset_id )
       {
-         if( itr->key.base == hkey.base && itr->key.quote == hkey.quote )
-         {
-            db.remove( *itr );
-            itr = history_idx.lower_bound( hkey );
-         }
-         else break;
+         const price trade_price = o.pays / o.receives;
+         ticker_accumulator& ticker = _impl._pending_tickers[ std::make_pair( o.pays.asset_id, o.receives.asset_id ) ];
+         ticker.base_volume += trade_price.base.amount;
+         ticker.quote_volume += trade_price.quote.amount;
+         ticker.latest_base = trade_price.base.amount;
+         ticker.latest_quote = trade_price.quote.amount;
       }
-      */
 
+      if( !_impl._storing_history )
+         return;
 
-      auto max_history = _plugin.max_history();
-      for( auto bucket : buckets )
-      {
-          auto cutoff      = (fc::time_point() + fc::seconds( bucket * max_history));
+      _impl._store.append_fill( o, _impl.database().head_block_time() );
+
+      if( o.pays.asset_id > o.receives.asset_id || _impl._maximum_history_per_bucket_size == 0 )
+         return;
 
+      const price trade_price = o.pays / o.receives;
+      for( auto bucket : _impl._tracked_buckets )
+      {
           bucket_key key;
           key.base    = o.pays.asset_id;
           key.quote   = o.receives.asset_id;
-
-
-          /** for every matched order there are two fill order operations created, one for
-           * each side.  We can filter the duplicates by only considering the fill operations where
-           * the base > quote
-           */
-          if( key.base > key.quote ) 
-          {
-             //ilog( "     skipping because base > quote" );
-             continue;
-          }
-
-          price trade_price = o.pays / o.receives;
-
           key.seconds = bucket;
           key.open    = fc::time_point() + fc::seconds((_now.sec_since_epoch() / key.seconds) * key.seconds);
 
-          const auto& by_key_idx = bucket_idx.indices().get<by_key>();
-          auto itr = by_key_idx.find( key );
-          if( itr == by_key_idx.end() )
-          { // create new bucket
-            /* const auto& obj = */
-            db.create<bucket_object>( [&]( bucket_object& b ){
-                 b.key = key;
-                 b.quote_volume += trade_price.quote.amount;
-                 b.base_volume += trade_price.base.amount;
-                 b.open_base = trade_price.base.amount;
-                 b.open_quote = trade_price.quote.amount;
-                 b.close_base = trade_price.base.amount;
-                 b.close_quote = trade_price.quote.amount;
-                 b.high_base = b.close_base;
-                 b.high_quote = b.close_quote;
-                 b.low_base = b.close_base;
-                 b.low_quote = b.close_quote;
-            });
-            //wlog( "    creating bucket ${b}", ("b",obj) );
-          }
-          else
-          { // update existing bucket
-             //wlog( "    before updating bucket ${b}", ("b",*itr) );
-             db.modify( *itr, [&]( bucket_object& b ){
-                  b.base_volume += trade_price.base.amount;
-                  b.quote_volume += trade_price.quote.amount;
-                  b.close_base = trade_price.base.amount;
-                  b.close_quote = trade_price.quote.amount;
-                  if( b.high() < trade_price ) 
-                  {
-                      b.high_base = b.close_base;
-                      b.high_quote = b.close_quote;
-                  }
-                  if( b.low() > trade_price ) 
-                  {
-                      b.low_base = b.close_base;
-                      b.low_quote = b.close_quote;
-                  }
-             });
-             //wlog( "    after bucket bucket ${b}", ("b",*itr) );
-          }
-
-          if( max_history != 0  )
+          auto acc_itr = _impl._pending_buckets.find( key );
+          if( acc_itr == _impl._pending_buckets.end() )
           {
-             key.open = fc::time_point_sec();
-             auto itr = by_key_idx.lower_bound( key );
-
-             while( itr != by_key_idx.end() && 
-                    itr->key.base == key.base && 
-                    itr->key.quote == key.quote && 
-                    itr->key.seconds == bucket && 
-                    itr->key.open < cutoff )
-             {
-              //  elog( "    removing old bucket ${b}", ("b", *itr) );
-                auto old_itr = itr;
-                ++itr;
-                db.remove( *old_itr );
-             }
+             bucket_accumulator acc;
+             acc.open = trade_price;
+             acc.high = trade_price;
+             acc.low = trade_price;
+             acc_itr = _impl._pending_buckets.emplace( key, acc ).first;
           }
+          bucket_accumulator& acc = acc_itr->second;
+          acc.base_volume += trade_price.base.amount;
+          acc.quote_volume += trade_price.quote.amount;
+          acc.close = trade_price;
+          if( acc.high < trade_price )
+             acc.high = trade_price;
+          if( acc.low > trade_price )
+             acc.low = trade_price;
       }
    }
 };
@@ -213,17 +176,142 @@ struct operation_process_fill_order
 market_history_plugin_impl::~market_history_plugin_impl()
 {}
 
-void market_history_plugin_impl::update_market_histories( const signed_block& b )
+void market_history_plugin_impl::open_store()
 {
-   if( _maximum_history_per_bucket_size == 0 ) return;
-   if( _tracked_buckets.size() == 0 ) return;
+   if( _store_opened )
+      return;
+   _store.open( _store_file, database().get_chain_id(), GRAPHENE_CURRENT_DB_VERSION );
+   _store_opened = true;
+}
 
+void market_history_plugin_impl::update_market_histories( const signed_block& b )
+{
    graphene::chain::database& db = database();
+   open_store();
+   _pending_buckets.clear();
+   _pending_tickers.clear();
+
+   // blocks already in the store's log are being replayed, they only need to update the tickers
+   _storing_history = b.block_num() > _store.last_logged_block_num();
+   if( _storing_history )
+      _store.begin_block( b.block_num() );
+
    const vector<optional< operation_history_object > >& hist = db.get_applied_operations();
    for( const optional< operation_history_object >& o_op : hist )
    {
       if( o_op.valid() )
-         o_op->op.visit( operation_process_fill_order( _self, b.timestamp ) );
+         o_op->op.visit( operation_process_fill_order( *this, b.timestamp ) );
+   }
+
+   apply_pending_tickers( b.timestamp );
+   if( !_storing_history )
+      return;
+   apply_pending_buckets();
+   remove_expired_buckets( b.timestamp );
+   _store.end_block( db.get_dynamic_global_properties().last_irreversible_block_num );
+}
+
+void market_history_plugin_impl::apply_pending_buckets()
+{
+   for( const auto& pending : _pending_buckets )
+   {
+      const bucket_key& key = pending.first;
+      const bucket_accumulator& acc = pending.second;
+      const bucket_object* existing = _store.find_bucket( key );
+      bucket_object b;
+      if( !existing )
+      { // create new bucket
+         b.key = key;
+         b.base_volume = acc.base_volume;
+         b.quote_volume = acc.quote_volume;
+         b.open_base = acc.open.base.amount;
+         b.open_quote = acc.open.quote.amount;
+         b.close_base = acc.close.base.amount;
+         b.close_quote = acc.close.quote.amount;
+         b.high_base = acc.high.base.amount;
+         b.high_quote = acc.high.quote.amount;
+         b.low_base = acc.low.base.amount;
+         b.low_quote = acc.low.quote.amount;
+      }
+      else
+      { // update existing bucket
+         b = *existing;
+         b.base_volume += acc.base_volume;
+         b.quote_volume += acc.quote_volume;
+         b.close_base = acc.close.base.amount;
+         b.close_quote = acc.close.quote.amount;
+         if( b.high() < acc.high )
+         {
+             b.high_base = acc.high.base.amount;
+             b.high_quote = acc.high.quote.amount;
+         }
+         if( b.low() > acc.low )
+         {
+             b.low_base = acc.low.base.amount;
+             b.low_quote = acc.low.quote.amount;
+         }
+      }
+      _store.store_bucket( b );
+   }
+   _pending_buckets.clear();
+}
+
+void market_history_plugin_impl::apply_pending_tickers( fc::time_point_sec now )
+{
+   graphene::chain::database& db = database();
+   const auto& ticker_idx = db.get_index_type<market_ticker_index>().indices().get<by_market>();
+
+   const fc::time_point_sec start = market_ticker_object::window_start( now );
+   const fc::time_point_sec open( ( now.sec_since_epoch() / market_ticker_object::bucket_seconds )
+                                  * market_ticker_object::bucket_seconds );
+   for( const auto& pending : _pending_tickers )
+   {
+      const ticker_accumulator& acc = pending.second;
+      auto itr = ticker_idx.find( std::make_tuple( pending.first.first, pending.first.second ) );
+      const market_ticker_object* ticker = itr != ticker_idx.end() ? &*itr :
+         &db.create<market_ticker_object>( [&]( market_ticker_object& t ) {
+            t.base = pending.first.first;
+            t.quote = pending.first.second;
+         });
+
+      db.modify( *ticker, [&]( market_ticker_object& t ) {
+         auto expired = t.buckets.begin();
+         for( ; expired != t.buckets.end() && expired->open < start; ++expired )
+         {
+            t.base_volume -= expired->base_volume;
+            t.quote_volume -= expired->quote_volume;
+            t.last_day_base = expired->close_base;
+            t.last_day_quote = expired->close_quote;
+         }
+         t.buckets.erase( t.buckets.begin(), expired );
+
+         if( t.buckets.empty() || t.buckets.back().open != open )
+         {
+            t.buckets.emplace_back();
+            t.buckets.back().open = open;
+         }
+         market_ticker_bucket& b = t.buckets.back();
+         b.base_volume += acc.base_volume;
+         b.quote_volume += acc.quote_volume;
+         b.close_base = acc.latest_base;
+         b.close_quote = acc.latest_quote;
+
+         t.base_volume += acc.base_volume;
+         t.quote_volume += acc.quote_volume;
+         t.latest_base = acc.latest_base;
+         t.latest_quote = acc.latest_quote;
+      });
+   }
+   _pending_tickers.clear();
+}
+
+void market_history_plugin_impl::remove_expired_buckets( fc::time_point_sec now )
+{
+   for( uint32_t bucket : _tracked_buckets )
+   {
+      const uint64_t history_seconds = uint64_t( bucket ) * _maximum_history_per_bucket_size;
+      if( history_seconds < now.sec_since_epoch() )
+         _store.remove_buckets_before( bucket, fc::time_point_sec( now.sec_since_epoch() - history_seconds ) );
    }
 }
 
@@ -264,9 +352,11 @@ void market_history_plugin::plugin_set_program_options(
 
 void market_history_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 { try {
-   database().applied_block.connect( [this]( const signed_block& b){ my->update_market_histories(b); } );
-   database().add_index< primary_index< bucket_index  > >();
-   database().add_index< primary_index< history_index  > >();
+   database().applied_block.connect( [this]( const signed_block& b){
+      my->update_market_histories(b);
+      my->_feed.apply_block( database(), b );
+   } );
+   database().add_index< primary_index< market_ticker_index > >();
 
    if( options.count( "bucket-size" ) )
    {
@@ -276,10 +366,35 @@ void market_history_plugin::plugin_initialize(const boost::program_options::vari
    }
    if( options.count( "history-per-size" ) )
       my->_maximum_history_per_bucket_size = options["history-per-size"].as<uint32_t>();
+
+   // the history lives next to the object database, a node without a data directory keeps it in memory
+   if( options.count( "data-dir" ) )
+   {
+      fc::path data_dir = options["data-dir"].as<boost::filesystem::path>();
+      if( data_dir.is_relative() )
+         data_dir = fc::current_path() / data_dir;
+      my->_store_file = data_dir / "market_history" / "market_history.log";
+   }
 } FC_CAPTURE_AND_RETHROW() }
 
 void market_history_plugin::plugin_startup()
 {
+   my->open_store();
+}
+
+void market_history_plugin::plugin_shutdown()
+{
+   my->_store.close();
+}
+
+const market_history_store& market_history_plugin::get_market_history_store()const
+{
+   return my->_store;
+}
+
+order_book_feed& market_history_plugin::get_order_book_feed()
+{
+   return my->_feed;
 }
 
 const flat_set<uint32_t>& market_history_plugin::tracked_buckets() const
@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/market_history/market_history_store.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace market_history {
+
+namespace {
+
+template<typename Series>
+auto lower_bound_open( Series& series, fc::time_point_sec open ) -> decltype( series.begin() )
+{
+   return std::lower_bound( series.begin(), series.end(), open,
+                            []( const bucket_object& b, fc::time_point_sec t ) { return b.key.open < t; } );
+}
+
+bool read_entry( std::istream& in, std::vector<char>& data )
+{
+   uint32_t entry_size = 0;
+   if( !in.read( (char*)&entry_size, sizeof(entry_size) ) )
+      return false;
+   data.resize( entry_size );
+   return bool( in.read( data.data(), entry_size ) );
+}
+
+void write_entry( std::ostream& out, const std::vector<char>& data )
+{
+   const uint32_t entry_size = data.size();
+   out.write( (const char*)&entry_size, sizeof(entry_size) );
+   out.write( data.data(), data.size() );
+}
+
+}
+
+/* The log is a sequence of entries, each one a little endian uint32_t size followed by
+ * that many bytes.  The first entry is the packed header, the others a packed (block number,
+ * change) pair.  Applying the changes in order rebuilds the history.  The journal file has
+ * the same layout, its entries also carry what a change replaced so that it can be undone.
+ */
+void market_history_store::open( const fc::path& log_file, const chain_id_type& chain_id,
+                                 const std::string& db_version )
+{ try {
+   if( log_file == fc::path() )
+      return;
+
+   _header.chain_id = chain_id;
+   _header.db_version = db_version;
+   _journal_file = log_file.generic_string() + ".reversible";
+   fc::create_directories( log_file.parent_path() );
+
+   uint64_t entry_count = 0;
+   if( fc::exists( log_file ) )
+   {
+      std::ifstream in( log_file.generic_string().c_str(), std::ios::binary );
+      std::vector<char> data;
+      bool header_matches = false;
+      if( read_entry( in, data ) )
+      {
+         try
+         {
+            market_history_log_header header;
+            fc::raw::unpack( data, header );
+            header_matches = header.chain_id == chain_id && header.db_version == db_version;
+         }
+         catch( const fc::exception& )
+         {
+         }
+      }
+
+      if( header_matches )
+      {
+         uint64_t valid_size = sizeof(uint32_t) + data.size();
+         while( read_entry( in, data ) )
+         {
+            std::pair<uint32_t, change_type> entry;
+            fc::raw::unpack( data, entry );
+            apply( entry.second );
+            _last_logged_block_num = std::max( _last_logged_block_num, entry.first );
+            valid_size += sizeof(uint32_t) + data.size();
+            ++entry_count;
+         }
+         // drop a partially written entry left by a crash
+         if( valid_size != fc::file_size( log_file ) )
+         {
+            wlog( "Truncating market history log ${f} to its last complete entry", ("f", log_file) );
+            fc::resize_file( log_file, valid_size );
+         }
+      }
+      else
+      {
+         wlog( "Discarding market history log ${f}, it was not written for chain ${c} and database version ${v}",
+               ("f", log_file)("c", chain_id)("v", db_version) );
+         in.close();
+         fc::remove_all( log_file );
+         fc::remove_all( _journal_file );
+      }
+   }
+
+   uint64_t live_count = 0;
+   for( const auto& fills : _fills )
+      live_count += fills.second.size();
+   for( const auto& series : _buckets )
+      live_count += series.second.size();
+
+   if( !fc::exists( log_file ) )
+   {
+      std::ofstream out( log_file.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::trunc );
+      write_header( out );
+   }
+   // most bucket entries are superseded by a later one for the same bucket, rewrite the log from the loaded state
+   // once they make up most of it
+   else if( entry_count > 2 * live_count + 1000 )
+   {
+      const fc::path compacted_file = log_file.generic_string() + ".compact";
+      _log.open( compacted_file.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::trunc );
+      FC_ASSERT( _log.is_open(), "Unable to open market history log ${f}", ("f", compacted_file) );
+      write_header( _log );
+      for( const auto& fills : _fills )
+         for( const order_history_object& fill : fills.second )
+            append_to_log( _last_logged_block_num, fill );
+      for( const auto& series : _buckets )
+         for( const bucket_object& bucket : series.second )
+            append_to_log( _last_logged_block_num, bucket );
+      _log.close();
+      fc::rename( compacted_file, log_file );
+      ilog( "Compacted market history log ${f} from ${e} to ${n} entries", ("f", log_file)("e", entry_count)("n", live_count) );
+   }
+
+   _log.open( log_file.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::app );
+   FC_ASSERT( _log.is_open(), "Unable to open market history log ${f}", ("f", log_file) );
+   ilog( "Loaded ${n} fills and buckets from market history log ${f}, up to block ${b}",
+         ("n", live_count)("f", log_file)("b", _last_logged_block_num) );
+
+   load_journal();
+} FC_CAPTURE_AND_RETHROW( (log_file) ) }
+
+void market_history_store::close()
+{
+   if( !_log.is_open() )
+      return;
+   save_journal();
+   _log.close();
+}
+
+void market_history_store::begin_block( uint32_t block_num )
+{
+   // blocks at or above this one were popped, undo their changes
+   while( !_journal.empty() && _journal.rbegin()->first >= block_num )
+   {
+      const auto& entries = _journal.rbegin()->second;
+      for( auto entry_itr = entries.rbegin(); entry_itr != entries.rend(); ++entry_itr )
+         undo( *entry_itr );
+      _journal.erase( std::prev( _journal.end() ) );
+   }
+   _current_block_num = block_num;
+}
+
+void market_history_store::append_fill( const fill_order_operation& op, fc::time_point_sec time )
+{
+   order_history_object fill;
+   fill.key.base = op.pays.asset_id;
+   fill.key.quote = op.receives.asset_id;
+   if( fill.key.base > fill.key.quote )
+      std::swap( fill.key.base, fill.key.quote );
+
+   // sequences count down, so the newest fill has the lowest one
+   const auto* fills = get_fills( fill.key.base, fill.key.quote );
+   fill.key.sequence = fills ? fills->back().key.sequence - 1 : 0;
+   fill.time = time;
+   fill.op = op;
+   fill.id = object_id_type( order_history_object::space_id, order_history_object::type_id, _next_fill_instance );
+
+   journal_entry entry;
+   entry.change = fill;
+   _journal[_current_block_num].push_back( entry );
+   apply( entry.change );
+}
+
+void market_history_store::store_bucket( const bucket_object& bucket )
+{
+   journal_entry entry;
+   entry.change = bucket;
+   if( const bucket_object* existing = find_bucket( bucket.key ) )
+      entry.before = *existing;
+   _journal[_current_block_num].push_back( entry );
+   apply( entry.change );
+}
+
+void market_history_store::remove_buckets_before( uint32_t seconds, fc::time_point_sec cutoff )
+{
+   const auto first = std::make_tuple( seconds, fc::time_point_sec(), asset_id_type(), asset_id_type() );
+   for( auto itr = _oldest_buckets.lower_bound( first );
+        itr != _oldest_buckets.end() && std::get<0>( *itr ) == seconds && std::get<1>( *itr ) < cutoff;
+        itr = _oldest_buckets.lower_bound( first ) )
+   {
+      const bucket_key key( std::get<2>( *itr ), std::get<3>( *itr ), seconds, std::get<1>( *itr ) );
+      journal_entry entry;
+      entry.change = key;
+      entry.before = *find_bucket( key );
+      _journal[_current_block_num].push_back( entry );
+      apply( entry.change );
+   }
+}
+
+void market_history_store::end_block( uint32_t last_irreversible_block_num )
+{
+   while( !_journal.empty() && _journal.begin()->first <= last_irreversible_block_num )
+   {
+      const uint32_t block_num = _journal.begin()->first;
+      if( _log.is_open() )
+      {
+         for( const journal_entry& entry : _journal.begin()->second )
+            append_to_log( block_num, entry.change );
+         _log.flush();
+         _last_logged_block_num = std::max( _last_logged_block_num, block_num );
+      }
+      _journal.erase( _journal.begin() );
+   }
+}
+
+const std::deque<order_history_object>* market_history_store::get_fills( asset_id_type base, asset_id_type quote )const
+{
+   auto itr = _fills.find( std::make_pair( base, quote ) );
+   return itr != _fills.end() ? &itr->second : nullptr;
+}
+
+const std::deque<bucket_object>* market_history_store::get_buckets( asset_id_type base, asset_id_type quote,
+                                                                     uint32_t seconds )const
+{
+   auto itr = _buckets.find( std::make_tuple( base, quote, seconds ) );
+   return itr != _buckets.end() ? &itr->second : nullptr;
+}
+
+const bucket_object* market_history_store::find_bucket( const bucket_key& key )const
+{
+   const auto* series = get_buckets( key.base, key.quote, key.seconds );
+   if( !series )
+      return nullptr;
+   auto itr = lower_bound_open( *series, key.open );
+   return itr != series->end() && itr->key.open == key.open ? &*itr : nullptr;
+}
+
+void market_history_store::apply( const change_type& change )
+{
+   if( change.which() == change_type::tag<order_history_object>::value )
+   {
+      const order_history_object& fill = change.get<order_history_object>();
+      _fills[ std::make_pair( fill.key.base, fill.key.quote ) ].push_back( fill );
+      _next_fill_instance = std::max( _next_fill_instance, fill.id.instance() + 1 );
+   }
+   else if( change.which() == change_type::tag<bucket_object>::value )
+      set_bucket( change.get<bucket_object>() );
+   else
+      erase_bucket( change.get<bucket_key>() );
+}
+
+void market_history_store::undo( const journal_entry& entry )
+{
+   if( entry.change.which() == change_type::tag<order_history_object>::value )
+   {
+      const order_history_object& fill = entry.change.get<order_history_object>();
+      auto itr = _fills.find( std::make_pair( fill.key.base, fill.key.quote ) );
+      itr->second.pop_back();
+      if( itr->second.empty() )
+         _fills.erase( itr );
+      // fills are undone newest first, so this ends at the id of the oldest fill undone
+      _next_fill_instance = fill.id.instance();
+   }
+   else if( entry.before )
+      set_bucket( *entry.before );
+   else
+      erase_bucket( entry.change.get<bucket_object>().key );
+}
+
+void market_history_store::set_bucket( const bucket_object& bucket )
+{
+   const bucket_key& key = bucket.key;
+   std::deque<bucket_object>& series = _buckets[ std::make_tuple( key.base, key.quote, key.seconds ) ];
+   auto itr = lower_bound_open( series, key.open );
+   if( itr != series.end() && itr->key.open == key.open )
+   {
+      *itr = bucket;
+      return;
+   }
+
+   if( itr == series.begin() )
+   {
+      if( !series.empty() )
+         _oldest_buckets.erase( std::make_tuple( key.seconds, series.front().key.open, key.base, key.quote ) );
+      _oldest_buckets.insert( std::make_tuple( key.seconds, key.open, key.base, key.quote ) );
+   }
+   series.insert( itr, bucket );
+}
+
+void market_history_store::erase_bucket( const bucket_key& key )
+{
+   auto series_itr = _buckets.find( std::make_tuple( key.base, key.quote, key.seconds ) );
+   if( series_itr == _buckets.end() )
+      return;
+   std::deque<bucket_object>& series = series_itr->second;
+   auto itr = lower_bound_open( series, key.open );
+   if( itr == series.end() || itr->key.open != key.open )
+      return;
+
+   const bool oldest = itr == series.begin();
+   if( oldest )
+      _oldest_buckets.erase( std::make_tuple( key.seconds, key.open, key.base, key.quote ) );
+   series.erase( itr );
+   if( series.empty() )
+      _buckets.erase( series_itr );
+   else if( oldest )
+      _oldest_buckets.insert( std::make_tuple( key.seconds, series.front().key.open, key.base, key.quote ) );
+}
+
+void market_history_store::append_to_log( uint32_t block_num, const change_type& change )
+{
+   write_entry( _log, fc::raw::pack( std::make_pair( block_num, change ) ) );
+}
+
+void market_history_store::write_header( std::ostream& out )const
+{
+   write_entry( out, fc::raw::pack( _header ) );
+}
+
+void market_history_store::load_journal()
+{ try {
+   if( !fc::exists( _journal_file ) )
+      return;
+
+   std::ifstream in( _journal_file.generic_string().c_str(), std::ios::binary );
+   std::vector<char> data;
+   bool header_matches = false;
+   if( read_entry( in, data ) )
+   {
+      try
+      {
+         market_history_log_header header;
+         fc::raw::unpack( data, header );
+         header_matches = header.chain_id == _header.chain_id && header.db_version == _header.db_version;
+      }
+      catch( const fc::exception& )
+      {
+      }
+   }
+   if( header_matches )
+   {
+      while( read_entry( in, data ) )
+      {
+         std::pair< uint32_t, std::pair< change_type, optional<bucket_object> > > saved;
+         fc::raw::unpack( data, saved );
+         if( saved.first <= _last_logged_block_num )
+            continue;
+         journal_entry entry;
+         entry.change = saved.second.first;
+         entry.before = saved.second.second;
+         _journal[saved.first].push_back( entry );
+         apply( entry.change );
+      }
+   }
+   in.close();
+   // a crash before the next shutdown must not bring back blocks that were rolled back since
+   fc::remove_all( _journal_file );
+   if( !_journal.empty() )
+      ilog( "Loaded the market history journal of blocks ${f} to ${l}",
+            ("f", _journal.begin()->first)("l", _journal.rbegin()->first) );
+} FC_CAPTURE_AND_RETHROW( (_journal_file) ) }
+
+void market_history_store::save_journal()const
+{ try {
+   if( _journal.empty() )
+      return;
+
+   const fc::path tmp_file = _journal_file.generic_string() + ".tmp";
+   {
+      std::ofstream out( tmp_file.generic_string().c_str(), std::ios::binary | std::ios::out | std::ios::trunc );
+      FC_ASSERT( out.is_open(), "Unable to open market history journal ${f}", ("f", tmp_file) );
+      write_header( out );
+      for( const auto& block : _journal )
+         for( const journal_entry& entry : block.second )
+            write_entry( out, fc::raw::pack( std::make_pair( block.first, std::make_pair( entry.change, entry.before ) ) ) );
+   }
+   fc::rename( tmp_file, _journal_file );
+} FC_CAPTURE_AND_RETHROW( (_journal_file) ) }
+
+} } //graphene::market_history
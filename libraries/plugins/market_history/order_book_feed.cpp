@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/market_history/order_book_feed.hpp>
+
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <set>
+
+namespace graphene { namespace market_history {
+
+order_book_snapshot order_book_feed::watch( const database& db, asset_id_type a, asset_id_type b )
+{
+   const market_key market = make_key( a, b );
+   market_book& book = _books[market];
+   if( book.watchers++ == 0 )
+   {
+      load( db, market, book );
+      book.block_num = db.head_block_num();
+   }
+   return get_snapshot( a, b );
+}
+
+void order_book_feed::unwatch( asset_id_type a, asset_id_type b )
+{
+   auto itr = _books.find( make_key( a, b ) );
+   if( itr != _books.end() && --itr->second.watchers == 0 )
+      _books.erase( itr );
+}
+
+order_book_snapshot order_book_feed::get_snapshot( asset_id_type a, asset_id_type b )const
+{
+   const market_key market = make_key( a, b );
+   auto itr = _books.find( market );
+   FC_ASSERT( itr != _books.end(), "Market ${a}:${b} is not watched", ("a", market.first)("b", market.second) );
+
+   order_book_snapshot result;
+   result.base = market.first;
+   result.quote = market.second;
+   result.sequence = itr->second.sequence;
+   result.block_num = itr->second.block_num;
+   result.asks.reserve( itr->second.asks.size() );
+   for( const auto& level : itr->second.asks )
+      result.asks.push_back( { level.first, level.second } );
+   result.bids.reserve( itr->second.bids.size() );
+   for( const auto& level : itr->second.bids )
+      result.bids.push_back( { level.first, level.second } );
+   return result;
+}
+
+void order_book_feed::load( const database& db, const market_key& market, market_book& book )
+{
+   const auto& depth = db.get_index_type< primary_index<limit_order_index> >().get_secondary_index<limit_order_depth_index>();
+   const limit_order_depth_index::levels_type* asks = depth.get_levels( market.first, market.second );
+   const limit_order_depth_index::levels_type* bids = depth.get_levels( market.second, market.first );
+   book.asks = asks ? *asks : levels_type();
+   book.bids = bids ? *bids : levels_type();
+}
+
+share_type order_book_feed::level_total( const database& db, const price& p )
+{
+   const auto& depth = db.get_index_type< primary_index<limit_order_index> >().get_secondary_index<limit_order_depth_index>();
+   const limit_order_depth_index::levels_type* levels = depth.get_levels( p.base.asset_id, p.quote.asset_id );
+   if( !levels )
+      return share_type();
+   auto itr = levels->find( p );
+   return itr != levels->end() ? itr->second : share_type();
+}
+
+void order_book_feed::set_level( levels_type& levels, const price& p, share_type total,
+                                 vector<order_book_level>& changes )
+{
+   auto itr = levels.find( p );
+   if( itr == levels.end() ? total == 0 : itr->second == total )
+      return;
+   if( total == 0 )
+      levels.erase( itr );
+   else
+      levels[p] = total;
+   changes.push_back( { p, total } );
+}
+
+order_book_diff order_book_feed::reload( const database& db, const market_key& market, market_book& book )
+{
+   market_book fresh;
+   load( db, market, fresh );
+
+   order_book_diff diff;
+   auto compare = [&]( levels_type& levels, const levels_type& fresh_levels, vector<order_book_level>& changes ) {
+      for( auto itr = levels.begin(); itr != levels.end(); )
+      {
+         const price p = (itr++)->first;
+         if( fresh_levels.find( p ) == fresh_levels.end() )
+            set_level( levels, p, 0, changes );
+      }
+      for( const auto& level : fresh_levels )
+         set_level( levels, level.first, level.second, changes );
+   };
+   compare( book.asks, fresh.asks, diff.asks );
+   compare( book.bids, fresh.bids, diff.bids );
+   return diff;
+}
+
+void order_book_feed::apply_block( const database& db, const signed_block& block )
+{
+   const uint32_t block_num = block.block_num();
+   const bool consecutive = block_num == _last_block_num + 1;
+   _last_block_num = block_num;
+   if( _books.empty() )
+      return;
+
+   std::map< market_key, order_book_diff > diffs;
+
+   // the levels of the limit orders the block created, changed or removed, known from its undo state
+   const bool incremental = consecutive && db._undo_db.enabled() && db._undo_db.size() > 0;
+   if( incremental )
+   {
+      std::set< price, std::greater<price> > touched;
+      auto touch = [&]( const object* obj ) {
+         if( const limit_order_object* order = dynamic_cast<const limit_order_object*>( obj ) )
+            if( _books.count( order->get_market() ) )
+               touched.insert( order->sell_price );
+      };
+      const undo_state& state = db._undo_db.head();
+      for( const auto& item : state.old_values )
+         if( item.first.is<limit_order_object>() )
+            touch( item.second.get() );
+      for( const auto& item : state.removed )
+         if( item.first.is<limit_order_object>() )
+            touch( item.second.get() );
+      for( const object_id_type& id : state.new_ids )
+         if( id.is<limit_order_object>() )
+            touch( db.find_object( id ) );
+
+      for( const price& p : touched )
+      {
+         const market_key market = make_key( p.base.asset_id, p.quote.asset_id );
+         market_book& book = _books[market];
+         if( book.reload )
+            continue;
+         order_book_diff& diff = diffs[market];
+         if( p.base.asset_id == market.first )
+            set_level( book.asks, p, level_total( db, p ), diff.asks );
+         else
+            set_level( book.bids, p, level_total( db, p ), diff.bids );
+      }
+   }
+
+   for( auto& item : _books )
+   {
+      market_book& book = item.second;
+      if( !incremental || book.reload )
+      {
+         order_book_diff diff = reload( db, item.first, book );
+         diffs[item.first].asks = std::move( diff.asks );
+         diffs[item.first].bids = std::move( diff.bids );
+         book.reload = false;
+      }
+   }
+
+   for( const optional< operation_history_object >& o_op : db.get_applied_operations() )
+   {
+      if( !o_op.valid() || o_op->op.which() != operation::tag<fill_order_operation>::value )
+         continue;
+      const fill_order_operation& fill = o_op->op.get<fill_order_operation>();
+      if( fill.pays.asset_id < fill.receives.asset_id && _books.count( fill.get_market() ) )
+         diffs[fill.get_market()].trades.push_back( fill );
+   }
+
+   vector<order_book_diff> published;
+   for( auto& item : diffs )
+   {
+      order_book_diff& diff = item.second;
+      if( diff.asks.empty() && diff.bids.empty() && diff.trades.empty() )
+         continue;
+      diff.base = item.first.first;
+      diff.quote = item.first.second;
+      diff.sequence = ++_books[item.first].sequence;
+      diff.block_num = block_num;
+      diff.time = block.timestamp;
+      published.push_back( std::move( diff ) );
+   }
+   for( auto& item : _books )
+      item.second.block_num = block_num;
+
+   if( !published.empty() )
+      diffs_applied( published );
+}
+
+} } // graphene::market_history
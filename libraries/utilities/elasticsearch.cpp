@@ -26,6 +26,7 @@
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string.hpp>
 #include <fc/log/logger.hpp>
+#include <fc/exception/exception.hpp>
 #include <fc/io/json.hpp>
 
 size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
@@ -36,6 +37,34 @@ size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
 
 namespace graphene { namespace utilities {
 
+CurlPool::~CurlPool()
+{
+   for(CURL* handle : _idle)
+      curl_easy_cleanup(handle);
+}
+
+CURL* CurlPool::acquire()
+{
+   {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if(!_idle.empty()) {
+         CURL* handle = _idle.back();
+         _idle.pop_back();
+         return handle;
+      }
+   }
+   CURL* handle = curl_easy_init();
+   FC_ASSERT(handle, "Unable to create a CURL handle");
+   curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+   return handle;
+}
+
+void CurlPool::release(CURL* handle)
+{
+   std::lock_guard<std::mutex> lock(_mutex);
+   _idle.push_back(handle);
+}
+
 bool checkES(ES& es)
 {
    graphene::utilities::CurlRequest curl_request;
@@ -176,13 +205,17 @@ const std::string doCurl(CurlRequest& curl)
    {
       curl_easy_setopt(curl.handler, CURLOPT_POST, true);
       curl_easy_setopt(curl.handler, CURLOPT_POSTFIELDS, curl.query.c_str());
+      curl_easy_setopt(curl.handler, CURLOPT_POSTFIELDSIZE, long(curl.query.size()));
    }
+   else // handles are reused, drop the body of a previous POST
+      curl_easy_setopt(curl.handler, CURLOPT_HTTPGET, 1L);
    curl_easy_setopt(curl.handler, CURLOPT_WRITEFUNCTION, WriteCallback);
    curl_easy_setopt(curl.handler, CURLOPT_WRITEDATA, (void *)&CurlReadBuffer);
    curl_easy_setopt(curl.handler, CURLOPT_USERAGENT, "libcrp/0.1");
    if(!curl.auth.empty())
       curl_easy_setopt(curl.handler, CURLOPT_USERPWD, curl.auth.c_str());
    curl_easy_perform(curl.handler);
+   curl_slist_free_all(headers);
 
    return CurlReadBuffer;
 }
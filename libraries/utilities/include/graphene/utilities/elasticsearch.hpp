@@ -23,6 +23,7 @@
  */
 #pragma once
 #include <cstddef>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -44,6 +45,40 @@ namespace graphene { namespace utilities {
          std::string endpoint;
          std::string query;
    };
+   /**
+    *  CURL handles kept between requests, so that requests reuse their keep-alive connections to the elasticsearch
+    *  node instead of connecting for each one.  A handle serves one request at a time: concurrent requests lease
+    *  different handles, and the pool keeps as many as were ever used at once.
+    */
+   class CurlPool {
+      public:
+         /// a handle for the duration of one request, given back to the pool when destroyed
+         class Lease {
+            public:
+               explicit Lease(CurlPool& pool) : _pool(pool), _handle(pool.acquire()) {}
+               ~Lease() { _pool.release(_handle); }
+               Lease(const Lease&) = delete;
+               Lease& operator=(const Lease&) = delete;
+
+               CURL* get()const { return _handle; }
+
+            private:
+               CurlPool& _pool;
+               CURL*     _handle;
+         };
+
+         CurlPool() = default;
+         ~CurlPool();
+         CurlPool(const CurlPool&) = delete;
+         CurlPool& operator=(const CurlPool&) = delete;
+
+      private:
+         CURL* acquire();
+         void release(CURL* handle);
+
+         std::mutex          _mutex;
+         std::vector<CURL*>  _idle;
+   };
    class CurlRequest {
       public:
          CURL *handler;
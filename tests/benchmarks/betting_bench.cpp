@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2018 Peerplays Blockchain Standards Association, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/betting_market_object.hpp>
+
+#include "../common/betting_test_markets.hpp"
+#include "../common/bench_options.hpp"
+
+#include <boost/range/iterator_range.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+using namespace graphene::chain::keywords;
+
+namespace {
+
+/**
+ * Shape of the generated bet flow, which can be overridden on the command line, e.g.
+ *    chain_bench --run_test=betting_bench -- --bench-bets=500000 --bench-events=1000 --bench-skew=120
+ */
+struct betting_bench_config
+{
+#ifdef NDEBUG
+   uint32_t events           = 200;
+   uint32_t bettors          = 2000;
+   uint32_t bets             = 200000;
+#else
+   uint32_t events           = 10;
+   uint32_t bettors          = 100;
+   uint32_t bets             = 5000;
+#endif
+   uint32_t bets_per_block   = 500;
+   uint32_t skew             = 100;  ///< zipf exponent of market popularity, in percent
+   uint32_t in_play_percent  = 20;   ///< share of groups taking delayed live bets
+   uint32_t cancel_percent   = 10;   ///< share of bets followed by a cancel of one of the bettor's open bets
+   uint32_t seed             = 1;
+
+   betting_bench_config()
+   {
+      read_bench_option( "--bench-events=",          events );
+      read_bench_option( "--bench-bettors=",         bettors );
+      read_bench_option( "--bench-bets=",            bets );
+      read_bench_option( "--bench-bets-per-block=",  bets_per_block );
+      read_bench_option( "--bench-skew=",            skew );
+      read_bench_option( "--bench-in-play-percent=", in_play_percent );
+      read_bench_option( "--bench-cancel-percent=",  cancel_percent );
+      read_bench_option( "--bench-seed=",            seed );
+   }
+};
+
+/// latencies of one kind of work, in microseconds
+struct latency_samples
+{
+   std::string          name;
+   std::vector<int64_t> samples;
+
+   explicit latency_samples( std::string n ) : name( std::move(n) ) {}
+
+   void add( const fc::time_point& start ) { samples.push_back( (fc::time_point::now() - start).count() ); }
+
+   void report()
+   {
+      if( samples.empty() )
+         return;
+      std::sort( samples.begin(), samples.end() );
+      auto percentile = [this]( double p ) { return samples[ size_t( p * ( samples.size() - 1 ) ) ]; };
+      int64_t total = 0;
+      for( int64_t sample : samples )
+         total += sample;
+      ilog( "${n}: ${c} samples, ${t} ms total, p50 ${p50} us, p90 ${p90} us, p99 ${p99} us, p99.9 ${p999} us, max ${max} us",
+            ("n", name)("c", samples.size())("t", total / 1000)
+            ("p50", percentile(0.5))("p90", percentile(0.9))("p99", percentile(0.99))("p999", percentile(0.999))
+            ("max", samples.back()) );
+   }
+};
+
+struct betting_bench_fixture : database_fixture
+{
+   betting_bench_config                 cfg;
+   quiet_betting_logger                 quiet_logger;
+   std::mt19937                         rng;
+   vector<betting_market_group_id_type> groups;
+   vector<betting_market_id_type>       markets;
+   vector<account_id_type>              bettors;
+   /// bets each bettor placed recently, candidates for cancels
+   vector<vector<bet_id_type>>          open_bets;
+
+   latency_samples                      place_latency{ "bet_place" };
+   latency_samples                      cancel_latency{ "bet_cancel" };
+   latency_samples                      block_latency{ "generate_block" };
+   size_t                               max_undo_entries = 0;
+   uint64_t                             total_undo_entries = 0;
+   uint32_t                             blocks = 0;
+
+   betting_bench_fixture() : rng( cfg.seed ) {}
+
+   void create_markets()
+   {
+      const sport_object& sport = create_sport( {{"en", "Bench Sport"}} );
+      const event_group_id_type event_group_id = create_event_group( {{"en", "Bench League"}}, sport.id ).id;
+      const betting_market_rules_id_type rules_id = create_betting_market_rules( {{"en", "Bench Rules"}}, {{"en", "The team with most points wins."}} ).id;
+      generate_block();
+
+      for( uint32_t i = 0; i < cfg.events; ++i )
+      {
+         const event_id_type event_id = create_event( {{"en", "Bench Home " + fc::to_string(i) + "/Bench Away " + fc::to_string(i)}}, {{"en", "2018"}}, event_group_id ).id;
+         const betting_market_group_id_type group_id = create_betting_market_group( {{"en", "Moneyline " + fc::to_string(i)}}, event_id, rules_id, asset_id_type(), false, 0 ).id;
+         groups.push_back( group_id );
+         markets.push_back( create_betting_market( group_id, {{"en", "Home " + fc::to_string(i) + " wins"}} ).id );
+         markets.push_back( create_betting_market( group_id, {{"en", "Away " + fc::to_string(i) + " wins"}} ).id );
+         if( ( i + 1 ) % 20 == 0 )
+            generate_block();
+      }
+      generate_block();
+
+      for( uint32_t i = 0; i < groups.size(); ++i )
+         if( i % 100 < cfg.in_play_percent )
+            update_betting_market_group( groups[i], _status = betting_market_group_status::in_play );
+      generate_block();
+   }
+
+   void create_bettors()
+   {
+      open_bets.resize( cfg.bettors );
+      for( uint32_t i = 0; i < cfg.bettors; ++i )
+      {
+         set_expiration( db, trx );
+         const account_id_type id = create_account( "benchbettor" + fc::to_string(i) ).id;
+         transfer( account_id_type(), id, asset( 100000000 ) );
+         bettors.push_back( id );
+         if( ( i + 1 ) % 1000 == 0 )
+            generate_block();
+      }
+      generate_block();
+   }
+
+   void place_random_bet( std::discrete_distribution<uint32_t>& market_popularity )
+   {
+      const uint32_t bettor = std::uniform_int_distribution<uint32_t>( 0, bettors.size() - 1 )( rng );
+
+      bet_place_operation op;
+      op.bettor_id = bettors[bettor];
+      op.betting_market_id = markets[ market_popularity( rng ) ];
+      op.back_or_lay = std::uniform_int_distribution<int>( 0, 1 )( rng ) ? bet_type::back : bet_type::lay;
+      op.amount_to_bet = asset( std::uniform_int_distribution<int64_t>( 100, 1000 )( rng ) );
+      // odds on a narrow ladder between 1.50 and 2.00, so most bets find something to match
+      op.backer_multiplier = 15000 + 100 * std::uniform_int_distribution<bet_multiplier_type>( 0, 50 )( rng );
+
+      trx.operations.push_back( op );
+      fc::time_point start = fc::time_point::now();
+      processed_transaction ptx = db.push_transaction( trx, ~0 );
+      place_latency.add( start );
+      trx.operations.clear();
+
+      vector<bet_id_type>& bettor_bets = open_bets[bettor];
+      bettor_bets.push_back( ptx.operation_results.front().get<object_id_type>().as<bet_id_type>() );
+      if( bettor_bets.size() > 16 )
+         bettor_bets.erase( bettor_bets.begin() );
+
+      if( std::uniform_int_distribution<uint32_t>( 0, 99 )( rng ) >= cfg.cancel_percent )
+         return;
+
+      // cancel one of the bettor's bets that is still on the books or waiting out its delay
+      const bet_id_type bet_id = bettor_bets[ std::uniform_int_distribution<size_t>( 0, bettor_bets.size() - 1 )( rng ) ];
+      if( !db.find( bet_id ) )
+         return;
+
+      bet_cancel_operation cancel;
+      cancel.bettor_id = bettors[bettor];
+      cancel.bet_to_cancel = bet_id;
+      trx.operations.push_back( cancel );
+      start = fc::time_point::now();
+      db.push_transaction( trx, ~0 );
+      cancel_latency.add( start );
+      trx.operations.clear();
+   }
+
+   void bench_block()
+   {
+      // everything pushed since the last block is in the pending undo session
+      if( db._undo_db.size() > 0 )
+      {
+         const undo_state& state = db._undo_db.head();
+         const size_t entries = state.old_values.size() + state.new_ids.size() + state.removed.size();
+         max_undo_entries = std::max( max_undo_entries, entries );
+         total_undo_entries += entries;
+      }
+      const fc::time_point start = fc::time_point::now();
+      generate_block();
+      block_latency.add( start );
+      ++blocks;
+      set_expiration( db, trx );
+   }
+
+   void report_index_sizes()
+   {
+      const auto& delayed_bets = db.get_index_type<primary_index<bet_object_index>>().get_secondary_index<delayed_bet_index>();
+      ilog( "index sizes: ${b} bets, ${d} markets with delayed bets, ${p} positions, ${a} account balances, ${o} operation history objects",
+            ("b", db.get_index_type<bet_object_index>().indices().size())
+            ("d", delayed_bets.get_markets_by_next_delay().size())
+            ("p", db.get_index_type<betting_market_position_index>().indices().size())
+            ("a", db.get_index_type<account_balance_index>().indices().size())
+            ("o", db.get_index_type<operation_history_index>().indices().size()) );
+   }
+};
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_CASE( betting_bench, betting_bench_fixture )
+{
+   try {
+      ilog( "Betting benchmark: ${b} bets by ${n} bettors over ${e} events, skew ${s}%, ${i}% in play, ${c}% cancels, ${p} bets per block",
+            ("b", cfg.bets)("n", cfg.bettors)("e", cfg.events)("s", cfg.skew)
+            ("i", cfg.in_play_percent)("c", cfg.cancel_percent)("p", cfg.bets_per_block) );
+
+      fc::time_point start_time = fc::time_point::now();
+      create_markets();
+      create_bettors();
+      ilog( "Built markets and bettors in ${t} milliseconds.", ("t", (fc::time_point::now() - start_time).count() / 1000) );
+
+      // a few markets get most of the action, like the big games of the day do
+      vector<double> weights;
+      for( uint32_t i = 0; i < markets.size(); ++i )
+         weights.push_back( 1.0 / std::pow( double( i / 2 + 1 ), cfg.skew / 100.0 ) );
+      std::shuffle( weights.begin(), weights.end(), rng );
+      std::discrete_distribution<uint32_t> market_popularity( weights.begin(), weights.end() );
+
+      set_expiration( db, trx );
+      start_time = fc::time_point::now();
+      for( uint32_t i = 0; i < cfg.bets; ++i )
+      {
+         place_random_bet( market_popularity );
+         if( ( i + 1 ) % cfg.bets_per_block == 0 )
+            bench_block();
+      }
+      bench_block();
+      const int64_t elapsed = (fc::time_point::now() - start_time).count();
+      ilog( "Pushed ${b} bets in ${t} milliseconds, ${r} bets/sec including block production.",
+            ("b", cfg.bets)("t", elapsed / 1000)("r", uint64_t( cfg.bets ) * 1000000 / std::max<int64_t>( elapsed, 1 )) );
+
+      place_latency.report();
+      cancel_latency.report();
+      block_latency.report();
+      ilog( "undo sessions: ${m} entries at most, ${a} on average per block",
+            ("m", max_undo_entries)("a", total_undo_entries / std::max<uint32_t>( blocks, 1 )) );
+      report_index_sizes();
+
+      for( betting_market_group_id_type group_id : groups )
+         update_betting_market_group( group_id, _status = betting_market_group_status::closed );
+      generate_block();
+      for( betting_market_group_id_type group_id : groups )
+      {
+         const betting_market_group_object& group = group_id(db);
+         std::map<betting_market_id_type, betting_market_resolution_type> resolutions;
+         for( const betting_market_object& market : boost::make_iterator_range(
+                 db.get_index_type<betting_market_object_index>().indices().get<by_betting_market_group_id>().equal_range( group.id ) ) )
+            resolutions[market.id] = resolutions.empty() ? betting_market_resolution_type::win : betting_market_resolution_type::not_win;
+         resolve_betting_market_group( group_id, resolutions );
+      }
+
+      // the groups have no settling delay, so the next block settles them
+      start_time = fc::time_point::now();
+      generate_block();
+      ilog( "Settled ${g} groups in ${t} milliseconds.",
+            ("g", groups.size())("t", (fc::time_point::now() - start_time).count() / 1000) );
+      BOOST_CHECK_EQUAL( db.get_index_type<betting_market_position_index>().indices().size(), 0u );
+      report_index_sizes();
+   } catch( fc::exception& e ) {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
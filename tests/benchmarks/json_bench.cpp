@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2018 Peerplays Blockchain Standards Association, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/app/database_api.hpp>
+#include <graphene/elasticsearch/json_writer.hpp>
+
+#include <fc/io/json.hpp>
+
+#include "../common/database_fixture.hpp"
+#include "../common/bench_options.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+
+/**
+ * Size of the documents encoded, which can be overridden on the command line, e.g.
+ *    chain_bench --run_test=json_bench -- --bench-json-transfers=2000 --bench-json-iterations=1000
+ */
+struct json_bench_config
+{
+#ifdef NDEBUG
+   uint32_t transfers         = 1000;   ///< transfers in the encoded block
+   uint32_t iterations        = 1000;
+#else
+   uint32_t transfers         = 100;
+   uint32_t iterations        = 50;
+#endif
+
+   json_bench_config()
+   {
+      read_bench_option( "--bench-json-transfers=",   transfers );
+      read_bench_option( "--bench-json-iterations=",  iterations );
+   }
+};
+
+/// encodes @ref value through a variant and with the reflection writer, and checks both give the same text
+template<typename T>
+void bench_encoding( const std::string& name, const T& value, uint32_t iterations )
+{
+   std::string via_variant;
+   fc::time_point start = fc::time_point::now();
+   for( uint32_t i = 0; i < iterations; ++i )
+      via_variant = fc::json::to_string( fc::variant( value, GRAPHENE_MAX_NESTED_OBJECTS ) );
+   const int64_t variant_time = (fc::time_point::now() - start).count();
+
+   std::string direct;
+   start = fc::time_point::now();
+   for( uint32_t i = 0; i < iterations; ++i )
+      direct = graphene::elasticsearch::to_json( value );
+   const int64_t direct_time = (fc::time_point::now() - start).count();
+
+   ilog( "${n} (${s} bytes): ${v} us through a variant, ${d} us with json_writer per encoding",
+         ("n", name)("s", direct.size())
+         ("v", variant_time / std::max<uint32_t>( iterations, 1 ))("d", direct_time / std::max<uint32_t>( iterations, 1 )) );
+   BOOST_CHECK_EQUAL( direct, via_variant );
+}
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_CASE( json_bench, database_fixture )
+{
+   try {
+      json_bench_config cfg;
+      ilog( "JSON benchmark: a block of ${t} transfers, ${i} iterations", ("t", cfg.transfers)("i", cfg.iterations) );
+
+      ACTORS( (alice)(bob) );
+      transfer( account_id_type(), alice_id, asset( 100000000 ) );
+      generate_block();
+
+      set_expiration( db, trx );
+      for( uint32_t i = 0; i < cfg.transfers; ++i )
+      {
+         transfer_operation op;
+         op.from = alice_id;
+         op.to = bob_id;
+         op.amount = asset( i + 1 );
+         trx.operations.push_back( op );
+         db.push_transaction( trx, ~0 );
+         trx.operations.clear();
+      }
+      const signed_block block = generate_block();
+
+      bench_encoding( "signed_block", block, cfg.iterations );
+      bench_encoding( "account_object", alice, cfg.iterations );
+      bench_encoding( "dynamic_global_property_object", db.get_dynamic_global_properties(), cfg.iterations );
+
+      graphene::app::database_api db_api( db );
+      auto accounts = db_api.get_full_accounts( { "alice" }, false );
+      BOOST_REQUIRE_EQUAL( accounts.size(), 1u );
+      bench_encoding( "full_account", accounts.begin()->second, cfg.iterations );
+   } catch( fc::exception& e ) {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
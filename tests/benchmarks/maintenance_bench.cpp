@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/son_object.hpp>
+#include <graphene/chain/vesting_balance_object.hpp>
+#include <graphene/chain/witness_object.hpp>
+
+#include "../common/database_fixture.hpp"
+#include "../common/bench_options.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+// Count the heap allocations made while maintenance is benchmarked, so its
+// phases can be reported by the number of allocations as well as by time.
+// The replacement covers the whole chain_bench binary, the other benchmarks
+// run with counting off and only pay for the flag check.
+static std::atomic<bool> bench_count_allocations(false);
+static std::atomic<uint64_t> bench_allocation_count(0);
+
+void* operator new( std::size_t size )
+{
+   if( bench_count_allocations.load( std::memory_order_relaxed ) )
+      ++bench_allocation_count;
+   if( void* p = std::malloc( size ? size : 1 ) )
+      return p;
+   throw std::bad_alloc();
+}
+
+void operator delete( void* p ) noexcept
+{
+   std::free( p );
+}
+
+namespace {
+
+/**
+ * Sizes of the synthetic chain state, which can be overridden on the command line, e.g.
+ *    chain_bench --run_test=maintenance_bench -- --bench-accounts=100000 --bench-sons=50
+ */
+struct maintenance_bench_config
+{
+#ifdef NDEBUG
+   uint32_t accounts           = 200000;
+#else
+   uint32_t accounts           = 5000;
+#endif
+   uint32_t proxy_percent      = 20;  ///< share of accounts voting through a proxy
+   uint32_t vesting_percent    = 60;  ///< share of accounts holding a GPOS vesting balance
+   uint32_t dividend_assets    = 3;
+   uint32_t dividend_holders   = 10;  ///< percent of accounts holding each dividend asset
+   uint32_t sons               = 15;
+   uint32_t maintenances       = 3;
+
+   maintenance_bench_config()
+   {
+      read_bench_option( "--bench-accounts=",         accounts );
+      read_bench_option( "--bench-proxy-percent=",    proxy_percent );
+      read_bench_option( "--bench-vesting-percent=",  vesting_percent );
+      read_bench_option( "--bench-dividend-assets=",  dividend_assets );
+      read_bench_option( "--bench-dividend-holders=", dividend_holders );
+      read_bench_option( "--bench-sons=",             sons );
+      read_bench_option( "--bench-maintenances=",     maintenances );
+   }
+};
+
+struct maintenance_bench_fixture : database_fixture
+{
+   maintenance_bench_config cfg;
+   vector<vote_id_type>     witness_votes;
+   vector<vote_id_type>     son_votes;
+   vector<account_id_type>  bench_accounts;
+   vector<asset_id_type>    bench_dividend_assets;
+
+   void push_op( const operation& op )
+   {
+      trx.operations.push_back( op );
+      set_expiration( db, trx );
+      db.push_transaction( trx, ~0 );
+      trx.clear();
+   }
+
+   object_id_type push_op_result( const operation& op )
+   {
+      trx.operations.push_back( op );
+      set_expiration( db, trx );
+      processed_transaction ptx = db.push_transaction( trx, ~0 );
+      trx.clear();
+      return ptx.operation_results[0].get<object_id_type>();
+   }
+
+   vesting_balance_id_type create_vesting( account_id_type owner, share_type amount, vesting_balance_type type )
+   {
+      vesting_balance_create_operation op;
+      op.creator = owner;
+      op.owner = owner;
+      op.amount = asset( amount );
+      op.balance_type = type;
+      if( type == vesting_balance_type::son )
+         op.policy = dormant_vesting_policy_initializer{};
+      return push_op_result( op );
+   }
+
+   void create_sons()
+   {
+      for( uint32_t i = 0; i < cfg.sons; ++i )
+      {
+         const account_object& owner = create_account( "benchson" + fc::to_string(i) );
+         upgrade_to_lifetime_member( owner );
+         transfer( committee_account, owner.id, asset( 1000 * GRAPHENE_BLOCKCHAIN_PRECISION ) );
+
+         son_create_operation op;
+         op.owner_account = owner.id;
+         op.url = "https://son" + fc::to_string(i);
+         op.deposit = create_vesting( owner.id, 50 * GRAPHENE_BLOCKCHAIN_PRECISION, vesting_balance_type::son );
+         op.pay_vb = create_vesting( owner.id, GRAPHENE_BLOCKCHAIN_PRECISION, vesting_balance_type::normal );
+         op.signing_key = init_account_pub_key;
+         op.sidechain_public_keys[sidechain_type::bitcoin] = "bitcoin address " + fc::to_string(i);
+         push_op( op );
+      }
+      generate_block();
+
+      for( const son_object& son : db.get_index_type<son_index>().indices() )
+         son_votes.push_back( son.vote_id );
+   }
+
+   void create_dividend_assets()
+   {
+      for( uint32_t i = 0; i < cfg.dividend_assets; ++i )
+      {
+         asset_create_operation creator;
+         creator.issuer = account_id_type();
+         creator.symbol = "BENCHDIV" + std::string( 1, char('A' + i % 26) ) + std::string( 1, char('A' + i / 26) );
+         creator.common_options.max_supply = GRAPHENE_MAX_SHARE_SUPPLY;
+         creator.precision = 2;
+         creator.common_options.issuer_permissions = UIA_ASSET_ISSUER_PERMISSION_MASK;
+         creator.common_options.core_exchange_rate = price( { asset(2), asset(1, asset_id_type(1)) } );
+         const asset_id_type id = push_op_result( creator );
+
+         asset_update_dividend_operation op;
+         op.issuer = account_id_type();
+         op.asset_to_update = id;
+         op.new_options.next_payout_time = db.head_block_time() + fc::minutes(1);
+         op.new_options.payout_interval = 60 * 60 * 24;
+         push_op( op );
+
+         bench_dividend_assets.push_back( id );
+      }
+      generate_block();
+   }
+
+   void create_accounts()
+   {
+      const uint32_t max_witness_votes = std::min<uint32_t>( witness_votes.size(), 5 );
+      const uint32_t max_son_votes = std::min<uint32_t>( son_votes.size(), 5 );
+      bench_accounts.reserve( cfg.accounts );
+
+      for( uint32_t i = 0; i < cfg.accounts; ++i )
+      {
+         account_create_operation op = make_account( "benchacct" + fc::to_string(i), init_account_pub_key );
+         if( i > 0 && (i % 100) < cfg.proxy_percent )
+         {
+            // proxy to a deterministic earlier account, the proxy's opinions are the ones that count
+            op.options.voting_account = bench_accounts[ (i * 7919) % i ];
+         }
+         else
+         {
+            op.options.num_witness = i % (max_witness_votes + 1);
+            for( uint32_t v = 0; v < op.options.num_witness; ++v )
+               op.options.votes.insert( witness_votes[ (i + v) % witness_votes.size() ] );
+            op.options.num_son = max_son_votes ? i % (max_son_votes + 1) : 0;
+            for( uint32_t v = 0; v < op.options.num_son; ++v )
+               op.options.votes.insert( son_votes[ (i + v) % son_votes.size() ] );
+         }
+         const account_id_type id = push_op_result( op );
+         bench_accounts.push_back( id );
+
+         transfer( committee_account, id, asset( 100 * GRAPHENE_BLOCKCHAIN_PRECISION ) );
+         if( (i % 100) < cfg.vesting_percent )
+            create_vesting( id, 10 * GRAPHENE_BLOCKCHAIN_PRECISION + i % 1000, vesting_balance_type::gpos );
+
+         for( uint32_t a = 0; a < bench_dividend_assets.size(); ++a )
+         {
+            if( ((i + a * 37) % 100) >= cfg.dividend_holders )
+               continue;
+            asset_issue_operation issue;
+            issue.issuer = account_id_type();
+            issue.asset_to_issue = asset( 1000 + i % 5000, bench_dividend_assets[a] );
+            issue.issue_to_account = id;
+            push_op( issue );
+         }
+
+         // keep the undo history and the pending state small while building
+         if( (i + 1) % 1000 == 0 )
+            generate_block();
+      }
+      generate_block();
+   }
+
+   /// Give every dividend distribution account something to pay out at the next maintenance
+   void fund_dividends()
+   {
+      for( asset_id_type id : bench_dividend_assets )
+      {
+         const asset_dividend_data_object& data = (*id(db).dividend_data_id)(db);
+         transfer( committee_account, data.dividend_distribution_account, asset( 1000000 * GRAPHENE_BLOCKCHAIN_PRECISION ) );
+      }
+   }
+};
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_CASE( maintenance_bench, maintenance_bench_fixture )
+{
+   try {
+      ilog( "Maintenance benchmark: ${a} accounts, ${p}% proxied, ${v}% vesting, ${d} dividend assets held by ${h}%, ${s} SONs",
+            ("a", cfg.accounts)("p", cfg.proxy_percent)("v", cfg.vesting_percent)
+            ("d", cfg.dividend_assets)("h", cfg.dividend_holders)("s", cfg.sons) );
+
+      generate_blocks( HARDFORK_SON_TIME );
+      generate_block();
+      set_expiration( db, trx );
+
+      for( const witness_id_type& wid : db.get_global_properties().active_witnesses )
+         witness_votes.push_back( wid(db).vote_id );
+
+      fc::time_point start_time = fc::time_point::now();
+      create_sons();
+      create_dividend_assets();
+      create_accounts();
+      fund_dividends();
+      ilog( "Built synthetic state in ${t} milliseconds.", ("t", (fc::time_point::now() - start_time).count() / 1000) );
+
+      bench_count_allocations = true;
+      db.set_maintenance_probe( []() -> uint64_t { return bench_allocation_count.load(); } );
+
+      for( uint32_t m = 0; m < cfg.maintenances; ++m )
+      {
+         generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+
+         const auto& stats = db.get_last_maintenance_stats();
+         BOOST_REQUIRE( !stats.empty() );
+         fc::microseconds total;
+         uint64_t total_allocations = 0;
+         for( const auto& phase : stats )
+         {
+            ilog( "maintenance ${m} ${p}: ${t} us, ${a} allocations",
+                  ("m", m)("p", phase.name)("t", phase.elapsed.count())("a", phase.probe_delta) );
+            total += phase.elapsed;
+            total_allocations += phase.probe_delta;
+         }
+         ilog( "maintenance ${m} total: ${t} us, ${a} allocations",
+               ("m", m)("t", total.count())("a", total_allocations) );
+      }
+
+      db.set_maintenance_probe( std::function<uint64_t()>() );
+      bench_count_allocations = false;
+   } catch( fc::exception& e ) {
+      bench_count_allocations = false;
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2018 Peerplays Blockchain Standards Association, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/market_object.hpp>
+
+#include "../common/database_fixture.hpp"
+#include "../common/bench_options.hpp"
+
+#include <algorithm>
+#include <random>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+
+/**
+ * Shape of the generated order flow, which can be overridden on the command line, e.g.
+ *    chain_bench --run_test=market_bench -- --bench-borrowers=5000 --bench-depth=20000 --bench-orders=100000
+ */
+struct market_bench_config
+{
+#ifdef NDEBUG
+   uint32_t borrowers         = 2000;
+   uint32_t depth             = 10000;  ///< resting orders selling the MIA before the timed run
+   uint32_t orders            = 50000;
+#else
+   uint32_t borrowers         = 100;
+   uint32_t depth             = 500;
+   uint32_t orders            = 2000;
+#endif
+   uint32_t orders_per_block  = 500;
+   uint32_t take_percent      = 5;      ///< share of timed orders buying the MIA at the front of the book
+   uint32_t seed              = 1;
+
+   market_bench_config()
+   {
+      read_bench_option( "--bench-borrowers=",         borrowers );
+      read_bench_option( "--bench-depth=",             depth );
+      read_bench_option( "--bench-orders=",            orders );
+      read_bench_option( "--bench-orders-per-block=",  orders_per_block );
+      read_bench_option( "--bench-take-percent=",      take_percent );
+      read_bench_option( "--bench-seed=",              seed );
+   }
+};
+
+/// latencies of one kind of work, in microseconds
+struct latency_samples
+{
+   std::string          name;
+   std::vector<int64_t> samples;
+
+   explicit latency_samples( std::string n ) : name( std::move(n) ) {}
+
+   void add( const fc::time_point& start ) { samples.push_back( (fc::time_point::now() - start).count() ); }
+
+   void report()
+   {
+      if( samples.empty() )
+         return;
+      std::sort( samples.begin(), samples.end() );
+      auto percentile = [this]( double p ) { return samples[ size_t( p * ( samples.size() - 1 ) ) ]; };
+      int64_t total = 0;
+      for( int64_t sample : samples )
+         total += sample;
+      ilog( "${n}: ${c} samples, ${t} ms total, p50 ${p50} us, p90 ${p90} us, p99 ${p99} us, max ${max} us",
+            ("n", name)("c", samples.size())("t", total / 1000)
+            ("p50", percentile(0.5))("p90", percentile(0.9))("p99", percentile(0.99))("max", samples.back()) );
+   }
+};
+
+struct market_bench_fixture : database_fixture
+{
+   market_bench_config        cfg;
+   std::mt19937               rng;
+   asset_id_type              usd_id;
+   vector<account_id_type>    borrowers;
+
+   latency_samples            maker_latency{ "limit_order_create (resting)" };
+   latency_samples            taker_latency{ "limit_order_create (taking)" };
+   latency_samples            block_latency{ "generate_block" };
+
+   market_bench_fixture() : rng( cfg.seed ) {}
+
+   /// a market issued asset backed by core, with one call order per borrower at 2x to 4x collateral
+   void create_market()
+   {
+      ACTOR( feedproducer );
+      usd_id = create_bitasset( "USDBIT", feedproducer_id ).id;
+      update_feed_producers( usd_id, { feedproducer_id } );
+      price_feed feed;
+      feed.settlement_price = asset( 100, usd_id ) / asset( 100 );
+      publish_feed( usd_id, feedproducer_id, feed );
+      generate_block();
+
+      for( uint32_t i = 0; i < cfg.borrowers; ++i )
+      {
+         set_expiration( db, trx );
+         const account_object& borrower = create_account( "benchborrower" + fc::to_string(i) );
+         transfer( account_id_type(), borrower.id, asset( 100000000 ) );
+         borrow( borrower, asset( 1000000, usd_id ), asset( 2000000 + 2000000 * i / cfg.borrowers ) );
+         borrowers.push_back( borrower.id );
+         if( ( i + 1 ) % 500 == 0 )
+            generate_block();
+      }
+      generate_block();
+   }
+
+   void push_order( account_id_type seller, const asset& amount, const asset& recv, latency_samples& latency )
+   {
+      limit_order_create_operation op;
+      op.seller = seller;
+      op.amount_to_sell = amount;
+      op.min_to_receive = recv;
+      trx.operations.push_back( op );
+      const fc::time_point start = fc::time_point::now();
+      db.push_transaction( trx, ~0 );
+      latency.add( start );
+      trx.operations.clear();
+   }
+
+   /// sells the MIA for 1.2 to 3 times the feed price, far from anything that could margin call
+   void place_resting_order()
+   {
+      const account_id_type seller = borrowers[ std::uniform_int_distribution<size_t>( 0, borrowers.size() - 1 )( rng ) ];
+      const int64_t amount = std::uniform_int_distribution<int64_t>( 100, 1000 )( rng );
+      const int64_t premium = std::uniform_int_distribution<int64_t>( 120, 300 )( rng );
+      push_order( seller, asset( amount, usd_id ), asset( amount * premium / 100 ), maker_latency );
+   }
+
+   /// buys the MIA at up to 1.2 times the feed price, which fills the front of the book
+   void place_taking_order()
+   {
+      const account_id_type buyer = borrowers[ std::uniform_int_distribution<size_t>( 0, borrowers.size() - 1 )( rng ) ];
+      const int64_t amount = std::uniform_int_distribution<int64_t>( 100, 1000 )( rng );
+      push_order( buyer, asset( amount * 12 / 10 ), asset( amount, usd_id ), taker_latency );
+   }
+
+   void bench_block()
+   {
+      const fc::time_point start = fc::time_point::now();
+      generate_block();
+      block_latency.add( start );
+      set_expiration( db, trx );
+   }
+};
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_CASE( market_bench, market_bench_fixture )
+{
+   try {
+      ilog( "Market benchmark: ${o} orders against a book ${d} deep with ${b} call orders, ${t}% taking, ${p} orders per block",
+            ("o", cfg.orders)("d", cfg.depth)("b", cfg.borrowers)("t", cfg.take_percent)("p", cfg.orders_per_block) );
+
+      fc::time_point start_time = fc::time_point::now();
+      create_market();
+      set_expiration( db, trx );
+      latency_samples depth_latency{ "limit_order_create (building the book)" };
+      for( uint32_t i = 0; i < cfg.depth; ++i )
+      {
+         place_resting_order();
+         if( ( i + 1 ) % cfg.orders_per_block == 0 )
+            bench_block();
+      }
+      bench_block();
+      std::swap( depth_latency.samples, maker_latency.samples );
+      ilog( "Built the book in ${t} milliseconds.", ("t", (fc::time_point::now() - start_time).count() / 1000) );
+      depth_latency.report();
+
+      start_time = fc::time_point::now();
+      for( uint32_t i = 0; i < cfg.orders; ++i )
+      {
+         if( std::uniform_int_distribution<uint32_t>( 0, 99 )( rng ) < cfg.take_percent )
+            place_taking_order();
+         else
+            place_resting_order();
+         if( ( i + 1 ) % cfg.orders_per_block == 0 )
+            bench_block();
+      }
+      bench_block();
+      const int64_t elapsed = (fc::time_point::now() - start_time).count();
+      ilog( "Pushed ${o} orders in ${t} milliseconds, ${r} orders/sec including block production.",
+            ("o", cfg.orders)("t", elapsed / 1000)("r", uint64_t( cfg.orders ) * 1000000 / std::max<int64_t>( elapsed, 1 )) );
+
+      maker_latency.report();
+      taker_latency.report();
+      block_latency.report();
+      ilog( "index sizes: ${l} limit orders, ${c} call orders",
+            ("l", db.get_index_type<limit_order_index>().indices().size())
+            ("c", db.get_index_type<call_order_index>().indices().size()) );
+      BOOST_CHECK_EQUAL( db.get_index_type<call_order_index>().indices().size(), cfg.borrowers );
+   } catch( fc::exception& e ) {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
@@ -46,6 +46,8 @@
 #include <graphene/chain/proposal_object.hpp>
 
 #include <graphene/bookie/bookie_api.hpp>
+#include <graphene/bookie/bet_history_store.hpp>
+#include <graphene/bookie/bookie_objects.hpp>
 
 struct enable_betting_logging_config {
    enable_betting_logging_config()
@@ -415,6 +417,124 @@ BOOST_AUTO_TEST_CASE(binned_order_books)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(bet_order_book_levels)
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      CREATE_ICE_HOCKEY_BETTING_MARKET(false, 0);
+
+      const auto& order_book_idx = db.get_index_type<primary_index<bet_object_index>>().get_secondary_index<bet_order_book_index>();
+
+      transfer(account_id_type(), alice_id, asset(10000));
+      transfer(account_id_type(), bob_id, asset(10000));
+
+      BOOST_CHECK(order_book_idx.get_book(capitals_win_market.id) == nullptr);
+
+      // two back bets at 1.6 share a level, the one at 1.7 gets its own
+      place_bet(bob_id, capitals_win_market.id, bet_type::back, asset(100, asset_id_type()), 16 * GRAPHENE_BETTING_ODDS_PRECISION / 10);
+      place_bet(bob_id, capitals_win_market.id, bet_type::back, asset(200, asset_id_type()), 16 * GRAPHENE_BETTING_ODDS_PRECISION / 10);
+      place_bet(bob_id, capitals_win_market.id, bet_type::back, asset(100, asset_id_type()), 17 * GRAPHENE_BETTING_ODDS_PRECISION / 10);
+      // lay bets at 1.5 and 1.4 don't cross the backs
+      place_bet(alice_id, capitals_win_market.id, bet_type::lay, asset(50, asset_id_type()), 15 * GRAPHENE_BETTING_ODDS_PRECISION / 10);
+      place_bet(alice_id, capitals_win_market.id, bet_type::lay, asset(40, asset_id_type()), 14 * GRAPHENE_BETTING_ODDS_PRECISION / 10);
+
+      const betting_market_book* book = order_book_idx.get_book(capitals_win_market.id);
+      BOOST_REQUIRE(book != nullptr);
+      BOOST_REQUIRE_EQUAL(book->back_levels.size(), 2u);
+      BOOST_REQUIRE_EQUAL(book->lay_levels.size(), 2u);
+
+      auto back_level = book->back_levels.begin();
+      BOOST_CHECK_EQUAL(back_level->first, 16 * GRAPHENE_BETTING_ODDS_PRECISION / 10);
+      BOOST_CHECK_EQUAL(back_level->second.total_amount_to_bet.value, 300);
+      BOOST_CHECK_EQUAL(back_level->second.bets.size(), 2u);
+      ++back_level;
+      BOOST_CHECK_EQUAL(back_level->first, 17 * GRAPHENE_BETTING_ODDS_PRECISION / 10);
+      BOOST_CHECK_EQUAL(back_level->second.total_amount_to_bet.value, 100);
+
+      auto lay_level = book->lay_levels.begin();
+      BOOST_CHECK_EQUAL(lay_level->first, 15 * GRAPHENE_BETTING_ODDS_PRECISION / 10);
+      BOOST_CHECK_EQUAL(lay_level->second.total_amount_to_bet.value, 50);
+      ++lay_level;
+      BOOST_CHECK_EQUAL(lay_level->first, 14 * GRAPHENE_BETTING_ODDS_PRECISION / 10);
+      BOOST_CHECK_EQUAL(lay_level->second.total_amount_to_bet.value, 40);
+
+      // every level must agree with the bets left in the by_odds index after a partial match
+      place_bet(alice_id, capitals_win_market.id, bet_type::lay, asset(60, asset_id_type()), 16 * GRAPHENE_BETTING_ODDS_PRECISION / 10);
+
+      const auto& bet_odds_idx = db.get_index_type<bet_object_index>().indices().get<by_odds>();
+      std::map<std::pair<bet_type, bet_multiplier_type>, share_type> expected;
+      for (auto itr = bet_odds_idx.lower_bound(std::make_tuple(capitals_win_market.id));
+           itr != bet_odds_idx.end() && itr->betting_market_id == capitals_win_market.id; ++itr)
+         expected[std::make_pair(itr->back_or_lay, itr->backer_multiplier)] += itr->amount_to_bet.amount;
+
+      book = order_book_idx.get_book(capitals_win_market.id);
+      BOOST_REQUIRE(book != nullptr);
+      BOOST_CHECK_EQUAL(book->back_levels.size() + book->lay_levels.size(), expected.size());
+      for (const auto& level : book->back_levels)
+         BOOST_CHECK_EQUAL(level.second.total_amount_to_bet.value, expected[std::make_pair(bet_type::back, level.first)].value);
+      for (const auto& level : book->lay_levels)
+         BOOST_CHECK_EQUAL(level.second.total_amount_to_bet.value, expected[std::make_pair(bet_type::lay, level.first)].value);
+
+      // canceling everything empties the book
+      cancel_unmatched_bets(moneyline_betting_markets.id);
+      BOOST_CHECK(order_book_idx.get_book(capitals_win_market.id) == nullptr);
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE(events_containing_sub_string)
+{
+   try
+   {
+      CREATE_ICE_HOCKEY_BETTING_MARKET(false, 0);
+      create_event({{"en", "Chicago Blackhawks/Boston Bruins"}}, {{"en", "2016-17"}}, nhl.id);
+      generate_blocks(1);
+      const event_object& blackhawks_vs_bruins = *db.get_index_type<event_object_index>().indices().get<by_id>().rbegin();
+
+      graphene::bookie::bookie_api bookie_api(app);
+
+      // trigram lookups are case insensitive
+      std::vector<event_object> events = bookie_api.get_events_containing_sub_string("BLACKHAWKS", "en");
+      BOOST_REQUIRE_EQUAL(events.size(), 2u);
+      BOOST_CHECK(events[0].id == capitals_vs_blackhawks.id);
+      BOOST_CHECK(events[1].id == blackhawks_vs_bruins.id);
+      BOOST_CHECK_EQUAL(bookie_api.get_events_containing_sub_string("capitals", "en").size(), 1u);
+      // every trigram of "hawks bruins" is indexed, but not next to each other
+      BOOST_CHECK(bookie_api.get_events_containing_sub_string("hawksbruins", "en").empty());
+      // sub strings shorter than a trigram still match
+      BOOST_CHECK_EQUAL(bookie_api.get_events_containing_sub_string("/", "en").size(), 2u);
+      BOOST_CHECK(bookie_api.get_events_containing_sub_string("capitals", "fr").empty());
+
+      // paging
+      events = bookie_api.list_events_containing_sub_string("blackhawks", "en", event_id_type(), 1);
+      BOOST_REQUIRE_EQUAL(events.size(), 1u);
+      BOOST_CHECK(events[0].id == capitals_vs_blackhawks.id);
+      events = bookie_api.list_events_containing_sub_string("blackhawks", "en", event_id_type(events[0].id.instance() + 1), 1);
+      BOOST_REQUIRE_EQUAL(events.size(), 1u);
+      BOOST_CHECK(events[0].id == blackhawks_vs_bruins.id);
+      BOOST_CHECK_THROW(bookie_api.list_events_containing_sub_string("blackhawks", "en", event_id_type(), 101), fc::exception);
+
+      // renaming an event replaces its indexed name
+      update_event(blackhawks_vs_bruins.id, _name = internationalized_string_type({{"en", "Chicago Blackhawks/Montreal Canadiens"}}));
+      generate_blocks(1);
+      BOOST_CHECK(bookie_api.get_events_containing_sub_string("bruins", "en").empty());
+      BOOST_CHECK_EQUAL(bookie_api.get_events_containing_sub_string("canadiens", "en").size(), 1u);
+
+      // a removed event does not take a place in the page
+      const event_id_type removed_event_id = capitals_vs_blackhawks.id;
+      const event_id_type remaining_event_id = blackhawks_vs_bruins.id;
+      update_event(removed_event_id, _status = event_status::canceled);
+      generate_blocks(1);
+      BOOST_REQUIRE(db.find(removed_event_id) == nullptr);
+      events = bookie_api.list_events_containing_sub_string("blackhawks", "en", event_id_type(), 1);
+      BOOST_REQUIRE_EQUAL(events.size(), 1u);
+      BOOST_CHECK(events[0].id == remaining_event_id);
+      events = bookie_api.list_events_containing_sub_string("b", "en", event_id_type(), 1);
+      BOOST_REQUIRE_EQUAL(events.size(), 1u);
+      BOOST_CHECK(events[0].id == remaining_event_id);
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( peerplays_sport_create_test )
 {
    try
@@ -1033,6 +1153,247 @@ BOOST_AUTO_TEST_CASE(persistent_objects_test)
    FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(betting_market_group_statistics_test)
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      CREATE_ICE_HOCKEY_BETTING_MARKET(false, 0);
+
+      graphene::bookie::bookie_api bookie_api(app);
+
+      transfer(account_id_type(), alice_id, asset(10000000));
+      transfer(account_id_type(), bob_id, asset(10000000));
+
+      // lay 47 at 1.94 odds (50:47), matched exactly by a back of 50
+      place_bet(alice_id, capitals_win_market.id, bet_type::lay, asset(47, asset_id_type()), 194 * GRAPHENE_BETTING_ODDS_PRECISION / 100);
+      place_bet(bob_id, capitals_win_market.id, bet_type::back, asset(50, asset_id_type()), 194 * GRAPHENE_BETTING_ODDS_PRECISION / 100);
+      // and a back that stays on the books
+      place_bet(bob_id, capitals_win_market.id, bet_type::back, asset(100, asset_id_type()), 15 * GRAPHENE_BETTING_ODDS_PRECISION / 10);
+      generate_blocks(1);
+
+      graphene::bookie::betting_market_group_statistics statistics = bookie_api.get_betting_market_group_statistics(moneyline_betting_markets.id);
+      BOOST_CHECK(statistics.total_matched_bets_amount == 97);
+      BOOST_CHECK(statistics.open_interest == 97);
+      BOOST_CHECK(statistics.unmatched_back_amount == 100);
+      BOOST_CHECK(statistics.unmatched_lay_amount == 0);
+      BOOST_CHECK(bookie_api.get_total_matched_bet_amount_for_betting_market_group(moneyline_betting_markets.id) == asset(97, asset_id_type()));
+
+      BOOST_REQUIRE_EQUAL(statistics.betting_markets.size(), 2u);
+      BOOST_CHECK(statistics.betting_markets[0].betting_market_id == capitals_win_market.id);
+      BOOST_CHECK(statistics.betting_markets[0].total_matched_bets_amount == 97);
+      BOOST_CHECK(statistics.betting_markets[0].open_interest == 97);
+      BOOST_CHECK(statistics.betting_markets[0].unmatched_back_amount == 100);
+      BOOST_CHECK(statistics.betting_markets[1].betting_market_id == blackhawks_win_market.id);
+      BOOST_CHECK(statistics.betting_markets[1].total_matched_bets_amount == 0);
+      BOOST_CHECK(statistics.betting_markets[1].open_interest == 0);
+
+      // canceling the unmatched bet only takes it off the books
+      cancel_unmatched_bets(moneyline_betting_markets.id);
+      generate_blocks(1);
+      statistics = bookie_api.get_betting_market_group_statistics(moneyline_betting_markets.id);
+      BOOST_CHECK(statistics.total_matched_bets_amount == 97);
+      BOOST_CHECK(statistics.open_interest == 97);
+      BOOST_CHECK(statistics.unmatched_back_amount == 0);
+
+      // the totals are undone along with the matches
+      db.pop_block();
+      db.pop_block();
+      db.clear_pending();
+      statistics = bookie_api.get_betting_market_group_statistics(moneyline_betting_markets.id);
+      BOOST_CHECK(statistics.total_matched_bets_amount == 0);
+      BOOST_CHECK(statistics.betting_markets[0].total_matched_bets_amount == 0);
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE(bet_history_survives_popped_blocks)
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      CREATE_ICE_HOCKEY_BETTING_MARKET(false, 0);
+
+      graphene::bookie::bookie_api bookie_api(app);
+
+      transfer(account_id_type(), alice_id, asset(10000000));
+      transfer(account_id_type(), bob_id, asset(10000000));
+      generate_blocks(1);
+
+      place_bet(alice_id, capitals_win_market.id, bet_type::lay, asset(47, asset_id_type()), 194 * GRAPHENE_BETTING_ODDS_PRECISION / 100);
+      place_bet(bob_id, capitals_win_market.id, bet_type::back, asset(50, asset_id_type()), 194 * GRAPHENE_BETTING_ODDS_PRECISION / 100);
+      generate_blocks(1);
+
+      std::vector<graphene::bookie::matched_bet_object> alice_matched_bets = bookie_api.get_matched_bets_for_bettor(alice_id);
+      BOOST_REQUIRE_EQUAL(alice_matched_bets.size(), 1u);
+      BOOST_CHECK(alice_matched_bets[0].amount_matched == 47);
+
+      // the popped transactions are pushed back as pending once the next block is applied,
+      // and go into the block after that; the history of the popped block must be rolled back
+      db.pop_block();
+      generate_blocks(1);
+      BOOST_CHECK(bookie_api.get_matched_bets_for_bettor(alice_id).empty());
+      generate_blocks(1);
+
+      alice_matched_bets = bookie_api.get_matched_bets_for_bettor(alice_id);
+      BOOST_REQUIRE_EQUAL(alice_matched_bets.size(), 1u);
+      BOOST_CHECK(alice_matched_bets[0].amount_matched == 47);
+      std::vector<graphene::bookie::matched_bet_object> bob_matched_bets = bookie_api.get_matched_bets_for_bettor(bob_id);
+      BOOST_REQUIRE_EQUAL(bob_matched_bets.size(), 1u);
+      BOOST_CHECK(bob_matched_bets[0].amount_matched == 50);
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE(popping_a_settling_block_restores_the_group)
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      CREATE_ICE_HOCKEY_BETTING_MARKET(false, 0);
+
+      graphene::bookie::bookie_api bookie_api(app);
+
+      transfer(account_id_type(), alice_id, asset(10000000));
+      transfer(account_id_type(), bob_id, asset(10000000));
+      place_bet(alice_id, capitals_win_market.id, bet_type::lay, asset(47, asset_id_type()), 194 * GRAPHENE_BETTING_ODDS_PRECISION / 100);
+      place_bet(bob_id, capitals_win_market.id, bet_type::back, asset(50, asset_id_type()), 194 * GRAPHENE_BETTING_ODDS_PRECISION / 100);
+      update_betting_market_group(moneyline_betting_markets.id, _status = betting_market_group_status::closed);
+      generate_blocks(1);
+
+      const betting_market_group_id_type group_id = moneyline_betting_markets.id;
+      const betting_market_id_type capitals_win_market_id = capitals_win_market.id;
+      resolve_betting_market_group(group_id,
+            {{capitals_win_market_id, betting_market_resolution_type::cancel},
+            {blackhawks_win_market.id, betting_market_resolution_type::cancel}});
+      generate_blocks(1);
+      BOOST_REQUIRE(!db.find(group_id));
+      BOOST_REQUIRE(!db.find(capitals_win_market_id));
+
+      const auto& persistent_groups = db.get_index_type<graphene::bookie::persistent_betting_market_group_index>().indices();
+      const auto& persistent_markets = db.get_index_type<graphene::bookie::persistent_betting_market_index>().indices();
+      const size_t group_count = persistent_groups.size();
+      const size_t market_count = persistent_markets.size();
+
+      // undo puts the settled group and its markets back, their persistent copies are updated rather than duplicated
+      db.pop_block();
+      BOOST_CHECK(db.find(group_id));
+      BOOST_CHECK(db.find(capitals_win_market_id));
+      BOOST_CHECK_EQUAL(persistent_groups.size(), group_count);
+      BOOST_CHECK_EQUAL(persistent_markets.size(), market_count);
+
+      // the resolution is applied again with the next blocks
+      generate_blocks(2);
+      BOOST_CHECK(!db.find(group_id));
+      BOOST_CHECK(!db.find(capitals_win_market_id));
+      BOOST_CHECK_EQUAL(persistent_groups.size(), group_count);
+      fc::variants objects_from_bookie = bookie_api.get_objects({group_id, capitals_win_market_id});
+      BOOST_REQUIRE_EQUAL(objects_from_bookie.size(), 2u);
+      BOOST_CHECK(!objects_from_bookie[0].is_null());
+      BOOST_CHECK(!objects_from_bookie[1].is_null());
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE(bet_history_log_is_checked_and_compacted)
+{
+   try
+   {
+      using graphene::bookie::detail::bet_history_record;
+      using graphene::bookie::detail::bet_history_store;
+
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const fc::path log_file = data_dir.path() / "bet_history.log";
+      const chain_id_type chain_id = db.get_chain_id();
+
+      bet_object bet;
+      bet.id = bet_id_type(1);
+      bet.bettor_id = account_id_type(5);
+
+      // one log entry per block, until the log is rewritten with one entry per bet
+      {
+         bet_history_store store;
+         store.open( log_file, chain_id, GRAPHENE_CURRENT_DB_VERSION );
+         const uint32_t blocks = 10002;
+         for( uint32_t block_num = 1; block_num <= blocks; ++block_num )
+         {
+            store.begin_block( block_num );
+            if( block_num == 1 )
+               store.store_bet( bet );
+            else
+               store.modify( bet.id, []( bet_history_record& record ) { record.amount_matched += 1; } );
+            store.end_block( block_num - 1 );
+         }
+         BOOST_CHECK_EQUAL( store.log_entries(), 1u );
+         store.close();
+         BOOST_CHECK_EQUAL( store.log_entries(), 1u );
+      }
+      {
+         // the last block was reversible, it comes back from the journal and can still be rolled back
+         bet_history_store store;
+         store.open( log_file, chain_id, GRAPHENE_CURRENT_DB_VERSION );
+         BOOST_CHECK_EQUAL( store.last_logged_block_num(), 10001u );
+         BOOST_REQUIRE_EQUAL( store.size(), 1u );
+         BOOST_REQUIRE( store.find( bet.id ) );
+         BOOST_CHECK( store.find( bet.id )->amount_matched == 10001 );
+         store.begin_block( 10002 );
+         BOOST_CHECK( store.find( bet.id )->amount_matched == 10000 );
+         store.modify( bet.id, []( bet_history_record& record ) { record.amount_matched += 2; } );
+         store.end_block( 10002 );
+         store.close();
+      }
+      {
+         // records of irreversible blocks are read from the log
+         bet_history_store store;
+         store.open( log_file, chain_id, GRAPHENE_CURRENT_DB_VERSION );
+         BOOST_CHECK_EQUAL( store.last_logged_block_num(), 10002u );
+         BOOST_REQUIRE( store.find( bet.id ) );
+         BOOST_CHECK( store.find( bet.id )->amount_matched == 10002 );
+
+         bet_object other_bet = bet;
+         other_bet.id = bet_id_type(2);
+         store.begin_block( 10003 );
+         store.store_bet( other_bet );
+         store.modify( other_bet.id, []( bet_history_record& record ) { record.amount_matched = 1; } );
+         store.end_block( 10002 );
+         const std::vector<bet_history_record> matched = store.get_matched_bets( bet.bettor_id, bet_id_type(), 10 );
+         BOOST_REQUIRE_EQUAL( matched.size(), 2u );
+         BOOST_CHECK( matched[0].get_bet_id() == other_bet.id );
+         BOOST_CHECK( matched[1].get_bet_id() == bet.id );
+         BOOST_CHECK_EQUAL( store.get_matched_bets( bet.bettor_id, bet.id, 10 ).size(), 1u );
+
+         store.begin_block( 10003 );
+         BOOST_CHECK( !store.find( other_bet.id ) );
+         BOOST_CHECK_EQUAL( store.size(), 1u );
+         store.close();
+      }
+
+      // a log written by another database version is discarded, and so is one of another chain
+      {
+         bet_history_store store;
+         store.open( log_file, chain_id, "not the current version" );
+         BOOST_CHECK_EQUAL( store.size(), 0u );
+         BOOST_CHECK_EQUAL( store.last_logged_block_num(), 0u );
+         store.begin_block( 1 );
+         store.store_bet( bet );
+         store.close();
+      }
+      {
+         bet_history_store store;
+         store.open( log_file, chain_id, "not the current version" );
+         BOOST_CHECK_EQUAL( store.size(), 1u );
+         store.close();
+      }
+      {
+         bet_history_store store;
+         store.open( log_file, fc::sha256::hash( std::string( "another chain" ) ), "not the current version" );
+         BOOST_CHECK_EQUAL( store.size(), 0u );
+         BOOST_CHECK_EQUAL( store.last_logged_block_num(), 0u );
+      }
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE(test_settled_market_states)
 {
    try
@@ -1168,6 +1529,48 @@ BOOST_AUTO_TEST_CASE(delayed_bets_test) // test live betting
    FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(delayed_bets_parked_while_frozen_test)
+{
+   try
+   {
+      const auto& bet_odds_idx = db.get_index_type<bet_object_index>().indices().get<by_odds>();
+      const auto& delayed_bet_idx = db.get_index_type<primary_index<bet_object_index>>().get_secondary_index<delayed_bet_index>();
+
+      ACTORS( (alice)(bob) );
+
+      CREATE_ICE_HOCKEY_BETTING_MARKET(false, 0);
+
+      generate_blocks(1);
+
+      update_betting_market_group(moneyline_betting_markets.id, _status = betting_market_group_status::in_play);
+      generate_blocks(1);
+
+      transfer(account_id_type(), alice_id, asset(10000000));
+      transfer(account_id_type(), bob_id, asset(10000000));
+
+      BOOST_TEST_MESSAGE("Alice places a back bet of 100 at odds 2.0, then the market is frozen");
+      bet_id_type delayed_back_bet = place_bet(alice_id, capitals_win_market.id, bet_type::back, asset(100, asset_id_type()), 2 * GRAPHENE_BETTING_ODDS_PRECISION);
+      BOOST_REQUIRE(delayed_bet_idx.get_delayed_bets(capitals_win_market.id) != nullptr);
+      BOOST_CHECK_EQUAL(delayed_bet_idx.get_delayed_bets(capitals_win_market.id)->size(), 1u);
+      update_betting_market_group(moneyline_betting_markets.id, _status = betting_market_group_status::frozen);
+
+      // the delay expires while the market is frozen, so the bet stays parked in the queue
+      generate_blocks(5);
+      BOOST_CHECK(delayed_back_bet(db).end_of_delay);
+      BOOST_CHECK(bet_odds_idx.lower_bound(std::make_tuple(capitals_win_market.id)) == bet_odds_idx.end());
+      BOOST_CHECK_EQUAL(delayed_bet_idx.get_markets_by_next_delay().size(), 1u);
+
+      // unfreezing the market wakes the bet up at the next block
+      update_betting_market_group(moneyline_betting_markets.id, _status = betting_market_group_status::in_play);
+      generate_blocks(1);
+      BOOST_CHECK(!delayed_back_bet(db).end_of_delay);
+      BOOST_CHECK(delayed_bet_idx.get_delayed_bets(capitals_win_market.id) == nullptr);
+      BOOST_CHECK(delayed_bet_idx.get_markets_by_next_delay().empty());
+      BOOST_CHECK(bet_odds_idx.lower_bound(std::make_tuple(capitals_win_market.id)) != bet_odds_idx.end());
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( chained_market_create_test )
 {
    // Often you will want to create several objects that reference each other at the same time.
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2018 Peerplays Blockchain Standards Association, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../common/betting_test_markets.hpp"
+#include "../common/bench_options.hpp"
+
+#include <graphene/chain/betting_market_object.hpp>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+using namespace graphene::chain::keywords;
+
+namespace {
+
+/**
+ * Number of positions to settle, which can be overridden on the command line, e.g.
+ *    betting_test --run_test=settlement_bench -- --bench-positions=20000
+ */
+struct settlement_bench_config
+{
+#ifdef NDEBUG
+   uint32_t positions = 100000;
+#else
+   uint32_t positions = 2000;
+#endif
+
+   settlement_bench_config()
+   {
+      read_bench_option( "--bench-positions=", positions );
+   }
+};
+
+struct settlement_bench_fixture : database_fixture
+{
+   settlement_bench_config cfg;
+   quiet_betting_logger    quiet_logger;
+};
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_CASE( settlement_bench, settlement_bench_fixture )
+{
+   try {
+      CREATE_ICE_HOCKEY_BETTING_MARKET(false, 0);
+
+      // every bettor ends up with exactly one position: pairs of bettors back and lay each other
+      // at even odds, alternating between the two markets of the group
+      const uint32_t bettors = ( cfg.positions + 1 ) / 2 * 2;
+      ilog( "Settlement benchmark: ${n} positions", ("n", bettors) );
+
+      fc::time_point start_time = fc::time_point::now();
+      for( uint32_t i = 0; i < bettors; i += 2 )
+      {
+         set_expiration( db, trx );
+         const account_id_type backer_id = create_account( "benchbacker" + fc::to_string(i) ).id;
+         const account_id_type layer_id = create_account( "benchlayer" + fc::to_string(i) ).id;
+         transfer( account_id_type(), backer_id, asset(1000) );
+         transfer( account_id_type(), layer_id, asset(1000) );
+
+         const betting_market_id_type market_id = ( i / 2 ) % 2 ? blackhawks_win_market.id : capitals_win_market.id;
+         place_bet( backer_id, market_id, bet_type::back, asset(100, asset_id_type()), 2 * GRAPHENE_BETTING_ODDS_PRECISION );
+         place_bet( layer_id, market_id, bet_type::lay, asset(100, asset_id_type()), 2 * GRAPHENE_BETTING_ODDS_PRECISION );
+
+         // keep the undo history and the pending state small while building
+         if( ( i + 2 ) % 1000 == 0 )
+            generate_block();
+      }
+      generate_block();
+      ilog( "Placed bets in ${t} milliseconds.", ("t", (fc::time_point::now() - start_time).count() / 1000) );
+
+      const auto& position_index = db.get_index_type<betting_market_position_index>().indices().get<by_betting_market_group_bettor>();
+      const auto positions_in_group = std::distance( position_index.lower_bound( moneyline_betting_markets.id ),
+                                                     position_index.upper_bound( moneyline_betting_markets.id ) );
+      BOOST_REQUIRE_EQUAL( static_cast<uint32_t>( positions_in_group ), bettors );
+
+      update_betting_market_group( moneyline_betting_markets.id, _status = betting_market_group_status::closed );
+      resolve_betting_market_group( moneyline_betting_markets.id,
+                                    {{capitals_win_market.id, betting_market_resolution_type::win},
+                                     {blackhawks_win_market.id, betting_market_resolution_type::not_win}} );
+      const betting_market_group_id_type moneyline_id = moneyline_betting_markets.id;
+
+      // the group has no settling delay, so the next block settles it
+      start_time = fc::time_point::now();
+      generate_block();
+      ilog( "Settled ${n} positions in ${t} milliseconds.",
+            ("n", bettors)("t", (fc::time_point::now() - start_time).count() / 1000) );
+
+      BOOST_CHECK( position_index.lower_bound( moneyline_id ) == position_index.upper_bound( moneyline_id ) );
+   } catch( fc::exception& e ) {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
@@ -138,6 +138,14 @@ using namespace graphene::chain;
   const betting_market_object& cilic_wins_final_market = *db.get_index_type<betting_market_object_index>().indices().get<by_id>().rbegin(); \
   (void)federer_wins_market;(void)cilic_wins_market;(void)federer_wins_final_market; (void)cilic_wins_final_market; (void)berdych_wins_market; (void)querrey_wins_market;
 
+/// benchmarks place enough bets that logging every match dominates, keep the betting logger quiet while they run
+struct quiet_betting_logger
+{
+   fc::log_level previous_level = fc::logger::get("betting").get_log_level();
+   quiet_betting_logger()  { fc::logger::get("betting").set_log_level( fc::log_level::warn ); }
+   ~quiet_betting_logger() { fc::logger::get("betting").set_log_level( previous_level ); }
+};
+
 // set up a fixture that places a series of two matched bets, we'll use this fixture to verify
 // the result in all three possible outcomes
 struct simple_bet_test_fixture : database_fixture {
@@ -127,6 +127,25 @@ database_fixture::database_fixture()
       options.insert(std::make_pair("track-account", boost::program_options::variable_value(track_account, false)));
    }
 
+   // account histories indexed by operation type, with a few entries per account
+   if( !options.count("history-by-operation-type") && boost::unit_test::framework::current_test_case().p_name.value == "get_account_history_operations_by_type") {
+      options.insert(std::make_pair("history-by-operation-type", boost::program_options::variable_value(true, false)));
+      options.insert(std::make_pair("max-ops-per-account", boost::program_options::variable_value(uint32_t(10), false)));
+   }
+
+   // the same, pruning the operations no account refers to any more
+   if( !options.count("history-by-operation-type") && boost::unit_test::framework::current_test_case().p_name.value == "get_account_history_operations_by_type_pruned") {
+      options.insert(std::make_pair("history-by-operation-type", boost::program_options::variable_value(true, false)));
+      options.insert(std::make_pair("max-ops-per-account", boost::program_options::variable_value(uint32_t(3), false)));
+      options.insert(std::make_pair("partial-operations", boost::program_options::variable_value(true, false)));
+   }
+
+   // market history buckets that expire quickly
+   if( !options.count("bucket-size") && boost::unit_test::framework::current_test_case().p_name.value == "market_history_buckets") {
+      options.insert(std::make_pair("bucket-size", boost::program_options::variable_value(string("[300]"), false)));
+      options.insert(std::make_pair("history-per-size", boost::program_options::variable_value(uint32_t(2), false)));
+   }
+
    // standby votes tracking
    if( boost::unit_test::framework::current_test_case().p_name.value == "track_votes_witnesses_disabled" ||
        boost::unit_test::framework::current_test_case().p_name.value == "track_votes_committee_disabled") {
@@ -28,6 +28,7 @@
 
 #include <graphene/utilities/elasticsearch.hpp>
 #include <graphene/elasticsearch/elasticsearch_plugin.hpp>
+#include <graphene/elasticsearch/bulk_indexer.hpp>
 
 #include "../common/database_fixture.hpp"
 
@@ -532,4 +533,104 @@ BOOST_AUTO_TEST_CASE(elasticsearch_history_api) {
       throw;
    }
 }
+
+BOOST_AUTO_TEST_CASE(elasticsearch_bulk_indexer_spill) {
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      graphene::elasticsearch::bulk_indexer::options opts;
+      opts.node_url = "http://127.0.0.1:9/"; // nothing listens, every batch stays pending
+      opts.chain_id = db.get_chain_id();
+      opts.index_prefix = "peerplays-";
+      opts.queue_size = 1;
+      opts.directory = data_dir.path();
+
+      {
+         graphene::elasticsearch::bulk_indexer indexer;
+         indexer.start( opts );
+         for( uint32_t block_num = 1; block_num <= 3; ++block_num )
+            indexer.push( block_num, { "{\"index\":{}}", "{\"block\":" + std::to_string( block_num ) + "}" } );
+         BOOST_CHECK_EQUAL( indexer.pending_batches(), 3u );
+         indexer.stop();
+      }
+      {
+         // the queued and spilled batches are sent first on the next start
+         graphene::elasticsearch::bulk_indexer indexer;
+         indexer.start( opts );
+         BOOST_CHECK_EQUAL( indexer.pending_batches(), 3u );
+         BOOST_CHECK_EQUAL( indexer.acknowledged_block_num(), 0u );
+         indexer.stop();
+      }
+      {
+         // they were indexed under another prefix
+         opts.index_prefix = "other-";
+         graphene::elasticsearch::bulk_indexer indexer;
+         indexer.start( opts );
+         BOOST_CHECK_EQUAL( indexer.pending_batches(), 0u );
+         indexer.stop();
+      }
+   }
+   catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(elasticsearch_bulk_indexer_watermark) {
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      graphene::elasticsearch::bulk_indexer::options opts;
+      opts.node_url = "http://127.0.0.1:9/";
+      opts.chain_id = db.get_chain_id();
+      opts.index_prefix = "peerplays-";
+      opts.directory = data_dir.path();
+
+      {
+         // an empty batch is acknowledged without a request
+         graphene::elasticsearch::bulk_indexer indexer;
+         indexer.start( opts );
+         indexer.push( 5, {} );
+         for( int i = 0; i < 100 && indexer.acknowledged_block_num() != 5; ++i )
+            fc::usleep( fc::milliseconds( 10 ) );
+         BOOST_CHECK_EQUAL( indexer.acknowledged_block_num(), 5u );
+         indexer.stop();
+      }
+      {
+         graphene::elasticsearch::bulk_indexer indexer;
+         indexer.start( opts );
+         BOOST_CHECK_EQUAL( indexer.acknowledged_block_num(), 5u );
+         indexer.stop();
+      }
+      {
+         // a watermark written for another chain does not skip anything
+         opts.chain_id = fc::sha256::hash( std::string( "another chain" ) );
+         graphene::elasticsearch::bulk_indexer indexer;
+         indexer.start( opts );
+         BOOST_CHECK_EQUAL( indexer.acknowledged_block_num(), 0u );
+         indexer.stop();
+      }
+   }
+   catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(elasticsearch_bulk_response) {
+   try {
+      typedef graphene::elasticsearch::bulk_indexer indexer;
+      BOOST_CHECK_EQUAL( indexer::classify_response( 200, "{\"took\":3,\"errors\":false,\"items\":[]}" ), indexer::sent );
+      BOOST_CHECK_EQUAL( indexer::classify_response( 200,
+            "{\"took\":3,\"errors\":true,\"items\":[{\"index\":{\"status\":400,"
+            "\"error\":{\"type\":\"mapper_parsing_exception\"}}}]}" ), indexer::rejected );
+      BOOST_CHECK_EQUAL( indexer::classify_response( 400, "{\"error\":\"bad request\"}" ), indexer::rejected );
+      BOOST_CHECK_EQUAL( indexer::classify_response( 401, "" ), indexer::rejected );
+      BOOST_CHECK_EQUAL( indexer::classify_response( 429, "" ), indexer::failed );
+      BOOST_CHECK_EQUAL( indexer::classify_response( 503, "" ), indexer::failed );
+      BOOST_CHECK_EQUAL( indexer::classify_response( 0, "" ), indexer::failed );
+   }
+   catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
 BOOST_AUTO_TEST_SUITE_END()
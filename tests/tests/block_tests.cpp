@@ -24,6 +24,8 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <graphene/app/api.hpp>
+
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/exceptions.hpp>
 
@@ -37,7 +39,9 @@
 
 #include <graphene/utilities/tempdir.hpp>
 
+#include <fc/crypto/base64.hpp>
 #include <fc/crypto/digest.hpp>
+#include <fc/crypto/hex.hpp>
 
 #include "../common/database_fixture.hpp"
 
@@ -127,6 +131,112 @@ BOOST_AUTO_TEST_CASE( block_database_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( block_database_range_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+
+      vector<signed_block> blocks;
+      signed_block b;
+      for( uint32_t i = 0; i < 6; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+         blocks.push_back( b );
+      }
+
+      // a fork switch stores another block 3 at the end of the blocks file, and block 5 is popped
+      signed_block fork = blocks[2];
+      fork.witness = witness_id_type(100);
+      bdb.store( fork.id(), fork );
+      blocks[2] = fork;
+      bdb.remove( blocks[4].id() );
+
+      auto check = [&]( uint32_t first, uint32_t last ) {
+         vector<packed_block> range = bdb.fetch_range( first, last, std::numeric_limits<uint64_t>::max() );
+         BOOST_REQUIRE_EQUAL( range.size(), last - first + 1 );
+         for( uint32_t num = first; num <= last; ++num )
+         {
+            const packed_block& packed = range[num - first];
+            if( num == 0 || num == 5 || num > 6 )
+            {
+               BOOST_CHECK( packed.data.empty() );
+               continue;
+            }
+            BOOST_CHECK( packed.id == blocks[num-1].id() );
+            BOOST_CHECK( packed.data == fc::raw::pack( blocks[num-1] ) );
+         }
+      };
+      check( 0, 8 );
+      check( 1, 2 );
+      check( 4, 6 );
+      check( 3, 3 );
+      check( 2, 3 );
+      BOOST_CHECK( bdb.fetch_range( 2, 1, std::numeric_limits<uint64_t>::max() ).empty() );
+      BOOST_CHECK_EQUAL( bdb.fetch_range( 20, 30, std::numeric_limits<uint64_t>::max() ).size(), 11u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( block_api_get_blocks, database_fixture )
+{
+   try {
+      generate_blocks( 20 );
+      graphene::app::block_api api( db );
+
+      const uint32_t head = db.head_block_num();
+      auto blocks = api.get_blocks( head - 15, head + 2 );
+      BOOST_REQUIRE_EQUAL( blocks.size(), 18u );
+      for( uint32_t i = 0; i < 16; ++i )
+      {
+         BOOST_REQUIRE( blocks[i].valid() );
+         BOOST_CHECK( blocks[i]->id() == db.fetch_block_by_number( head - 15 + i )->id() );
+      }
+      BOOST_CHECK( !blocks[16].valid() );
+      BOOST_CHECK( !blocks[17].valid() );
+
+      for( const string encoding : { "hex", "base64" } )
+      {
+         auto raw = api.get_raw_blocks( head - 15, head + 2, encoding );
+         BOOST_REQUIRE_EQUAL( raw.size(), 18u );
+         for( uint32_t i = 0; i < 16; ++i )
+         {
+            BOOST_REQUIRE( raw[i].valid() );
+            BOOST_CHECK_EQUAL( raw[i]->block_num, head - 15 + i );
+            BOOST_CHECK( raw[i]->id == blocks[i]->id() );
+            const vector<char> packed = fc::raw::pack( *blocks[i] );
+            const string expected = encoding == string("hex")
+                  ? fc::to_hex( packed.data(), packed.size() )
+                  : fc::base64_encode( (const unsigned char*)packed.data(), packed.size() );
+            BOOST_CHECK_EQUAL( raw[i]->data, expected );
+         }
+         BOOST_CHECK( !raw[16].valid() );
+      }
+      GRAPHENE_REQUIRE_THROW( api.get_raw_blocks( 1, 2, "binary" ), fc::exception );
+      GRAPHENE_REQUIRE_THROW( api.get_blocks( 1, 200 ), fc::exception );
+
+      // a byte budget cuts the range short, the caller continues after the last block returned
+      const uint64_t block_size = fc::raw::pack_size( *blocks[0] );
+      auto packed = db.fetch_packed_blocks( head - 15, head, 3 * block_size );
+      BOOST_REQUIRE_EQUAL( packed.size(), 3u );
+      BOOST_CHECK( packed[2].id == blocks[2]->id() );
+      packed = db.fetch_packed_blocks( head - 12, head, 3 * block_size );
+      BOOST_REQUIRE_EQUAL( packed.size(), 3u );
+      BOOST_CHECK( packed[0].id == blocks[3]->id() );
+      // the first block is returned even when it alone is over the budget
+      BOOST_CHECK_EQUAL( db.fetch_packed_blocks( head - 15, head, 1 ).size(), 1u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
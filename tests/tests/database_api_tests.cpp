@@ -24,7 +24,12 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <graphene/app/api.hpp>
+#include <graphene/app/api_workers.hpp>
 #include <graphene/app/database_api.hpp>
+#include <graphene/app/object_notifications.hpp>
+
+#include <cmath>
 
 #include "../common/database_fixture.hpp"
 
@@ -68,4 +73,289 @@ BOOST_FIXTURE_TEST_SUITE(database_api_tests, database_fixture)
       } FC_LOG_AND_RETHROW()
   }
 
+  BOOST_AUTO_TEST_CASE(get_tickers) {
+      try {
+          ACTORS( (buyer)(seller) );
+          const asset_object& test_asset = create_user_issued_asset( "TICKER" );
+          const asset_object& core_asset = asset_id_type()(db);
+          issue_uia( seller, test_asset.amount( 10000 ) );
+          transfer( committee_account, buyer_id, core_asset.amount( 10000 ) );
+
+          auto core = [&]( int64_t amount ) { return amount / std::pow( 10, core_asset.precision ); };
+          auto uia = [&]( int64_t amount ) { return amount / std::pow( 10, test_asset.precision ); };
+
+          graphene::app::database_api db_api(db);
+          graphene::app::market_ticker ticker = db_api.get_ticker( GRAPHENE_SYMBOL, "TICKER" );
+          BOOST_CHECK_EQUAL( ticker.base_volume, 0 );
+          BOOST_CHECK_EQUAL( ticker.latest, 0 );
+
+          // one trade at 2 core per TICKER, and a day later one at 3
+          create_sell_order( seller, test_asset.amount( 100 ), core_asset.amount( 200 ) );
+          create_sell_order( buyer, core_asset.amount( 200 ), test_asset.amount( 100 ) );
+          generate_block();
+
+          ticker = db_api.get_ticker( GRAPHENE_SYMBOL, "TICKER" );
+          BOOST_CHECK_CLOSE( ticker.latest, core( 200 ) / uia( 100 ), 0.0001 );
+          BOOST_CHECK_CLOSE( ticker.base_volume, core( 200 ), 0.0001 );
+          BOOST_CHECK_CLOSE( ticker.quote_volume, uia( 100 ), 0.0001 );
+          BOOST_CHECK_EQUAL( ticker.percent_change, 0 );
+
+          generate_blocks( db.head_block_time() + fc::days(1) );
+          ticker = db_api.get_ticker( GRAPHENE_SYMBOL, "TICKER" );
+          BOOST_CHECK_CLOSE( ticker.latest, core( 200 ) / uia( 100 ), 0.0001 );
+          BOOST_CHECK_EQUAL( ticker.base_volume, 0 );
+          BOOST_CHECK_EQUAL( ticker.quote_volume, 0 );
+
+          create_sell_order( seller, test_asset.amount( 100 ), core_asset.amount( 300 ) );
+          create_sell_order( buyer, core_asset.amount( 300 ), test_asset.amount( 100 ) );
+          generate_block();
+
+          const vector<graphene::app::market_ticker> tickers = db_api.get_tickers( { { GRAPHENE_SYMBOL, "TICKER" }, { "TICKER", GRAPHENE_SYMBOL } } );
+          BOOST_REQUIRE_EQUAL( tickers.size(), 2u );
+          BOOST_CHECK_CLOSE( tickers[0].latest, core( 300 ) / uia( 100 ), 0.0001 );
+          BOOST_CHECK_CLOSE( tickers[0].percent_change, 50, 0.0001 );
+          BOOST_CHECK_CLOSE( tickers[0].base_volume, core( 300 ), 0.0001 );
+          BOOST_CHECK_CLOSE( tickers[1].latest, uia( 100 ) / core( 300 ), 0.0001 );
+          BOOST_CHECK_CLOSE( tickers[1].base_volume, uia( 100 ), 0.0001 );
+          BOOST_CHECK_CLOSE( tickers[1].quote_volume, core( 300 ), 0.0001 );
+
+          const graphene::app::market_volume volume = db_api.get_24_volume( GRAPHENE_SYMBOL, "TICKER" );
+          BOOST_CHECK_CLOSE( volume.base_volume, core( 300 ), 0.0001 );
+          BOOST_CHECK_CLOSE( volume.quote_volume, uia( 100 ), 0.0001 );
+
+          const vector<std::pair<string, string>> too_many_markets( 101, std::make_pair( string( GRAPHENE_SYMBOL ), string( "TICKER" ) ) );
+          GRAPHENE_REQUIRE_THROW( db_api.get_tickers( too_many_markets ), fc::exception );
+
+      } FC_LOG_AND_RETHROW()
+  }
+
+  BOOST_AUTO_TEST_CASE(get_order_book_depth) {
+      try {
+          ACTORS( (buyer)(seller) );
+          const asset_object& test_asset = create_user_issued_asset( "DEPTH" );
+          const asset_object& core_asset = asset_id_type()(db);
+          issue_uia( seller, test_asset.amount( 10000 ) );
+          transfer( committee_account, buyer_id, core_asset.amount( 10000000 ) );
+
+          auto core = [&]( double amount ) { return share_type( int64_t( amount * std::pow( 10, core_asset.precision ) ) ); };
+          auto uia = [&]( double amount ) { return share_type( int64_t( amount * std::pow( 10, test_asset.precision ) ) ); };
+
+          // asks at 2.00 twice, 2.05 and 2.10 core per DEPTH, bids at 1.50, 1.45 and 1.40
+          create_sell_order( seller, test_asset.amount( uia( 1 ) ), core_asset.amount( core( 2 ) ) );
+          create_sell_order( seller, test_asset.amount( uia( 1 ) ), core_asset.amount( core( 2 ) ) );
+          create_sell_order( seller, test_asset.amount( uia( 1 ) ), core_asset.amount( core( 2.05 ) ) );
+          create_sell_order( seller, test_asset.amount( uia( 1 ) ), core_asset.amount( core( 2.1 ) ) );
+          create_sell_order( buyer, core_asset.amount( core( 1.5 ) ), test_asset.amount( uia( 1 ) ) );
+          create_sell_order( buyer, core_asset.amount( core( 1.45 ) ), test_asset.amount( uia( 1 ) ) );
+          create_sell_order( buyer, core_asset.amount( core( 1.4 ) ), test_asset.amount( uia( 1 ) ) );
+
+          graphene::app::database_api db_api(db);
+          graphene::app::order_book book = db_api.get_order_book_depth( GRAPHENE_SYMBOL, "DEPTH", 2 );
+          BOOST_REQUIRE_EQUAL( book.asks.size(), 3u );
+          BOOST_REQUIRE_EQUAL( book.bids.size(), 3u );
+          BOOST_CHECK_CLOSE( book.asks[0].price, 2, 0.0001 );
+          BOOST_CHECK_CLOSE( book.asks[0].quote, 2, 0.0001 );
+          BOOST_CHECK_CLOSE( book.asks[0].base, 4, 0.0001 );
+
+          // at one decimal, 2.05 rounds up into the 2.10 ask and 1.45 down into the 1.40 bid
+          book = db_api.get_order_book_depth( GRAPHENE_SYMBOL, "DEPTH", 1 );
+          BOOST_REQUIRE_EQUAL( book.asks.size(), 2u );
+          BOOST_CHECK_CLOSE( book.asks[1].price, 2.1, 0.0001 );
+          BOOST_CHECK_CLOSE( book.asks[1].quote, 2, 0.0001 );
+          BOOST_CHECK_CLOSE( book.asks[1].base, 4.15, 0.0001 );
+          BOOST_REQUIRE_EQUAL( book.bids.size(), 2u );
+          BOOST_CHECK_CLOSE( book.bids[0].price, 1.5, 0.0001 );
+          BOOST_CHECK_CLOSE( book.bids[1].price, 1.4, 0.0001 );
+          BOOST_CHECK_CLOSE( book.bids[1].base, 2.85, 0.0001 );
+          BOOST_CHECK_CLOSE( book.bids[1].quote, 2, 0.0001 );
+
+          book = db_api.get_order_book_depth( GRAPHENE_SYMBOL, "DEPTH", 0, 1 );
+          BOOST_REQUIRE_EQUAL( book.asks.size(), 1u );
+          BOOST_CHECK_CLOSE( book.asks[0].price, 2, 0.0001 );
+          BOOST_CHECK_CLOSE( book.asks[0].quote, 2, 0.0001 );
+          BOOST_REQUIRE_EQUAL( book.bids.size(), 1u );
+          BOOST_CHECK_CLOSE( book.bids[0].price, 1, 0.0001 );
+
+          // filling an order takes it off its level
+          create_sell_order( buyer, core_asset.amount( core( 2 ) ), test_asset.amount( uia( 1 ) ) );
+          book = db_api.get_order_book_depth( GRAPHENE_SYMBOL, "DEPTH", 2 );
+          BOOST_REQUIRE_EQUAL( book.asks.size(), 3u );
+          BOOST_CHECK_CLOSE( book.asks[0].quote, 1, 0.0001 );
+
+      } FC_LOG_AND_RETHROW()
+  }
+
+  BOOST_AUTO_TEST_CASE(object_notifications_serialize_once) {
+      try {
+          graphene::app::object_notification_hub hub( db );
+          const object_id_type dgpo_id = db.get_dynamic_global_properties().id;
+
+          // two sessions subscribed to the same object get the same serialized variant
+          vector<const fc::variant*> seen;
+          auto session = [&]( const graphene::app::object_notification& n ) {
+             for( size_t i = 0; i < n.ids().size(); ++i )
+                if( n.ids()[i] == dgpo_id )
+                   seen.push_back( &n.full_object( i ) );
+          };
+          boost::signals2::scoped_connection first = hub.objects_changed.connect( session );
+          boost::signals2::scoped_connection second = hub.objects_changed.connect( session );
+
+          generate_block();
+          BOOST_REQUIRE_EQUAL( seen.size(), 2u );
+          BOOST_CHECK( seen[0] == seen[1] );
+
+      } FC_LOG_AND_RETHROW()
+  }
+
+  BOOST_AUTO_TEST_CASE(full_accounts_cache_and_delta) {
+      try {
+          ACTORS( (alice)(bob) );
+          generate_block();
+          graphene::app::database_api db_api(db);
+
+          // nothing is known before the first request
+          auto delta = db_api.get_full_accounts_delta( { "alice", "nobody" }, 0 );
+          BOOST_REQUIRE_EQUAL( delta.size(), 1u );
+          BOOST_CHECK( delta["alice"].complete );
+          BOOST_CHECK_EQUAL( delta["alice"].account.account.name, "alice" );
+          const uint32_t since = delta["alice"].block_num;
+          BOOST_CHECK_EQUAL( since, db.head_block_num() );
+
+          // a block impacting alice refreshes her cached account, bob's stays as it was
+          transfer( account_id_type(), alice_id, asset( 1000 ) );
+          generate_block();
+          auto accounts = db_api.get_full_accounts( { "alice", "bob" }, false );
+          BOOST_REQUIRE_EQUAL( accounts["alice"].balances.size(), 1u );
+          BOOST_CHECK_EQUAL( accounts["alice"].balances[0].balance.value, 1000 );
+          BOOST_CHECK( accounts["bob"].balances.empty() );
+
+          delta = db_api.get_full_accounts_delta( { "alice" }, since );
+          BOOST_CHECK( !delta["alice"].complete );
+          BOOST_CHECK( delta["alice"].sections.count( "balances" ) );
+          BOOST_CHECK( !delta["alice"].sections.count( "account" ) );
+          BOOST_CHECK( !delta["alice"].sections.count( "limit_orders" ) );
+          BOOST_REQUIRE_EQUAL( delta["alice"].account.balances.size(), 1u );
+          BOOST_CHECK_EQUAL( delta["alice"].account.balances[0].balance.value, 1000 );
+
+          delta = db_api.get_full_accounts_delta( { "alice" }, delta["alice"].block_num );
+          BOOST_CHECK( delta["alice"].sections.empty() );
+
+          // pending transactions are included without being cached
+          transfer( account_id_type(), alice_id, asset( 500 ) );
+          accounts = db_api.get_full_accounts( { "alice" }, false );
+          BOOST_CHECK_EQUAL( accounts["alice"].balances[0].balance.value, 1500 );
+          db.clear_pending();
+          accounts = db_api.get_full_accounts( { "alice" }, false );
+          BOOST_CHECK_EQUAL( accounts["alice"].balances[0].balance.value, 1000 );
+
+          // popping a block drops what the cache knows
+          transfer( account_id_type(), alice_id, asset( 500 ) );
+          generate_block();
+          BOOST_CHECK_EQUAL( db_api.get_full_accounts( { "alice" }, false )["alice"].balances[0].balance.value, 1500 );
+          db.pop_block();
+          BOOST_CHECK_EQUAL( db_api.get_full_accounts( { "alice" }, false )["alice"].balances[0].balance.value, 1000 );
+
+      } FC_LOG_AND_RETHROW()
+  }
+
+  BOOST_AUTO_TEST_CASE(api_worker_pool_reads_between_blocks) {
+      try {
+          graphene::app::api_worker_pool workers( "test API", 2 );
+          BOOST_CHECK_EQUAL( workers.thread_count(), 2u );
+
+          // calls run on the workers, see the state of the main thread and pass exceptions back
+          const fc::thread* main_thread = &fc::thread::current();
+          for( int i = 0; i < 4; ++i )
+          {
+             generate_block();
+             const fc::thread* worker_thread = nullptr;
+             const uint32_t head = workers.run( db, [&]() {
+                worker_thread = &fc::thread::current();
+                return db.head_block_num();
+             });
+             BOOST_CHECK( worker_thread != main_thread );
+             BOOST_CHECK_EQUAL( head, db.head_block_num() );
+          }
+          GRAPHENE_REQUIRE_THROW( workers.run( db, [&]() -> uint32_t { FC_ASSERT( false ); } ), fc::exception );
+
+          // calls to external services run on the workers without the chain state, even while a block is applied
+          {
+             boost::unique_lock<boost::shared_mutex> writing( db.chain_state_mutex() );
+             const fc::thread* worker_thread = nullptr;
+             workers.run_unlocked( [&]() { worker_thread = &fc::thread::current(); } );
+             BOOST_CHECK( worker_thread != main_thread );
+          }
+
+          // a call holds the chain state while it runs, pushing a block waits for it
+          BOOST_CHECK( db.chain_state_mutex().try_lock() );
+          db.chain_state_mutex().unlock();
+          boost::shared_lock<boost::shared_mutex> reading( db.chain_state_mutex() );
+          BOOST_CHECK( !db.chain_state_mutex().try_lock() );
+
+      } FC_LOG_AND_RETHROW()
+  }
+
+  BOOST_AUTO_TEST_CASE(asset_holders_paging_and_counts) {
+      try {
+          ACTORS( (alice)(bob)(carl)(dan)(eve) );
+          const asset_id_type uia_id = create_user_issued_asset( "HOLDERS" ).id;
+          issue_uia( alice, asset( 500, uia_id ) );
+          issue_uia( bob, asset( 300, uia_id ) );
+          issue_uia( carl, asset( 300, uia_id ) );
+          issue_uia( dan, asset( 100, uia_id ) );
+          // eve ends with a zero balance object, which is counted but not listed
+          issue_uia( eve, asset( 50, uia_id ) );
+          transfer( eve, alice, asset( 50, uia_id ) );
+          generate_block();
+
+          graphene::app::asset_api asset_api( app );
+
+          // what walking the balances of the asset finds
+          auto check = [&]() {
+             const auto& bal_idx = db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
+             auto range = bal_idx.equal_range( boost::make_tuple( uia_id ) );
+             vector< std::pair<account_id_type, int64_t> > expected;
+             for( const account_balance_object& bal : boost::make_iterator_range( range.first, range.second ) )
+                if( bal.balance != 0 )
+                   expected.emplace_back( bal.owner, bal.balance.value );
+
+             BOOST_CHECK_EQUAL( asset_api.get_asset_holders_count( "HOLDERS" ), boost::distance( range ) - 1 );
+             for( uint32_t start = 0; start <= expected.size() + 1; ++start )
+                for( uint32_t limit = 1; limit <= 3; ++limit )
+                {
+                   auto page = asset_api.get_asset_holders( "HOLDERS", start, limit );
+                   BOOST_REQUIRE_EQUAL( page.size(), std::min<size_t>( limit, expected.size() - std::min<size_t>( start, expected.size() ) ) );
+                   for( size_t i = 0; i < page.size(); ++i )
+                   {
+                      BOOST_CHECK( page[i].account_id == expected[start + i].first );
+                      BOOST_CHECK_EQUAL( page[i].amount.value, expected[start + i].second );
+                   }
+                }
+             return expected.size();
+          };
+
+          BOOST_CHECK_EQUAL( check(), 4u );
+          auto page = asset_api.get_asset_holders( "HOLDERS", 0, 100 );
+          BOOST_REQUIRE_EQUAL( page.size(), 4u );
+          BOOST_CHECK_EQUAL( page[0].name, "alice" );
+          BOOST_CHECK_EQUAL( page[0].amount.value, 550 );
+          BOOST_CHECK_EQUAL( page[3].name, "dan" );
+
+          // balances moving between holders reorder them, and undo restores the order
+          transfer( alice, eve, asset( 450, uia_id ) );
+          transfer( dan, bob, asset( 100, uia_id ) );
+          generate_block();
+          BOOST_CHECK_EQUAL( check(), 4u );
+          BOOST_CHECK_EQUAL( asset_api.get_asset_holders( "HOLDERS", 0, 1 )[0].name, "eve" );
+          db.pop_block();
+          db.clear_pending();
+          BOOST_CHECK_EQUAL( check(), 4u );
+          BOOST_CHECK_EQUAL( asset_api.get_asset_holders( "HOLDERS", 0, 1 )[0].name, "alice" );
+
+          for( const auto& holders : asset_api.get_all_asset_holders() )
+             if( holders.asset_id == uia_id )
+                BOOST_CHECK_EQUAL( holders.count, 4 );
+      } FC_LOG_AND_RETHROW()
+  }
+
 BOOST_AUTO_TEST_SUITE_END()
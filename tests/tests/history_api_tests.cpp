@@ -27,6 +27,9 @@
 #include <graphene/app/database_api.hpp>
 #include <graphene/app/api.hpp>
 #include <graphene/chain/account_object.hpp>
+#include <graphene/market_history/market_history_store.hpp>
+#include <graphene/market_history/order_book_feed.hpp>
+#include <graphene/utilities/tempdir.hpp>
 
 #include "../common/database_fixture.hpp"
 
@@ -594,4 +597,343 @@ BOOST_AUTO_TEST_CASE(get_account_history_operations) {
    }
 }
 
+BOOST_AUTO_TEST_CASE(get_account_history_operations_by_type) {
+   try {
+      // the fixture indexes the histories by operation type and keeps 10 operations per account
+      graphene::app::history_api hist_api(app);
+      const int transfer_op_id = operation::tag<transfer_operation>::value;
+      const int account_create_op_id = operation::tag<account_create_operation>::value;
+
+      // the transfers among alice's last 100 operations, walking her history
+      auto expected_transfers = [&]() {
+         vector<operation_history_id_type> result;
+         for( const auto& o : hist_api.get_account_history( "alice", operation_history_id_type(), 100, operation_history_id_type() ) )
+            if( o.op.which() == transfer_op_id )
+               result.push_back( o.id );
+         return result;
+      };
+      auto ids = []( const vector<operation_history_object>& ops ) {
+         vector<operation_history_id_type> result;
+         for( const auto& o : ops )
+            result.push_back( o.id );
+         return result;
+      };
+
+      ACTORS( (alice)(bob) );
+      transfer( account_id_type(), alice_id, asset( 100000 ) );
+      for( int i = 0; i < 8; ++i )
+         transfer( alice_id, bob_id, asset( 100 + i ) );
+      generate_block();
+
+      auto transfers = hist_api.get_account_history_operations( "alice", transfer_op_id, operation_history_id_type(), operation_history_id_type(), 100 );
+      BOOST_CHECK_EQUAL( transfers.size(), 9u );
+      BOOST_CHECK( ids( transfers ) == expected_transfers() );
+      BOOST_CHECK_EQUAL( hist_api.get_account_history_operations( "alice", account_create_op_id, operation_history_id_type(), operation_history_id_type(), 100 ).size(), 1u );
+
+      // start and stop bound the operation ids, most recent first
+      const vector<operation_history_id_type> all = ids( transfers );
+      auto page = hist_api.get_account_history_operations( "alice", transfer_op_id, all[3], operation_history_id_type(), 2 );
+      BOOST_REQUIRE_EQUAL( page.size(), 2u );
+      BOOST_CHECK( page[0].id == all[3] );
+      BOOST_CHECK( page[1].id == all[4] );
+      BOOST_CHECK_EQUAL( hist_api.get_account_history_operations( "alice", transfer_op_id, operation_history_id_type(), all[5], 100 ).size(), 5u );
+      BOOST_CHECK_EQUAL( hist_api.get_account_history_operations( "alice", transfer_op_id, all[2], all[5], 100 ).size(), 3u );
+      BOOST_CHECK_EQUAL( hist_api.get_account_history_operations( "alice", transfer_op_id, all[5], all[2], 100 ).size(), 0u );
+
+      // pruning to 10 operations drops her account creation, the funding and her first transfer
+      for( int i = 0; i < 3; ++i )
+         transfer( alice_id, bob_id, asset( 200 + i ) );
+      generate_block();
+      transfers = hist_api.get_account_history_operations( "alice", transfer_op_id, operation_history_id_type(), operation_history_id_type(), 100 );
+      BOOST_CHECK_EQUAL( transfers.size(), 10u );
+      BOOST_CHECK( ids( transfers ) == expected_transfers() );
+      BOOST_CHECK_EQUAL( hist_api.get_account_history_operations( "alice", account_create_op_id, operation_history_id_type(), operation_history_id_type(), 100 ).size(), 0u );
+
+      // popping a block brings back the entries it pruned
+      const vector<operation_history_id_type> before = ids( transfers );
+      transfer( alice_id, bob_id, asset( 300 ) );
+      transfer( alice_id, bob_id, asset( 301 ) );
+      generate_block();
+      BOOST_CHECK( ids( hist_api.get_account_history_operations( "alice", transfer_op_id, operation_history_id_type(), operation_history_id_type(), 100 ) ) == expected_transfers() );
+      db.pop_block();
+      db.clear_pending();
+      BOOST_CHECK( ids( hist_api.get_account_history_operations( "alice", transfer_op_id, operation_history_id_type(), operation_history_id_type(), 100 ) ) == before );
+      BOOST_CHECK( expected_transfers() == before );
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(get_account_history_operations_by_type_pruned) {
+   try {
+      // the fixture keeps 3 operations per account and drops the operations no account refers to
+      graphene::app::history_api hist_api(app);
+      const int transfer_op_id = operation::tag<transfer_operation>::value;
+
+      auto ids = []( const vector<operation_history_object>& ops ) {
+         vector<operation_history_id_type> result;
+         for( const auto& o : ops )
+            result.push_back( o.id );
+         return result;
+      };
+      auto transfers_of = [&]( const string& name ) {
+         return ids( hist_api.get_account_history_operations( name, transfer_op_id, operation_history_id_type(), operation_history_id_type(), 100 ) );
+      };
+
+      ACTORS( (alice)(bob) );
+      transfer( account_id_type(), alice_id, asset( 100000 ) );
+      for( int i = 0; i < 3; ++i )
+         transfer( alice_id, bob_id, asset( 100 + i ) );
+      generate_block();
+      const vector<operation_history_id_type> before = transfers_of( "alice" );
+      BOOST_REQUIRE_EQUAL( before.size(), 3u );
+      BOOST_CHECK( transfers_of( "bob" ) == before );
+
+      // both drop the oldest transfer, and with it the operation itself
+      const operation_history_id_type oldest = before.back();
+      transfer( alice_id, bob_id, asset( 200 ) );
+      generate_block();
+      BOOST_CHECK( db.find( oldest ) == nullptr );
+      const vector<operation_history_id_type> after = transfers_of( "alice" );
+      BOOST_CHECK_EQUAL( after.size(), 3u );
+      BOOST_CHECK( std::find( after.begin(), after.end(), oldest ) == after.end() );
+
+      // undo puts the entries and the operation back in no particular order, the index has them all again
+      db.pop_block();
+      db.clear_pending();
+      BOOST_REQUIRE( db.find( oldest ) != nullptr );
+      BOOST_CHECK( transfers_of( "alice" ) == before );
+      BOOST_CHECK( transfers_of( "bob" ) == before );
+
+      // and prunes them again when the block comes back
+      transfer( alice_id, bob_id, asset( 200 ) );
+      generate_block();
+      BOOST_CHECK( db.find( oldest ) == nullptr );
+      BOOST_CHECK_EQUAL( transfers_of( "alice" ).size(), 3u );
+      BOOST_CHECK_EQUAL( transfers_of( "bob" ).size(), 3u );
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(market_history_buckets) {
+   try {
+      // the fixture tracks 300 second buckets for two buckets back in this test
+      graphene::app::history_api hist_api(app);
+      ACTORS( (buyer)(seller) );
+      const asset_object& test_asset = create_user_issued_asset( "BUCKET" );
+      const asset_object& core_asset = asset_id_type()(db);
+      issue_uia( seller, test_asset.amount( 10000 ) );
+      transfer( committee_account, buyer_id, core_asset.amount( 10000 ) );
+
+      // both fills land in one block and are applied to the bucket at once
+      create_sell_order( seller, test_asset.amount( 100 ), core_asset.amount( 200 ) );
+      create_sell_order( seller, test_asset.amount( 100 ), core_asset.amount( 300 ) );
+      create_sell_order( buyer, core_asset.amount( 800 ), test_asset.amount( 200 ) );
+      generate_block();
+
+      vector<bucket_object> buckets = hist_api.get_market_history( GRAPHENE_SYMBOL, "BUCKET", 300,
+                                                                   fc::time_point_sec(), db.head_block_time() );
+      BOOST_REQUIRE_EQUAL( buckets.size(), 1u );
+      BOOST_CHECK_EQUAL( buckets[0].base_volume.value, 500 );
+      BOOST_CHECK_EQUAL( buckets[0].quote_volume.value, 200 );
+      BOOST_CHECK_EQUAL( buckets[0].open_base.value, 200 );
+      BOOST_CHECK_EQUAL( buckets[0].close_base.value, 300 );
+      BOOST_CHECK_EQUAL( buckets[0].high_base.value, 300 );
+      BOOST_CHECK_EQUAL( buckets[0].low_base.value, 200 );
+      BOOST_CHECK_EQUAL( buckets[0].low_quote.value, 100 );
+
+      // expired buckets are swept even when the market doesn't trade again
+      generate_blocks( db.head_block_time() + fc::seconds( 900 ) );
+      buckets = hist_api.get_market_history( GRAPHENE_SYMBOL, "BUCKET", 300, fc::time_point_sec(), db.head_block_time() );
+      BOOST_CHECK( buckets.empty() );
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(market_history_store_fork) {
+   try {
+      graphene::market_history::market_history_store store;
+      const asset_id_type base;
+      const asset_id_type quote( 1 );
+
+      bucket_object bucket;
+      bucket.key = bucket_key( base, quote, 60, fc::time_point_sec( 600 ) );
+      bucket.base_volume = 10;
+      fill_order_operation fill;
+      fill.pays = asset( 10, base );
+      fill.receives = asset( 5, quote );
+
+      store.begin_block( 1 );
+      store.append_fill( fill, fc::time_point_sec( 600 ) );
+      store.store_bucket( bucket );
+      store.end_block( 0 );
+
+      store.begin_block( 2 );
+      store.append_fill( fill, fc::time_point_sec( 603 ) );
+      bucket.base_volume = 20;
+      store.store_bucket( bucket );
+      store.remove_buckets_before( 60, fc::time_point_sec( 660 ) );
+      BOOST_CHECK( !store.get_buckets( base, quote, 60 ) );
+      store.end_block( 1 );
+
+      // block 2 is replaced by a block from another fork
+      store.begin_block( 2 );
+      BOOST_REQUIRE_EQUAL( store.get_fills( base, quote )->size(), 1u );
+      BOOST_CHECK_EQUAL( store.get_fills( base, quote )->back().key.sequence, 0 );
+      const bucket_object* restored = store.find_bucket( bucket.key );
+      BOOST_REQUIRE( restored );
+      BOOST_CHECK_EQUAL( restored->base_volume.value, 10 );
+
+      // the fill of the other fork takes the id of the one it replaces
+      store.append_fill( fill, fc::time_point_sec( 606 ) );
+      BOOST_CHECK( store.get_fills( base, quote )->back().id == object_id_type( 0, 0, 1 ) );
+
+      // block 1 is irreversible
+      store.begin_block( 1 );
+      BOOST_CHECK_EQUAL( store.get_fills( base, quote )->size(), 1u );
+      BOOST_CHECK( store.get_fills( base, quote )->back().id == object_id_type( 0, 0, 0 ) );
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(market_history_store_log) {
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const fc::path log_file = data_dir.path() / "market_history.log";
+      const chain_id_type chain_id = db.get_chain_id();
+      const asset_id_type base;
+      const asset_id_type quote( 1 );
+      fill_order_operation fill;
+      fill.pays = asset( 10, base );
+      fill.receives = asset( 5, quote );
+
+      {
+         graphene::market_history::market_history_store store;
+         store.open( log_file, chain_id, GRAPHENE_CURRENT_DB_VERSION );
+         store.begin_block( 1 );
+         store.append_fill( fill, fc::time_point_sec( 600 ) );
+         store.append_fill( fill, fc::time_point_sec( 600 ) );
+         store.end_block( 1 );
+         store.begin_block( 2 );
+         store.append_fill( fill, fc::time_point_sec( 603 ) );
+         store.end_block( 1 );
+         store.close();
+      }
+      {
+         // only the irreversible block is logged, the other one comes back from the journal
+         graphene::market_history::market_history_store store;
+         store.open( log_file, chain_id, GRAPHENE_CURRENT_DB_VERSION );
+         BOOST_CHECK_EQUAL( store.last_logged_block_num(), 1u );
+         BOOST_REQUIRE_EQUAL( store.get_fills( base, quote )->size(), 3u );
+
+         // and can still be rolled back, fill ids carry on from the log
+         store.begin_block( 2 );
+         BOOST_REQUIRE_EQUAL( store.get_fills( base, quote )->size(), 2u );
+         store.append_fill( fill, fc::time_point_sec( 606 ) );
+         BOOST_CHECK( store.get_fills( base, quote )->back().id == object_id_type( 0, 0, 2 ) );
+         BOOST_CHECK( store.get_fills( base, quote )->back().time == fc::time_point_sec( 606 ) );
+      }
+      {
+         // the journal is not saved without a close
+         graphene::market_history::market_history_store store;
+         store.open( log_file, chain_id, GRAPHENE_CURRENT_DB_VERSION );
+         BOOST_CHECK_EQUAL( store.get_fills( base, quote )->size(), 2u );
+      }
+      {
+         // a log written for another database version is applied again from scratch
+         graphene::market_history::market_history_store store;
+         store.open( log_file, chain_id, "not the current version" );
+         BOOST_CHECK_EQUAL( store.last_logged_block_num(), 0u );
+         BOOST_CHECK( !store.get_fills( base, quote ) );
+      }
+      {
+         graphene::market_history::market_history_store store;
+         store.open( log_file, fc::sha256::hash( std::string( "another chain" ) ), "not the current version" );
+         BOOST_CHECK_EQUAL( store.last_logged_block_num(), 0u );
+      }
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(order_book_feed) {
+   try {
+      ACTORS( (buyer)(seller) );
+      const asset_object& test_asset = create_user_issued_asset( "DEPTH" );
+      const asset_object& core_asset = asset_id_type()(db);
+      issue_uia( seller, test_asset.amount( 10000 ) );
+      transfer( committee_account, buyer_id, core_asset.amount( 10000 ) );
+      generate_block();
+
+      graphene::market_history::order_book_feed& feed =
+         app.get_plugin<graphene::market_history::market_history_plugin>( "market_history" )->get_order_book_feed();
+      vector<graphene::market_history::order_book_diff> diffs;
+      boost::signals2::scoped_connection connection = feed.diffs_applied.connect(
+         [&diffs]( const vector<graphene::market_history::order_book_diff>& applied ) {
+            diffs.insert( diffs.end(), applied.begin(), applied.end() );
+         } );
+
+      graphene::market_history::order_book_snapshot snapshot = feed.watch( db, test_asset.id, core_asset.id );
+      BOOST_CHECK( snapshot.base == core_asset.id );
+      BOOST_CHECK_EQUAL( snapshot.sequence, 0u );
+      BOOST_CHECK( snapshot.asks.empty() && snapshot.bids.empty() );
+
+      // orders at the same price share a level
+      create_sell_order( seller, test_asset.amount( 100 ), core_asset.amount( 200 ) );
+      create_sell_order( seller, test_asset.amount( 100 ), core_asset.amount( 200 ) );
+      create_sell_order( seller, test_asset.amount( 100 ), core_asset.amount( 300 ) );
+      generate_block();
+      BOOST_REQUIRE_EQUAL( diffs.size(), 1u );
+      BOOST_CHECK_EQUAL( diffs[0].sequence, 1u );
+      BOOST_CHECK( diffs[0].asks.empty() );
+      BOOST_REQUIRE_EQUAL( diffs[0].bids.size(), 2u );
+      BOOST_CHECK_EQUAL( diffs[0].bids[0].for_sale.value, 200 );
+      BOOST_CHECK_EQUAL( diffs[0].bids[1].for_sale.value, 100 );
+      diffs.clear();
+
+      // the buyer takes one order and rests with the rest of its core
+      create_sell_order( buyer, core_asset.amount( 250 ), test_asset.amount( 100 ) );
+      generate_block();
+      BOOST_REQUIRE_EQUAL( diffs.size(), 1u );
+      BOOST_CHECK_EQUAL( diffs[0].sequence, 2u );
+      BOOST_REQUIRE_EQUAL( diffs[0].bids.size(), 1u );
+      BOOST_CHECK( diffs[0].bids[0].sell_price == test_asset.amount( 100 ) / core_asset.amount( 200 ) );
+      BOOST_CHECK_EQUAL( diffs[0].bids[0].for_sale.value, 100 );
+      BOOST_REQUIRE_EQUAL( diffs[0].asks.size(), 1u );
+      BOOST_CHECK_EQUAL( diffs[0].asks[0].for_sale.value, 50 );
+      BOOST_REQUIRE_EQUAL( diffs[0].trades.size(), 1u );
+      BOOST_CHECK( diffs[0].trades[0].pays == core_asset.amount( 200 ) );
+      diffs.clear();
+
+      // nothing is published for a block that doesn't touch the market
+      generate_block();
+      BOOST_CHECK( diffs.empty() );
+
+      snapshot = feed.get_snapshot( core_asset.id, test_asset.id );
+      BOOST_CHECK_EQUAL( snapshot.sequence, 2u );
+      BOOST_CHECK_EQUAL( snapshot.asks.size(), 1u );
+      BOOST_REQUIRE_EQUAL( snapshot.bids.size(), 2u );
+      BOOST_CHECK_EQUAL( snapshot.bids[0].for_sale.value, 100 );
+      BOOST_CHECK_EQUAL( snapshot.bids[1].for_sale.value, 100 );
+
+      feed.unwatch( core_asset.id, test_asset.id );
+      GRAPHENE_REQUIRE_THROW( feed.get_snapshot( core_asset.id, test_asset.id ), fc::exception );
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -543,4 +543,69 @@ BOOST_AUTO_TEST_CASE( lottery_winner_ticket_id_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( lottery_ticket_ranges_test )
+{
+   try {
+      asset_id_type test_asset_id = db.get_index<asset_object>().get_next_id();
+      INVOKE( create_lottery_asset_test );
+      auto test_asset = test_asset_id(db);
+      for( int i = 1; i < 5; ++i )
+         transfer(account_id_type(), account_id_type(i), asset(2000000));
+      // several purchases of different sizes per buyer, interleaved
+      for( int round = 1; round < 4; ++round ) {
+         for( int i = 1; i < 5; ++i ) {
+            ticket_purchase_operation tpo;
+            tpo.buyer = account_id_type(i);
+            tpo.lottery = test_asset.id;
+            tpo.tickets_to_buy = round * i;
+            tpo.amount = asset(100 * round * i);
+            trx.operations.push_back(std::move(tpo));
+            graphene::chain::test::set_expiration(db, trx);
+            PUSH_TX( db, trx, ~0 );
+            trx.operations.clear();
+         }
+      }
+      generate_block();
+      test_asset = test_asset_id(db);
+
+      auto holders = test_asset.get_holders(db);
+      auto ticket_ids = test_asset.get_ticket_ids(db);
+      auto ranges = test_asset.get_ticket_ranges(db);
+      BOOST_REQUIRE_EQUAL( ranges.size(), holders.size() );
+      BOOST_CHECK_EQUAL( ranges.owners.size(), 4u );
+      BOOST_REQUIRE_EQUAL( ticket_ids.size(), holders.size() );
+      for( uint64_t t = 0; t < holders.size(); ++t ) {
+         BOOST_CHECK( ranges.owners[ ranges.holder_index(t) ] == holders[t] );
+         auto ticket_id = test_asset.get_ticket_id( db, ranges, t );
+         BOOST_REQUIRE( ticket_id.valid() );
+         BOOST_CHECK_EQUAL( *ticket_id, ticket_ids[t] );
+      }
+      GRAPHENE_REQUIRE_THROW( ranges.holder_index( holders.size() ), fc::exception );
+
+      // a purchase undone with its block is forgotten
+      ticket_purchase_operation tpo;
+      tpo.buyer = account_id_type(1);
+      tpo.lottery = test_asset.id;
+      tpo.tickets_to_buy = 5;
+      tpo.amount = asset(100 * 5);
+      trx.operations.push_back(std::move(tpo));
+      graphene::chain::test::set_expiration(db, trx);
+      PUSH_TX( db, trx, ~0 );
+      trx.operations.clear();
+      generate_block();
+      db.pop_block();
+      test_asset = test_asset_id(db);
+      ranges = test_asset.get_ticket_ranges(db);
+      BOOST_REQUIRE_EQUAL( ranges.size(), holders.size() );
+      for( uint64_t t = 0; t < holders.size(); ++t ) {
+         auto ticket_id = test_asset.get_ticket_id( db, ranges, t );
+         BOOST_REQUIRE( ticket_id.valid() );
+         BOOST_CHECK_EQUAL( *ticket_id, ticket_ids[t] );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
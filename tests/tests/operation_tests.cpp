@@ -230,6 +230,52 @@ BOOST_AUTO_TEST_CASE( margin_call_limit_test )
    }
 }
 
+/**
+ *  Orders behind the best one selling an asset for its backing asset don't repeat the margin call check, but a
+ *  feed update or an order at the front of the book must still margin call.
+ */
+BOOST_AUTO_TEST_CASE( margin_call_after_skipped_checks )
+{ try {
+      ACTORS((borrower)(borrower2)(feedproducer));
+
+      const auto& bitusd = create_bitasset("USDBIT", feedproducer_id);
+      const auto& core   = asset_id_type()(db);
+      const auto& triggers = db.get_index_type< primary_index<limit_order_index> >().get_secondary_index<margin_call_trigger_index>();
+
+      transfer(committee_account, borrower_id, asset(1000000));
+      transfer(committee_account, borrower2_id, asset(1000000));
+      update_feed_producers( bitusd, {feedproducer.id} );
+
+      price_feed current_feed;
+      current_feed.settlement_price = bitusd.amount( 100 ) / core.amount(100);
+      publish_feed( bitusd, feedproducer, current_feed );
+
+      const call_order_object& call = *borrow( borrower, bitusd.amount(1000), asset(2000) );
+      borrow( borrower2, bitusd.amount(1000), asset(4000) );
+
+      BOOST_CHECK( create_sell_order( borrower2, bitusd.amount(100), core.amount(300) ) != nullptr );
+      BOOST_CHECK( triggers.is_clean( bitusd.id ) );
+      BOOST_CHECK( create_sell_order( borrower2, bitusd.amount(100), core.amount(400) ) != nullptr );
+      BOOST_CHECK( triggers.is_clean( bitusd.id ) );
+
+      // borrower is now below the maintenance collateral ratio, but no order sells cheaply enough to call it
+      current_feed.settlement_price = bitusd.amount( 100 ) / core.amount(150);
+      publish_feed( bitusd, feedproducer, current_feed );
+      BOOST_CHECK( triggers.is_clean( bitusd.id ) );
+      BOOST_CHECK( create_sell_order( borrower2, bitusd.amount(100), core.amount(500) ) != nullptr );
+      BOOST_CHECK( triggers.is_clean( bitusd.id ) );
+      BOOST_CHECK_EQUAL( call.debt.value, 1000 );
+
+      // a better order moves the front of the book and margin calls borrower
+      BOOST_CHECK( create_sell_order( borrower2, bitusd.amount(100), core.amount(200) ) == nullptr );
+      BOOST_CHECK_EQUAL( call.debt.value, 900 );
+      BOOST_CHECK_EQUAL( call.collateral.value, 2000 - 200 );
+   } catch( const fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 /**
  *  This test sets up the minimum condition for a black swan to occur but does
  *  not test the full range of cases that may be possible during a black swan.
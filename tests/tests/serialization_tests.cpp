@@ -25,6 +25,8 @@
 #include <boost/test/unit_test.hpp>
 
 #include <graphene/chain/database.hpp>
+#include <graphene/elasticsearch/json_writer.hpp>
+#include <graphene/chain/operation_history_object.hpp>
 
 
 #include <fc/crypto/digest.hpp>
@@ -35,6 +37,17 @@
 
 using namespace graphene::chain;
 
+namespace {
+
+template<typename T>
+void check_json_writer( const T& value )
+{
+   BOOST_CHECK_EQUAL( graphene::elasticsearch::to_json( value ),
+                      fc::json::to_string( fc::variant( value, GRAPHENE_MAX_NESTED_OBJECTS ) ) );
+}
+
+} // anonymous namespace
+
 BOOST_FIXTURE_TEST_SUITE( operation_unit_tests, database_fixture )
 
 BOOST_AUTO_TEST_CASE( serialization_raw_test )
@@ -148,4 +161,42 @@ BOOST_AUTO_TEST_CASE( extension_serialization_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( json_writer_test )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      const asset_object& uia = create_user_issued_asset( "JSONUIA" );
+      transfer( account_id_type(), alice_id, asset( 5000000000 ) );
+      transfer( alice_id, bob_id, asset( 1234 ) );
+      generate_block();
+
+      // chain objects, with unset optionals, static variants, maps and sets
+      check_json_writer( alice );
+      check_json_writer( alice.statistics( db ) );
+      check_json_writer( uia );
+      check_json_writer( db.get_global_properties() );
+      check_json_writer( db.get_dynamic_global_properties() );
+      check_json_writer( *db.fetch_block_by_number( db.head_block_num() ) );
+      for( const auto& history : db.get_index_type<operation_history_index>().indices() )
+         check_json_writer( history );
+
+      // large and negative numbers, enums and strings that need escaping
+      check_json_writer( asset( 5000000000 ) );
+      check_json_writer( asset( -5000000000 ) );
+      check_json_writer( std::make_pair( uint64_t( 4294967296 ), int32_t( -1 ) ) );
+      check_json_writer( vote_id_type::committee );
+      asset_object escaped = uia;
+      escaped.options.description = "line\n\"quoted\" \\ \x01 \xc3\xa9";
+      check_json_writer( escaped );
+      check_json_writer( fc::variant( escaped, GRAPHENE_MAX_NESTED_OBJECTS ) );
+      check_json_writer( fc::optional<asset>() );
+   }
+   catch ( const fc::exception& e )
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()